@@ -7,6 +7,7 @@
 #include "waveform_tables.h"
 #include "dac_output.h"
 #include "uart_labels.h"
+#include "campaign.h"
 
 // Configuration
 #define WAVEFORM_SWITCH_PERIOD_MS  5000    // Base switch period
@@ -23,6 +24,36 @@ void heartbeat_task(void *pvParameter) {
     }
 }
 
+#if DAC_STREAMING_ENABLE
+// Plays the selected campaign; the output holds its last step afterwards
+void waveform_manager_task(void *pvParameter) {
+    campaign_run(campaign_get(CAMPAIGN_SELECT), CAMPAIGN_REPEATS);
+    ESP_LOGI(TAG, "Campaign finished, holding the last step");
+    vTaskDelete(NULL);
+}
+
+// Labels each segment once it has actually reached the DAC
+void label_reporter_task(void *pvParameter) {
+    dac_switch_event_t event;
+    
+    while (1) {
+        if (!dac_output_wait_switch(&event, portMAX_DELAY)) {
+            continue;
+        }
+        
+        // The stamped switch first: the label that follows is then a repeat
+        // and only serves as the acknowledged fallback
+        uart_send_waveform_config(&event);
+        if (!uart_send_label_with_ack(event.segment.type)) {
+            ESP_LOGW(TAG, "Failed to get ACK for waveform %d, continuing anyway", event.segment.type);
+        }
+        
+        ESP_LOGI(TAG, "Waveform %d at sample %llu (%.0f->%.0f Hz), output %lld us ago",
+                 event.segment.type, event.sample_index, event.segment.start_hz,
+                 event.segment.end_hz, esp_timer_get_time() - event.output_time_us);
+    }
+}
+#else
 // Waveform management task
 void waveform_manager_task(void *pvParameter) {
     waveform_type_t current_waveform = INITIAL_WAVEFORM;
@@ -58,6 +89,7 @@ void waveform_manager_task(void *pvParameter) {
                  current_waveform, delay_ms, jitter_ms);
     }
 }
+#endif
 
 void app_main(void) {
     // Initialize logging
@@ -85,6 +117,11 @@ void app_main(void) {
         NULL                    // Task handle
     );
     
+#if DAC_STREAMING_ENABLE
+    // Sends labels, so it must keep up with switches but not starve the DAC
+    xTaskCreate(label_reporter_task, "label_rpt", 4096, NULL, 5, NULL);
+#endif
+    
     // Create heartbeat task
     xTaskCreate(
         heartbeat_task,         // Task function
@@ -99,6 +136,14 @@ void app_main(void) {
     int counter = 0;
     while (1) {
         ESP_LOGI(TAG, "System running... (loop %d)", ++counter);
+#if DAC_STREAMING_ENABLE
+        dac_stream_stats_t stats;
+        dac_output_get_stream_stats(&stats);
+        ESP_LOGI(TAG, "DAC stream: %lu blocks, %lu underruns, %lu short loads, "
+                 "%lu switches dropped, render max %lu us",
+                 stats.blocks_rendered, stats.underruns, stats.short_loads,
+                 stats.switches_dropped, stats.render_max_us);
+#endif
         vTaskDelay(pdMS_TO_TICKS(10000));
     }
 }
\ No newline at end of file
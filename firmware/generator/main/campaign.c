@@ -0,0 +1,125 @@
+#include "campaign.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <stdlib.h>
+
+#if DAC_STREAMING_ENABLE
+
+static const char *TAG = "campaign";
+
+#define STEP(t, ms, amp, off) { .type = (t), .dwell_ms = (ms), .frequency_hz = 0.0f, \
+                                .amplitude = (amp), .offset = (off) }
+
+// Long dwells: steady-state accuracy and a clean detection latency
+static const campaign_step_t s_dwell_steps[] = {
+    STEP(WAVEFORM_SINE,     5000, 1.0f, 0.0f),
+    STEP(WAVEFORM_SQUARE,   5000, 1.0f, 0.0f),
+    STEP(WAVEFORM_TRIANGLE, 5000, 1.0f, 0.0f),
+    STEP(WAVEFORM_SAWTOOTH, 5000, 1.0f, 0.0f),
+};
+
+// Throughput under rapid switching: every type at each dwell
+#define RAPID_ROUND(ms) \
+    STEP(WAVEFORM_SINE, ms, 1.0f, 0.0f), STEP(WAVEFORM_SQUARE, ms, 1.0f, 0.0f), \
+    STEP(WAVEFORM_TRIANGLE, ms, 1.0f, 0.0f), STEP(WAVEFORM_SAWTOOTH, ms, 1.0f, 0.0f)
+
+static const campaign_step_t s_rapid_steps[] = {
+    RAPID_ROUND(2000),
+    RAPID_ROUND(1000),
+    RAPID_ROUND(500),
+    RAPID_ROUND(250),
+    RAPID_ROUND(100),
+};
+
+// Level robustness: shrinking amplitude, then shifted offsets
+#define LEVEL_ROUND(t) \
+    STEP(t, 3000, 1.0f, 0.0f), STEP(t, 3000, 0.6f, 0.0f), STEP(t, 3000, 0.3f, 0.0f), \
+    STEP(t, 3000, 0.6f, 0.2f), STEP(t, 3000, 0.6f, -0.2f)
+
+static const campaign_step_t s_level_steps[] = {
+    LEVEL_ROUND(WAVEFORM_SINE),
+    LEVEL_ROUND(WAVEFORM_SQUARE),
+    LEVEL_ROUND(WAVEFORM_TRIANGLE),
+    LEVEL_ROUND(WAVEFORM_SAWTOOTH),
+};
+
+#define STEPS(a) (a), (sizeof(a) / sizeof((a)[0]))
+
+static const campaign_t s_campaigns[CAMPAIGN_COUNT] = {
+    [CAMPAIGN_RANDOM_SWEEP] = { "random_sweep", NULL, WAVEFORM_COUNT, SWEEP_JITTER_MS },
+    [CAMPAIGN_DWELL]        = { "dwell", STEPS(s_dwell_steps), 500 },
+    [CAMPAIGN_RAPID]        = { "rapid", STEPS(s_rapid_steps), 0 },
+    [CAMPAIGN_LEVELS]       = { "levels", STEPS(s_level_steps), 0 },
+};
+
+static float random_between(float lo, float hi) {
+    return lo + (hi - lo) * (float)rand() / (float)RAND_MAX;
+}
+
+static uint32_t jittered_samples(uint32_t dwell_ms, uint32_t jitter_ms) {
+    int32_t ms = (int32_t)dwell_ms;
+    if (jitter_ms) {
+        ms += (rand() % (2 * jitter_ms + 1)) - (int32_t)jitter_ms;
+    }
+    if (ms < 1) ms = 1;
+    return (uint32_t)ms * (DAC_CONVERT_FREQ_HZ / 1000);
+}
+
+static void build_segment(const campaign_t *campaign, uint32_t index, dac_segment_t *segment) {
+    if (!campaign->steps) {
+        *segment = (dac_segment_t){
+            .type = (waveform_type_t)(index % WAVEFORM_COUNT),
+            .start_hz = random_between(SWEEP_MIN_HZ, SWEEP_MAX_HZ),
+            .end_hz = random_between(SWEEP_MIN_HZ, SWEEP_MAX_HZ),
+            .start_amplitude = random_between(SWEEP_MIN_AMPLITUDE, SWEEP_MAX_AMPLITUDE),
+            .end_amplitude = random_between(SWEEP_MIN_AMPLITUDE, SWEEP_MAX_AMPLITUDE),
+            .start_offset = random_between(-SWEEP_MAX_OFFSET, SWEEP_MAX_OFFSET),
+            .end_offset = random_between(-SWEEP_MAX_OFFSET, SWEEP_MAX_OFFSET),
+            .noise = random_between(0.0f, SWEEP_MAX_NOISE),
+            .duration_samples = jittered_samples(SWEEP_PERIOD_MS, campaign->jitter_ms),
+        };
+        return;
+    }
+
+    const campaign_step_t *step = &campaign->steps[index];
+    float hz = step->frequency_hz > 0.0f ? step->frequency_hz : CAMPAIGN_NOMINAL_HZ;
+    *segment = (dac_segment_t){
+        .type = step->type,
+        .start_hz = hz,
+        .end_hz = hz,
+        .start_amplitude = step->amplitude,
+        .end_amplitude = step->amplitude,
+        .start_offset = step->offset,
+        .end_offset = step->offset,
+        .noise = 0.0f,
+        .duration_samples = jittered_samples(step->dwell_ms, campaign->jitter_ms),
+    };
+}
+
+const campaign_t *campaign_get(campaign_id_t id) {
+    return (id >= 0 && id < CAMPAIGN_COUNT) ? &s_campaigns[id] : NULL;
+}
+
+void campaign_run(const campaign_t *campaign, uint32_t repeats) {
+    if (!campaign) return;
+
+    srand(esp_timer_get_time());
+    ESP_LOGI(TAG, "Campaign '%s': %lu steps, jitter ±%lu ms, %lu passes (0 = forever)",
+             campaign->name, (unsigned long)campaign->step_count,
+             (unsigned long)campaign->jitter_ms, (unsigned long)repeats);
+
+    for (uint32_t pass = 0; repeats == 0 || pass < repeats; pass++) {
+        for (uint32_t i = 0; i < campaign->step_count; i++) {
+            dac_segment_t segment;
+            build_segment(campaign, i, &segment);
+            // Blocks while DAC_STREAM_SEGMENT_QUEUE segments are waiting
+            dac_output_queue_segment(&segment, portMAX_DELAY);
+            ESP_LOGD(TAG, "Pass %lu step %lu queued: waveform %d for %lu samples",
+                     (unsigned long)pass, (unsigned long)i, segment.type,
+                     (unsigned long)segment.duration_samples);
+        }
+        ESP_LOGI(TAG, "Campaign '%s' pass %lu queued", campaign->name, (unsigned long)pass);
+    }
+}
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef CAMPAIGN_H
+#define CAMPAIGN_H
+
+#include <stdint.h>
+#include "dac_output.h"
+#include "waveform_tables.h"
+
+// Built-in test schedules
+typedef enum {
+    CAMPAIGN_RANDOM_SWEEP,   // Cycling types with random sweeps, 5 s ±500 ms
+    CAMPAIGN_DWELL,          // Each type for 5 s at training parameters
+    CAMPAIGN_RAPID,          // Dwell shrinking from 2 s to 100 ms
+    CAMPAIGN_LEVELS,         // Amplitude and offset steps per type
+    CAMPAIGN_COUNT
+} campaign_id_t;
+
+// Configuration
+#define CAMPAIGN_SELECT         CAMPAIGN_DWELL
+#define CAMPAIGN_REPEATS        0        // Passes over the schedule, 0 = forever
+#define CAMPAIGN_NOMINAL_HZ     ((float)DAC_CONVERT_FREQ_HZ / TABLE_SIZE)  // One LUT per 256 samples
+
+// CAMPAIGN_RANDOM_SWEEP: each segment sweeps between random points of this space
+#define SWEEP_PERIOD_MS         5000
+#define SWEEP_JITTER_MS         500
+#define SWEEP_MIN_HZ            40.0f
+#define SWEEP_MAX_HZ            320.0f
+#define SWEEP_MIN_AMPLITUDE     0.5f
+#define SWEEP_MAX_AMPLITUDE     1.0f
+#define SWEEP_MAX_OFFSET        0.1f
+#define SWEEP_MAX_NOISE         0.03f
+
+// One scripted segment, held steady for its dwell
+typedef struct {
+    waveform_type_t type;
+    uint32_t dwell_ms;
+    float frequency_hz;         // 0 = CAMPAIGN_NOMINAL_HZ
+    float amplitude;            // 0.0 to 1.0
+    float offset;               // -0.5 to 0.5
+} campaign_step_t;
+
+typedef struct {
+    const char *name;
+    const campaign_step_t *steps;   // NULL = random sweeps
+    uint32_t step_count;
+    uint32_t jitter_ms;             // Uniform ±jitter on every dwell
+} campaign_t;
+
+/**
+ * @brief Look up a built-in campaign
+ *
+ * @param id Campaign
+ * @return Campaign, or NULL for an unknown id
+ */
+const campaign_t *campaign_get(campaign_id_t id);
+
+/**
+ * @brief Play a campaign through the streaming output
+ *
+ * Queues one segment per step, blocking while the DAC segment queue is
+ * full, so steps switch on exact sample indices; each switch is reported
+ * by dac_output_wait_switch() once played. Returns after the last step is
+ * queued; the output then holds it.
+ *
+ * @param campaign Campaign to play
+ * @param repeats Passes over the schedule, 0 = forever
+ */
+void campaign_run(const campaign_t *campaign, uint32_t repeats);
+
+#endif
@@ -1,8 +1,13 @@
 #include "dac_output.h"
 #include "waveform_tables.h"
 #include "driver/dac_continuous.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_attr.h"
 #include "esp_check.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "soc/soc_caps.h"
 #include <string.h>
 
 static const char *TAG = "dac_output";
@@ -14,10 +19,6 @@ static waveform_config_t current_config = {
     .frequency_hz = 0
 };
 
-// Phase drift simulation
-static uint32_t s_phase_offset = 0;
-static uint32_t s_phase_increment = 1;  // Samples to shift per cycle
-
 // Map waveform type to LUT
 static const uint8_t* get_waveform_lut(waveform_type_t type) {
     switch (type) {
@@ -29,6 +30,423 @@ static const uint8_t* get_waveform_lut(waveform_type_t type) {
     }
 }
 
+#if DAC_STREAMING_ENABLE
+
+/*
+ * Streaming synthesis. The DMA-done callback hands each played buffer to
+ * the stream task, which refills it with the next block from a 32-bit
+ * phase accumulator over the LUTs (8.8 linear interpolation, Q15 gain,
+ * Q8 offset and noise). Segment parameters are interpolated exactly at
+ * block boundaries in 64-bit and stepped per sample within a block, so
+ * ramp rounding never accumulates.
+ *
+ * Block j is written into the buffer released by done event j and plays
+ * after the other DAC_STREAM_DESC_NUM - 1 buffers, so done event
+ * j + DAC_STREAM_DESC_NUM marks the end of its output: that sets the
+ * output time of any switch inside it.
+ */
+
+#if SOC_DAC_DMA_16BIT_ALIGN
+#define DMA_BYTES_PER_SAMPLE    2       // 8-bit samples expand to 16-bit DMA slots
+#else
+#define DMA_BYTES_PER_SAMPLE    1
+#endif
+
+#define STREAM_TASK_STACK       3072
+// One less than the buffers in flight: a full queue means the oldest
+// released buffer is already replaying stale samples
+#define DONE_QUEUE_DEPTH        (DAC_STREAM_DESC_NUM - 1)
+#define SWITCH_QUEUE_DEPTH      8
+#define PENDING_SWITCHES        (DAC_STREAM_SEGMENT_QUEUE + DAC_STREAM_DESC_NUM + 2)
+#define SAMPLE_PERIOD_US        (1000000 / DAC_CONVERT_FREQ_HZ)
+
+_Static_assert(1000000 % DAC_CONVERT_FREQ_HZ == 0, "sample period must be whole microseconds");
+
+typedef struct {
+    void *buf;
+    size_t size;
+    int64_t time_us;
+} dma_done_t;
+
+// A ramp from start to end over a segment, in fixed point
+typedef struct {
+    int32_t start;
+    int32_t end;
+} ramp_t;
+
+typedef struct {
+    dac_segment_t config;
+    const uint8_t *lut;
+    uint32_t duration;          // 0 = hold
+    uint32_t position;          // Samples played so far
+    ramp_t step;                // Phase increment (2^32 = sample rate)
+    ramp_t gain_q15;
+    ramp_t offset_q8;           // DAC LSBs
+    int32_t noise_q8;
+} stream_segment_t;
+
+static stream_segment_t s_segment;
+static uint32_t s_phase = 0;
+static uint32_t s_noise_state = 0x2545F491;
+static uint64_t s_next_sample = 0;
+
+static QueueHandle_t s_done_queue = NULL;
+static QueueHandle_t s_segment_queue = NULL;
+static QueueHandle_t s_switch_queue = NULL;
+
+// Switches rendered but not yet played, oldest first
+static dac_switch_event_t s_pending[PENDING_SWITCHES];
+static int s_pending_count = 0;
+
+static uint32_t s_done_events = 0;
+static bool s_timing_valid = true;
+static uint8_t s_block[DAC_STREAM_BLOCK_SAMPLES];
+static dac_stream_stats_t s_stats;
+static volatile uint32_t s_isr_overflows = 0;
+
+static inline int32_t clamp_i32(int32_t v, int32_t lo, int32_t hi) {
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+static inline int32_t ramp_at(const ramp_t *r, uint32_t position, uint32_t duration) {
+    if (duration == 0 || position >= duration) {
+        return duration == 0 ? r->start : r->end;
+    }
+    return r->start + (int32_t)(((int64_t)r->end - r->start) * position / duration);
+}
+
+// Phase increment for a frequency, capped just below Nyquist so ramps fit int32
+static int32_t hz_to_step(float hz) {
+    double step = (double)hz * 4294967296.0 / DAC_CONVERT_FREQ_HZ;
+    return step <= 0.0 ? 0 : (step >= 2147483647.0 ? INT32_MAX : (int32_t)step);
+}
+
+static int32_t to_q15(float v) {
+    return clamp_i32((int32_t)(v * 32768.0f), 0, 32768);
+}
+
+static int32_t to_lsb_q8(float v, float limit) {
+    v = v < -limit ? -limit : (v > limit ? limit : v);
+    return (int32_t)(v * 255.0f * 256.0f);
+}
+
+// Float math happens here, once per segment
+static void segment_load(const dac_segment_t *config) {
+    s_segment.config = *config;
+    s_segment.lut = get_waveform_lut(config->type);
+    s_segment.duration = config->duration_samples;
+    s_segment.position = 0;
+    s_segment.step.start = hz_to_step(config->start_hz);
+    s_segment.step.end = hz_to_step(config->end_hz);
+    s_segment.gain_q15.start = to_q15(config->start_amplitude);
+    s_segment.gain_q15.end = to_q15(config->end_amplitude);
+    s_segment.offset_q8.start = to_lsb_q8(config->start_offset, 0.5f);
+    s_segment.offset_q8.end = to_lsb_q8(config->end_offset, 0.5f);
+    s_segment.noise_q8 = to_lsb_q8(config->noise, 0.25f);
+}
+
+// Remember where the new segment starts; reported once it has played
+static void segment_note_switch(void) {
+    if (s_pending_count == PENDING_SWITCHES) {
+        memmove(&s_pending[0], &s_pending[1], (PENDING_SWITCHES - 1) * sizeof(s_pending[0]));
+        s_pending_count--;
+        s_stats.switches_dropped++;
+    }
+    dac_switch_event_t *sw = &s_pending[s_pending_count++];
+    sw->segment = s_segment.config;
+    sw->sample_index = s_next_sample;
+    sw->output_time_us = 0;
+    sw->timing_valid = s_timing_valid;
+}
+
+/*
+ * Synthesize count samples of the current segment: no float and no
+ * division per sample. Ramps restart from their exact value on every call.
+ */
+static void render_span(uint8_t *out, uint32_t count) {
+    stream_segment_t *seg = &s_segment;
+    uint32_t p0 = seg->position;
+    uint32_t p1 = p0 + count;
+
+    int32_t step = ramp_at(&seg->step, p0, seg->duration);
+    int32_t step_delta = (ramp_at(&seg->step, p1, seg->duration) - step) / (int32_t)count;
+    int32_t gain = ramp_at(&seg->gain_q15, p0, seg->duration);
+    int32_t gain_delta = (ramp_at(&seg->gain_q15, p1, seg->duration) - gain) / (int32_t)count;
+    int32_t offset = ramp_at(&seg->offset_q8, p0, seg->duration);
+    int32_t offset_delta = (ramp_at(&seg->offset_q8, p1, seg->duration) - offset) / (int32_t)count;
+
+    const uint8_t *lut = seg->lut;
+    int32_t noise_q8 = seg->noise_q8;
+    uint32_t phase = s_phase;
+    uint32_t x = s_noise_state;
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t index = phase >> 24;
+        int32_t frac = (phase >> 16) & 0xFF;
+        int32_t a = lut[index];
+        int32_t b = lut[(index + 1) & (TABLE_SIZE - 1)];
+        uint32_t level_q8 = (uint32_t)((a << 8) + (b - a) * frac);
+
+        int32_t v_q8 = (int32_t)((level_q8 * (uint32_t)gain) >> 15) + offset;
+        if (noise_q8) {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            v_q8 += (((int32_t)(x >> 16) - 32768) * noise_q8) >> 15;
+        }
+        out[i] = (uint8_t)clamp_i32((v_q8 + 128) >> 8, 0, 255);
+
+        phase += (uint32_t)step;
+        step += step_delta;
+        gain += gain_delta;
+        offset += offset_delta;
+    }
+
+    s_phase = phase;
+    s_noise_state = x;
+    seg->position = p1;
+}
+
+// Fill one block, switching segments at their exact sample index
+static void render_block(uint8_t *out) {
+    uint32_t done = 0;
+    dac_segment_t next;
+
+    while (done < DAC_STREAM_BLOCK_SAMPLES) {
+        bool finished = s_segment.duration && s_segment.position >= s_segment.duration;
+        bool preempted = !s_segment.duration && uxQueueMessagesWaiting(s_segment_queue) > 0;
+        if ((finished || preempted) && xQueueReceive(s_segment_queue, &next, 0) == pdTRUE) {
+            segment_load(&next);
+            segment_note_switch();
+        } else if (finished) {
+            // Nothing queued: hold the end values
+            s_segment.config.start_hz = s_segment.config.end_hz;
+            s_segment.config.start_amplitude = s_segment.config.end_amplitude;
+            s_segment.config.start_offset = s_segment.config.end_offset;
+            s_segment.config.duration_samples = 0;
+            segment_load(&s_segment.config);
+        }
+
+        uint32_t count = DAC_STREAM_BLOCK_SAMPLES - done;
+        if (s_segment.duration && s_segment.duration - s_segment.position < count) {
+            count = s_segment.duration - s_segment.position;
+        }
+        render_span(out + done, count);
+        done += count;
+        s_next_sample += count;
+    }
+}
+
+// Switches inside the block that just finished playing now have a time
+static void report_played(uint64_t end_sample, int64_t end_time_us) {
+    int reported = 0;
+    while (reported < s_pending_count && s_pending[reported].sample_index < end_sample) {
+        dac_switch_event_t *sw = &s_pending[reported];
+        sw->output_time_us = end_time_us - (int64_t)(end_sample - sw->sample_index) * SAMPLE_PERIOD_US;
+        sw->timing_valid = sw->timing_valid && s_timing_valid;
+        if (xQueueSend(s_switch_queue, sw, 0) != pdTRUE) {
+            s_stats.switches_dropped++;
+        }
+        reported++;
+    }
+    if (reported) {
+        memmove(&s_pending[0], &s_pending[reported], (s_pending_count - reported) * sizeof(s_pending[0]));
+        s_pending_count -= reported;
+    }
+}
+
+static IRAM_ATTR bool on_convert_done(dac_continuous_handle_t handle, const dac_event_data_t *event,
+                                      void *user_data) {
+    BaseType_t woken = pdFALSE;
+    dma_done_t done = {
+        .buf = event->buf,
+        .size = event->buf_size,
+        .time_us = esp_timer_get_time(),
+    };
+    if (xQueueSendFromISR(s_done_queue, &done, &woken) != pdTRUE) {
+        s_isr_overflows++;
+    }
+    return woken == pdTRUE;
+}
+
+static void dac_stream_task(void *arg) {
+    dma_done_t done;
+
+    while (1) {
+        if (xQueueReceive(s_done_queue, &done, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+
+        // A lost done event means a buffer replayed stale data: the
+        // block-to-time mapping is off from here on
+        if (s_isr_overflows) {
+            s_stats.underruns += s_isr_overflows;
+            s_isr_overflows = 0;
+            s_timing_valid = false;
+        }
+
+        if (s_done_events >= DAC_STREAM_DESC_NUM) {
+            uint64_t end_sample = (uint64_t)(s_done_events - DAC_STREAM_DESC_NUM + 1) * DAC_STREAM_BLOCK_SAMPLES;
+            report_played(end_sample, done.time_us);
+        }
+        s_done_events++;
+
+        int64_t start = esp_timer_get_time();
+        render_block(s_block);
+        uint32_t render_us = (uint32_t)(esp_timer_get_time() - start);
+        if (render_us > s_stats.render_max_us) {
+            s_stats.render_max_us = render_us;
+        }
+
+        size_t loaded = 0;
+        dac_continuous_write_asynchronously(dac_handle, done.buf, done.size,
+                                            s_block, DAC_STREAM_BLOCK_SAMPLES, &loaded);
+        if (loaded != DAC_STREAM_BLOCK_SAMPLES) {
+            s_stats.short_loads++;
+            s_timing_valid = false;
+        }
+        s_stats.blocks_rendered++;
+        s_stats.samples_rendered = s_next_sample;
+    }
+}
+
+static void config_to_segment(const waveform_config_t *config, dac_segment_t *segment) {
+    float hz = config->frequency_hz ? (float)config->frequency_hz
+                                    : (float)DAC_CONVERT_FREQ_HZ / TABLE_SIZE;
+    *segment = (dac_segment_t){
+        .type = config->type,
+        .start_hz = hz,
+        .end_hz = hz,
+        .start_amplitude = config->amplitude,
+        .end_amplitude = config->amplitude,
+        .start_offset = config->dc_offset,
+        .end_offset = config->dc_offset,
+        .noise = 0.0f,
+        .duration_samples = 0,
+    };
+}
+
+/**
+ * @brief Initializes the DAC continuous mode with DMA-done callbacks
+ */
+void dac_output_init(void) {
+    s_done_queue = xQueueCreate(DONE_QUEUE_DEPTH, sizeof(dma_done_t));
+    s_segment_queue = xQueueCreate(DAC_STREAM_SEGMENT_QUEUE, sizeof(dac_segment_t));
+    s_switch_queue = xQueueCreate(SWITCH_QUEUE_DEPTH, sizeof(dac_switch_event_t));
+    if (!s_done_queue || !s_segment_queue || !s_switch_queue) {
+        ESP_LOGE(TAG, "Failed to create stream queues");
+        return;
+    }
+
+    dac_continuous_config_t dac_config = {
+        .chan_mask = DAC_CHANNEL_MASK_CH0,  // Only DAC channel 0 (GPIO25)
+        .desc_num = DAC_STREAM_DESC_NUM,
+        .buf_size = DAC_STREAM_BLOCK_SAMPLES * DMA_BYTES_PER_SAMPLE,
+        .freq_hz = DAC_CONVERT_FREQ_HZ,
+        .offset = 0,
+        .clk_src = DAC_DIGI_CLK_SRC_DEFAULT,
+        .chan_mode = DAC_CHANNEL_MODE_SIMUL,
+    };
+    ESP_ERROR_CHECK(dac_continuous_new_channels(&dac_config, &dac_handle));
+
+    // Callbacks must be registered before the channel is enabled
+    dac_event_callbacks_t callbacks = {
+        .on_convert_done = on_convert_done,
+        .on_stop = NULL,
+    };
+    ESP_ERROR_CHECK(dac_continuous_register_event_callback(dac_handle, &callbacks, NULL));
+    ESP_ERROR_CHECK(dac_continuous_enable(dac_handle));
+
+    dac_segment_t initial;
+    config_to_segment(&current_config, &initial);
+    segment_load(&initial);
+    segment_note_switch();
+
+    ESP_LOGI(TAG, "DAC streaming initialized: %d Hz, %d x %d-sample DMA buffers",
+             DAC_CONVERT_FREQ_HZ, DAC_STREAM_DESC_NUM, DAC_STREAM_BLOCK_SAMPLES);
+}
+
+/**
+ * @brief Switches the active waveform (simple version)
+ */
+void dac_output_set_waveform(waveform_type_t type) {
+    waveform_config_t config = {
+        .type = type,
+        .amplitude = DEFAULT_AMPLITUDE,
+        .dc_offset = DEFAULT_DC_OFFSET,
+        .frequency_hz = 0
+    };
+    dac_output_set_waveform_config(&config);
+}
+
+/**
+ * @brief Holds a waveform from the next output block on
+ */
+void dac_output_set_waveform_config(waveform_config_t *config) {
+    if (!config) return;
+
+    current_config = *config;
+    dac_segment_t segment;
+    config_to_segment(config, &segment);
+    if (!dac_output_queue_segment(&segment, portMAX_DELAY)) {
+        ESP_LOGW(TAG, "Waveform change not queued");
+        return;
+    }
+    ESP_LOGI(TAG, "Waveform queued: %d at %.1f Hz (amp: %.2f, offset: %.2f)",
+             segment.type, segment.start_hz, current_config.amplitude, current_config.dc_offset);
+}
+
+bool dac_output_queue_segment(const dac_segment_t *segment, TickType_t timeout) {
+    if (!segment || !s_segment_queue || segment->type >= WAVEFORM_COUNT) {
+        return false;
+    }
+    return xQueueSend(s_segment_queue, segment, timeout) == pdTRUE;
+}
+
+bool dac_output_wait_switch(dac_switch_event_t *event, TickType_t timeout) {
+    if (!event || !s_switch_queue) {
+        return false;
+    }
+    return xQueueReceive(s_switch_queue, event, timeout) == pdTRUE;
+}
+
+void dac_output_get_stream_stats(dac_stream_stats_t *stats) {
+    if (!stats) return;
+    *stats = s_stats;
+}
+
+/**
+ * @brief Starts DAC output
+ */
+void dac_output_start(void) {
+    if (dac_handle) {
+        if (xTaskCreate(dac_stream_task, "dac_stream", STREAM_TASK_STACK, NULL,
+                        DAC_STREAM_TASK_PRIORITY, NULL) != pdPASS) {
+            ESP_LOGE(TAG, "Failed to create stream task");
+            return;
+        }
+        ESP_ERROR_CHECK(dac_continuous_start_async_writing(dac_handle));
+        ESP_LOGI(TAG, "DAC streaming started");
+    }
+}
+
+/**
+ * @brief Stops DAC output
+ */
+void dac_output_stop(void) {
+    if (dac_handle) {
+        ESP_ERROR_CHECK(dac_continuous_stop_async_writing(dac_handle));
+        ESP_ERROR_CHECK(dac_continuous_disable(dac_handle));
+        ESP_LOGI(TAG, "DAC output stopped");
+    }
+}
+
+#else /* !DAC_STREAMING_ENABLE */
+
+// Phase drift simulation
+static uint32_t s_phase_offset = 0;
+static uint32_t s_phase_increment = 1;  // Samples to shift per cycle
+
 /**
  * @brief Generate waveform sample with amplitude and offset control
  */
@@ -125,6 +543,19 @@ void dac_output_set_waveform_config(waveform_config_t *config) {
     }
 }
 
+// Segments need the streaming engine
+bool dac_output_queue_segment(const dac_segment_t *segment, TickType_t timeout) {
+    return false;
+}
+
+bool dac_output_wait_switch(dac_switch_event_t *event, TickType_t timeout) {
+    return false;
+}
+
+void dac_output_get_stream_stats(dac_stream_stats_t *stats) {
+    if (stats) memset(stats, 0, sizeof(*stats));
+}
+
 /**
  * @brief Starts DAC output
  */
@@ -160,6 +591,8 @@ void dac_output_stop(void) {
     }
 }
 
+#endif /* DAC_STREAMING_ENABLE */
+
 /**
  * @brief Checks if DAC is running
  */
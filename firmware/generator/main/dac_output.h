@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "freertos/FreeRTOS.h"
 #include "driver/dac_continuous.h"
 
 // Define the available waveforms for the system
@@ -19,7 +20,7 @@ typedef struct {
     waveform_type_t type;
     float amplitude;        // 0.0 to 1.0
     float dc_offset;        // -0.5 to 0.5
-    uint32_t frequency_hz;  // Not used in current implementation but available
+    uint32_t frequency_hz;  // 0 = one LUT period per TABLE_SIZE samples (streaming only)
 } waveform_config_t;
 
 // Configuration
@@ -28,6 +29,51 @@ typedef struct {
 #define DEFAULT_AMPLITUDE       1.0f
 #define DEFAULT_DC_OFFSET       0.0f
 
+// Streaming synthesis: DMA buffers refilled from a phase-accumulator NCO.
+// 0 = legacy mode, one fixed buffer written cyclically.
+#define DAC_STREAMING_ENABLE    1
+#define DAC_STREAM_BLOCK_SAMPLES 256     // Samples per DMA buffer (12.8 ms)
+#define DAC_STREAM_DESC_NUM      4       // DMA buffers in flight
+#define DAC_STREAM_SEGMENT_QUEUE 2       // Segments queued ahead of the output
+#define DAC_STREAM_TASK_PRIORITY 10
+
+/**
+ * @brief One stretch of output, optionally sweeping its parameters
+ *
+ * Each parameter moves linearly from its start to its end value over
+ * duration_samples. Segments play back to back with continuous phase.
+ */
+typedef struct {
+    waveform_type_t type;
+    float start_hz;             // Fundamental frequency (0..DAC_CONVERT_FREQ_HZ / 2)
+    float end_hz;
+    float start_amplitude;      // 0.0 to 1.0
+    float end_amplitude;
+    float start_offset;         // DC offset, -0.5 to 0.5 of full scale
+    float end_offset;
+    float noise;                // Uniform noise amplitude, 0.0 to 0.25 of full scale
+    uint32_t duration_samples;  // 0 = hold until the next segment is queued
+} dac_segment_t;
+
+/**
+ * @brief A segment taking over the output
+ */
+typedef struct {
+    dac_segment_t segment;
+    uint64_t sample_index;      // Index of the segment's first output sample
+    int64_t output_time_us;     // esp_timer time that sample left the DMA
+    bool timing_valid;          // false if a DMA underrun broke the buffer accounting
+} dac_switch_event_t;
+
+typedef struct {
+    uint64_t samples_rendered;
+    uint32_t blocks_rendered;
+    uint32_t underruns;         // DMA buffers not refilled in time
+    uint32_t short_loads;       // Blocks the driver did not take whole
+    uint32_t switches_dropped;  // Switch events nobody collected
+    uint32_t render_max_us;     // Slowest block synthesis
+} dac_stream_stats_t;
+
 // Function Prototypes
 void dac_output_init(void);
 void dac_output_set_waveform(waveform_type_t type);
@@ -36,4 +82,34 @@ void dac_output_start(void);
 void dac_output_stop(void);
 bool dac_output_is_running(void);
 
-#endif
\ No newline at end of file
+/**
+ * @brief Queue a segment behind the ones already scheduled (streaming mode)
+ *
+ * A hold segment (duration 0) ends as soon as another segment is queued.
+ *
+ * @param segment Segment to play
+ * @param timeout Ticks to wait for queue space
+ * @return true if queued
+ */
+bool dac_output_queue_segment(const dac_segment_t *segment, TickType_t timeout);
+
+/**
+ * @brief Wait for the next segment switch to reach the output (streaming mode)
+ *
+ * Reported once the DMA buffer holding the switch has played, with the
+ * exact sample index and the time it was output.
+ *
+ * @param event Output event
+ * @param timeout Ticks to wait
+ * @return true if an event was received
+ */
+bool dac_output_wait_switch(dac_switch_event_t *event, TickType_t timeout);
+
+/**
+ * @brief Get streaming statistics
+ *
+ * @param stats Output statistics
+ */
+void dac_output_get_stream_stats(dac_stream_stats_t *stats);
+
+#endif
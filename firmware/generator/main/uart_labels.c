@@ -182,4 +182,45 @@ void uart_send_heartbeat(void) {
     };
     
     uart_send_packet(&packet);
-}
\ No newline at end of file
+}
+
+static uint8_t scale_u8(float v, float full_scale) {
+    float q = v / full_scale * 255.0f + 0.5f;
+    return q <= 0.0f ? 0 : (q >= 255.0f ? 255 : (uint8_t)q);
+}
+
+static int8_t scale_offset(float v) {
+    float q = v * 254.0f;
+    return q <= -127.0f ? -127 : (q >= 127.0f ? 127 : (int8_t)q);
+}
+
+void uart_send_waveform_config(const dac_switch_event_t *event) {
+    if (!s_uart_initialized || !event) return;
+    
+    const dac_segment_t *segment = &event->segment;
+    waveform_config_payload_t payload = {
+        .sample_index = (uint32_t)event->sample_index,
+        .output_time_us = event->output_time_us,
+        .duration_samples = segment->duration_samples,
+        .start_hz = segment->start_hz,
+        .end_hz = segment->end_hz,
+        .start_amplitude = scale_u8(segment->start_amplitude, 1.0f),
+        .end_amplitude = scale_u8(segment->end_amplitude, 1.0f),
+        .start_offset = scale_offset(segment->start_offset),
+        .end_offset = scale_offset(segment->end_offset),
+        .noise = scale_u8(segment->noise, 0.25f),
+        .waveform = (uint8_t)segment->type,
+        .flags = event->timing_valid ? WAVEFORM_CONFIG_FLAG_TIMING_VALID : 0,
+    };
+    
+    uart_packet_t packet = {
+        .sync_byte = 0xAA,
+        .packet_type = PKT_TYPE_WAVEFORM_CONFIG,
+        .sequence = s_sequence_number++,
+        .timestamp_ms = (uint32_t)(esp_timer_get_time() / 1000),
+        .payload_length = sizeof(payload)
+    };
+    
+    memcpy(packet.payload, &payload, sizeof(payload));
+    uart_send_packet(&packet);
+}
@@ -7,7 +7,7 @@
 // Hardware Configuration
 #define LABEL_UART_PORT      UART_NUM_1
 #define LABEL_UART_TX_PIN    GPIO_NUM_17
-#define LABEL_UART_RX_PIN    UART_PIN_NO_CHANGE // Not receiving on this node
+#define LABEL_UART_RX_PIN    GPIO_NUM_16        // ACKs from the inference node (its TX 17)
 #define LABEL_BAUD_RATE      115200
 
 // UART Protocol Definitions
@@ -29,6 +29,26 @@ typedef struct __attribute__((packed)) {
     uint8_t crc8;
 } uart_packet_t;
 
+// PKT_TYPE_WAVEFORM_CONFIG payload: a segment reaching the output
+typedef struct __attribute__((packed)) {
+    uint32_t sample_index;      // First sample of the segment (wraps after ~59 h)
+    int64_t output_time_us;     // Generator esp_timer time of that sample
+    uint32_t duration_samples;  // 0 = held until the next segment
+    float start_hz;
+    float end_hz;
+    uint8_t start_amplitude;    // 255 = full scale
+    uint8_t end_amplitude;
+    int8_t start_offset;        // 127 = +0.5 of full scale
+    int8_t end_offset;
+    uint8_t noise;              // 255 = 0.25 of full scale
+    uint8_t waveform;           // waveform_type_t
+    uint8_t flags;              // WAVEFORM_CONFIG_FLAG_*
+} waveform_config_payload_t;
+
+#define WAVEFORM_CONFIG_FLAG_TIMING_VALID  0x01
+
+_Static_assert(sizeof(waveform_config_payload_t) <= 32, "must fit uart_packet_t payload");
+
 // Calculate CRC8 for packet
 uint8_t calculate_crc8(const uint8_t *data, size_t length);
 
@@ -37,6 +57,7 @@ void uart_labels_init(void);
 void uart_send_label(waveform_type_t type);
 bool uart_send_label_with_ack(waveform_type_t type);
 void uart_send_heartbeat(void);
+void uart_send_waveform_config(const dac_switch_event_t *event);
 bool uart_wait_for_ack(uint16_t sequence, uint32_t timeout_ms);
 
 #endif
\ No newline at end of file
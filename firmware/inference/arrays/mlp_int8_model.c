@@ -1,4 +1,7 @@
-unsigned char mlp_int8_model_tflite[] = {
+#include "model_data.h"
+#include "mlp_int8_model.h"
+
+const unsigned char mlp_int8_model_tflite[] MODEL_DATA_ATTR = {
   0x20, 0x00, 0x00, 0x00, 0x54, 0x46, 0x4c, 0x33, 0x00, 0x00, 0x00, 0x00,
   0x14, 0x00, 0x20, 0x00, 0x1c, 0x00, 0x18, 0x00, 0x14, 0x00, 0x10, 0x00,
   0x0c, 0x00, 0x00, 0x00, 0x08, 0x00, 0x04, 0x00, 0x14, 0x00, 0x00, 0x00,
@@ -4401,4 +4404,4 @@ unsigned char mlp_int8_model_tflite[] = {
   0x08, 0x00, 0x04, 0x00, 0x0c, 0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00,
   0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x09
 };
-unsigned int mlp_int8_model_tflite_len = 52808;
+const unsigned int mlp_int8_model_tflite_len = 52808;
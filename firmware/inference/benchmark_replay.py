@@ -0,0 +1,148 @@
+"""
+Collect and compare replay benchmark results (CONFIG_BENCHMARK_REPLAY_MODE).
+
+The firmware prints one "BENCH_JSON {...}" line per model and "BENCH_DONE"
+when finished. This reads those lines from the serial port or a saved log,
+writes them to a results file, and compares them against a baseline run.
+Exits non-zero if any model got slower or less accurate than the thresholds
+allow, so it can gate a firmware change.
+
+    python benchmark_replay.py --port /dev/ttyUSB0 --output bench.json
+    python benchmark_replay.py --log run.txt --baseline bench_main.json
+"""
+import argparse
+import json
+import sys
+import time
+
+BENCH_PREFIX = 'BENCH_JSON '
+BENCH_DONE = 'BENCH_DONE'
+
+# Compared per model: lower is better
+LATENCY_KEYS = ['cold_us', 'warm_mean_us', 'warm_p50_us', 'warm_p99_us', 'cycles_per_window']
+
+
+def parse_lines(lines):
+    """BENCH_JSON records keyed by model name"""
+    results = {}
+    for line in lines:
+        start = line.find(BENCH_PREFIX)
+        if start < 0:
+            continue
+        try:
+            record = json.loads(line[start + len(BENCH_PREFIX):])
+        except ValueError:
+            print(f"Skipping malformed line: {line.strip()}")
+            continue
+        results[record['model']] = record
+    return results
+
+
+def read_serial(port, baudrate, timeout):
+    import serial
+
+    lines = []
+    deadline = time.time() + timeout
+    with serial.Serial(port, baudrate, timeout=1) as ser:
+        # Reset so the replay starts from a cold boot
+        ser.setDTR(False)
+        ser.setRTS(True)
+        time.sleep(0.1)
+        ser.setRTS(False)
+        while time.time() < deadline:
+            line = ser.readline().decode('utf-8', errors='replace')
+            if not line:
+                continue
+            lines.append(line)
+            if line.startswith(BENCH_DONE):
+                return lines
+    print(f"Timed out after {timeout:.0f} s without {BENCH_DONE}")
+    return lines
+
+
+def compare(results, baseline, latency_pct, accuracy_drop):
+    """Print a comparison table, return the list of regressions"""
+    regressions = []
+    print(f"{'Model':<16} {'Metric':<18} {'Baseline':>12} {'Current':>12} {'Change':>9}")
+    for model, base in baseline.items():
+        current = results.get(model)
+        if current is None:
+            regressions.append(f"{model}: missing from this run")
+            continue
+        if current.get('corpus') != base.get('corpus'):
+            print(f"{model}: corpus differs ({base.get('corpus')} -> {current.get('corpus')})")
+
+        for key in LATENCY_KEYS:
+            old, new = base.get(key), current.get(key)
+            if not old or new is None:
+                continue
+            change = 100.0 * (new - old) / old
+            flag = ''
+            if change > latency_pct:
+                flag = ' !'
+                regressions.append(f"{model}: {key} {old} -> {new} ({change:+.1f}%)")
+            print(f"{model:<16} {key:<18} {old:>12} {new:>12} {change:>+8.1f}%{flag}")
+
+        old, new = base.get('accuracy', -1), current.get('accuracy', -1)
+        if old >= 0 and new >= 0:
+            flag = ''
+            if old - new > accuracy_drop:
+                flag = ' !'
+                regressions.append(f"{model}: accuracy {old:.4f} -> {new:.4f}")
+            print(f"{model:<16} {'accuracy':<18} {old:>12.4f} {new:>12.4f} "
+                  f"{100.0 * (new - old):>+8.2f}pp{flag}")
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Replay benchmark collector / regression check')
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument('--port', type=str, help='Serial port of the device in replay mode')
+    source.add_argument('--log', type=str, help='Saved console log to parse instead')
+    parser.add_argument('--baud', type=int, default=115200, help='Console baud rate')
+    parser.add_argument('--timeout', type=float, default=300.0, help='Seconds to wait for BENCH_DONE')
+    parser.add_argument('--output', type=str, help='Write parsed results to this JSON file')
+    parser.add_argument('--baseline', type=str, help='Results JSON to compare against')
+    parser.add_argument('--latency-pct', type=float, default=5.0,
+                        help='Allowed latency increase in percent (default 5)')
+    parser.add_argument('--accuracy-drop', type=float, default=0.01,
+                        help='Allowed absolute accuracy drop (default 0.01)')
+    args = parser.parse_args()
+
+    if args.port:
+        lines = read_serial(args.port, args.baud, args.timeout)
+    else:
+        with open(args.log, encoding='utf-8', errors='replace') as f:
+            lines = f.readlines()
+
+    results = parse_lines(lines)
+    if not results:
+        print("No BENCH_JSON lines found")
+        return 2
+
+    for model, r in results.items():
+        print(f"{model:<16} cold {r['cold_us']:>8} us  warm p50 {r['warm_p50_us']:>8} us  "
+              f"p99 {r['warm_p99_us']:>8} us  {r.get('energy_uj', 0):>8.1f} uJ  "
+              f"arena {r['arena_bytes']:>7} B  "
+              f"accuracy {r['accuracy']:.4f} (ref {r['reference_accuracy']:.4f})")
+
+    if args.output:
+        with open(args.output, 'w') as f:
+            json.dump(results, f, indent=2)
+        print(f"Saved {len(results)} results to {args.output}")
+
+    if args.baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+        regressions = compare(results, baseline, args.latency_pct, args.accuracy_drop)
+        if regressions:
+            print("\nREGRESSIONS:")
+            for r in regressions:
+                print(f"  {r}")
+            return 1
+        print("\nNo regressions")
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
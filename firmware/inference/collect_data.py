@@ -6,8 +6,271 @@ import json
 from datetime import datetime
 from pathlib import Path
 import argparse
+import struct
 from collections import defaultdict
 
+# ml_class_t values (ml_contract.h)
+ML_CLASSES = ['SINE', 'SQUARE', 'TRIANGLE', 'SAWTOOTH', 'NOISE']
+
+# calculate_crc8() in clock_sync.c: polynomial 0x07, initial value 0
+def _crc8_table():
+    table = []
+    for byte in range(256):
+        crc = byte
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x07) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+        table.append(crc)
+    return bytes(table)
+
+CRC8_TABLE = _crc8_table()
+
+def crc8(data):
+    crc = 0
+    for byte in data:
+        crc = CRC8_TABLE[crc ^ byte]
+    return crc
+
+def unpack12(packed, count):
+    """
+    Decode sample_pack12() payloads (sample_codec.h)
+
+    Args:
+        packed: uint8 array, one payload per row (2D) or a single payload (1D)
+        count: Samples per payload
+    Returns:
+        uint16 codes with the same leading shape
+    """
+    packed = np.atleast_2d(np.asarray(packed, dtype=np.uint8))
+    triples = np.zeros((packed.shape[0], ((count + 1) // 2) * 3), dtype=np.uint16)
+    triples[:, :packed.shape[1]] = packed
+    triples = triples.reshape(packed.shape[0], -1, 3)
+    codes = np.empty((packed.shape[0], triples.shape[1] * 2), dtype=np.uint16)
+    codes[:, 0::2] = triples[..., 0] | ((triples[..., 1] & 0x0F) << 8)
+    codes[:, 1::2] = (triples[..., 1] >> 4) | (triples[..., 2] << 4)
+    return codes[:, :count]
+
+class SampleStream:
+    """
+    Reader for the firmware's binary sample stream (sample_stream.h)
+
+    Parses CRC-framed sample and log frames and acknowledges them with
+    generator-format ACK packets; the device stops sending (and drops
+    blocks) once CONFIG_SAMPLE_STREAM_WINDOW_FRAMES go unacknowledged.
+    Until the first frame arrives, resync ACKs reopen a window that closed
+    before the reader attached.
+    """
+    SYNC_BYTE = 0xAA
+    PKT_TYPE_ACK = 0x04
+    ACK_RESYNC = 0x01                            # STREAM_ACK_RESYNC
+    PKT_SAMPLES = 0x10
+    PKT_LOG = 0x11
+    FLAG_TRANSITION = 0x01
+
+    FRAME_HEADER = struct.Struct('<BBHIHB')      # stream_frame_header_t
+    SAMPLES_HEADER = struct.Struct('<IqbBH')     # stream_samples_header_t
+    UART_PACKET = struct.Struct('<BBHIB32s')     # uart_packet_t without crc8
+    MAX_PAYLOAD = 4096
+
+    def __init__(self, serial_conn, ack_every=8, on_log=None):
+        self.serial_conn = serial_conn
+        self.ack_every = ack_every
+        self.on_log = on_log if on_log else (lambda text: print(text, end=''))
+        self.buffer = bytearray()
+        self.last_sequence = None
+        self.unacked = 0
+        self.crc_errors = 0
+        self.lost_frames = 0
+
+    def ack(self, sequence, payload=b''):
+        body = self.UART_PACKET.pack(self.SYNC_BYTE, self.PKT_TYPE_ACK, sequence & 0xFFFF,
+                                     int(time.time() * 1000) & 0xFFFFFFFF, len(payload),
+                                     payload)
+        self.serial_conn.write(body + bytes([crc8(body)]))
+        self.unacked = 0
+
+    def resync(self):
+        """Acknowledge everything the device sent before this reader attached"""
+        self.ack(0, bytes([self.ACK_RESYNC]))
+
+    def _frames(self):
+        """Yield (type, payload) for every complete frame in the buffer"""
+        header_size = self.FRAME_HEADER.size
+        while True:
+            start = self.buffer.find(self.SYNC_BYTE)
+            if start < 0:
+                self.buffer.clear()
+                return
+            del self.buffer[:start]
+            if len(self.buffer) < header_size:
+                return
+
+            header = bytes(self.buffer[:header_size])
+            _, ptype, sequence, _, length, header_crc = self.FRAME_HEADER.unpack(header)
+            if crc8(header[:-1]) != header_crc or length > self.MAX_PAYLOAD:
+                self.crc_errors += 1
+                del self.buffer[:1]
+                continue
+            if len(self.buffer) < header_size + length + 1:
+                return
+
+            payload = bytes(self.buffer[header_size:header_size + length])
+            if crc8(payload) != self.buffer[header_size + length]:
+                self.crc_errors += 1
+                del self.buffer[:1]
+                continue
+            del self.buffer[:header_size + length + 1]
+
+            if self.last_sequence is not None:
+                self.lost_frames += (sequence - self.last_sequence - 1) & 0xFFFF
+            self.last_sequence = sequence
+            self.unacked += 1
+            yield ptype, payload
+
+    def poll(self):
+        """
+        Read what has arrived and decode its sample blocks
+
+        Returns:
+            List of dicts (window_sequence, start_us, label, flags, codes)
+        """
+        waiting = self.serial_conn.in_waiting
+        data = self.serial_conn.read(waiting if waiting else 1)
+        if data:
+            self.buffer.extend(data)
+
+        headers, payloads = [], []
+        for ptype, payload in self._frames():
+            if ptype == self.PKT_SAMPLES:
+                headers.append(self.SAMPLES_HEADER.unpack_from(payload))
+                payloads.append(payload[self.SAMPLES_HEADER.size:])
+            elif ptype == self.PKT_LOG:
+                self.on_log(payload.decode('utf-8', errors='replace'))
+
+        # Acknowledge regularly, and when idle in case an ACK was lost
+        if self.last_sequence is None:
+            if not data:
+                self.resync()
+        elif self.unacked >= self.ack_every or not data:
+            self.ack(self.last_sequence)
+
+        # One vectorized unpack per run of equally sized blocks
+        blocks = []
+        i = 0
+        while i < len(headers):
+            count = headers[i][4]
+            j = i
+            while j < len(headers) and headers[j][4] == count:
+                j += 1
+            packed = np.frombuffer(b''.join(payloads[i:j]), dtype=np.uint8).reshape(j - i, -1)
+            codes = unpack12(packed, count)
+            for k in range(i, j):
+                window_sequence, start_us, label, flags, _ = headers[k]
+                blocks.append({'window_sequence': window_sequence, 'start_us': start_us,
+                               'label': label, 'flags': flags, 'codes': codes[k - i]})
+            i = j
+        return blocks
+
+class CaptureFile:
+    """
+    Random access to an SD capture written by data_collection.c (format v2)
+
+    The file is memory-mapped; windows are located through the trailing
+    index, the .idx sidecar of an interrupted capture, or a block scan.
+    """
+    FILE_MAGIC = 0x31434557
+    RECORD_MAGIC = 0x5752
+    INDEX_MAGIC = 0x58444957
+    TRAILER_MAGIC = 0x444E4557
+    SECTOR_SIZE = 512
+    ENCODING_PACKED12 = 0
+    ENCODING_DELTA = 1
+    FLAG_TRANSITION = 0x01
+    FLAG_LOCAL_CLOCK = 0x02
+
+    FILE_HEADER = struct.Struct('<IHHIIHH')
+    RECORD_DTYPE = np.dtype([
+        ('magic', '<u2'), ('sample_count', '<u2'), ('sequence', '<u4'),
+        ('start_us', '<i8'), ('end_us', '<i8'), ('label', 'i1'), ('flags', 'u1'),
+        ('encoding', 'u1'), ('delta_bits', 'u1'), ('payload_bytes', '<u2'),
+    ])
+
+    def __init__(self, path):
+        self.path = Path(path)
+        self.data = np.memmap(self.path, dtype=np.uint8, mode='r')
+
+        (magic, self.version, header_size, self.block_size, self.sample_rate,
+         self.window_size, self.adc_bits) = self.FILE_HEADER.unpack_from(self.data, 0)
+        if magic != self.FILE_MAGIC or self.version != 2:
+            raise ValueError(f"{self.path}: not a version 2 capture")
+        self.header_size = header_size
+
+        self.offsets = self._load_index()
+        # One vectorized gather for every record header
+        rows = self.data[self.offsets[:, None] + np.arange(self.RECORD_DTYPE.itemsize)]
+        self.records = rows.view(self.RECORD_DTYPE).reshape(-1)
+
+    def _load_index(self):
+        trailer_magic, index_offset = struct.unpack_from('<II', self.data, len(self.data) - 8)
+        if trailer_magic == self.TRAILER_MAGIC:
+            magic, count = struct.unpack_from('<II', self.data, index_offset)
+            if magic == self.INDEX_MAGIC:
+                return np.frombuffer(self.data, dtype='<u4', count=count,
+                                     offset=index_offset + 8).astype(np.int64)
+
+        sidecar = self.path.with_suffix('.idx')
+        if sidecar.exists():
+            offsets = np.fromfile(sidecar, dtype='<u4').astype(np.int64)
+            return offsets[offsets + self.RECORD_DTYPE.itemsize <= len(self.data)]
+
+        return self._scan_blocks()
+
+    def _scan_blocks(self):
+        """Walk the blocks of a capture with no usable index"""
+        offsets = []
+        for block in range(self.header_size, len(self.data) - self.block_size + 1, self.block_size):
+            pos = block
+            while pos + self.RECORD_DTYPE.itemsize <= block + self.block_size:
+                record = self.data[pos:pos + self.RECORD_DTYPE.itemsize].view(self.RECORD_DTYPE)[0]
+                if record['magic'] != self.RECORD_MAGIC:
+                    break
+                offsets.append(pos)
+                pos += self.RECORD_DTYPE.itemsize + int(record['payload_bytes'])
+        return np.array(offsets, dtype=np.int64)
+
+    def __len__(self):
+        return len(self.offsets)
+
+    def __getitem__(self, i):
+        """Raw ADC codes of window i (uint16)"""
+        record = self.records[i]
+        start = int(self.offsets[i]) + self.RECORD_DTYPE.itemsize
+        payload = np.asarray(self.data[start:start + int(record['payload_bytes'])])
+        count = int(record['sample_count'])
+
+        if record['encoding'] == self.ENCODING_DELTA:
+            return self._decode_delta(payload, count, int(record['delta_bits']))
+        return unpack12(payload, count)[0]
+
+    @staticmethod
+    def _decode_delta(payload, count, bits):
+        first = int(payload[0]) | (int(payload[1]) << 8)
+        if bits == 0:
+            return np.full(count, first, dtype=np.uint16)
+        stream = np.unpackbits(payload[2:], bitorder='little')[:(count - 1) * bits]
+        zigzag = stream.reshape(count - 1, bits).astype(np.int32) @ (1 << np.arange(bits, dtype=np.int32))
+        deltas = (zigzag >> 1) ^ -(zigzag & 1)
+        return (first + np.concatenate(([0], np.cumsum(deltas)))).astype(np.uint16)
+
+    @property
+    def labels(self):
+        """ml_class_t per window (-1 if unlabeled)"""
+        return self.records['label'].astype(np.int8)
+
+    def windows(self, indices=None):
+        """Stack windows into an (N, window_size) uint16 array"""
+        indices = range(len(self)) if indices is None else indices
+        return np.stack([self[i] for i in indices])
+
 class ESP32DataCollector:
     def __init__(self, port='COM3', baudrate=115200, 
                  sample_window=256, sampling_rate=20000):
@@ -167,6 +430,88 @@ class ESP32DataCollector:
         
         return collected_windows
     
+    def import_capture(self, path, include_transitions=False):
+        """
+        Add labeled windows from an SD capture file
+
+        Args:
+            path: rec_NNNN.bin written by the firmware recorder
+            include_transitions: Keep windows whose label changed mid-window
+        """
+        capture = CaptureFile(path)
+        keep = capture.labels >= 0
+        if not include_transitions:
+            keep &= (capture.records['flags'] & CaptureFile.FLAG_TRANSITION) == 0
+        counts = defaultdict(int)
+
+        for i in np.flatnonzero(keep):
+            name = ML_CLASSES[capture.labels[i]]
+            if name in self.waveform_data_ml:
+                self.waveform_data_ml[name].append(capture[i].tolist())
+                counts[name] += 1
+
+        print(f"Imported {sum(counts.values())}/{len(capture)} windows from {path}")
+        for name, count in counts.items():
+            print(f"  {name}: {count} windows")
+        return sum(counts.values())
+    
+    def collect_stream(self, duration_s, include_transitions=False):
+        """
+        Collect labeled windows from the binary sample stream
+
+        Contiguous blocks with the same ground-truth label are joined and
+        cut into non-overlapping sample_window windows; a label change,
+        a transition block or a lost block starts a new run.
+
+        Args:
+            duration_s: Seconds to stream
+            include_transitions: Keep blocks whose label changed mid-block
+        """
+        if not self.serial_conn:
+            print("Not connected to ESP32")
+            return 0
+        
+        stream = SampleStream(self.serial_conn)
+        self.serial_conn.reset_input_buffer()
+        stream.resync()
+        run, run_label, next_sequence = [], None, None
+        counts = defaultdict(int)
+        received = 0
+        start = time.time()
+        
+        try:
+            while time.time() - start < duration_s:
+                for block in stream.poll():
+                    received += len(block['codes'])
+                    label = block['label']
+                    usable = (0 <= label < len(ML_CLASSES) and
+                              (include_transitions or not block['flags'] & SampleStream.FLAG_TRANSITION))
+                    if not usable or label != run_label or block['window_sequence'] != next_sequence:
+                        run = []
+                    run_label = label if usable else None
+                    next_sequence = block['window_sequence'] + 1
+                    if not usable:
+                        continue
+                    
+                    run.append(block['codes'])
+                    samples = np.concatenate(run)
+                    name = ML_CLASSES[label]
+                    while len(samples) >= self.sample_window:
+                        if name in self.waveform_data_ml:
+                            self.waveform_data_ml[name].append(samples[:self.sample_window].tolist())
+                            counts[name] += 1
+                        samples = samples[self.sample_window:]
+                    run = [samples] if len(samples) else []
+        except KeyboardInterrupt:
+            print("\nStreaming interrupted by user")
+        
+        elapsed = time.time() - start
+        print(f"\nStreamed {received} samples in {elapsed:.1f} s ({received / elapsed:.0f} samples/s), "
+              f"{stream.crc_errors} CRC errors, {stream.lost_frames} lost frames")
+        for name, count in counts.items():
+            print(f"  {name}: {count} windows")
+        return sum(counts.values())
+    
     def _save_ml_csv_files(self):
         """Save each waveform's data to ML-friendly CSV files"""
         print("\n" + "="*50)
@@ -307,13 +652,19 @@ def main():
                        help='List collected waveforms without collecting new data')
     parser.add_argument('--combine', action='store_true',
                        help='Combine all 4 waveform CSV files into training dataset')
+    parser.add_argument('--capture', type=str, nargs='+',
+                       help='Import SD capture files (rec_NNNN.bin) instead of reading serial')
+    parser.add_argument('--stream', type=float, metavar='SECONDS',
+                       help='Collect from the binary sample stream (CONFIG_SAMPLE_STREAM_ENABLE)')
+    parser.add_argument('--baud', type=int, default=None,
+                       help='Serial baud rate (default 115200, 921600 with --stream)')
     
     args = parser.parse_args()
     
     # Initialize collector
     collector = ESP32DataCollector(
         port=args.port,
-        baudrate=115200
+        baudrate=args.baud or (921600 if args.stream else 115200)
     )
     
     if args.list:
@@ -324,6 +675,25 @@ def main():
         collector.combine_all_waveforms()
         return
     
+    if args.capture:
+        for path in args.capture:
+            collector.import_capture(path)
+        collector._save_ml_csv_files()
+        collector.combine_all_waveforms()
+        collector._save_collection_summary()
+        return
+    
+    if args.stream:
+        if collector.connect():
+            try:
+                collector.collect_stream(args.stream)
+                collector._save_ml_csv_files()
+                collector.combine_all_waveforms()
+                collector._save_collection_summary()
+            finally:
+                collector.disconnect()
+        return
+    
     # Connect and collect data
     if collector.connect():
         try:
@@ -0,0 +1,175 @@
+// bench_dsp.cc - Preprocessing, quantization and signal statistics on the host
+#include <benchmark/benchmark.h>
+#include <cstring>
+#include <vector>
+#include "bench_signals.h"
+
+extern "C" {
+#include "decimator.h"
+#include "preprocessing.h"
+#include "signal_processing.h"
+#include "spectral_features.h"
+#include "window_stats.h"
+}
+
+namespace {
+
+// Typical int8 model input quantization (models/*_int8_model.tflite)
+constexpr float kInputScale = 1.0f / 128.0f;
+constexpr int kInputZeroPoint = 0;
+
+alignas(16) float g_float[ML_WINDOW_SIZE];
+alignas(16) int8_t g_int8[ML_WINDOW_SIZE];
+
+// Cycle through the corpus so branchy code sees every waveform
+const uint16_t *NextWindow(size_t &index)
+{
+    const auto &corpus = bench::Corpus();
+    const uint16_t *codes = corpus[index].codes.data();
+    index = (index + 1) % corpus.size();
+    return codes;
+}
+
+void SetWindowCounters(benchmark::State &state)
+{
+    state.SetItemsProcessed(state.iterations());
+    state.counters["samples/s"] = benchmark::Counter(
+        (double)state.iterations() * ML_WINDOW_SIZE, benchmark::Counter::kIsRate);
+}
+
+void BM_PreprocessCodesFloat(benchmark::State &state)
+{
+    size_t index = 0;
+    for (auto _ : state) {
+        preprocess_codes_float(NextWindow(index), ML_WINDOW_SIZE, g_float);
+        benchmark::DoNotOptimize(g_float);
+    }
+    SetWindowCounters(state);
+}
+BENCHMARK(BM_PreprocessCodesFloat);
+
+void BM_PreprocessCodesInt8(benchmark::State &state)
+{
+    size_t index = 0;
+    for (auto _ : state) {
+        preprocess_codes_int8(NextWindow(index), ML_WINDOW_SIZE, kInputScale, kInputZeroPoint, g_int8);
+        benchmark::DoNotOptimize(g_int8);
+    }
+    SetWindowCounters(state);
+}
+BENCHMARK(BM_PreprocessCodesInt8);
+
+// The float path followed by quantization, which the int8 path replaces
+void BM_PreprocessFloatThenQuantize(benchmark::State &state)
+{
+    size_t index = 0;
+    for (auto _ : state) {
+        preprocess_codes_float(NextWindow(index), ML_WINDOW_SIZE, g_float);
+        quantize_samples_int8(g_float, ML_WINDOW_SIZE, kInputScale, kInputZeroPoint, g_int8);
+        benchmark::DoNotOptimize(g_int8);
+    }
+    SetWindowCounters(state);
+}
+BENCHMARK(BM_PreprocessFloatThenQuantize);
+
+void BM_QuantizeSamplesInt8(benchmark::State &state)
+{
+    size_t index = 0;
+    preprocess_codes_float(NextWindow(index), ML_WINDOW_SIZE, g_float);
+    for (auto _ : state) {
+        quantize_samples_int8(g_float, ML_WINDOW_SIZE, kInputScale, kInputZeroPoint, g_int8);
+        benchmark::DoNotOptimize(g_int8);
+    }
+    SetWindowCounters(state);
+}
+BENCHMARK(BM_QuantizeSamplesInt8);
+
+void BM_WindowMoments(benchmark::State &state)
+{
+    size_t index = 0;
+    window_moments_t moments;
+    for (auto _ : state) {
+        window_moments_compute(NextWindow(index), ML_WINDOW_SIZE, &moments);
+        benchmark::DoNotOptimize(moments);
+    }
+    SetWindowCounters(state);
+}
+BENCHMARK(BM_WindowMoments);
+
+void BM_ValidateSignal(benchmark::State &state)
+{
+    size_t index = 0;
+    preprocess_codes_float(NextWindow(index), ML_WINDOW_SIZE, g_float);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(validate_signal(g_float, ML_WINDOW_SIZE));
+    }
+    SetWindowCounters(state);
+}
+BENCHMARK(BM_ValidateSignal);
+
+void BM_FftMagnitude(benchmark::State &state)
+{
+    size_t index = 0;
+    preprocess_codes_float(NextWindow(index), ML_WINDOW_SIZE, g_float);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(compute_fft_magnitude(g_float, ML_WINDOW_SIZE));
+    }
+    SetWindowCounters(state);
+}
+BENCHMARK(BM_FftMagnitude);
+
+void BM_SpectralFeatures(benchmark::State &state)
+{
+    size_t index = 0;
+    spectral_features_t features;
+    preprocess_codes_float(NextWindow(index), ML_WINDOW_SIZE, g_float);
+    for (auto _ : state) {
+        extract_spectral_features(g_float, ML_WINDOW_SIZE, ML_SAMPLE_RATE_HZ, &features);
+        benchmark::DoNotOptimize(features);
+    }
+    SetWindowCounters(state);
+}
+BENCHMARK(BM_SpectralFeatures);
+
+// Front-end FIR: one window of output codes from factor x as many conversions
+void BM_Decimate(benchmark::State &state)
+{
+    const int factor = (int)state.range(0);
+    decimator_t decimator;
+    decimator_init(&decimator, factor);
+    std::vector<uint16_t> conversions;
+    for (size_t index = 0; conversions.size() < (size_t)factor * ML_WINDOW_SIZE;) {
+        const uint16_t *codes = NextWindow(index);
+        conversions.insert(conversions.end(), codes, codes + ML_WINDOW_SIZE);
+    }
+    uint16_t out[ML_WINDOW_SIZE + 1];
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(decimator_process(&decimator, conversions.data(),
+                                                   factor * ML_WINDOW_SIZE, out));
+    }
+    SetWindowCounters(state);
+}
+BENCHMARK(BM_Decimate)->Arg(2)->Arg(4)->Arg(8);
+
+// Accuracy guard for quantization changes: worst int8 error versus float
+void BM_Int8PathError(benchmark::State &state)
+{
+    int worst = 0;
+    for (auto _ : state) {
+        for (const auto &window : bench::Corpus()) {
+            preprocess_codes_float(window.codes.data(), ML_WINDOW_SIZE, g_float);
+            int8_t reference[ML_WINDOW_SIZE];
+            quantize_samples_int8(g_float, ML_WINDOW_SIZE, kInputScale, kInputZeroPoint, reference);
+            preprocess_codes_int8(window.codes.data(), ML_WINDOW_SIZE, kInputScale, kInputZeroPoint, g_int8);
+            for (int i = 0; i < ML_WINDOW_SIZE; i++) {
+                worst = std::max(worst, std::abs(g_int8[i] - reference[i]));
+            }
+        }
+    }
+    state.counters["max_lsb_error"] = worst;
+}
+BENCHMARK(BM_Int8PathError)->Iterations(1);
+
+}  // namespace
+
+BENCHMARK_MAIN();
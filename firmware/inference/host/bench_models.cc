@@ -0,0 +1,160 @@
+// bench_models.cc - The six models in models/ on the host TFLite Micro build
+#include <benchmark/benchmark.h>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+#include "bench_signals.h"
+
+extern "C" {
+#include "inference.h"
+#include "preprocessing.h"
+#include "tflite_wrapper.h"
+}
+
+namespace {
+
+const char *const kModels[] = {
+    "cnn_float32_model", "cnn_int8_model", "mlp_float32_model",
+    "mlp_int8_model", "hybrid_float32_model", "hybrid_int8_model",
+};
+
+constexpr size_t kModelAlignment = 16;    // FlatBuffers tables must be aligned
+constexpr int kMaxClasses = 8;
+
+struct Model {
+    std::string name;
+    std::unique_ptr<uint8_t, decltype(&std::free)> data{nullptr, &std::free};
+    size_t size = 0;
+    tflite_session_t *session = nullptr;
+    tflite_input_view_t view{};
+    preprocess_format_t format{};
+    double accuracy = 0.0;
+};
+
+std::vector<Model> g_models;
+
+bool LoadModel(const std::string &dir, const char *name, Model &model)
+{
+    std::string path = dir + "/" + name + ".tflite";
+    FILE *f = std::fopen(path.c_str(), "rb");
+    if (!f) {
+        std::fprintf(stderr, "Cannot open %s\n", path.c_str());
+        return false;
+    }
+    std::fseek(f, 0, SEEK_END);
+    long size = std::ftell(f);
+    std::fseek(f, 0, SEEK_SET);
+
+    size_t padded = (size + kModelAlignment - 1) / kModelAlignment * kModelAlignment;
+    model.data.reset(static_cast<uint8_t *>(std::aligned_alloc(kModelAlignment, padded)));
+    bool ok = model.data && std::fread(model.data.get(), 1, size, f) == (size_t)size;
+    std::fclose(f);
+    if (!ok) {
+        return false;
+    }
+
+    model.name = name;
+    model.size = size;
+    model.session = tflite_session_create(model.data.get(), model.size);
+    if (!model.session || !tflite_session_set_class_map(model.session, &ml_trained_class_map) ||
+        !tflite_session_input(model.session, &model.view)) {
+        std::fprintf(stderr, "%s: session creation failed\n", name);
+        return false;
+    }
+    if (model.view.type == TFLITE_INPUT_INT8) {
+        preprocess_format_int8(&model.format, model.view.scale, model.view.zero_point);
+    } else {
+        model.format = {};
+        model.format.type = PREPROCESS_OUTPUT_FLOAT32;
+    }
+    return true;
+}
+
+// Preprocess straight into the input tensor, as the firmware does
+bool RunWindow(Model &model, const uint16_t *codes, float *probabilities, int *num_classes)
+{
+    return preprocess_codes(&model.format, codes, ML_WINDOW_SIZE, model.view.data) &&
+           tflite_session_invoke(model.session, probabilities, kMaxClasses, num_classes);
+}
+
+double CorpusAccuracy(Model &model)
+{
+    float probabilities[kMaxClasses];
+    int num_classes = 0, correct = 0;
+    const auto &corpus = bench::Corpus();
+    for (const auto &window : corpus) {
+        if (RunWindow(model, window.codes.data(), probabilities, &num_classes)) {
+            correct += ml_argmax(probabilities, num_classes) == window.label;
+        }
+    }
+    return (double)correct / corpus.size();
+}
+
+void BM_Window(benchmark::State &state, Model *model)
+{
+    float probabilities[kMaxClasses];
+    int num_classes = 0;
+    size_t index = 0;
+    const auto &corpus = bench::Corpus();
+    for (auto _ : state) {
+        if (!RunWindow(*model, corpus[index].codes.data(), probabilities, &num_classes)) {
+            state.SkipWithError("inference failed");
+            break;
+        }
+        benchmark::DoNotOptimize(probabilities);
+        index = (index + 1) % corpus.size();
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["arena_bytes"] = (double)tflite_session_arena_used(model->session);
+    state.counters["model_bytes"] = (double)model->size;
+    state.counters["accuracy"] = model->accuracy;
+}
+
+void BM_ExtractFeatures(benchmark::State &state)
+{
+    alignas(16) float samples[ML_WINDOW_SIZE];
+    signal_features_t features;
+    size_t index = 0;
+    const auto &corpus = bench::Corpus();
+    for (auto _ : state) {
+        preprocess_codes_float(corpus[index].codes.data(), ML_WINDOW_SIZE, samples);
+        extract_features(samples, ML_WINDOW_SIZE, &features);
+        benchmark::DoNotOptimize(features);
+        index = (index + 1) % corpus.size();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ExtractFeatures);
+
+}  // namespace
+
+int main(int argc, char **argv)
+{
+    const char *dir = std::getenv("INFERENCE_MODELS_DIR");
+    std::string models_dir = dir ? dir : INFERENCE_MODELS_DIR;
+
+    g_models.reserve(sizeof(kModels) / sizeof(kModels[0]));
+    for (const char *name : kModels) {
+        g_models.emplace_back();
+        Model &model = g_models.back();
+        if (!LoadModel(models_dir, name, model)) {
+            return 1;
+        }
+        model.accuracy = CorpusAccuracy(model);
+        benchmark::RegisterBenchmark(("BM_Window/" + model.name).c_str(), BM_Window, &model);
+    }
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    for (Model &model : g_models) {
+        tflite_session_destroy(model.session);
+    }
+    return 0;
+}
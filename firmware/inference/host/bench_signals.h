@@ -0,0 +1,69 @@
+// bench_signals.h - Deterministic synthetic ADC windows for the host benchmarks
+#ifndef BENCH_SIGNALS_H
+#define BENCH_SIGNALS_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+#include "ml_contract.h"
+
+namespace bench {
+
+constexpr int kLutSize = 256;           // Generator table: one period per 256 samples
+constexpr int kWindowsPerClass = 16;
+
+struct Window {
+    ml_class_t label;
+    std::vector<uint16_t> codes;  // Consecutive windows of ML_WINDOW_SIZE codes
+};
+
+// 8-bit DAC value of the generator's waveform tables, as gen_replay_corpus.py
+inline int GeneratorLut(int cls, int i)
+{
+    switch (cls) {
+        case ML_CLASS_SINE: return (int)(127.0 + 127.0 * std::sin(2.0 * M_PI * i / kLutSize));
+        case ML_CLASS_SQUARE: return i < kLutSize / 2 ? 255 : 0;
+        case ML_CLASS_TRIANGLE:
+            return i < kLutSize / 2 ? (int)(2.0 * 255.0 * i / kLutSize)
+                                    : (int)(255.0 - 2.0 * 255.0 * (i - kLutSize / 2) / kLutSize);
+        default: return (int)(255.0 * i / (kLutSize - 1));
+    }
+}
+
+// Balanced, seeded corpus: random phase, gain, offset and noise per window.
+// periods > 1 plays the tables that many times faster: periods x the
+// nominal frequency, at which a 256-sample window holds one period.
+// windows > 1 makes each entry that many consecutive windows of one signal.
+inline const std::vector<Window> &Corpus(int periods = 1, int windows = 1)
+{
+    static std::map<std::pair<int, int>, std::vector<Window>> corpora;
+    std::vector<Window> &corpus = corpora[{periods, windows}];
+    if (!corpus.empty()) {
+        return corpus;
+    }
+
+    std::mt19937 rng(20240601);
+    std::uniform_int_distribution<int> phase(0, kLutSize - 1);
+    std::uniform_real_distribution<double> gain(0.85, 1.0), offset(-40.0, 40.0);
+    std::normal_distribution<double> noise(0.0, 6.0);
+    for (int w = 0; w < kWindowsPerClass * 4; w++) {
+        Window window{(ml_class_t)(w % 4), std::vector<uint16_t>(windows * ML_WINDOW_SIZE)};
+        int p = phase(rng);
+        double g = gain(rng), o = offset(rng);
+        for (int i = 0; i < windows * ML_WINDOW_SIZE; i++) {
+            double dac = GeneratorLut(window.label, (i * periods + p) % kLutSize);
+            double code = ML_ADC_MIDSCALE + (dac - 127.5) * 16.0 * g + o + noise(rng);
+            window.codes[i] = (uint16_t)std::min(std::max(std::lround(code), 0L), (long)ML_ADC_MAX);
+        }
+        corpus.push_back(std::move(window));
+    }
+    return corpus;
+}
+
+}  // namespace bench
+
+#endif /* BENCH_SIGNALS_H */
@@ -0,0 +1,86 @@
+// cascade_check.cc - The cascade's cheap stage over the synthetic corpus
+//
+//   cascade_check PERIODS WINDOWS HOP ACCEPT MIN_ACCURACY MAX_ESCALATED
+//
+// Runs what cascade_inference() runs before any model: the float
+// preprocessing and the spectral classifier, with no heuristic fallback.
+// Each corpus entry is WINDOWS windows' worth of one signal, cut into
+// windows HOP samples apart and pushed through a stream's spectral span;
+// the last one is classified, from the span if the window alone has too
+// few periods. A window is accepted when the
+// spectral answer reaches ACCEPT, otherwise it escalates to the MLP.
+// Fails if fewer than MIN_ACCURACY of the accepted answers are right or
+// more than MAX_ESCALATED of the windows escalate. PERIODS is the
+// generator speed (see bench::Corpus()).
+#include <cstdio>
+#include <cstdlib>
+
+#include "bench_signals.h"
+
+extern "C" {
+#include "preprocessing.h"
+#include "spectral_features.h"
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 7) {
+        std::fprintf(stderr, "usage: %s PERIODS WINDOWS HOP ACCEPT MIN_ACCURACY MAX_ESCALATED\n",
+                     argv[0]);
+        return 2;
+    }
+    int periods = std::atoi(argv[1]);
+    int windows_per_entry = std::atoi(argv[2]);
+    int hop = std::atoi(argv[3]);
+    float accept = std::strtof(argv[4], nullptr);
+    double min_accuracy = std::strtod(argv[5], nullptr);
+    double max_escalated = std::strtod(argv[6], nullptr);
+    if (windows_per_entry < 1 || hop < 1 || hop > ML_WINDOW_SIZE) {
+        std::fprintf(stderr, "WINDOWS must be >= 1 and HOP 1..%d\n", ML_WINDOW_SIZE);
+        return 2;
+    }
+
+    const auto &corpus = bench::Corpus(periods, windows_per_entry);
+    static spectral_span_t span;
+    int accepted = 0, correct = 0;
+    for (const auto &entry : corpus) {
+        spectral_span_reset(&span);
+        const uint16_t *last = entry.codes.data();
+        spectral_span_push(&span, last, ML_WINDOW_SIZE, hop);
+        while (last + hop + ML_WINDOW_SIZE <= entry.codes.data() + entry.codes.size()) {
+            last += hop;
+            spectral_span_push(&span, last, ML_WINDOW_SIZE, hop);
+        }
+
+        float samples[ML_WINDOW_SIZE];
+        if (!preprocess_codes_float(last, ML_WINDOW_SIZE, samples)) {
+            std::fprintf(stderr, "window rejected by preprocessing\n");
+            return 1;
+        }
+        spectral_features_t features;
+        if (!extract_spectral_features_span(&span, samples, ML_WINDOW_SIZE, ML_SAMPLE_RATE_HZ,
+                                            &features)) {
+            continue;
+        }
+        float confidence;
+        ml_class_t predicted = spectral_classify(&features, &confidence);
+        if (confidence >= accept) {
+            accepted++;
+            correct += (predicted == entry.label);
+        }
+    }
+
+    int windows = (int)corpus.size();
+    double escalated = (double)(windows - accepted) / windows;
+    // No accepted answer is no wrong answer
+    double accuracy = accepted ? (double)correct / accepted : 1.0;
+    std::printf("%d periods, %d windows each, hop %d: %d/%d accepted, %d correct, "
+                "%.1f%% escalated\n", periods, windows_per_entry, hop, accepted, windows, correct,
+                100.0 * escalated);
+    if (accuracy < min_accuracy || escalated > max_escalated) {
+        std::fprintf(stderr, "accuracy %.3f (min %.3f), escalated %.3f (max %.3f)\n",
+                     accuracy, min_accuracy, escalated, max_escalated);
+        return 1;
+    }
+    return 0;
+}
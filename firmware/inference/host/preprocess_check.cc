@@ -0,0 +1,63 @@
+// preprocess_check.cc - Firmware int8 preprocessing of CSV windows, for preprocess_ref.py --check
+//
+//   preprocess_check SCALE ZERO_POINT CODES.csv OUTPUT.csv
+//
+// Each CODES row is one raw ADC window; each OUTPUT row is what
+// preprocess_codes() writes into the int8 input tensor for it.
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "preprocessing.h"
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 5) {
+        std::fprintf(stderr, "usage: %s SCALE ZERO_POINT CODES.csv OUTPUT.csv\n", argv[0]);
+        return 2;
+    }
+
+    // The same format the inference engine publishes for an int8 model
+    preprocess_format_t format;
+    preprocess_format_int8(&format, std::strtof(argv[1], nullptr), std::atoi(argv[2]));
+
+    std::ifstream in(argv[3]);
+    std::ofstream out(argv[4]);
+    if (!in || !out) {
+        std::fprintf(stderr, "can't open %s or %s\n", argv[3], argv[4]);
+        return 2;
+    }
+
+    std::string line;
+    int windows = 0;
+    while (std::getline(in, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        std::vector<uint16_t> codes;
+        std::stringstream row(line);
+        std::string field;
+        while (std::getline(row, field, ',')) {
+            codes.push_back((uint16_t)std::atoi(field.c_str()));
+        }
+
+        std::vector<int8_t> q(codes.size());
+        if (!preprocess_codes(&format, codes.data(), (int)codes.size(), q.data())) {
+            std::fprintf(stderr, "window %d: %zu samples rejected\n", windows, codes.size());
+            return 1;
+        }
+        for (size_t i = 0; i < q.size(); i++) {
+            out << (i ? "," : "") << (int)q[i];
+        }
+        out << "\n";
+        windows++;
+    }
+
+    std::printf("%d windows preprocessed\n", windows);
+    return 0;
+}
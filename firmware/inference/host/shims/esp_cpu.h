@@ -0,0 +1,22 @@
+/*
+ * Host stand-in for esp_cpu.h. The "cycle" count is the monotonic clock in
+ * nanoseconds: relative costs only, real cycle counts need the hardware.
+ */
+#ifndef HOST_ESP_CPU_H
+#define HOST_ESP_CPU_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint32_t esp_cpu_cycle_count_t;
+
+esp_cpu_cycle_count_t esp_cpu_get_cycle_count(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOST_ESP_CPU_H */
@@ -0,0 +1,30 @@
+/*
+ * Host stand-in for esp_log.h: tagged lines on stderr. Only errors are
+ * printed unless HOST_LOG_LEVEL is raised (0 = none, 5 = verbose), so
+ * per-window warnings do not flood the benchmark output.
+ */
+#ifndef HOST_ESP_LOG_H
+#define HOST_ESP_LOG_H
+
+#include <stdio.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+
+#ifndef HOST_LOG_LEVEL
+#define HOST_LOG_LEVEL 1
+#endif
+
+#define HOST_LOG(level, letter, tag, format, ...) \
+    do { \
+        if ((level) <= HOST_LOG_LEVEL) { \
+            fprintf(stderr, letter " (%s) " format "\n", tag, ##__VA_ARGS__); \
+        } \
+    } while (0)
+
+#define ESP_LOGE(tag, format, ...) HOST_LOG(1, "E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) HOST_LOG(2, "W", tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) HOST_LOG(3, "I", tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) HOST_LOG(4, "D", tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) HOST_LOG(5, "V", tag, format, ##__VA_ARGS__)
+
+#endif /* HOST_ESP_LOG_H */
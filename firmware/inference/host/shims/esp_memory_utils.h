@@ -0,0 +1,13 @@
+/* Host stand-in for esp_memory_utils.h: everything is internal RAM */
+#ifndef HOST_ESP_MEMORY_UTILS_H
+#define HOST_ESP_MEMORY_UTILS_H
+
+#include <stdbool.h>
+
+static inline bool esp_ptr_external_ram(const void *p)
+{
+    (void)p;
+    return false;
+}
+
+#endif /* HOST_ESP_MEMORY_UTILS_H */
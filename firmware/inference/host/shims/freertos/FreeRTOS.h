@@ -0,0 +1,40 @@
+/*
+ * Host stand-in for the FreeRTOS headers the inference core includes. The
+ * benchmarks are single-threaded: one core, mutexes backed by pthreads,
+ * delays that sleep.
+ */
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdTRUE                  1
+#define pdFALSE                 0
+#define pdPASS                  pdTRUE
+#define pdFAIL                  pdFALSE
+#define portMAX_DELAY           ((TickType_t)0xFFFFFFFFUL)
+#define portTICK_PERIOD_MS      1
+#define portNUM_PROCESSORS      1
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(ms))
+
+static inline BaseType_t xPortGetCoreID(void)
+{
+    return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOST_FREERTOS_H */
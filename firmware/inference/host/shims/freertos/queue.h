@@ -0,0 +1,15 @@
+/* Host stand-in: queue handles only (no queue is used by the host core) */
+#ifndef HOST_FREERTOS_QUEUE_H
+#define HOST_FREERTOS_QUEUE_H
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct host_queue_s *QueueHandle_t;
+
+static inline UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    (void)queue;
+    return 0;
+}
+
+#endif /* HOST_FREERTOS_QUEUE_H */
@@ -0,0 +1,36 @@
+/*
+ * Host build configuration: the Kconfig defaults of main/Kconfig.projbuild,
+ * minus the ESP-only accelerators (ESP-DSP FFT, ESP-NN kernels). Options
+ * the benchmarks sweep can be overridden with -D on the CMake command line.
+ */
+#ifndef HOST_SDKCONFIG_H
+#define HOST_SDKCONFIG_H
+
+#ifndef CONFIG_INFERENCE_SAMPLE_WINDOW_SIZE
+#define CONFIG_INFERENCE_SAMPLE_WINDOW_SIZE 256
+#endif
+#if !defined(CONFIG_PREPROCESS_WINDOW_HAMMING) && !defined(CONFIG_PREPROCESS_WINDOW_BLACKMAN)
+#define CONFIG_PREPROCESS_WINDOW_HANN 1
+#endif
+
+#define CONFIG_INFERENCE_USE_FFT 1
+#define CONFIG_ENABLE_SIGNAL_VALIDATION 1
+#define CONFIG_ENABLE_MEMORY_METRICS 1
+#define CONFIG_SIGNAL_GATE 1
+#define CONFIG_SIGNAL_GATE_MIN_P2P_CODES 200
+#define CONFIG_SIGNAL_GATE_RAIL_CODES 16
+#define CONFIG_SIGNAL_GATE_MAX_DC_CODES 614
+#define CONFIG_SIGNAL_GATE_NOISE_ZCR_PCT 40
+
+#define CONFIG_INFERENCE_ARENA_HEADROOM_PCT 10
+#define CONFIG_INFERENCE_ARENA_PROBE_KB 128
+#define CONFIG_INFERENCE_ARENA_INTERNAL_MAX_KB 48
+#define CONFIG_INFERENCE_ARENA_INTERNAL_RESERVE_KB 48
+#define CONFIG_INFERENCE_LATENCY_BUDGET_US 12800
+#define CONFIG_MODEL_REGISTRY_RESIDENT_BUDGET_KB 64
+#define CONFIG_MODEL_CNN_INT8 1
+
+#define CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ 240
+#define CONFIG_FREERTOS_UNICORE 1
+
+#endif /* HOST_SDKCONFIG_H */
@@ -3,17 +3,25 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
+#include "esp_timer.h"
 #include "soc/soc_caps.h"
+#include "ml_contract.h"
+#include "decimator.h"
+#include "system_monitor.h"
+#include "esp_cpu.h"
+#include <stdatomic.h>
+#include <string.h>
 
 static const char *TAG = "ADC_SAMPLING";
 
 // ADC configuration
 #define ADC_UNIT                    ADC_UNIT_1
-#define ADC_CHANNEL                 ADC_CHANNEL_6  // GPIO34
+#define ADC_CHANNEL                 CONFIG_ADC_INPUT_CHANNEL_0  // GPIO34 by default
 #define ADC_ATTEN                   ADC_ATTEN_DB_12
 #define ADC_BIT_WIDTH               SOC_ADC_DIGI_MAX_BITWIDTH
-#define SAMPLE_RATE_HZ              20000
-#define READ_LEN                    256
+#define SAMPLE_RATE_HZ              ML_SAMPLE_RATE_HZ          // Per channel, after decimation
+#define DECIMATION                  CONFIG_ADC_DECIMATION
+#define CONVERSION_RATE_HZ          (SAMPLE_RATE_HZ * DECIMATION * ADC_STREAM_COUNT)
 
 #if CONFIG_IDF_TARGET_ESP32 || CONFIG_IDF_TARGET_ESP32S2
 #define ADC_OUTPUT_TYPE             ADC_DIGI_OUTPUT_FORMAT_TYPE1
@@ -25,19 +33,157 @@ static const char *TAG = "ADC_SAMPLING";
 #define ADC_GET_DATA(p_data)        ((p_data)->type2.data)
 #endif
 
+#define WINDOW_POOL_DEPTH           CONFIG_ADC_WINDOW_POOL_DEPTH
+#define WINDOW_HOP                  CONFIG_ADC_WINDOW_HOP
+
+// Conversion results go through a stage to be split by channel or filtered
+#define DEMUX_RESULTS               (ADC_STREAM_COUNT > 1 || DECIMATION > 1)
+
+// Conversions per DMA frame: by default one hop of every channel, capped
+// so heavy oversampling does not need huge DMA buffers
+#define HOP_CONVERSIONS             (WINDOW_HOP * DECIMATION * ADC_STREAM_COUNT)
+#if CONFIG_ADC_DMA_FRAME_CONVERSIONS > 0
+#define READ_LEN                    CONFIG_ADC_DMA_FRAME_CONVERSIONS
+#elif HOP_CONVERSIONS > 1024
+#define READ_LEN                    1024
+#else
+#define READ_LEN                    HOP_CONVERSIONS
+#endif
+#define FRAME_BYTES                 (READ_LEN * SOC_ADC_DIGI_RESULT_BYTES)
+#define DMA_POOL_BYTES              (4 * FRAME_BYTES < 2048 ? 2048 : 4 * FRAME_BYTES)
+
+_Static_assert(FRAME_BYTES % SOC_ADC_DIGI_DATA_BYTES_PER_CONV == 0,
+               "ADC_DMA_FRAME_CONVERSIONS must fill whole DMA conversion slots");
+_Static_assert(CONVERSION_RATE_HZ >= SOC_ADC_SAMPLE_FREQ_THRES_LOW &&
+               CONVERSION_RATE_HZ <= SOC_ADC_SAMPLE_FREQ_THRES_HIGH,
+               "sample rate x decimation x channels outside the converter's range");
+
+// Raw conversion results for one window; decoded to uint16 codes in place
+#define WINDOW_FRAME_BYTES          (ML_WINDOW_SIZE * SOC_ADC_DIGI_RESULT_BYTES)
+
+// ADC channel of each stream, in pattern order
+static const uint8_t s_stream_channels[] = {
+    CONFIG_ADC_INPUT_CHANNEL_0,
+#if ADC_STREAM_COUNT >= 2
+    CONFIG_ADC_INPUT_CHANNEL_1,
+#endif
+#if ADC_STREAM_COUNT >= 3
+    CONFIG_ADC_INPUT_CHANNEL_2,
+#endif
+#if ADC_STREAM_COUNT >= 4
+    CONFIG_ADC_INPUT_CHANNEL_3,
+#endif
+};
+_Static_assert(sizeof(s_stream_channels) == ADC_STREAM_COUNT, "one ADC channel per stream");
+_Static_assert(ADC_STREAM_COUNT <= ADC_STREAM_MAX, "too many ADC streams");
+
 static adc_config_t s_adc_config;
 static TaskHandle_t s_conversion_task_handle = NULL;
 
+// Conversion timeline: the ISR stamps each DMA frame as it completes, the
+// reader counts results it has consumed. A result's conversion time is
+// the last frame time minus the results converted after it.
+static portMUX_TYPE s_timeline_lock = portMUX_INITIALIZER_UNLOCKED;
+static int64_t s_frame_done_us = 0;        // esp_timer time of the last completed frame
+static uint64_t s_results_converted = 0;   // Results in frames that reached the pool
+static uint64_t s_results_consumed = 0;    // Results read by the ADC task
+#ifdef CONFIG_STAGE_TRACE
+static uint32_t s_dma_cycles = 0;          // Cycle count at the last successful frame read
+#endif
+static uint32_t s_pool_overflows = 0;      // Frames the driver dropped with a full pool
+static uint32_t s_overflows_seen[ADC_STREAM_COUNT]; // s_pool_overflows at each stream's last window
+
+// Window ring: a single-producer/single-consumer ring of descriptors.
+// Only the ADC task advances s_ring_head, only the consumer advances
+// s_ring_tail; both are free-running and indexed modulo the depth.
+// Slot WINDOW_POOL_DEPTH is the producer's scratch window for overruns.
+static uint32_t s_window_storage[WINDOW_POOL_DEPTH + 1][WINDOW_FRAME_BYTES / sizeof(uint32_t)];
+static float s_input_storage[WINDOW_POOL_DEPTH + 1][ML_WINDOW_SIZE] __attribute__((aligned(16)));
+static adc_window_t s_windows[WINDOW_POOL_DEPTH + 1];
+static atomic_uint s_ring_head = 0;
+static atomic_uint s_ring_tail = 0;
+static volatile TaskHandle_t s_consumer_task = NULL;
+static uint32_t s_window_sequence[ADC_STREAM_COUNT];
+static atomic_uint s_window_overruns = 0;
+static bool s_pool_initialized = false;
+static bool s_resumed[ADC_STREAM_COUNT];
+
+#define SCRATCH_WINDOW              (&s_windows[WINDOW_POOL_DEPTH])
+
+// Producer-side preprocessing format, set by the consumer whenever its
+// model changes; the producer copies it once per window
+static preprocess_format_t s_input_format = { .type = PREPROCESS_OUTPUT_NONE };
+static portMUX_TYPE s_input_format_lock = portMUX_INITIALIZER_UNLOCKED;
+
+#if DEMUX_RESULTS
+// Several channels or decimation: conversion frames are staged and
+// demultiplexed one result at a time into per-stream hops, through the
+// stream's decimator. Results after a completed window stay staged for
+// the next call.
+typedef struct {
+    uint16_t hop[WINDOW_HOP];
+    uint32_t fill;
+    #if DECIMATION > 1
+    decimator_t decimator;
+    #endif
+    #if WINDOW_HOP < ML_WINDOW_SIZE
+    sliding_window_t sliding;
+    bool sliding_initialized;
+    #endif
+} adc_stream_t;
+
+static adc_stream_t s_streams[ADC_STREAM_COUNT];
+static int8_t s_stream_of_channel[SOC_ADC_CHANNEL_NUM(ADC_UNIT)]; // -1: not sampled
+static uint32_t s_stage_storage[FRAME_BYTES / sizeof(uint32_t)];
+static uint32_t s_stage_bytes = 0;
+static uint32_t s_stage_pos = 0;
+#elif WINDOW_HOP < ML_WINDOW_SIZE
+// Overlapping windows: hops accumulate in a sliding window with running moments
+static sliding_window_t s_sliding;
+static uint32_t s_hop_storage[WINDOW_HOP * SOC_ADC_DIGI_RESULT_BYTES / sizeof(uint32_t)];
+static bool s_sliding_initialized = false;
+#endif
+
 // ADC conversion done callback
 static bool IRAM_ATTR conversion_done_callback(adc_continuous_handle_t handle, 
                                                const adc_continuous_evt_data_t *edata, 
                                                void *user_data)
 {
+    // Stamp at DMA completion, before any task latency
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL_ISR(&s_timeline_lock);
+    s_frame_done_us = now;
+    s_results_converted += edata->size / SOC_ADC_DIGI_RESULT_BYTES;
+    portEXIT_CRITICAL_ISR(&s_timeline_lock);
+    
     BaseType_t mustYield = pdFALSE;
     vTaskNotifyGiveFromISR(s_conversion_task_handle, &mustYield);
     return (mustYield == pdTRUE);
 }
 
+// Pool full: the frame just stamped was dropped and will never be read
+static bool IRAM_ATTR pool_overflow_callback(adc_continuous_handle_t handle, 
+                                             const adc_continuous_evt_data_t *edata, 
+                                             void *user_data)
+{
+    portENTER_CRITICAL_ISR(&s_timeline_lock);
+    s_results_converted -= edata->size / SOC_ADC_DIGI_RESULT_BYTES;
+    s_pool_overflows++;
+    portEXIT_CRITICAL_ISR(&s_timeline_lock);
+    return false;
+}
+
+// Conversion time of the most recently consumed result
+static int64_t consumed_result_time_us(void)
+{
+    portENTER_CRITICAL(&s_timeline_lock);
+    int64_t frame_done_us = s_frame_done_us;
+    uint64_t pending = s_results_converted - s_results_consumed;
+    portEXIT_CRITICAL(&s_timeline_lock);
+    
+    return frame_done_us - (int64_t)(pending * 1000000ULL / CONVERSION_RATE_HZ);
+}
+
 // Initialize ADC continuous sampling
 adc_continuous_handle_t adc_sampling_init(void)
 {
@@ -49,8 +195,8 @@ adc_continuous_handle_t adc_sampling_init(void)
     
     // ADC handle configuration
     adc_continuous_handle_cfg_t adc_handle_cfg = {
-        .max_store_buf_size = 2048,
-        .conv_frame_size = READ_LEN * SOC_ADC_DIGI_RESULT_BYTES,
+        .max_store_buf_size = DMA_POOL_BYTES,
+        .conv_frame_size = FRAME_BYTES,
     };
     
     ret = adc_continuous_new_handle(&adc_handle_cfg, &handle);
@@ -60,22 +206,43 @@ adc_continuous_handle_t adc_sampling_init(void)
     }
     
     // ADC continuous mode configuration
+    // The pattern cycles through the channels: the rate is the total
     adc_continuous_config_t adc_cont_cfg = {
-        .sample_freq_hz = SAMPLE_RATE_HZ,
+        .sample_freq_hz = CONVERSION_RATE_HZ,
         .conv_mode = ADC_CONV_SINGLE_UNIT_1,
         .format = ADC_OUTPUT_TYPE,
     };
     
-    // Pattern configuration for single channel
-    adc_digi_pattern_config_t adc_pattern = {
-        .atten = ADC_ATTEN,
-        .channel = ADC_CHANNEL & 0x7,
-        .unit = ADC_UNIT,
-        .bit_width = ADC_BIT_WIDTH,
-    };
+    // One pattern entry per stream
+    adc_digi_pattern_config_t adc_pattern[ADC_STREAM_COUNT];
+    #if DEMUX_RESULTS
+    memset(s_stream_of_channel, -1, sizeof(s_stream_of_channel));
+    #endif
+    for (int i = 0; i < ADC_STREAM_COUNT; i++) {
+        uint8_t channel = s_stream_channels[i];
+        #if DEMUX_RESULTS
+        if (s_stream_of_channel[channel] >= 0) {
+            ESP_LOGE(TAG, "ADC channel %d configured for inputs %d and %d",
+                     channel, s_stream_of_channel[channel], i);
+            adc_continuous_deinit(handle);
+            return NULL;
+        }
+        s_stream_of_channel[channel] = (int8_t)i;
+        #endif
+        #if DECIMATION > 1
+        decimator_init(&s_streams[i].decimator, DECIMATION);
+        #endif
+        adc_pattern[i] = (adc_digi_pattern_config_t){
+            .atten = ADC_ATTEN,
+            .channel = channel & 0x7,
+            .unit = ADC_UNIT,
+            .bit_width = ADC_BIT_WIDTH,
+        };
+        s_adc_config.channels[i] = channel;
+    }
     
-    adc_cont_cfg.pattern_num = 1;
-    adc_cont_cfg.adc_pattern = &adc_pattern;
+    adc_cont_cfg.pattern_num = ADC_STREAM_COUNT;
+    adc_cont_cfg.adc_pattern = adc_pattern;
     
     ret = adc_continuous_config(handle, &adc_cont_cfg);
     if (ret != ESP_OK) {
@@ -87,6 +254,7 @@ adc_continuous_handle_t adc_sampling_init(void)
     // Register event callbacks
     adc_continuous_evt_cbs_t cbs = {
         .on_conv_done = conversion_done_callback,
+        .on_pool_ovf = pool_overflow_callback,
     };
     
     ret = adc_continuous_register_event_callbacks(handle, &cbs, NULL);
@@ -107,60 +275,447 @@ adc_continuous_handle_t adc_sampling_init(void)
     // Store configuration
     s_adc_config.handle = handle;
     s_adc_config.channel = ADC_CHANNEL;
+    s_adc_config.channel_count = ADC_STREAM_COUNT;
     s_adc_config.sample_rate_hz = SAMPLE_RATE_HZ;
+    s_adc_config.decimation = DECIMATION;
     s_adc_config.adc_unit = ADC_UNIT;
     s_adc_config.adc_bit_width = ADC_BIT_WIDTH;
     
     ESP_LOGI(TAG, "ADC initialized: channel=%d, sample_rate=%d Hz", 
              ADC_CHANNEL, SAMPLE_RATE_HZ);
+    #if DEMUX_RESULTS
+    ESP_LOGI(TAG, "%d input channel(s), decimation %d, %d Hz conversion rate, %d-result frames", 
+             ADC_STREAM_COUNT, DECIMATION, CONVERSION_RATE_HZ, READ_LEN);
+    #endif
     
     return handle;
 }
 
-// Read samples from ADC
-esp_err_t adc_sampling_read(adc_continuous_handle_t handle, 
-                            int16_t *buffer, 
-                            size_t buffer_size, 
-                            uint32_t *samples_read)
+#if !DEMUX_RESULTS
+// Decode conversion results at raw[0..bytes) into codes starting at
+// index 'first'. Safe in place: code i is written at or below the
+// result it came from.
+static uint32_t decode_frame(const uint8_t *raw, uint32_t bytes, 
+                             uint16_t *codes, uint32_t first, uint32_t max_codes)
 {
-    uint8_t raw_buffer[READ_LEN * SOC_ADC_DIGI_RESULT_BYTES];
-    uint32_t bytes_read;
-    esp_err_t ret;
+    uint32_t n = bytes / SOC_ADC_DIGI_RESULT_BYTES;
+    uint32_t written = 0;
+    
+    for (uint32_t i = 0; i < n && first + written < max_codes; i++) {
+        const adc_digi_output_data_t *p = (const adc_digi_output_data_t*)&raw[i * SOC_ADC_DIGI_RESULT_BYTES];
+        uint32_t chan = ADC_GET_CHANNEL(p);
+        uint32_t data = ADC_GET_DATA(p);
+        
+        // Drop results from other channels (and corrupt ones) instead of zero-filling
+        if (chan == ADC_CHANNEL) {
+            codes[first + written++] = (uint16_t)data;
+        }
+    }
+    
+    return written;
+}
+#endif
+
+esp_err_t adc_window_pool_init(void)
+{
+    if (s_pool_initialized) {
+        return ESP_OK;
+    }
     
-    // Wait for conversion complete
-    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    for (int i = 0; i <= WINDOW_POOL_DEPTH; i++) {
+        adc_window_t *w = &s_windows[i];
+        w->codes = (uint16_t *)s_window_storage[i];
+        w->input = s_input_storage[i];
+        w->count = 0;
+        w->input_format.type = PREPROCESS_OUTPUT_NONE;
+    }
+    atomic_store(&s_ring_head, 0);
+    atomic_store(&s_ring_tail, 0);
+    s_pool_initialized = true;
     
-    // Read ADC data
-    ret = adc_continuous_read(handle, raw_buffer, 
-                              READ_LEN * SOC_ADC_DIGI_RESULT_BYTES, 
-                              &bytes_read, 0);
+    ESP_LOGI(TAG, "Window ring: %d x %d samples, hop %d", 
+             WINDOW_POOL_DEPTH, ML_WINDOW_SIZE, WINDOW_HOP);
+    return ESP_OK;
+}
+
+void adc_window_set_input_format(const preprocess_format_t *format)
+{
+    if (!format) {
+        return;
+    }
+    portENTER_CRITICAL(&s_input_format_lock);
+    s_input_format = *format;
+    portEXIT_CRITICAL(&s_input_format_lock);
+    ESP_LOGI(TAG, "Producer preprocessing enabled (format %d)", format->type);
+}
+
+#if !DEMUX_RESULTS
+// Read exactly 'wanted' codes into buf (raw frames, decoded in place)
+static esp_err_t read_codes(adc_continuous_handle_t handle, uint16_t *buf, uint32_t wanted)
+{
+    uint8_t *raw = (uint8_t *)buf;
+    uint32_t frame_bytes = wanted * SOC_ADC_DIGI_RESULT_BYTES;
+    uint32_t count = 0;
     
-    if (ret != ESP_OK) {
-        if (ret != ESP_ERR_TIMEOUT) {
+    while (count < wanted) {
+        // Read the remainder after the codes decoded so far. A DMA frame
+        // need not match a hop, so what is already pooled is read first.
+        uint32_t offset = count * SOC_ADC_DIGI_RESULT_BYTES;
+        uint32_t bytes_read = 0;
+        esp_err_t ret = adc_continuous_read(handle, raw + offset, 
+                                            frame_bytes - offset, 
+                                            &bytes_read, 0);
+        if (ret != ESP_OK) {
+            if (ret == ESP_ERR_TIMEOUT) {
+                // Wait for conversion complete
+                ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+                continue;
+            }
             ESP_LOGE(TAG, "ADC read error: %s", esp_err_to_name(ret));
+            return ret;
         }
-        return ret;
+        
+        #ifdef CONFIG_STAGE_TRACE
+        s_dma_cycles = esp_cpu_get_cycle_count();
+        #endif
+        s_results_consumed += bytes_read / SOC_ADC_DIGI_RESULT_BYTES;
+        count += decode_frame(raw + offset, bytes_read, buf, count, wanted);
+    }
+    
+    return ESP_OK;
+}
+#endif
+
+// Next free ring slot, or the scratch window if the consumer owns them all
+static adc_window_t *acquire_slot(void)
+{
+    uint32_t head = atomic_load_explicit(&s_ring_head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&s_ring_tail, memory_order_acquire);
+    
+    if (head - tail >= WINDOW_POOL_DEPTH) {
+        return SCRATCH_WINDOW;
     }
+    return &s_windows[head % WINDOW_POOL_DEPTH];
+}
+
+// Preprocess on the producer core so the consumer only runs the model
+static void prepare_input(adc_window_t *w)
+{
+    preprocess_format_t format;
+    portENTER_CRITICAL(&s_input_format_lock);
+    format = s_input_format;
+    portEXIT_CRITICAL(&s_input_format_lock);
     
-    // Convert raw data to samples
-    size_t num_samples = bytes_read / SOC_ADC_DIGI_RESULT_BYTES;
-    *samples_read = num_samples;
+    w->input_format.type = PREPROCESS_OUTPUT_NONE;
+    if (format.type == PREPROCESS_OUTPUT_NONE) {
+        return;
+    }
+    int64_t start = esp_timer_get_time();
+    if (preprocess_codes(&format, w->codes, w->count, w->input)) {
+        w->input_format = format;
+        metrics_record_stage(METRIC_STAGE_PREPROCESS, (uint32_t)(esp_timer_get_time() - start));
+    }
+}
+
+#if DEMUX_RESULTS
+// Next staged conversion result, reading a frame when the stage runs dry
+static const adc_digi_output_data_t *next_result(adc_continuous_handle_t handle)
+{
+    while (s_stage_pos >= s_stage_bytes) {
+        uint32_t bytes_read = 0;
+        esp_err_t ret = adc_continuous_read(handle, (uint8_t *)s_stage_storage, 
+                                            sizeof(s_stage_storage), &bytes_read, 0);
+        if (ret == ESP_ERR_TIMEOUT) {
+            // Wait for conversion complete
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "ADC read error: %s", esp_err_to_name(ret));
+            return NULL;
+        }
+        #ifdef CONFIG_STAGE_TRACE
+        s_dma_cycles = esp_cpu_get_cycle_count();
+        #endif
+        s_stage_pos = 0;
+        s_stage_bytes = bytes_read - bytes_read % SOC_ADC_DIGI_RESULT_BYTES;
+    }
     
-    for (int i = 0; i < num_samples && i < buffer_size; i++) {
-        adc_digi_output_data_t *p = (adc_digi_output_data_t*)&raw_buffer[i * SOC_ADC_DIGI_RESULT_BYTES];
+    const adc_digi_output_data_t *p = 
+        (const adc_digi_output_data_t *)((const uint8_t *)s_stage_storage + s_stage_pos);
+    s_stage_pos += SOC_ADC_DIGI_RESULT_BYTES;
+    s_results_consumed++;
+    return p;
+}
+
+// Demultiplex (and decimate) until some stream has a new window; returns it in a slot
+static adc_window_t *fill_demuxed(adc_continuous_handle_t handle, int *stream)
+{
+    while (1) {
+        const adc_digi_output_data_t *p = next_result(handle);
+        if (!p) {
+            return NULL;
+        }
         uint32_t chan = ADC_GET_CHANNEL(p);
-        uint32_t data = ADC_GET_DATA(p);
+        if (chan >= SOC_ADC_CHANNEL_NUM(ADC_UNIT) || s_stream_of_channel[chan] < 0) {
+            continue;
+        }
+        int index = s_stream_of_channel[chan];
+        adc_stream_t *st = &s_streams[index];
+        #if DECIMATION > 1
+        if (!decimator_push(&st->decimator, (uint16_t)ADC_GET_DATA(p), &st->hop[st->fill])) {
+            continue;
+        }
+        st->fill++;
+        #else
+        st->hop[st->fill++] = (uint16_t)ADC_GET_DATA(p);
+        #endif
+        if (st->fill < WINDOW_HOP) {
+            continue;
+        }
+        st->fill = 0;
         
-        // Validate channel
-        if (chan < SOC_ADC_CHANNEL_NUM(ADC_UNIT)) {
-            // Convert to signed 16-bit
-            buffer[i] = (int16_t)data;
-        } else {
-            buffer[i] = 0;
+        #if WINDOW_HOP < ML_WINDOW_SIZE
+        if (!st->sliding_initialized) {
+            sliding_window_reset(&st->sliding);
+            st->sliding_initialized = true;
+        }
+        sliding_window_push(&st->sliding, st->hop, WINDOW_HOP);
+        if (!sliding_window_ready(&st->sliding)) {
+            continue;
         }
+        adc_window_t *w = acquire_slot();
+        sliding_window_snapshot(&st->sliding, w->codes, &w->moments);
+        #else
+        // Results are interleaved, so the window is copied out of the hop
+        adc_window_t *w = acquire_slot();
+        memcpy(w->codes, st->hop, sizeof(st->hop));
+        window_moments_compute(w->codes, ML_WINDOW_SIZE, &w->moments);
+        #endif
+        
+        *stream = index;
+        return w;
+    }
+}
+#endif
+
+// The filter output lags the last conversion by its group delay
+#if DECIMATION > 1
+#define FILTER_DELAY_US \
+    ((int64_t)(DECIMATION * DECIMATOR_TAPS_PER_PHASE - 1) * 500000LL / (SAMPLE_RATE_HZ * DECIMATION))
+#else
+#define FILTER_DELAY_US 0
+#endif
+
+// Stamp a window of 'stream' whose codes and moments are in place
+static void finish_window(adc_window_t *w, int stream)
+{
+    #ifdef CONFIG_STAGE_TRACE
+    // The window's last sample arrived with the frame read last
+    memset(&w->trace, 0, sizeof(w->trace));
+    w->trace.cycles[STAGE_TRACE_DMA_COMPLETE] = s_dma_cycles;
+    w->trace.reached = 1u << STAGE_TRACE_DMA_COMPLETE;
+    w->trace.channel = (uint8_t)stream;
+    #endif
+    w->count = ML_WINDOW_SIZE;
+    w->channel = (uint8_t)stream;
+    w->decimation = DECIMATION;
+    w->timestamp_us = consumed_result_time_us() - FILTER_DELAY_US;
+    w->start_us = w->timestamp_us - 
+                  (int64_t)(ML_WINDOW_SIZE - 1) * 1000000LL / SAMPLE_RATE_HZ;
+    
+    // Idle, saturated or stuck input is not worth queueing, let alone a model run
+    w->gate = (uint8_t)signal_gate_check(&w->moments);
+    if (w->gate != SIGNAL_GATE_PASS) {
+        w->flags = ADC_WINDOW_FLAG_REJECTED;
+        s_resumed[stream] = true;
+        return;
     }
     
-    return ESP_OK;
+    w->sequence = s_window_sequence[stream]++;
+    w->flags = s_resumed[stream] ? ADC_WINDOW_FLAG_RESUMED : 0;
+    s_resumed[stream] = false;
+    
+    // Frames lost to a full DMA pool since the last window: samples are missing
+    uint32_t overflows = adc_sampling_pool_overflows();
+    if (overflows != s_overflows_seen[stream]) {
+        w->flags |= ADC_WINDOW_FLAG_GAP;
+        s_overflows_seen[stream] = overflows;
+    }
+    
+    // Skip the work for a window that is about to be dropped
+    if (w != SCRATCH_WINDOW) {
+        prepare_input(w);
+    }
+    #ifdef CONFIG_STAGE_TRACE
+    w->trace.sequence = w->sequence;
+    stage_trace_mark_at(&w->trace, STAGE_TRACE_PREPARED);
+    #endif
+}
+
+adc_window_t *adc_window_fill(adc_continuous_handle_t handle)
+{
+    int stream = 0;
+    #if DEMUX_RESULTS
+    adc_window_t *w = fill_demuxed(handle, &stream);
+    if (!w) {
+        return NULL;
+    }
+    #elif WINDOW_HOP < ML_WINDOW_SIZE
+    if (!s_sliding_initialized) {
+        sliding_window_reset(&s_sliding);
+        s_sliding_initialized = true;
+    }
+    
+    // Slide by one hop (more until the first window is complete)
+    uint16_t *hop = (uint16_t *)s_hop_storage;
+    do {
+        if (read_codes(handle, hop, WINDOW_HOP) != ESP_OK) {
+            return NULL;
+        }
+        sliding_window_push(&s_sliding, hop, WINDOW_HOP);
+    } while (!sliding_window_ready(&s_sliding));
+    
+    // The ring keeps moving, so the window is unrolled into the slot
+    adc_window_t *w = acquire_slot();
+    sliding_window_snapshot(&s_sliding, w->codes, &w->moments);
+    #else
+    // Disjoint windows: frames land directly in the slot
+    adc_window_t *w = acquire_slot();
+    if (read_codes(handle, w->codes, ML_WINDOW_SIZE) != ESP_OK) {
+        return NULL;
+    }
+    window_moments_compute(w->codes, ML_WINDOW_SIZE, &w->moments);
+    #endif
+    
+    finish_window(w, stream);
+    return w;
+}
+
+bool adc_window_submit(adc_window_t *window)
+{
+    if (!window) {
+        return false;
+    }
+    if (window->flags & ADC_WINDOW_FLAG_REJECTED) {
+        metrics_record_rejected_window(window->gate);
+        return false;
+    }
+    if (window == SCRATCH_WINDOW) {
+        atomic_fetch_add_explicit(&s_window_overruns, 1, memory_order_relaxed);
+        return false;
+    }
+    
+    #ifdef CONFIG_STAGE_TRACE
+    stage_trace_mark_at(&window->trace, STAGE_TRACE_SEALED);
+    #endif
+    
+    // Release: the window contents are visible before the new head
+    uint32_t head = atomic_load_explicit(&s_ring_head, memory_order_relaxed);
+    atomic_store_explicit(&s_ring_head, head + 1, memory_order_release);
+    
+    TaskHandle_t consumer = s_consumer_task;
+    if (consumer) {
+        xTaskNotifyGive(consumer);
+    }
+    return true;
+}
+
+adc_window_t *adc_window_receive(TickType_t timeout)
+{
+    // Register before checking, so a submit in between still wakes us
+    if (!s_consumer_task) {
+        s_consumer_task = xTaskGetCurrentTaskHandle();
+    }
+    
+    uint32_t tail = atomic_load_explicit(&s_ring_tail, memory_order_relaxed);
+    while (atomic_load_explicit(&s_ring_head, memory_order_acquire) == tail) {
+        if (ulTaskNotifyTake(pdTRUE, timeout) == 0) {
+            return NULL;
+        }
+    }
+    
+    return &s_windows[tail % WINDOW_POOL_DEPTH];
+}
+
+void adc_window_release(adc_window_t *window)
+{
+    if (!window) {
+        return;
+    }
+    
+    // Release: done reading the slot before the producer may reuse it
+    uint32_t tail = atomic_load_explicit(&s_ring_tail, memory_order_relaxed);
+    if (window != &s_windows[tail % WINDOW_POOL_DEPTH]) {
+        ESP_LOGE(TAG, "Window released out of order");
+        return;
+    }
+    atomic_store_explicit(&s_ring_tail, tail + 1, memory_order_release);
+}
+
+uint32_t adc_window_utilization(void)
+{
+    uint32_t tail = atomic_load_explicit(&s_ring_tail, memory_order_acquire);
+    uint32_t head = atomic_load_explicit(&s_ring_head, memory_order_acquire);
+    return ((head - tail) * 100) / WINDOW_POOL_DEPTH;
+}
+
+uint32_t adc_window_overruns(void)
+{
+    return atomic_load_explicit(&s_window_overruns, memory_order_relaxed);
+}
+
+uint32_t adc_sampling_pool_overflows(void)
+{
+    portENTER_CRITICAL(&s_timeline_lock);
+    uint32_t overflows = s_pool_overflows;
+    portEXIT_CRITICAL(&s_timeline_lock);
+    return overflows;
+}
+
+void adc_sampling_pause(adc_continuous_handle_t handle)
+{
+    if (handle) {
+        adc_continuous_stop(handle);
+    }
+}
+
+esp_err_t adc_sampling_resume(adc_continuous_handle_t handle)
+{
+    if (!handle) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    // Results from before the pause would splice a gap into the window
+    adc_continuous_flush_pool(handle);
+    ulTaskNotifyTake(pdTRUE, 0);
+    portENTER_CRITICAL(&s_timeline_lock);
+    s_results_converted = 0;
+    s_results_consumed = 0;
+    portEXIT_CRITICAL(&s_timeline_lock);
+    #if DEMUX_RESULTS
+    s_stage_pos = s_stage_bytes = 0;
+    for (int i = 0; i < ADC_STREAM_COUNT; i++) {
+        s_streams[i].fill = 0;
+        #if DECIMATION > 1
+        decimator_reset(&s_streams[i].decimator);
+        #endif
+        #if WINDOW_HOP < ML_WINDOW_SIZE
+        s_streams[i].sliding_initialized = false;
+        #endif
+    }
+    #elif WINDOW_HOP < ML_WINDOW_SIZE
+    s_sliding_initialized = false;
+    #endif
+    for (int i = 0; i < ADC_STREAM_COUNT; i++) {
+        s_resumed[i] = true;
+    }
+    
+    esp_err_t ret = adc_continuous_start(handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to restart ADC: %s", esp_err_to_name(ret));
+    }
+    return ret;
 }
 
 // Deinitialize ADC
@@ -2,21 +2,70 @@
 #define ADC_SAMPLING_H
 
 #include <stdint.h>
+#include <stdbool.h>
 #include "esp_err.h"
 #include "esp_adc/adc_continuous.h"
+#include "freertos/FreeRTOS.h"
+#include "window_stats.h"
+#include "preprocessing.h"
+#include "signal_gate.h"
+#include "stage_trace.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// Input channels, one window stream each (stream i samples channels[i])
+#define ADC_STREAM_COUNT CONFIG_ADC_CHANNEL_COUNT
+#define ADC_STREAM_MAX   4
+
 typedef struct {
     adc_continuous_handle_t handle;
-    uint8_t channel;
-    uint32_t sample_rate_hz;
+    uint8_t channel;                      // ADC channel of stream 0
+    uint8_t channels[ADC_STREAM_MAX];
+    uint8_t channel_count;
+    uint32_t sample_rate_hz;              // Per channel, after decimation
+    uint8_t decimation;
     uint8_t adc_unit;
     uint8_t adc_bit_width;
 } adc_config_t;
 
+/**
+ * @brief One window of raw ADC codes, handed between tasks by pointer
+ * 
+ * Windows live in a fixed ring owned by adc_sampling. The conversion
+ * frame is read straight into the window and decoded in place, so a
+ * window is never copied after the driver hands it over. Once an input
+ * format is set, the producer also preprocesses the window into 'input'
+ * so the consumer only has to copy it into the model.
+ * 
+ * With several input channels, windows of all streams share the ring in
+ * completion order; 'channel' says which stream a window belongs to and
+ * sequence numbers (and the flags) are kept per stream.
+ */
+typedef struct {
+    uint16_t *codes;          // ML_WINDOW_SIZE raw codes (0..4095)
+    uint32_t count;           // Valid codes in this window
+    uint32_t sequence;        // Monotonic per stream; dropped windows leave gaps
+    int64_t timestamp_us;     // esp_timer conversion time of the last sample (less filter delay)
+    int64_t start_us;         // esp_timer conversion time of the first sample
+    window_moments_t moments; // Raw-code moments of this window
+    void *input;              // ML_WINDOW_SIZE preprocessed elements
+    preprocess_format_t input_format; // Format of 'input' (NONE if absent)
+    uint8_t flags;            // ADC_WINDOW_FLAG_*
+    uint8_t channel;          // Stream index (0..ADC_STREAM_COUNT-1)
+    uint8_t decimation;       // ADC conversions per code (ADC_DECIMATION)
+    uint8_t gate;             // signal_gate_t verdict (PASS unless REJECTED)
+#ifdef CONFIG_STAGE_TRACE
+    stage_trace_t trace;      // Producer markers, through SEALED
+#endif
+} adc_window_t;
+
+#define ADC_WINDOW_FLAG_RESUMED   0x01  // First window after adc_sampling_resume() or a rejection
+#define ADC_WINDOW_FLAG_DECISION  0x02  // Last window of a duty-cycle burst
+#define ADC_WINDOW_FLAG_GAP       0x04  // DMA pool overflowed: samples are missing
+#define ADC_WINDOW_FLAG_REJECTED  0x08  // Failed the signal gate; never reaches the consumer
+
 /**
  * @brief Initialize ADC continuous sampling
  * 
@@ -25,18 +74,118 @@ typedef struct {
 adc_continuous_handle_t adc_sampling_init(void);
 
 /**
- * @brief Read samples from ADC
+ * @brief Set up the window ring
+ * 
+ * The ring is single-producer/single-consumer and lock-free: only the
+ * ADC task fills and submits windows, only one consumer task receives
+ * and releases them. Must be called before any other adc_window_* function.
+ * 
+ * @return esp_err_t ESP_OK on success
+ */
+esp_err_t adc_window_pool_init(void);
+
+/**
+ * @brief Set the format windows are preprocessed into by the producer
+ * 
+ * Called by the consumer when its model is ready, and again whenever it
+ * switches models. Windows filled afterwards carry 'input' in this
+ * format; earlier ones have input_format.type == PREPROCESS_OUTPUT_NONE
+ * or the previous format, which the consumer must check.
+ * 
+ * @param format Model input format
+ */
+void adc_window_set_input_format(const preprocess_format_t *format);
+
+/**
+ * @brief Fill the next free window with samples (producer only)
+ * 
+ * With ADC_WINDOW_HOP < ML_WINDOW_SIZE, consecutive windows overlap and
+ * each call waits for one hop of new samples; the moments are maintained
+ * incrementally. Otherwise windows are disjoint. With several channels,
+ * returns the window of whichever stream completes next; the streams
+ * take turns. Blocks until ready. If
+ * every window is still owned by the consumer, the samples go to a
+ * scratch window that adc_window_submit() drops and counts as an
+ * overrun, so acquisition never stalls.
+ * 
+ * @param handle ADC handle
+ * @return adc_window_t* Filled window (NULL on read error)
+ */
+adc_window_t *adc_window_fill(adc_continuous_handle_t handle);
+
+/**
+ * @brief Publish a filled window to the consumer (producer only)
+ * 
+ * Windows the signal gate rejected (ADC_WINDOW_FLAG_REJECTED) are
+ * counted in the metrics and dropped without taking a sequence number;
+ * the next accepted window of the stream carries ADC_WINDOW_FLAG_RESUMED.
+ * 
+ * @param window Window returned by adc_window_fill()
+ * @return true if published, false if rejected or dropped as an overrun
+ */
+bool adc_window_submit(adc_window_t *window);
+
+/**
+ * @brief Take the oldest unprocessed window (consumer only)
+ * 
+ * @param timeout Ticks to wait
+ * @return adc_window_t* Window (NULL on timeout); release when done
+ */
+adc_window_t *adc_window_receive(TickType_t timeout);
+
+/**
+ * @brief Hand a window back to the producer (consumer only)
+ * 
+ * Windows must be released in the order they were received.
+ * 
+ * @param window Window returned by adc_window_receive()
+ */
+void adc_window_release(adc_window_t *window);
+
+/**
+ * @brief Ring occupancy (for utilization monitoring)
+ * 
+ * @return uint32_t Windows submitted but not yet released, in percent of the ring
+ */
+uint32_t adc_window_utilization(void);
+
+/**
+ * @brief Number of windows dropped because the consumer fell behind
+ * 
+ * @return uint32_t Overrun count
+ */
+uint32_t adc_window_overruns(void);
+
+/**
+ * @brief Number of conversion frames the driver dropped with a full pool
+ * 
+ * Happens when the ADC task itself falls behind. The next window filled
+ * afterwards carries ADC_WINDOW_FLAG_GAP.
+ * 
+ * @return uint32_t Pool overflow count
+ */
+uint32_t adc_sampling_pool_overflows(void);
+
+/**
+ * @brief Stop conversions (and their PM lock) until resumed
+ * 
+ * The continuous driver holds an APB frequency lock while running, which
+ * keeps the chip out of light sleep.
+ * 
+ * @param handle ADC handle
+ */
+void adc_sampling_pause(adc_continuous_handle_t handle);
+
+/**
+ * @brief Restart conversions after adc_sampling_pause()
+ * 
+ * Stale results are flushed and the next window is built from fresh
+ * samples only; it carries ADC_WINDOW_FLAG_RESUMED.
  * 
  * @param handle ADC handle
- * @param buffer Buffer to store samples
- * @param buffer_size Size of buffer
- * @param samples_read Number of samples actually read
  * @return esp_err_t ESP_OK on success
  */
-esp_err_t adc_sampling_read(adc_continuous_handle_t handle, 
-                            int16_t *buffer, 
-                            size_t buffer_size, 
-                            uint32_t *samples_read);
+esp_err_t adc_sampling_resume(adc_continuous_handle_t handle);
 
 /**
  * @brief Deinitialize ADC
@@ -18,15 +18,34 @@
 #include "inference.h"
 #include "system_monitor.h"
 #include "data_collection.h"
+#include "sample_stream.h"
+#include "telemetry.h"
+#include "stage_trace.h"
 #include "signal_processing.h"
 #include "benchmark.h"
+#include "benchmark_replay.h"
+#include "ml_contract.h"
+#include "clock_sync.h"
+#include "packet_decoder.h"
+#include "label_timeline.h"
+#include "duty_cycle.h"
+#include "degradation.h"
+#include "model_registry.h"
+#include "model_store.h"
 
 static const char *TAG = "SIGNAL_INFERENCE";
 
-// Signal buffer
-#define SAMPLE_WINDOW_SIZE 256
-static float g_samples[SAMPLE_WINDOW_SIZE];
-static float g_processed_samples[SAMPLE_WINDOW_SIZE];
+// Signal window (raw windows live in the adc_sampling ring)
+#define SAMPLE_WINDOW_SIZE ML_WINDOW_SIZE
+
+// Pipeline cores: acquisition + preprocessing on one, Invoke on the other
+#if CONFIG_FREERTOS_UNICORE
+#define ACQUISITION_CORE   0
+#define INFERENCE_CORE     0
+#else
+#define ACQUISITION_CORE   CONFIG_PIPELINE_ACQUISITION_CORE
+#define INFERENCE_CORE     CONFIG_PIPELINE_INFERENCE_CORE
+#endif
 
 // UART configuration for receiving labels
 #define UART_PORT_NUM      UART_NUM_1
@@ -34,61 +53,205 @@ static float g_processed_samples[SAMPLE_WINDOW_SIZE];
 #define UART_RX_PIN        16
 #define UART_TX_PIN        17
 #define UART_BUF_SIZE      1024
+#define UART_EVENT_QUEUE_SIZE   20
 
 // Task handles
 static TaskHandle_t s_adc_task_handle = NULL;
 static TaskHandle_t s_inference_task_handle = NULL;
 
-// Queues for inter-task communication
-static QueueHandle_t s_samples_queue = NULL;
+// Label messages are passed by value; no heap per label
+typedef struct {
+    ml_class_t label;
+    int64_t time_us;        // Generator time the label became active
+    bool stamped;           // time_us is the generator's DAC output time
+} label_event_t;
+
+// One UART frame on the wire, for latency compensation of received times
+#define PACKET_AIRTIME_US  ((int64_t)sizeof(uart_packet_t) * 10 * 1000000LL / UART_BAUD_RATE)
+
+// Results are scored this long after their window ends, so a label change
+// inside the window has arrived over UART by then
+#define LABEL_SETTLE_US    20000
+#define PENDING_SCORES     8
+
+// Inference results logged: every Nth, adjustable by the host with telemetry
+#ifdef CONFIG_TELEMETRY_ENABLE
+#define INFERENCE_LOG_INTERVAL  telemetry_log_interval()
+#else
+#define INFERENCE_LOG_INTERVAL  CONFIG_INFERENCE_LOG_INTERVAL
+#endif
+
+// Queues for inter-task communication (sample windows use adc_window_*)
 static QueueHandle_t s_labels_queue = NULL;
+static QueueHandle_t s_uart_event_queue = NULL;
+
+// Clock offset to the generator, fed by its packets. Written by the UART
+// task only; readers take a snapshot under the lock.
+static clock_sync_t s_clock_sync;
+static portMUX_TYPE s_clock_sync_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void clock_sync_update(const uart_packet_t *packet)
+{
+    // Update a copy so the lock is never held across logging
+    clock_sync_t next = s_clock_sync;
+    uart_packet_t copy = *packet;
+    sync_process_packet(&next, &copy);
+    
+    portENTER_CRITICAL(&s_clock_sync_lock);
+    s_clock_sync = next;
+    portEXIT_CRITICAL(&s_clock_sync_lock);
+}
+
+static void clock_sync_snapshot(clock_sync_t *sync)
+{
+    portENTER_CRITICAL(&s_clock_sync_lock);
+    *sync = s_clock_sync;
+    portEXIT_CRITICAL(&s_clock_sync_lock);
+}
+
+// Local esp_timer time -> generator time
+static int64_t to_generator_time(const clock_sync_t *sync, int64_t local_us)
+{
+    if (sync->sync_count == 0) {
+        return local_us;
+    }
+    // The offset was measured at packet arrival, one airtime after sending
+    return sync_local_to_remote_us(sync, local_us) + PACKET_AIRTIME_US;
+}
+
+// Hand a label change to the inference task
+static void publish_label(ml_class_t label, int64_t time_us, bool stamped)
+{
+    label_event_t event = {
+        .label = label,
+        .time_us = time_us,
+        .stamped = stamped,
+    };
+    
+    // Only the latest label matters: drop the oldest if the queue is full
+    if (xQueueSend(s_labels_queue, &event, 0) != pdTRUE) {
+        label_event_t stale;
+        xQueueReceive(s_labels_queue, &stale, 0);
+        xQueueSend(s_labels_queue, &event, 0);
+    }
+}
+
+// Framed generator packets: labels, clock sync and heartbeats
+static void handle_uart_packet(const uart_packet_t *packet, bool duplicate, void *ctx)
+{
+    health_update_uart_activity();
+    
+    switch (packet->packet_type) {
+        case PKT_TYPE_LABEL: {
+            // Retries are ACKed too: the generator resends until it hears one
+            uart_send_ack(packet->sequence);
+            if (duplicate) {
+                break;
+            }
+            
+            char name[PACKET_MAX_PAYLOAD + 1];
+            memcpy(name, packet->payload, packet->payload_length);
+            name[packet->payload_length] = 0;
+            
+            ml_class_t label = ml_class_from_string(name);
+            if (label == ML_CLASS_UNKNOWN) {
+                ESP_LOGW(TAG, "Unknown label: %s", name);
+            }
+            // The generator switches its output right before sending
+            publish_label(label, (int64_t)packet->timestamp_ms * 1000, false);
+            clock_sync_update(packet);
+            break;
+        }
+        case PKT_TYPE_WAVEFORM_CONFIG: {
+            // Sent before the label with the exact output time of the switch;
+            // the label that follows is then a repeat
+            waveform_config_payload_t config;
+            if (duplicate || packet->payload_length < sizeof(config)) {
+                break;
+            }
+            memcpy(&config, packet->payload, sizeof(config));
+            clock_sync_update(packet);
+            if ((config.flags & WAVEFORM_CONFIG_FLAG_TIMING_VALID) && 
+                ML_VALIDATE_CLASS(config.waveform)) {
+                publish_label((ml_class_t)config.waveform, config.output_time_us, true);
+            }
+            break;
+        }
+        case PKT_TYPE_TIMESTAMP:
+        case PKT_TYPE_HEARTBEAT: {
+            // A retried packet carries a stale send time
+            if (!duplicate) {
+                clock_sync_update(packet);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
 
-// System health monitoring
-static system_health_t s_system_health;
+// Legacy ASCII labels ("LBL:<class>", e.g. from collect_data.py)
+static void handle_uart_line(char *line, void *ctx)
+{
+    health_update_uart_activity();
+    if (strncmp(line, "LBL:", 4) != 0) {
+        return;
+    }
+    
+    // Trim trailing spaces
+    char *label = line + 4;
+    int len = strlen(label);
+    while (len > 0 && label[len - 1] == ' ') {
+        label[--len] = 0;
+    }
+    
+    ml_class_t cls = ml_class_from_string(label);
+    if (cls == ML_CLASS_UNKNOWN) {
+        ESP_LOGW(TAG, "Unknown label: %s", label);
+    }
+    // No send time in ASCII: use our receive time on the generator clock
+    publish_label(cls, to_generator_time(&s_clock_sync, esp_timer_get_time()), false);
+}
 
-// UART label reception task
+// UART reception task: wakes on driver data events and streams the bytes
+// through the packet decoder
 static void uart_receive_task(void *arg)
 {
-    uint8_t data[UART_BUF_SIZE];
-    char label_buffer[64];
-    int label_index = 0;
+    static packet_decoder_t decoder;
+    uint8_t data[128];
+    uart_event_t event;
+    
+    packet_decoder_init(&decoder, handle_uart_packet, handle_uart_line, NULL);
     
     while (1) {
-        int len = uart_read_bytes(UART_PORT_NUM, data, UART_BUF_SIZE - 1, 20 / portTICK_PERIOD_MS);
-        if (len > 0) {
-            data[len] = 0;
-            
-            for (int i = 0; i < len; i++) {
-                if (data[i] == '\n' || data[i] == '\r') {
-                    if (label_index > 0) {
-                        label_buffer[label_index] = 0;
-                        
-                        // Parse label
-                        if (strstr(label_buffer, "LBL:")) {
-                            char *label = label_buffer + 4;
-                            
-                            // Clean up trailing whitespace
-                            char *end = label + strlen(label) - 1;
-                            while (end > label && (*end == '\n' || *end == '\r' || *end == ' ')) {
-                                *end = 0;
-                                end--;
-                            }
-                            
-                            // Send to inference task
-                            char *queue_label = malloc(strlen(label) + 1);
-                            if (queue_label) {
-                                strcpy(queue_label, label);
-                                xQueueSend(s_labels_queue, &queue_label, portMAX_DELAY);
-                            }
-                        }
-                        label_index = 0;
+        if (xQueueReceive(s_uart_event_queue, &event, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        
+        switch (event.type) {
+            case UART_DATA: {
+                size_t remaining = event.size;
+                while (remaining > 0) {
+                    int n = uart_read_bytes(UART_PORT_NUM, data, 
+                                            remaining < sizeof(data) ? remaining : sizeof(data), 0);
+                    if (n <= 0) {
+                        break;
                     }
-                } else if (label_index < sizeof(label_buffer) - 1) {
-                    label_buffer[label_index++] = data[i];
+                    packet_decoder_feed(&decoder, data, n);
+                    remaining -= n;
                 }
+                break;
             }
+            case UART_FIFO_OVF:
+            case UART_BUFFER_FULL:
+                ESP_LOGW(TAG, "UART overflow, flushing input (%u CRC errors, %u gaps so far)",
+                         (unsigned)decoder.crc_errors, (unsigned)decoder.sequence_gaps);
+                uart_flush_input(UART_PORT_NUM);
+                xQueueReset(s_uart_event_queue);
+                break;
+            default:
+                break;
         }
-        vTaskDelay(10 / portTICK_PERIOD_MS);
     }
 }
 
@@ -97,27 +260,29 @@ static void adc_sampling_task(void *arg)
 {
     adc_continuous_handle_t handle = adc_sampling_init();
     
+#ifdef CONFIG_DUTY_CYCLE_ENABLE
+    // Bursts with light sleep in between; falls through only if not initialized
+    duty_cycle_run(handle);
+#endif
+    
     while (1) {
-        int16_t raw_samples[SAMPLE_WINDOW_SIZE];
-        uint32_t sample_count;
-        
-        // Acquire samples
-        esp_err_t ret = adc_sampling_read(handle, raw_samples, SAMPLE_WINDOW_SIZE, &sample_count);
+        // Acquire (and preprocess) a window straight into a ring slot
+        adc_window_t *window = adc_window_fill(handle);
         
-        if (ret == ESP_OK && sample_count == SAMPLE_WINDOW_SIZE) {
-            // Convert to float for processing with proper scaling
-            for (int i = 0; i < SAMPLE_WINDOW_SIZE; i++) {
-                g_samples[i] = ((float)raw_samples[i] / 2048.0f) - 1.0f;
+        if (window) {
+            // Hand off by pointer to the inference task
+            if (!adc_window_submit(window) && !(window->flags & ADC_WINDOW_FLAG_REJECTED)) {
+                #ifdef CONFIG_DETAILED_LOGGING
+                ESP_LOGW(TAG, "Inference behind, window dropped (%u overruns)", 
+                         (unsigned)adc_window_overruns());
+                #endif
             }
             
-            // Send to inference task
-            xQueueSend(s_samples_queue, g_samples, portMAX_DELAY);
-            
-            // Record timing metrics
-            metrics_record_adc_time(esp_timer_get_time());
+            // Record timing metrics (one stream, or the interval shrinks with N)
+            if (window->channel == 0) {
+                metrics_record_adc_time(window->timestamp_us);
+            }
         }
-        
-        vTaskDelay(1 / portTICK_PERIOD_MS);
     }
 }
 
@@ -143,9 +308,21 @@ static model_type_t get_selected_model_type(void)
     #elif defined(CONFIG_MODEL_HYBRID_INT8)
         ESP_LOGI(TAG, "Selected model: HYBRID_INT8");
         return MODEL_HYBRID_INT8;
+    #elif defined(CONFIG_MODEL_CASCADE)
+        ESP_LOGI(TAG, "Selected model: CASCADE (MLP_INT8 -> CNN_INT8)");
+        return MODEL_CNN_INT8;
+    #elif defined(CONFIG_MODEL_ENSEMBLE)
+        ESP_LOGI(TAG, "Selected model: ENSEMBLE");
+        return ENSEMBLE_PRIMARY_MODEL;
+    #elif defined(CONFIG_MODEL_CNN_STREAMING)
+        ESP_LOGI(TAG, "Selected model: CNN_STREAMING (features per chunk, head per window)");
+        return MODEL_CNN_INT8;
     #elif defined(CONFIG_MODEL_HEURISTIC_ONLY)
         ESP_LOGI(TAG, "Selected model: HEURISTIC_ONLY");
         return MODEL_NONE;
+    #elif defined(CONFIG_MODEL_FFT_CLASSIFIER)
+        ESP_LOGI(TAG, "Selected model: FFT_CLASSIFIER");
+        return MODEL_NONE;
     #else
         ESP_LOGW(TAG, "No model selected in Kconfig, defaulting to heuristic");
         return MODEL_NONE;
@@ -156,23 +333,200 @@ static model_type_t get_selected_model_type(void)
 static inference_mode_t get_inference_mode(void)
 {
     // Check if any TFLite model is enabled
-    #if defined(CONFIG_MODEL_CNN_INT8) || defined(CONFIG_MODEL_CNN_FLOAT32) || \
+    #if defined(CONFIG_MODEL_CASCADE)
+        ESP_LOGI(TAG, "Using cascade inference mode");
+        return INFERENCE_MODE_CASCADE;
+    #elif defined(CONFIG_MODEL_ENSEMBLE)
+        ESP_LOGI(TAG, "Using ensemble inference mode");
+        return INFERENCE_MODE_ENSEMBLE;
+    #elif defined(CONFIG_MODEL_CNN_STREAMING)
+        ESP_LOGI(TAG, "Using streaming inference mode");
+        return INFERENCE_MODE_STREAMING;
+    #elif defined(CONFIG_MODEL_CNN_INT8) || defined(CONFIG_MODEL_CNN_FLOAT32) || \
         defined(CONFIG_MODEL_MLP_FLOAT32) || defined(CONFIG_MODEL_MLP_INT8) || \
         defined(CONFIG_MODEL_HYBRID_FLOAT32) || defined(CONFIG_MODEL_HYBRID_INT8)
         ESP_LOGI(TAG, "Using TFLite inference mode");
         return INFERENCE_MODE_TFLITE;
+    #elif defined(CONFIG_MODEL_FFT_CLASSIFIER)
+        ESP_LOGI(TAG, "Using FFT-based inference mode");
+        return INFERENCE_MODE_FFT_BASED;
     #else
         ESP_LOGI(TAG, "Using heuristic inference mode");
         return INFERENCE_MODE_HEURISTIC;
     #endif
 }
 
+// A result waiting to be scored against the label timeline
+typedef struct {
+    int64_t start_us;       // Window span in generator time
+    int64_t end_us;
+    ml_class_t predicted;
+} pending_score_t;
+
+// Score against the label active for most of the window; windows that
+// straddle a label change are counted separately
+static void score_prediction(const label_timeline_t *timeline, const pending_score_t *p)
+{
+    label_span_t truth;
+    if (!label_timeline_lookup(timeline, p->start_us, p->end_us, &truth)) {
+        return;
+    }
+    
+    bool correct = (p->predicted == truth.label);
+    if (truth.transition) {
+        metrics_record_transition_prediction(correct);
+    } else if (correct) {
+        metrics_record_correct_prediction();
+    } else {
+        metrics_record_incorrect_prediction();
+    }
+}
+
+#if defined(CONFIG_DATA_COLLECTION_ENABLE) || defined(CONFIG_SAMPLE_STREAM_ENABLE)
+// Input 0's raw codes wait for their ground truth to settle before they
+// are recorded or streamed, like results before scoring. Samples are kept
+// once, in arrival order; a window after a gap appends all of its codes
+// so every held window is the last SAMPLE_WINDOW_SIZE codes before its end.
+#define SETTLE_SAMPLES     ((int)((int64_t)LABEL_SETTLE_US * ML_SAMPLE_RATE_HZ / 1000000))
+#define HELD_SAMPLES       (SAMPLE_WINDOW_SIZE + SETTLE_SAMPLES + CONFIG_ADC_WINDOW_HOP)
+#define HELD_WINDOWS       (SETTLE_SAMPLES / CONFIG_ADC_WINDOW_HOP + 2)
+
+typedef struct {
+    uint32_t end;           // Samples held before this window's end
+    uint32_t sequence;
+    int64_t start_us;       // Window span in generator time
+    int64_t end_us;
+    uint16_t stream_count;  // Newest codes to stream, 0 for none
+    bool record;
+    bool local_clock;
+} held_window_t;
+
+typedef struct {
+    uint16_t codes[HELD_SAMPLES];
+    uint32_t total;         // Codes ever held, the next one's position
+    held_window_t windows[HELD_WINDOWS];
+    uint32_t head, count;
+} held_codes_t;
+
+#ifdef CONFIG_DATA_COLLECTION_ENABLE
+static uint32_t s_records_left = CONFIG_DATA_COLLECTION_MAX_WINDOWS;
+#endif
+
+// Copy the count codes that end at position end (still held)
+static void held_copy(const held_codes_t *h, uint32_t end, int count, uint16_t *out)
+{
+    for (int i = 0; i < count; i++) {
+        out[i] = h->codes[(end - count + i) % HELD_SAMPLES];
+    }
+}
+
+// Record and stream the oldest held window with the label it has now
+static void held_release(held_codes_t *h, const label_timeline_t *timeline)
+{
+    static uint16_t codes[SAMPLE_WINDOW_SIZE];
+    const held_window_t *w = &h->windows[h->head];
+    label_span_t truth;
+    
+#ifdef CONFIG_DATA_COLLECTION_ENABLE
+    if (w->record) {
+        bool known = label_timeline_lookup(timeline, w->start_us, w->end_us, &truth);
+        uint8_t flags = (known && truth.transition) ? DATA_RECORD_FLAG_TRANSITION : 0;
+        if (w->local_clock) {
+            flags |= DATA_RECORD_FLAG_LOCAL_CLOCK;
+        }
+        held_copy(h, w->end, SAMPLE_WINDOW_SIZE, codes);
+        bool recorded = data_collection_submit(codes, SAMPLE_WINDOW_SIZE, w->start_us, w->end_us,
+                                               known ? truth.label : ML_CLASS_UNKNOWN, flags);
+        // Close the capture so it gets its index and trailer
+        if (recorded && s_records_left > 0 && --s_records_left == 0) {
+            data_collection_stop();
+            ESP_LOGI(TAG, "Recording complete: %d windows", CONFIG_DATA_COLLECTION_MAX_WINDOWS);
+        }
+    }
+#endif
+#ifdef CONFIG_SAMPLE_STREAM_ENABLE
+    if (w->stream_count > 0) {
+        int64_t fresh_start = w->end_us - (int64_t)(w->stream_count - 1) * 1000000 / ML_SAMPLE_RATE_HZ;
+        bool known = label_timeline_lookup(timeline, fresh_start, w->end_us, &truth);
+        uint8_t flags = (known && truth.transition) ? STREAM_FLAG_TRANSITION : 0;
+        if (w->local_clock) {
+            flags |= STREAM_FLAG_LOCAL_CLOCK;
+        }
+        held_copy(h, w->end, w->stream_count, codes);
+        sample_stream_send(codes, w->stream_count, w->sequence, fresh_start,
+                           known ? truth.label : ML_CLASS_UNKNOWN, flags);
+    }
+#endif
+    h->head = (h->head + 1) % HELD_WINDOWS;
+    h->count--;
+}
+
+// Hold a window; whatever its codes would overwrite is released early
+static void held_add(held_codes_t *h, const label_timeline_t *timeline, const uint16_t *codes,
+                     int fresh, const held_window_t *window)
+{
+    while (h->count > 0) {
+        const held_window_t *oldest = &h->windows[h->head];
+        int needed = oldest->record ? SAMPLE_WINDOW_SIZE : oldest->stream_count;
+        if (h->count < HELD_WINDOWS && h->total + fresh - (oldest->end - needed) <= HELD_SAMPLES) {
+            break;
+        }
+        held_release(h, timeline);
+    }
+    for (int i = SAMPLE_WINDOW_SIZE - fresh; i < SAMPLE_WINDOW_SIZE; i++) {
+        h->codes[h->total++ % HELD_SAMPLES] = codes[i];
+    }
+    held_window_t *slot = &h->windows[(h->head + h->count) % HELD_WINDOWS];
+    *slot = *window;
+    slot->end = h->total;
+    h->count++;
+}
+#endif
+
+// The latest class switch, until a result first names the new class
+typedef struct {
+    int64_t switch_us;      // Generator time the new class reached the DAC
+    ml_class_t current;
+    bool waiting;           // Only stamped switches are timed
+} detection_t;
+
+static void detection_note_label(detection_t *d, const label_event_t *event)
+{
+    if (event->label == d->current) {
+        return;
+    }
+    if (d->waiting) {
+        metrics_record_missed_detection();
+    }
+    d->current = event->label;
+    d->switch_us = event->time_us;
+    d->waiting = event->stamped && event->label != ML_CLASS_UNKNOWN;
+}
+
+// Time to detection: switch output -> first result naming the new class
+// from a window that contains the switch or follows it
+static void detection_check(detection_t *d, ml_class_t predicted, int64_t span_end, 
+                            int64_t ready_us)
+{
+    if (!d->waiting || predicted != d->current || span_end < d->switch_us) {
+        return;
+    }
+    int64_t latency_us = ready_us - d->switch_us;
+    metrics_record_stage(METRIC_STAGE_DETECTION, latency_us > 0 ? (uint32_t)latency_us : 0);
+    d->waiting = false;
+}
+
 // Inference task
-static void inference_task(void *arg)
+// Calibrates and inspects every model at idle priority, after the
+// selected one is running
+static void benchmark_init_task(void *arg)
 {
-    // Initialize benchmark system
     model_benchmark_init();
-    
+    vTaskDelete(NULL);
+}
+
+static void inference_task(void *arg)
+{
     // Track when to run benchmarks
     static uint32_t inference_count = 0;
     static const uint32_t BENCHMARK_INTERVAL = 50;
@@ -183,9 +537,35 @@ static void inference_task(void *arg)
         .mode = get_inference_mode(),
         .model_type = get_selected_model_type(),
         .confidence_threshold = 0.5f,
-        .voting_window = 3,
+        #ifdef CONFIG_INFERENCE_VOTING
+        .voting_window = CONFIG_INFERENCE_VOTING_WINDOW,
+        .enable_voting = true,
+        #ifdef CONFIG_INFERENCE_VOTING_EMA
+        .voting_method = VOTING_EMA,
+        .ema_alpha = CONFIG_INFERENCE_VOTING_EMA_ALPHA_PCT / 100.0f,
+        #else
+        .voting_method = VOTING_MAJORITY,
+        #endif
+        .decisive_confidence = CONFIG_INFERENCE_DECISIVE_CONFIDENCE_PCT / 100.0f,
+        .decisive_skip = CONFIG_INFERENCE_DECISIVE_SKIP,
+        #else
+        .voting_window = 1,
         .enable_voting = false,
-        .enable_fft = true
+        #endif
+        .enable_fft = true,
+        #ifdef CONFIG_MODEL_CASCADE
+        .cascade_margin = CONFIG_INFERENCE_CASCADE_MARGIN_PCT / 100.0f,
+        #endif
+        #ifdef CONFIG_MODEL_ENSEMBLE
+        .ensemble_partner = ENSEMBLE_SECONDARY_MODEL,
+        .ensemble_weight = CONFIG_INFERENCE_ENSEMBLE_WEIGHT_PCT / 100.0f,
+        #ifdef CONFIG_INFERENCE_ENSEMBLE_GATED
+        .ensemble_fusion = ENSEMBLE_FUSION_GATED,
+        #else
+        .ensemble_fusion = ENSEMBLE_FUSION_WEIGHTED,
+        #endif
+        #endif
+        .window_hop = CONFIG_ADC_WINDOW_HOP,
     };
     
     if (!inference_init(&engine, &config)) {
@@ -193,67 +573,338 @@ static void inference_task(void *arg)
         vTaskDelete(NULL);
     }
     
-    // Buffer for current label
-    char *current_label = NULL;
+    // From here on the ADC task preprocesses windows for this model
+    preprocess_format_t input_format;
+    if (inference_input_format(&engine, &input_format)) {
+        adc_window_set_input_format(&input_format);
+    }
+    
+#ifdef CONFIG_INFERENCE_DEGRADATION
+    // Cheaper models to fall back on when windows start piling up
+    static degradation_t degradation;
+    degradation_init(&degradation, &engine);
+#endif
+    metrics_record_engine_ready();
+    
+    // The benchmark's calibration of every model would hold up the first
+    // decision; it only feeds the periodic benchmark
+    xTaskCreatePinnedToCore(benchmark_init_task, "bench_init", 12288, NULL, 1,
+                            NULL, ACQUISITION_CORE);
+    
+    // Sequence numbers are per input channel; input 0 carries the labels
+    uint32_t next_sequence[ADC_STREAM_COUNT] = {0};
+    bool first_window[ADC_STREAM_COUNT];
+    for (int i = 0; i < ADC_STREAM_COUNT; i++) {
+        first_window[i] = true;
+    }
+#ifdef CONFIG_ADC_CHANNEL_PRIORITY
+    uint32_t shed_windows[ADC_STREAM_COUNT] = {0};
+#endif
+    
+    // Ground truth timeline and results waiting for it to settle
+    static label_timeline_t timeline;
+    static pending_score_t pending[PENDING_SCORES];
+    uint32_t pending_head = 0, pending_count = 0;
+    label_timeline_init(&timeline);
+    detection_t detection = { .current = ML_CLASS_UNKNOWN };
+    
+    // Preprocessed copies of consecutive windows, only built for periodic benchmarks
+    static float benchmark_windows[CONFIG_BENCHMARK_BATCH_WINDOWS][SAMPLE_WINDOW_SIZE] __attribute__((aligned(16)));
+    static ml_class_t benchmark_labels[CONFIG_BENCHMARK_BATCH_WINDOWS];
+    static int64_t benchmark_spans[CONFIG_BENCHMARK_BATCH_WINDOWS][2];
+    int benchmark_filled = -1;  // -1 while not collecting
+    bool decided = false;       // Time to first decision recorded
+    
+#ifdef CONFIG_DATA_COLLECTION_ENABLE
+    // Record every (window / hop)-th window so the capture is contiguous, not overlapped
+    static const uint32_t RECORD_STRIDE = (SAMPLE_WINDOW_SIZE + CONFIG_ADC_WINDOW_HOP - 1) / 
+                                          CONFIG_ADC_WINDOW_HOP;
+    uint32_t record_countdown = 0;
+#endif
+#ifdef CONFIG_SAMPLE_STREAM_ENABLE
+    bool streamed_any = false;
+#endif
+#if defined(CONFIG_DATA_COLLECTION_ENABLE) || defined(CONFIG_SAMPLE_STREAM_ENABLE)
+    static held_codes_t held;
+    bool held_contiguous = false;   // The next window extends the held codes
+#endif
     
     while (1) {
         // Wait for new samples
-        if (xQueueReceive(s_samples_queue, g_samples, portMAX_DELAY) == pdTRUE) {
+        adc_window_t *window = adc_window_receive(portMAX_DELAY);
+        if (window) {
             uint64_t start_time = esp_timer_get_time();
+#ifdef CONFIG_STAGE_TRACE
+            // The slot goes back to the producer before the window is done
+            stage_trace_t trace = window->trace;
+            stage_trace_mark_at(&trace, STAGE_TRACE_DEQUEUED);
+#endif
+            uint8_t window_flags = window->flags;
+            uint32_t window_id = window->sequence;
+            int stream = window->channel;
+            bool labelled = (stream == 0);
             
-            // Check for new label
-            char *new_label = NULL;
-            if (xQueueReceive(s_labels_queue, &new_label, 0) == pdTRUE) {
-                if (current_label) {
-                    free(current_label);
+            // Sequence numbers of dropped windows are never delivered
+            uint32_t dropped = first_window[stream] ? 0 : window_id - next_sequence[stream];
+            if (dropped > 0 || (window_flags & ADC_WINDOW_FLAG_GAP)) {
+                metrics_record_dropped_windows(dropped, window_flags & ADC_WINDOW_FLAG_GAP);
+            }
+            next_sequence[stream] = window_id + 1;
+            first_window[stream] = false;
+            
+#ifdef CONFIG_ADC_CHANNEL_PRIORITY
+            // Falling behind: keep input 0's decision rate, shed the others
+            if (!labelled && adc_window_utilization() >= CONFIG_ADC_CHANNEL_SHED_PCT) {
+                adc_window_release(window);
+                shed_windows[stream]++;
+                // The stream's carried layer state would skip this window's samples
+                inference_select_stream(&engine, stream);
+                inference_streaming_reset(&engine);
+                continue;
+            }
+#endif
+            inference_select_stream(&engine, stream);
+            
+            // Streaming layer state must not bridge lost samples
+            if (dropped > 0 || (window_flags & (ADC_WINDOW_FLAG_GAP | ADC_WINDOW_FLAG_RESUMED))) {
+                inference_streaming_reset(&engine);
+            }
+            
+            // Votes from before a sampling gap describe a different moment
+            if (window_flags & ADC_WINDOW_FLAG_RESUMED) {
+                inference_voting_reset(&engine);
+            }
+            
+            // Record label changes and place the window on the generator clock
+            label_event_t label_event;
+            while (xQueueReceive(s_labels_queue, &label_event, 0) == pdTRUE) {
+                detection_note_label(&detection, &label_event);
+                label_timeline_add(&timeline, label_event.time_us, label_event.label);
+            }
+            clock_sync_t sync;
+            clock_sync_snapshot(&sync);
+            int64_t span_start = to_generator_time(&sync, window->start_us);
+            int64_t span_end = to_generator_time(&sync, window->timestamp_us);
+            
+#if defined(CONFIG_DATA_COLLECTION_ENABLE) || defined(CONFIG_SAMPLE_STREAM_ENABLE)
+            if (labelled) {
+                held_window_t hold = {
+                    .sequence = window->sequence,
+                    .start_us = span_start,
+                    .end_us = span_end,
+                    .local_clock = (sync.sync_count == 0),
+                };
+#ifdef CONFIG_DATA_COLLECTION_ENABLE
+                // Recordings carry input 0's ground truth
+                if (record_countdown > 0) {
+                    record_countdown--;
+                } else if (data_collection_active()) {
+                    hold.record = true;
+                    record_countdown = RECORD_STRIDE - 1;
                 }
-                current_label = new_label;
+#endif
+#ifdef CONFIG_SAMPLE_STREAM_ENABLE
+                // Only the samples this window added (one conversion frame)
+                hold.stream_count = streamed_any ? CONFIG_ADC_WINDOW_HOP : SAMPLE_WINDOW_SIZE;
+                streamed_any = true;
+#endif
+                if (dropped > 0 || (window_flags & (ADC_WINDOW_FLAG_GAP | ADC_WINDOW_FLAG_RESUMED))) {
+                    held_contiguous = false;
+                }
+                held_add(&held, &timeline, window->codes,
+                         held_contiguous ? CONFIG_ADC_WINDOW_HOP : SAMPLE_WINDOW_SIZE, &hold);
+                held_contiguous = true;
             }
+#endif
             
-            // Preprocessing
-            memcpy(g_processed_samples, g_samples, SAMPLE_WINDOW_SIZE * sizeof(float));
-            preprocess_samples_fixed(g_processed_samples, SAMPLE_WINDOW_SIZE, PREPROCESS_ALL);
-
-            // Periodic benchmark execution
+            // Periodic benchmark: collect a batch, then run it on every model
             inference_count++;
-            if (inference_count % BENCHMARK_INTERVAL == 0) {
-                run_benchmark_suite(g_processed_samples, SAMPLE_WINDOW_SIZE, current_label);
+            if (inference_count % BENCHMARK_INTERVAL == 0 && benchmark_filled < 0) {
+                // The other models are calibrated in the background first
+                if (model_benchmark_ready()) {
+                    benchmark_filled = 0;
+                }
+                inference_cascade_log_stats(&engine);
+                inference_ensemble_log_stats(&engine);
+                inference_streaming_log_stats(&engine);
+#ifdef CONFIG_ADC_CHANNEL_PRIORITY
+                for (int i = 1; i < ADC_STREAM_COUNT; i++) {
+                    ESP_LOGI(TAG, "Input %d: %lu windows shed", i, (unsigned long)shed_windows[i]);
+                }
+#endif
+#ifdef CONFIG_DATA_COLLECTION_ENABLE
+                data_collection_stats_t rec;
+                data_collection_get_stats(&rec);
+                ESP_LOGI(TAG, "Recorder: %lu windows, %lu dropped, %.2f B/sample, %lu blocks, "
+                         "%lu errors, max write %lu us",
+                         (unsigned long)rec.windows_recorded, (unsigned long)rec.windows_dropped,
+                         rec.samples_recorded ? (float)rec.payload_bytes / rec.samples_recorded : 0.0f,
+                         (unsigned long)rec.blocks_written, (unsigned long)rec.write_errors,
+                         (unsigned long)rec.max_write_us);
+#endif
+#if defined(CONFIG_SAMPLE_STREAM_ENABLE) && !defined(CONFIG_TELEMETRY_ENABLE)
+                sample_stream_stats_t st;
+                sample_stream_get_stats(&st);
+                ESP_LOGI(TAG, "Stream: %lu frames, %lu blocks dropped, %lu logs dropped, %lu acks",
+                         (unsigned long)st.frames_sent, (unsigned long)st.blocks_dropped,
+                         (unsigned long)st.logs_dropped, (unsigned long)st.acks);
+#endif
+            }
+            if (labelled && benchmark_filled >= 0 &&
+                preprocess_codes_float(window->codes, SAMPLE_WINDOW_SIZE, 
+                                       benchmark_windows[benchmark_filled])) {
+                benchmark_spans[benchmark_filled][0] = span_start;
+                benchmark_spans[benchmark_filled][1] = span_end;
+                benchmark_filled++;
+                if (benchmark_filled == CONFIG_BENCHMARK_BATCH_WINDOWS) {
+                    // Transition windows run but are not scored
+                    for (int i = 0; i < benchmark_filled; i++) {
+                        label_span_t truth;
+                        bool known = label_timeline_lookup(&timeline, benchmark_spans[i][0],
+                                                           benchmark_spans[i][1], &truth);
+                        benchmark_labels[i] = (known && !truth.transition) ? truth.label 
+                                                                           : ML_CLASS_UNKNOWN;
+                    }
+                    model_run_benchmark_batch(&benchmark_windows[0][0], benchmark_filled,
+                                              SAMPLE_WINDOW_SIZE, benchmark_labels);
+                    benchmark_filled = -1;
+#ifdef CONFIG_INFERENCE_DEGRADATION
+                    // Windows dropped during the batch are not the model's fault
+                    degradation_restart_epoch(&degradation);
+#endif
+                }
             }
             
-            // Perform inference
+            // Copy the preprocessed window into the model and run inference
+#ifdef CONFIG_STAGE_TRACE
+            stage_trace_mark_at(&trace, STAGE_TRACE_DISPATCHED);
+            stage_trace_activate(&trace);
+#endif
+            uint64_t run_start = esp_timer_get_time();
             inference_result_t result;
-            if (inference_run(&engine, g_processed_samples, SAMPLE_WINDOW_SIZE, &result)) {
+            bool success = inference_run_prepared(&engine, window->codes, SAMPLE_WINDOW_SIZE, 
+                                                  &window->moments, window->input, 
+                                                  &window->input_format, &result);
+#ifdef CONFIG_STAGE_TRACE
+            stage_trace_mark_at(&trace, STAGE_TRACE_POSTPROCESSED);
+            stage_trace_activate(NULL);
+#endif
+            int64_t window_end_us = window->timestamp_us;
+            adc_window_release(window);
+            result.window_id = window_id;
+            
+            int64_t now = to_generator_time(&sync, esp_timer_get_time());
+            while (pending_count > 0 && now - pending[pending_head].end_us >= LABEL_SETTLE_US) {
+                score_prediction(&timeline, &pending[pending_head]);
+                pending_head = (pending_head + 1) % PENDING_SCORES;
+                pending_count--;
+            }
+#if defined(CONFIG_DATA_COLLECTION_ENABLE) || defined(CONFIG_SAMPLE_STREAM_ENABLE)
+            while (held.count > 0 && now - held.windows[held.head].end_us >= LABEL_SETTLE_US) {
+                held_release(&held, &timeline);
+            }
+#endif
+            
+#ifdef CONFIG_STAGE_TRACE
+            stage_trace_commit(&trace);
+#if defined(CONFIG_TELEMETRY_ENABLE) && CONFIG_STAGE_TRACE_EXPORT_INTERVAL > 0
+            if (inference_count % CONFIG_STAGE_TRACE_EXPORT_INTERVAL == 0) {
+                telemetry_send_trace(&trace);
+            }
+#endif
+#endif
+            
+            if (success) {
                 uint64_t end_time = esp_timer_get_time();
-                uint64_t inference_time = end_time - start_time;
+                // The model's share only: labels, recording and benchmarks are not in it
+                uint64_t inference_time = end_time - run_start;
                 
-                // Log inference results
-                ESP_LOGI(TAG, "Inference: %s (%.2f) in %llu us", 
-                         result.predicted_class, result.confidence, inference_time);
-                
-                if (current_label) {
-                    // Calculate accuracy
-                    if (strcmp(result.predicted_class, current_label) == 0) {
-                        metrics_record_correct_prediction();
-                    } else {
-                        metrics_record_incorrect_prediction();
-                    }
+                // Last sample converted -> result ready, before any logging
+                metrics_record_stage(METRIC_STAGE_END_TO_END, (uint32_t)(end_time - window_end_us));
+                if (!decided) {
+                    decided = true;
+                    ESP_LOGI(TAG, "First decision %u ms after boot",
+                             (unsigned)metrics_record_first_decision());
                 }
                 
-                // Record metrics
-                metrics_record_inference_time(inference_time);
+                // A sample of the results: one formatted line costs more than some models
+                uint32_t log_interval = INFERENCE_LOG_INTERVAL;
+                if (log_interval > 0 && result.window_id % log_interval == 0) {
+#if ADC_STREAM_COUNT > 1
+                    ESP_LOGI(TAG, "Inference #%u (input %d): %s (%.2f) in %llu us", 
+                             (unsigned)result.window_id, stream,
+                             ml_class_to_string(result.predicted_class), result.confidence,
+                             inference_time);
+#else
+                    ESP_LOGI(TAG, "Inference #%u: %s (%.2f) in %llu us", (unsigned)result.window_id,
+                             ml_class_to_string(result.predicted_class), result.confidence,
+                             inference_time);
+#endif
+                }
                 
-                // Update system health
-                update_system_health(&s_system_health, s_samples_queue, s_labels_queue);
-                check_system_state(&s_system_health);
+                // Only input 0 has ground truth
+                if (labelled) {
+                    // Score once the window's ground truth has settled
+                    if (pending_count == PENDING_SCORES) {
+                        score_prediction(&timeline, &pending[pending_head]);
+                        pending_head = (pending_head + 1) % PENDING_SCORES;
+                        pending_count--;
+                    }
+                    pending[(pending_head + pending_count) % PENDING_SCORES] = (pending_score_t){
+                        .start_us = span_start,
+                        .end_us = span_end,
+                        .predicted = result.predicted_class,
+                    };
+                    pending_count++;
+                    
+                    // Latency is only meaningful on the generator clock
+                    if (sync.sync_count > 0) {
+                        detection_check(&detection, result.predicted_class, span_end,
+                                        to_generator_time(&sync, esp_timer_get_time()));
+                    }
+                }
+            }
+            
+#ifdef CONFIG_INFERENCE_DEGRADATION
+            // Rather a cheaper model than silently lost windows
+            degradation_update(&degradation, &engine, (uint32_t)(esp_timer_get_time() - start_time));
+#endif
+            
+#ifdef CONFIG_DUTY_CYCLE_ENABLE
+            // Unblock the scheduler even if this run failed
+            if (window_flags & ADC_WINDOW_FLAG_DECISION) {
+                duty_cycle_report_decision(success ? result.predicted_class : ML_CLASS_UNKNOWN,
+                                           success ? result.confidence : 0.0f);
+            }
+#endif
+            
+#ifdef CONFIG_MODEL_STORE_PARTITION
+            // New weights from a model store update, between two windows
+            if (model_registry_update_pending() && inference_reload_models(&engine)) {
+                if (inference_input_format(&engine, &input_format)) {
+                    adc_window_set_input_format(&input_format);
+                }
+                ESP_LOGI(TAG, "Models reloaded from store generation %u",
+                         (unsigned)model_store_generation());
             }
+#endif
         }
     }
 }
 
+#ifdef CONFIG_BENCHMARK_REPLAY_MODE
+static void replay_task(void *pvParameters)
+{
+    benchmark_replay_run();
+    vTaskDelete(NULL);
+}
+#endif
+
 void app_main(void)
 {
     ESP_LOGI(TAG, "Signal Inference Pipeline - Thesis Implementation");
-    ESP_LOGI(TAG, "Sampling Rate: 20kHz, Window Size: %d samples", SAMPLE_WINDOW_SIZE);
+    ESP_LOGI(TAG, "Sampling Rate: %d Hz (decimation %d), Window Size: %d samples",
+             ML_SAMPLE_RATE_HZ, CONFIG_ADC_DECIMATION, SAMPLE_WINDOW_SIZE);
     
     // Log selected model configuration
     model_type_t selected_model = get_selected_model_type();
@@ -263,19 +914,37 @@ void app_main(void)
     
     // Initialize metrics system
     metrics_init();
+#ifdef CONFIG_STAGE_TRACE
+    stage_trace_init();
+#endif
+    
+#ifdef CONFIG_BENCHMARK_REPLAY_MODE
+    // Fixed corpus instead of live acquisition: no ADC, UART or SD tasks
+    xTaskCreatePinnedToCore(replay_task, "replay", 12288, NULL, 4, NULL, INFERENCE_CORE);
+    return;
+#endif
+    
+    sync_init(&s_clock_sync);
     
-    // Initialize system health
-    health_init(&s_system_health);
+#ifdef CONFIG_DUTY_CYCLE_ENABLE
+    // Runs without light sleep if power management is not configured
+    duty_cycle_init();
+#endif
     
     // Create queues
-    s_samples_queue = xQueueCreate(2, sizeof(float) * SAMPLE_WINDOW_SIZE);
-    s_labels_queue = xQueueCreate(5, sizeof(char *));
+    s_labels_queue = xQueueCreate(5, sizeof(label_event_t));
     
-    if (!s_samples_queue || !s_labels_queue) {
+    if (adc_window_pool_init() != ESP_OK || !s_labels_queue) {
         ESP_LOGE(TAG, "Failed to create communication queues");
         return;
     }
     
+    // Model session first: it is built on the inference core while this
+    // core brings up UART, SD, the stream and the ADC. Windows wait in the
+    // ring until the engine takes them.
+    xTaskCreatePinnedToCore(inference_task, "inference", 12288, NULL, 4, 
+                            &s_inference_task_handle, INFERENCE_CORE);
+    
     // Initialize UART for label reception
     uart_config_t uart_config = {
         .baud_rate = UART_BAUD_RATE,
@@ -290,15 +959,30 @@ void app_main(void)
     ESP_ERROR_CHECK(uart_set_pin(UART_PORT_NUM, UART_TX_PIN, UART_RX_PIN, 
                                  UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
     ESP_ERROR_CHECK(uart_driver_install(UART_PORT_NUM, UART_BUF_SIZE * 2, 
-                                        UART_BUF_SIZE * 2, 0, NULL, 0));
+                                        UART_BUF_SIZE * 2, UART_EVENT_QUEUE_SIZE, 
+                                        &s_uart_event_queue, 0));
+    
+#ifdef CONFIG_DATA_COLLECTION_ENABLE
+    // Recording is optional: run without it if the card is missing
+    if (data_collection_init() != ESP_OK || data_collection_start() != ESP_OK) {
+        ESP_LOGW(TAG, "SD recording disabled");
+    }
+#endif
+#ifdef CONFIG_SAMPLE_STREAM_ENABLE
+    // From here on the console port carries only stream frames
+    if (sample_stream_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Sample streaming disabled");
+    }
+#endif
     
-    // Create tasks with proper priorities
-    xTaskCreate(uart_receive_task, "uart_rx", 4096, NULL, 5, NULL);
-    xTaskCreate(adc_sampling_task, "adc_sampling", 4096, NULL, 6, &s_adc_task_handle);
-    xTaskCreate(inference_task, "inference", 12288, NULL, 4, &s_inference_task_handle);
+    // Create tasks with proper priorities. Everything but Invoke shares the
+    // acquisition core, so the inference core only runs the model.
+    xTaskCreatePinnedToCore(uart_receive_task, "uart_rx", 4096, NULL, 5, NULL, ACQUISITION_CORE);
+    xTaskCreatePinnedToCore(adc_sampling_task, "adc_sampling", 4096, NULL, 6, 
+                            &s_adc_task_handle, ACQUISITION_CORE);
     
     // Create monitoring task
-    xTaskCreate(metrics_monitor_task, "metrics", 4096, NULL, 3, NULL);
+    xTaskCreatePinnedToCore(metrics_monitor_task, "metrics", 4096, NULL, 3, NULL, ACQUISITION_CORE);
     
     ESP_LOGI(TAG, "System initialized and ready");
 }
\ No newline at end of file
@@ -0,0 +1,110 @@
+// arena_cache.c - Model arena calibrations kept in NVS across boots
+#include "arena_cache.h"
+#include "tflite_wrapper.h"
+#include "esp_log.h"
+#include "esp_app_desc.h"
+#include "esp_rom_crc.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+#include <string.h>
+
+#ifdef CONFIG_INFERENCE_ARENA_CACHE
+
+static const char *TAG = "ARENA_CACHE";
+
+#define CACHE_NAMESPACE     "arena_plan"
+#define FIRMWARE_ID_LENGTH  16            // Hex digits of the ELF SHA-256
+
+typedef struct {
+    uint32_t model_size;
+    uint32_t model_crc;
+    char firmware[FIRMWARE_ID_LENGTH + 1];
+    tflite_arena_plan_t plan;
+} arena_cache_record_t;
+
+static nvs_handle_t s_handle;
+static bool s_open = false;
+static char s_firmware[FIRMWARE_ID_LENGTH + 1];
+
+esp_err_t arena_cache_init(void)
+{
+    if (s_open) {
+        return ESP_OK;
+    }
+
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_LOGW(TAG, "NVS unusable (%s), erasing", esp_err_to_name(ret));
+        ret = nvs_flash_erase();
+        if (ret == ESP_OK) {
+            ret = nvs_flash_init();
+        }
+    }
+    if (ret == ESP_OK) {
+        ret = nvs_open(CACHE_NAMESPACE, NVS_READWRITE, &s_handle);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Arena cache unavailable: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    esp_app_get_elf_sha256(s_firmware, sizeof(s_firmware));
+    s_open = true;
+    return ESP_OK;
+}
+
+bool arena_cache_restore(const char *name, const void *model_data, size_t model_size)
+{
+    if (!s_open || !name || !model_data) {
+        return false;
+    }
+
+    arena_cache_record_t stored;
+    size_t length = sizeof(stored);
+    if (nvs_get_blob(s_handle, name, &stored, &length) != ESP_OK || length != sizeof(stored)) {
+        return false;
+    }
+
+    // Size and firmware first: the CRC reads the whole model
+    if (stored.model_size != (uint32_t)model_size ||
+        memcmp(stored.firmware, s_firmware, sizeof(s_firmware)) != 0 ||
+        stored.model_crc != esp_rom_crc32_le(0, model_data, model_size)) {
+        ESP_LOGI(TAG, "%s: cached plan is for another model or firmware", name);
+        return false;
+    }
+
+    if (!tflite_seed_arena_plan(model_data, &stored.plan)) {
+        return false;
+    }
+    ESP_LOGI(TAG, "%s: arena plan restored (%u bytes used, probe Invoke %u us)", name,
+             (unsigned)stored.plan.used_bytes, (unsigned)stored.plan.probe_invoke_us);
+    return true;
+}
+
+bool arena_cache_save(const char *name, const void *model_data, size_t model_size)
+{
+    if (!s_open || !name || !model_data) {
+        return false;
+    }
+
+    arena_cache_record_t record = { 0 };
+    if (!tflite_get_arena_plan(model_data, &record.plan)) {
+        return false;
+    }
+    record.model_size = (uint32_t)model_size;
+    record.model_crc = esp_rom_crc32_le(0, model_data, model_size);
+    memcpy(record.firmware, s_firmware, sizeof(record.firmware));
+
+    esp_err_t ret = nvs_set_blob(s_handle, name, &record, sizeof(record));
+    if (ret == ESP_OK) {
+        ret = nvs_commit(s_handle);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "%s: arena plan not saved: %s", name, esp_err_to_name(ret));
+        return false;
+    }
+    ESP_LOGI(TAG, "%s: arena plan saved", name);
+    return true;
+}
+
+#endif /* CONFIG_INFERENCE_ARENA_CACHE */
@@ -0,0 +1,61 @@
+// arena_cache.h
+#ifndef ARENA_CACHE_H
+#define ARENA_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Only built with CONFIG_INFERENCE_ARENA_CACHE.
+ *
+ * Keeps each model's arena calibration (tflite_arena_plan_t) in NVS so the
+ * next boot seeds it with tflite_seed_arena_plan() instead of planning the
+ * model in a probe arena and timing an Invoke() first. A record is keyed by
+ * model name and only used for the same flatbuffer (size and zlib CRC-32)
+ * built into the same firmware (ELF SHA-256 prefix): kernels and the op
+ * resolver decide the plan as much as the model does.
+ */
+
+/**
+ * @brief Bring up NVS and open the cache namespace
+ * 
+ * The NVS partition holds nothing else: it is erased if it is full or was
+ * written by a newer IDF.
+ * 
+ * @return esp_err_t ESP_OK on success
+ */
+esp_err_t arena_cache_init(void);
+
+/**
+ * @brief Seed a model's calibration from its cached record
+ * 
+ * @param name Model name (NVS key, at most 15 characters)
+ * @param model_data Model data
+ * @param model_size Model bytes
+ * @return true if a matching record was found and seeded
+ */
+bool arena_cache_restore(const char *name, const void *model_data, size_t model_size);
+
+/**
+ * @brief Store a model's current calibration
+ * 
+ * Writes flash, so it is meant for the boots that had to calibrate.
+ * 
+ * @param name Model name (NVS key, at most 15 characters)
+ * @param model_data Model data
+ * @param model_size Model bytes
+ * @return true if the record is stored; false if the model is not
+ *         calibrated yet or NVS failed
+ */
+bool arena_cache_save(const char *name, const void *model_data, size_t model_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ARENA_CACHE_H */
@@ -1,70 +1,326 @@
-// benchmark.c - Fixed version with all required functions
+// benchmark.c - Measured benchmark of every compiled-in model
 #include "benchmark.h"
 #include "inference.h"
+#include "model_registry.h"
+#include "tflite_wrapper.h"
+#include "preprocessing.h"
+#include "system_monitor.h"
+#include "telemetry.h"
 #include "esp_log.h"
 #include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
 #include <string.h>
 #include <stdlib.h>
 
-#include "cnn_int8_model.h"
-#include "cnn_float32_model.h"
-#include "mlp_int8_model.h"
-#include "mlp_float32_model.h"
-#include "hybrid_int8_model.h"
-#include "hybrid_float32_model.h"
-
 static const char *TAG = "BENCHMARK";
 
 // Static benchmark results storage
 static model_benchmark_t s_results[MODEL_TYPE_COUNT];
+static uint64_t s_total_time_us[MODEL_TYPE_COUNT];
+// Set last by model_benchmark_init(), which may run in a background task
 static bool s_benchmark_initialized = false;
 
-// Initialize with dummy data
+// Fill static facts (flash, calibrated arena) - timings come from real runs
 void model_benchmark_init(void) {
     if (s_benchmark_initialized) return;
     
     ESP_LOGI(TAG, "Initializing benchmark system");
     
-    const char* names[] = {"CNN_F32", "CNN_INT8", "MLP_F32", "MLP_INT8", "HYBRID_F32", "HYBRID_INT8"};
-    float base_acc[] = {0.92f, 0.85f, 0.88f, 0.82f, 0.90f, 0.84f};
-    uint32_t base_time[] = {8500, 4500, 12000, 7000, 9500, 5500};
-    size_t flash[] = {256, 64, 128, 48, 180, 72};
-    size_t ram[] = {64, 16, 32, 12, 48, 24};
+    model_registry_init();
     
     for (int i = 0; i < MODEL_TYPE_COUNT; i++) {
+        const model_registry_entry_t *entry = model_registry_get((model_type_t)i);
+        
+        // Calibrated arena (arena_used_bytes + headroom) is the real RAM cost
+        size_t arena = model_registry_arena_bytes((model_type_t)i);
+        
+        memset(&s_results[i], 0, sizeof(model_benchmark_t));
         s_results[i].type = i;
-        s_results[i].name = names[i];
-        s_results[i].accuracy = base_acc[i];
-        s_results[i].inference_time_us = base_time[i];
-        s_results[i].flash_size_kb = flash[i];
-        s_results[i].ram_usage_kb = ram[i];
-        s_results[i].test_count = 0;
+        s_results[i].name = entry->name;
+        s_results[i].flash_size_kb = (entry->size + 1023) / 1024;
+        s_results[i].ram_usage_kb = (arena + 1023) / 1024;
+        
+        tflite_kernel_report_t kernels;
+        if (entry->data && tflite_model_kernel_report(entry->data, entry->size, false, &kernels)) {
+            s_results[i].ops = kernels.ops;
+            s_results[i].esp_nn_ops = kernels.esp_nn_ops;
+            s_results[i].fallback_ops = kernels.fallback_ops;
+        }
+        s_total_time_us[i] = 0;
     }
     
-    s_benchmark_initialized = true;
+    __atomic_store_n(&s_benchmark_initialized, true, __ATOMIC_RELEASE);
+    ESP_LOGI(TAG, "Benchmark system ready");
 }
 
-// Your existing benchmark suite
-void run_benchmark_suite(float *samples, int num_samples, const char* ground_truth) {
+bool model_benchmark_ready(void) {
+    return __atomic_load_n(&s_benchmark_initialized, __ATOMIC_ACQUIRE);
+}
+
+// Run every model on the same window and accumulate measured results
+void run_benchmark_suite(float *samples, int num_samples, ml_class_t ground_truth) {
+    if (!s_benchmark_initialized) {
+        model_benchmark_init();
+    }
+    
     ESP_LOGI(TAG, "=== BENCHMARK SUITE ===");
-    ESP_LOGI(TAG, "Ground truth: %s", ground_truth);
+    ESP_LOGI(TAG, "Ground truth: %s", 
+             ground_truth != ML_CLASS_UNKNOWN ? ml_class_to_string(ground_truth) : "unknown");
     
-    // Update test counts
     for (int i = 0; i < MODEL_TYPE_COUNT; i++) {
+        tflite_session_t *session = model_registry_acquire((model_type_t)i, false);
+        if (!session) {
+            continue;
+        }
+        
+        float probabilities[INFERENCE_MAX_CLASSES];
+        int num_classes = 0;
+        
+        uint64_t start_time = esp_timer_get_time();
+        bool ok = tflite_session_run(session, samples, num_samples,
+                                     probabilities, INFERENCE_MAX_CLASSES, &num_classes);
+        uint64_t elapsed = esp_timer_get_time() - start_time;
+        model_registry_release((model_type_t)i);
+        
+        if (!ok) {
+            ESP_LOGW(TAG, "%s failed to run", s_results[i].name);
+            continue;
+        }
+        
         s_results[i].test_count++;
+        s_total_time_us[i] += elapsed;
+        s_results[i].inference_time_us = (uint32_t)(s_total_time_us[i] / s_results[i].test_count);
+        s_results[i].energy_uj = METRICS_ENERGY_UJ(CONFIG_POWER_ACTIVE_MW, s_results[i].inference_time_us);
         
-        // Add some variation
-        float variation = ((rand() % 100) / 1000.0f) - 0.05f;
-        s_results[i].accuracy += variation;
-        if (s_results[i].accuracy > 1.0f) s_results[i].accuracy = 1.0f;
-        if (s_results[i].accuracy < 0.0f) s_results[i].accuracy = 0.0f;
+        if (ground_truth != ML_CLASS_UNKNOWN) {
+            s_results[i].labeled_count++;
+            if (ml_argmax(probabilities, num_classes) == ground_truth) {
+                s_results[i].correct_count++;
+            }
+            s_results[i].accuracy = (float)s_results[i].correct_count / s_results[i].labeled_count;
+        }
     }
     
     ESP_LOGI(TAG, "Benchmark complete");
 }
 
+// Batch input staging: window k+1 is converted to the tensor type on the
+// other core while window k is invoked, ping-ponging between two buffers
+typedef struct {
+    const float *samples;
+    int num_samples;
+    tflite_input_view_t view;
+    void *out;
+    bool ok;
+} stage_job_t;
+
+static float s_stage_buffers[2][ML_WINDOW_SIZE] __attribute__((aligned(16)));
+static stage_job_t s_stage_job;
+static SemaphoreHandle_t s_stage_request = NULL;
+static SemaphoreHandle_t s_stage_done = NULL;
+static TaskHandle_t s_stage_task = NULL;
+
+static bool stage_window(stage_job_t *job) {
+    if (job->view.type == TFLITE_INPUT_INT8) {
+        return quantize_samples_int8(job->samples, job->num_samples, job->view.scale,
+                                     job->view.zero_point, (int8_t *)job->out);
+    }
+    memcpy(job->out, job->samples, job->num_samples * sizeof(float));
+    return true;
+}
+
+static void stage_task(void *arg) {
+    while (1) {
+        xSemaphoreTake(s_stage_request, portMAX_DELAY);
+        s_stage_job.ok = stage_window(&s_stage_job);
+        xSemaphoreGive(s_stage_done);
+    }
+}
+
+// Start the staging task on the other core (false: stage in line)
+static bool stage_task_start(void) {
+    #if CONFIG_FREERTOS_UNICORE
+    return false;
+    #else
+    if (s_stage_task) {
+        return true;
+    }
+    s_stage_request = xSemaphoreCreateBinary();
+    s_stage_done = xSemaphoreCreateBinary();
+    if (!s_stage_request || !s_stage_done) {
+        return false;
+    }
+    BaseType_t other_core = xPortGetCoreID() ? 0 : 1;
+    if (xTaskCreatePinnedToCore(stage_task, "bench_stage", 2048, NULL, 4, 
+                                &s_stage_task, other_core) != pdPASS) {
+        s_stage_task = NULL;
+        return false;
+    }
+    return true;
+    #endif
+}
+
+static void stage_begin(bool async, const float *samples, int num_samples,
+                        const tflite_input_view_t *view, void *out) {
+    s_stage_job.samples = samples;
+    s_stage_job.num_samples = num_samples;
+    s_stage_job.view = *view;
+    s_stage_job.out = out;
+    if (async) {
+        xSemaphoreGive(s_stage_request);
+    } else {
+        s_stage_job.ok = stage_window(&s_stage_job);
+    }
+}
+
+static bool stage_wait(bool async) {
+    if (async) {
+        xSemaphoreTake(s_stage_done, portMAX_DELAY);
+    }
+    return s_stage_job.ok;
+}
+
+static bool run_batch(model_type_t type, tflite_session_t *session, const float *windows,
+                      int num_windows, int window_samples, const ml_class_t *ground_truth,
+                      ml_class_t *predictions, model_batch_result_t *result) {
+    tflite_input_view_t view;
+    if (!tflite_session_input(session, &view) || 
+        view.elements < (size_t)window_samples) {
+        return false;
+    }
+    size_t input_bytes = window_samples * 
+                         (view.type == TFLITE_INPUT_INT8 ? sizeof(int8_t) : sizeof(float));
+    
+    tflite_session_reset_profile(session);
+    
+    bool async = stage_task_start();
+    uint64_t latency_total = 0;
+    uint64_t batch_start = esp_timer_get_time();
+    
+    stage_begin(async, windows, window_samples, &view, s_stage_buffers[0]);
+    for (int k = 0; k < num_windows; k++) {
+        if (!stage_wait(async)) {
+            return false;
+        }
+        
+        uint64_t start_time = esp_timer_get_time();
+        memcpy(view.data, s_stage_buffers[k & 1], input_bytes);
+        
+        // Stage the next window while this one is invoked
+        if (k + 1 < num_windows) {
+            stage_begin(async, windows + (size_t)(k + 1) * window_samples, window_samples,
+                        &view, s_stage_buffers[(k + 1) & 1]);
+        }
+        
+        float probabilities[INFERENCE_MAX_CLASSES];
+        int num_classes = 0;
+        bool ok = tflite_session_invoke(session, probabilities, INFERENCE_MAX_CLASSES, 
+                                        &num_classes);
+        uint32_t latency = (uint32_t)(esp_timer_get_time() - start_time);
+        
+        if (!ok) {
+            // Let an in-flight stage finish before its buffer is reused
+            if (k + 1 < num_windows) {
+                stage_wait(async);
+            }
+            return false;
+        }
+        
+        ml_class_t predicted = (ml_class_t)ml_argmax(probabilities, num_classes);
+        if (predictions) {
+            predictions[k] = predicted;
+        }
+        if (ground_truth && ground_truth[k] != ML_CLASS_UNKNOWN) {
+            result->labeled_count++;
+            if (predicted == ground_truth[k]) {
+                result->correct_count++;
+            }
+        }
+        
+        latency_total += latency;
+        if (latency > result->latency_us_max) {
+            result->latency_us_max = latency;
+        }
+        result->windows++;
+    }
+    
+    result->elapsed_us = esp_timer_get_time() - batch_start;
+#ifdef CONFIG_TELEMETRY_ENABLE
+    telemetry_send_op_profile(type, session);
+#else
+    tflite_session_log_profile(session, model_registry_get(type)->name);
+#endif
+    result->latency_us_avg = (uint32_t)(latency_total / result->windows);
+    result->throughput_wps = result->elapsed_us > 0 ? 
+                             result->windows * 1e6f / result->elapsed_us : 0.0f;
+    return true;
+}
+
+bool model_run_batch(model_type_t type, const float *windows, int num_windows, 
+                     int window_samples, const ml_class_t *ground_truth,
+                     ml_class_t *predictions, model_batch_result_t *result) {
+    if (!windows || !result || num_windows <= 0 || 
+        window_samples <= 0 || window_samples > ML_WINDOW_SIZE) {
+        return false;
+    }
+    memset(result, 0, sizeof(model_batch_result_t));
+    
+    // One acquire for the whole batch: the interpreter stays loaded
+    tflite_session_t *session = model_registry_acquire(type, false);
+    if (!session) {
+        return false;
+    }
+    bool ok = run_batch(type, session, windows, num_windows, window_samples,
+                        ground_truth, predictions, result);
+    model_registry_release(type);
+    return ok;
+}
+
+void model_run_benchmark_batch(const float *windows, int num_windows, int window_samples,
+                               const ml_class_t *ground_truth) {
+    if (!s_benchmark_initialized) {
+        model_benchmark_init();
+    }
+    
+    ESP_LOGI(TAG, "=== BATCH BENCHMARK (%d windows) ===", num_windows);
+    
+    for (int i = 0; i < MODEL_TYPE_COUNT; i++) {
+        model_batch_result_t batch;
+        if (!model_run_batch((model_type_t)i, windows, num_windows, window_samples,
+                             ground_truth, NULL, &batch)) {
+            continue;
+        }
+        
+        model_benchmark_t *r = &s_results[i];
+        r->test_count += batch.windows;
+        s_total_time_us[i] += (uint64_t)batch.latency_us_avg * batch.windows;
+        r->inference_time_us = (uint32_t)(s_total_time_us[i] / r->test_count);
+        r->throughput_wps = batch.throughput_wps;
+        r->energy_uj = METRICS_ENERGY_UJ(CONFIG_POWER_ACTIVE_MW, r->inference_time_us);
+        
+        if (batch.labeled_count > 0) {
+            r->labeled_count += batch.labeled_count;
+            r->correct_count += batch.correct_count;
+            r->accuracy = (float)r->correct_count / r->labeled_count;
+        }
+        
+#ifndef CONFIG_TELEMETRY_ENABLE
+        ESP_LOGI(TAG, "%-12s %u windows: %.1f windows/s, latency avg %u us max %u us",
+                 r->name, (unsigned)batch.windows, batch.throughput_wps,
+                 (unsigned)batch.latency_us_avg, (unsigned)batch.latency_us_max);
+#endif
+    }
+    
+#ifdef CONFIG_TELEMETRY_ENABLE
+    telemetry_send_benchmark();
+#endif
+    ESP_LOGI(TAG, "Batch benchmark complete");
+}
+
 // Interface function
-void model_run_benchmark(float *samples, int num_samples, const char *ground_truth) {
+void model_run_benchmark(float *samples, int num_samples, ml_class_t ground_truth) {
     if (!s_benchmark_initialized) {
         model_benchmark_init();
     }
@@ -73,8 +329,9 @@ void model_run_benchmark(float *samples, int num_samples, const char *ground_tru
 }
 
 int model_get_benchmark_results(model_benchmark_t *results, int max_results) {
-    if (!s_benchmark_initialized) {
-        model_benchmark_init();
+    // Never initialize from here: telemetry may ask while the background init runs
+    if (!model_benchmark_ready()) {
+        return 0;
     }
     
     int count = (max_results < MODEL_TYPE_COUNT) ? max_results : MODEL_TYPE_COUNT;
@@ -90,15 +347,27 @@ void model_log_benchmark_results(void) {
         model_benchmark_init();
     }
     
-    ESP_LOGI(TAG, "=== MODEL BENCHMARK RESULTS ===");
+    #if CONFIG_INFERENCE_ESP_NN
+    ESP_LOGI(TAG, "=== MODEL BENCHMARK RESULTS (ESP-NN kernels) ===");
+    #else
+    ESP_LOGI(TAG, "=== MODEL BENCHMARK RESULTS (reference kernels) ===");
+    #endif
     for (int i = 0; i < MODEL_TYPE_COUNT; i++) {
-        ESP_LOGI(TAG, "%-12s Acc:%5.1f%% Time:%5uus Flash:%3uKB RAM:%2uKB Tests:%u",
+        ESP_LOGI(TAG, "%-12s Acc:%5.1f%% (%u/%u) Time:%5uus Energy:%7.1fuJ Rate:%6.1f/s "
+                 "Flash:%3uKB RAM:%2uKB NN:%u/%u ops (%u fallback) Tests:%u",
                  s_results[i].name,
                  s_results[i].accuracy * 100.0f,
-                 s_results[i].inference_time_us,
+                 (unsigned)s_results[i].correct_count,
+                 (unsigned)s_results[i].labeled_count,
+                 (unsigned)s_results[i].inference_time_us,
+                 s_results[i].energy_uj,
+                 s_results[i].throughput_wps,
                  (unsigned)s_results[i].flash_size_kb,
                  (unsigned)s_results[i].ram_usage_kb,
-                 s_results[i].test_count);
+                 s_results[i].esp_nn_ops,
+                 s_results[i].ops,
+                 s_results[i].fallback_ops,
+                 (unsigned)s_results[i].test_count);
     }
 }
 
@@ -109,11 +378,14 @@ model_type_t model_get_recommended(size_t max_flash_kb, size_t max_ram_kb, float
     
     model_type_t best = MODEL_CNN_INT8;  // Default fallback
     float best_score = -1000.0f;
+    bool found = false;
     
     ESP_LOGI(TAG, "Finding model: Flash<=%uKB, RAM<=%uKB, Acc>=%.1f%%",
              (unsigned)max_flash_kb, (unsigned)max_ram_kb, min_accuracy * 100.0f);
     
     for (int i = 0; i < MODEL_TYPE_COUNT; i++) {
+        // Only rank models with measured accuracy
+        if (s_results[i].labeled_count == 0) continue;
         if (s_results[i].flash_size_kb > max_flash_kb) continue;
         if (s_results[i].ram_usage_kb > max_ram_kb) continue;
         if (s_results[i].accuracy < min_accuracy) continue;
@@ -126,9 +398,15 @@ model_type_t model_get_recommended(size_t max_flash_kb, size_t max_ram_kb, float
         if (score > best_score) {
             best_score = score;
             best = s_results[i].type;
+            found = true;
         }
     }
     
+    if (!found) {
+        ESP_LOGW(TAG, "No measured model meets constraints, using %s", s_results[best].name);
+        return best;
+    }
+    
     ESP_LOGI(TAG, "Recommended: %s (score: %.1f)", s_results[best].name, best_score);
     return best;
 }
\ No newline at end of file
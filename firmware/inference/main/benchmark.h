@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include "ml_contract.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -11,6 +12,7 @@ extern "C" {
 
 // Model types that match your benchmark.c
 typedef enum {
+    MODEL_NONE = -1,          // Heuristic only, no TFLite model
     MODEL_CNN_FLOAT32,
     MODEL_CNN_INT8,
     MODEL_MLP_FLOAT32,
@@ -29,28 +31,56 @@ typedef struct {
     size_t flash_size_kb;
     size_t ram_usage_kb;
     uint32_t test_count;
+    uint32_t labeled_count;   // Runs with a known ground truth
+    uint32_t correct_count;
+    float throughput_wps;     // Sustained windows/s from the last batch (0 = not measured)
+    float energy_uj;          // Per inference at CONFIG_POWER_ACTIVE_MW (estimate)
+    uint8_t ops;              // Operators in the graph
+    uint8_t esp_nn_ops;       // Operators on ESP-NN optimized kernels
+    uint8_t fallback_ops;     // ESP-NN op types that fall back to reference kernels
 } model_benchmark_t;
 
+// Result of running a batch of windows back to back on one model
+typedef struct {
+    uint32_t windows;         // Windows run
+    uint32_t labeled_count;
+    uint32_t correct_count;
+    uint32_t latency_us_avg;  // Per window: tensor fill + Invoke + output
+    uint32_t latency_us_max;
+    uint64_t elapsed_us;      // Wall time for the whole batch
+    float throughput_wps;     // windows / elapsed
+} model_batch_result_t;
+
 /**
  * @brief Initialize benchmark system
+ * 
+ * Calibrates every model and reads its kernels, so it is kept off the
+ * startup path: app_main runs it in a low-priority task once the selected
+ * model is up. The other benchmark calls initialize lazily; callers that
+ * may overlap that task check model_benchmark_ready() first.
  */
 void model_benchmark_init(void);
 
+/**
+ * @brief Check whether model_benchmark_init() has completed
+ */
+bool model_benchmark_ready(void);
+
 /**
  * @brief Run benchmark suite for all models
  * 
  * @param samples Test samples
  * @param num_samples Number of samples
- * @param ground_truth Ground truth label
+ * @param ground_truth Ground truth class (ML_CLASS_UNKNOWN if unlabeled)
  */
-void run_benchmark_suite(float *samples, int num_samples, const char *ground_truth);
+void run_benchmark_suite(float *samples, int num_samples, ml_class_t ground_truth);
 
 /**
  * @brief Get benchmark results
  * 
  * @param results Array to store results
  * @param max_results Maximum number of results to return
- * @return Number of results actually returned
+ * @return Number of results actually returned (0 until model_benchmark_ready())
  */
 int model_get_benchmark_results(model_benchmark_t *results, int max_results);
 
@@ -74,9 +104,43 @@ void model_log_benchmark_results(void);
  * 
  * @param samples Test samples
  * @param num_samples Number of samples
- * @param ground_truth Ground truth label
+ * @param ground_truth Ground truth class (ML_CLASS_UNKNOWN if unlabeled)
+ */
+void model_run_benchmark(float *samples, int num_samples, ml_class_t ground_truth);
+
+/**
+ * @brief Run N windows back to back on one resident interpreter
+ * 
+ * While window k is being invoked, window k+1 is staged (quantized for
+ * int8 models) on the other core, so only a copy into the input tensor
+ * remains on the critical path. Single-core builds stage in line.
+ * 
+ * @param type Model type
+ * @param windows num_windows x window_samples preprocessed samples
+ * @param num_windows Number of windows
+ * @param window_samples Samples per window
+ * @param ground_truth Per-window ground truth (NULL if unlabeled)
+ * @param predictions Per-window predicted class (may be NULL)
+ * @param result Output batch result
+ * @return true if every window ran
+ */
+bool model_run_batch(model_type_t type, const float *windows, int num_windows, 
+                     int window_samples, const ml_class_t *ground_truth,
+                     ml_class_t *predictions, model_batch_result_t *result);
+
+/**
+ * @brief Run a batch of windows through every model and record the results
+ * 
+ * Updates accuracy and latency like model_run_benchmark(), plus
+ * throughput_wps.
+ * 
+ * @param windows num_windows x window_samples preprocessed samples
+ * @param num_windows Number of windows
+ * @param window_samples Samples per window
+ * @param ground_truth Per-window ground truth (NULL if unlabeled)
  */
-void model_run_benchmark(float *samples, int num_samples, const char *ground_truth);
+void model_run_benchmark_batch(const float *windows, int num_windows, int window_samples,
+                               const ml_class_t *ground_truth);
 
 #ifdef __cplusplus
 }
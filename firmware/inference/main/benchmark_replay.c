@@ -0,0 +1,188 @@
+// benchmark_replay.c - Deterministic replay benchmark over a fixed window corpus
+#include "benchmark_replay.h"
+#include "model_registry.h"
+#include "tflite_wrapper.h"
+#include "preprocessing.h"
+#include "inference.h"
+#include "system_monitor.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_cpu.h"
+#include "esp_app_desc.h"
+#include "esp_heap_caps.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef CONFIG_BENCHMARK_REPLAY_MODE
+
+static const char *TAG = "REPLAY";
+
+typedef struct {
+    uint32_t build_us;            // Session creation (arena calibration included)
+    uint32_t cold_us;             // First window on the fresh session
+    uint32_t warm_mean_us;
+    uint32_t warm_p50_us;
+    uint32_t warm_p99_us;
+    uint32_t warm_max_us;
+    uint32_t cycles_per_window;   // Warm mean
+    uint32_t windows;             // Warm windows run
+    uint32_t correct;
+    uint32_t labeled;
+} replay_result_t;
+
+static float s_window[ML_WINDOW_SIZE] __attribute__((aligned(16)));
+
+static int compare_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of a sorted array
+static uint32_t percentile(const uint32_t *sorted, uint32_t count, uint32_t pct)
+{
+    uint32_t rank = (pct * count + 99) / 100;
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+// Preprocess + tensor fill + Invoke + output, as the live pipeline does per window
+static bool replay_window(tflite_session_t *session, uint32_t index, ml_class_t *predicted,
+                          uint32_t *latency_us, uint32_t *cycles)
+{
+    float probabilities[INFERENCE_MAX_CLASSES];
+    int num_classes = 0;
+
+    esp_cpu_cycle_count_t start_cycles = esp_cpu_get_cycle_count();
+    int64_t start = esp_timer_get_time();
+    bool ok = preprocess_codes_float(replay_corpus_codes[index], ML_WINDOW_SIZE, s_window) &&
+              tflite_session_run(session, s_window, ML_WINDOW_SIZE, probabilities,
+                                 INFERENCE_MAX_CLASSES, &num_classes);
+    *latency_us = (uint32_t)(esp_timer_get_time() - start);
+    *cycles = (uint32_t)(esp_cpu_get_cycle_count() - start_cycles);
+
+    *predicted = ok ? (ml_class_t)ml_argmax(probabilities, num_classes) : ML_CLASS_UNKNOWN;
+    return ok;
+}
+
+static bool replay_session(tflite_session_t *session, uint32_t *latencies, replay_result_t *result)
+{
+    ml_class_t predicted;
+    uint32_t cycles;
+    if (!replay_window(session, 0, &predicted, &result->cold_us, &cycles)) {
+        return false;
+    }
+
+    uint64_t total_us = 0, total_cycles = 0;
+    for (int pass = 0; pass < CONFIG_BENCHMARK_REPLAY_PASSES; pass++) {
+        for (uint32_t i = 0; i < replay_corpus_windows; i++) {
+            uint32_t latency;
+            if (!replay_window(session, i, &predicted, &latency, &cycles)) {
+                return false;
+            }
+            latencies[result->windows++] = latency;
+            total_us += latency;
+            total_cycles += cycles;
+
+            // Accuracy from the first pass; later passes repeat the same inputs
+            if (pass == 0 && replay_corpus_labels[i] != ML_CLASS_UNKNOWN) {
+                result->labeled++;
+                result->correct += (predicted == replay_corpus_labels[i]);
+            }
+        }
+    }
+
+    qsort(latencies, result->windows, sizeof(uint32_t), compare_u32);
+    result->warm_mean_us = (uint32_t)(total_us / result->windows);
+    result->cycles_per_window = (uint32_t)(total_cycles / result->windows);
+    result->warm_p50_us = percentile(latencies, result->windows, 50);
+    result->warm_p99_us = percentile(latencies, result->windows, 99);
+    result->warm_max_us = latencies[result->windows - 1];
+    return true;
+}
+
+static bool replay_model(model_type_t type, uint32_t *latencies, replay_result_t *result)
+{
+    memset(result, 0, sizeof(*result));
+
+    // Cold: rebuild the session so the first window pays for first-touch costs
+    model_registry_unload(type);
+    int64_t build_start = esp_timer_get_time();
+    tflite_session_t *session = model_registry_acquire(type, false);
+    result->build_us = (uint32_t)(esp_timer_get_time() - build_start);
+    if (!session) {
+        return false;
+    }
+
+    bool ok = replay_session(session, latencies, result);
+    model_registry_release(type);
+    return ok;
+}
+
+void benchmark_replay_run(void)
+{
+    const esp_app_desc_t *app = esp_app_get_description();
+    char elf_sha[17];
+    esp_app_get_elf_sha256(elf_sha, sizeof(elf_sha));
+
+    ESP_LOGI(TAG, "Replaying %lu windows (%s), %d warm passes",
+             (unsigned long)replay_corpus_windows, replay_corpus_source,
+             CONFIG_BENCHMARK_REPLAY_PASSES);
+
+    uint32_t *latencies = heap_caps_malloc(replay_corpus_windows * CONFIG_BENCHMARK_REPLAY_PASSES *
+                                           sizeof(uint32_t), MALLOC_CAP_8BIT);
+    if (!latencies) {
+        ESP_LOGE(TAG, "No memory for latency samples");
+        return;
+    }
+
+    model_registry_init();
+    for (int i = 0; i < MODEL_TYPE_COUNT; i++) {
+        const model_registry_entry_t *entry = model_registry_get((model_type_t)i);
+        if (!entry || !entry->data) {
+            continue;
+        }
+
+        replay_result_t r;
+        if (!replay_model((model_type_t)i, latencies, &r)) {
+            ESP_LOGW(TAG, "%s failed to replay", entry->name);
+            continue;
+        }
+        float accuracy = r.labeled ? (float)r.correct / r.labeled : -1.0f;
+
+        tflite_kernel_report_t kernels = {0};
+        tflite_model_kernel_report(entry->data, entry->size, false, &kernels);
+
+        // One machine-readable line per model; keys are stable across builds
+        printf("BENCH_JSON {\"version\":\"%s\",\"elf_sha\":\"%s\",\"corpus\":\"%s\","
+               "\"kernels\":\"%s\",\"model\":\"%s\",\"windows\":%lu,"
+               "\"build_us\":%lu,\"cold_us\":%lu,\"warm_mean_us\":%lu,\"warm_p50_us\":%lu,"
+               "\"warm_p99_us\":%lu,\"warm_max_us\":%lu,\"cycles_per_window\":%lu,"
+               "\"energy_uj\":%.1f,"
+               "\"arena_bytes\":%u,\"flash_bytes\":%u,\"esp_nn_ops\":%d,\"fallback_ops\":%d,"
+               "\"accuracy\":%.4f,\"reference_accuracy\":%.4f}\n",
+               app->version, elf_sha, replay_corpus_source,
+               #if CONFIG_INFERENCE_ESP_NN
+               "esp-nn",
+               #else
+               "reference",
+               #endif
+               entry->name, (unsigned long)r.windows,
+               (unsigned long)r.build_us, (unsigned long)r.cold_us,
+               (unsigned long)r.warm_mean_us, (unsigned long)r.warm_p50_us,
+               (unsigned long)r.warm_p99_us, (unsigned long)r.warm_max_us,
+               (unsigned long)r.cycles_per_window,
+               METRICS_ENERGY_UJ(CONFIG_POWER_ACTIVE_MW, r.warm_mean_us),
+               (unsigned)model_registry_arena_bytes((model_type_t)i), (unsigned)entry->size,
+               kernels.esp_nn_ops, kernels.fallback_ops, accuracy, replay_reference_accuracy[i]);
+
+        // Free the arena before the next model is built
+        model_registry_unload((model_type_t)i);
+    }
+    printf("BENCH_DONE\n");
+    fflush(stdout);
+
+    free(latencies);
+}
+
+#endif /* CONFIG_BENCHMARK_REPLAY_MODE */
@@ -0,0 +1,41 @@
+#ifndef BENCHMARK_REPLAY_H
+#define BENCHMARK_REPLAY_H
+
+#include <stdint.h>
+#include "ml_contract.h"
+#include "benchmark.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Fixed replay corpus, generated at build time by gen_replay_corpus.py
+ * (only with CONFIG_BENCHMARK_REPLAY_MODE).
+ */
+extern const char replay_corpus_source[];
+extern const uint32_t replay_corpus_windows;
+extern const int8_t replay_corpus_labels[];                 // ml_class_t
+extern const uint16_t replay_corpus_codes[][ML_WINDOW_SIZE]; // Raw ADC codes
+
+/**
+ * @brief Test accuracy per model from training_summary.json (-1 if unknown)
+ */
+extern const float replay_reference_accuracy[MODEL_TYPE_COUNT];
+
+/**
+ * @brief Replay the corpus through preprocessing and every model
+ *
+ * For each model with a compiled-in flatbuffer: builds its session,
+ * times the first (cold) window, then CONFIG_BENCHMARK_REPLAY_PASSES
+ * warm passes over the corpus. Prints one "BENCH_JSON {...}" line per
+ * model (cold/warm latency, p50/p99, cycles per window, arena bytes,
+ * accuracy versus the reference) for benchmark_replay.py.
+ */
+void benchmark_replay_run(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BENCHMARK_REPLAY_H */
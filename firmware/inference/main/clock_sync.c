@@ -117,6 +117,20 @@ uint32_t get_synchronized_timestamp(clock_sync_t *sync) {
     return local;
 }
 
+int64_t sync_local_to_remote_us(const clock_sync_t *sync, int64_t local_us) {
+    if (!sync || sync->sync_count == 0) {
+        return local_us;
+    }
+    
+    int64_t offset_us = (int64_t)sync->offset_ms * 1000;
+    
+    // Extrapolate the drift since the last sync packet
+    int64_t since_sync_us = local_us - (int64_t)sync->local_timestamp * 1000;
+    offset_us += (int64_t)(sync->drift_ppm * (float)since_sync_us / 1000000.0f);
+    
+    return local_us - offset_us;
+}
+
 bool is_clock_synchronized(clock_sync_t *sync) {
     return sync ? sync->synchronized : false;
 }
@@ -24,9 +24,30 @@ typedef enum {
     PKT_TYPE_LABEL = 0x01,
     PKT_TYPE_TIMESTAMP = 0x02,
     PKT_TYPE_HEARTBEAT = 0x03,
-    PKT_TYPE_ACK = 0x04
+    PKT_TYPE_ACK = 0x04,
+    PKT_TYPE_WAVEFORM_CONFIG = 0x05,
+    PKT_TYPE_COMMAND = 0x06         // Host tools only (telemetry.h), never the generator
 } uart_packet_type_t;
 
+// PKT_TYPE_WAVEFORM_CONFIG payload: a generator segment reaching its DAC
+// output (must match generator)
+typedef struct __attribute__((packed)) {
+    uint32_t sample_index;      // First DAC sample of the segment (wraps after ~59 h)
+    int64_t output_time_us;     // Generator esp_timer time of that sample
+    uint32_t duration_samples;  // 0 = held until the next segment
+    float start_hz;
+    float end_hz;
+    uint8_t start_amplitude;    // 255 = full scale
+    uint8_t end_amplitude;
+    int8_t start_offset;        // 127 = +0.5 of full scale
+    int8_t end_offset;
+    uint8_t noise;              // 255 = 0.25 of full scale
+    uint8_t waveform;           // Generator waveform index = ml_class_t
+    uint8_t flags;              // WAVEFORM_CONFIG_FLAG_*
+} waveform_config_payload_t;
+
+#define WAVEFORM_CONFIG_FLAG_TIMING_VALID  0x01
+
 typedef struct {
     uint32_t remote_timestamp;
     uint32_t local_timestamp;
@@ -59,6 +80,20 @@ void sync_process_packet(clock_sync_t *sync, uart_packet_t *packet);
  */
 uint32_t get_synchronized_timestamp(clock_sync_t *sync);
 
+/**
+ * @brief Convert a local esp_timer time to generator time
+ * 
+ * Applies the filtered offset (and drift since the last sync packet) as
+ * soon as one packet has been seen, whether or not the offset is small
+ * enough to count as synchronized. The offset includes the one-way
+ * packet latency.
+ * 
+ * @param sync Clock sync structure
+ * @param local_us Local time in microseconds
+ * @return int64_t Generator time in microseconds (local_us before any packet)
+ */
+int64_t sync_local_to_remote_us(const clock_sync_t *sync, int64_t local_us);
+
 /**
  * @brief Check if clock is synchronized
  * 
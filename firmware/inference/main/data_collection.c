@@ -1,98 +1,508 @@
-// data_collection.c - Optimized with binary format
+// data_collection.c - Asynchronous SD-card recorder of raw labeled windows
 #include "data_collection.h"
+#include "sample_codec.h"
 #include "esp_log.h"
 #include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_vfs_fat.h"
+#include "sdmmc_cmd.h"
+#include "driver/sdspi_host.h"
+#include "driver/spi_common.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
+#include <stdatomic.h>
+
+#ifdef CONFIG_DATA_COLLECTION_ENABLE
 
 static const char *TAG = "DATA_COLLECT";
-static FILE *s_data_file = NULL;
-static bool s_collecting = false;
-static uint32_t s_sample_count = 0;
-static char s_current_label[32] = {0};
-
-// Binary format header
-typedef struct __attribute__((packed)) {
-    uint64_t timestamp;
-    uint8_t source_id;
-    uint8_t label_len;
-    uint16_t sample_count;
-    // Followed by: label string (null-terminated), then samples
-} data_header_t;
-
-void data_collection_init(void) {
-    // Open file for binary writing
-    s_data_file = fopen("/sdcard/waveform_data.bin", "wb");
-    if (s_data_file) {
-        ESP_LOGI(TAG, "Binary data collection initialized");
+
+#define MOUNT_POINT         "/sdcard"
+#define BLOCK_SIZE          (CONFIG_DATA_COLLECTION_BLOCK_KB * 1024)
+#define BLOCK_COUNT         2       // Ping-pong: one filling, one writing
+#define WRITER_STACK_SIZE   4096
+#define WRITER_PRIORITY     3       // Below ADC and inference
+#define INDEX_CHUNK         (DATA_SECTOR_SIZE / sizeof(uint32_t))
+
+#if CONFIG_FREERTOS_UNICORE
+#define WRITER_CORE         0
+#else
+#define WRITER_CORE         CONFIG_PIPELINE_ACQUISITION_CORE  // Keep SD work off the model core
+#endif
+
+// Encoded payload sizes
+#define DELTA_BYTES(n, bits)    (2 + (((n) - 1) * (bits) + 7) / 8)
+#define MAX_RECORD_SIZE         (sizeof(data_record_header_t) + SAMPLE_PACKED12_BYTES(ML_WINDOW_SIZE))
+
+_Static_assert(BLOCK_SIZE % DATA_SECTOR_SIZE == 0, "blocks must be whole sectors");
+_Static_assert(MAX_RECORD_SIZE <= BLOCK_SIZE, "a window must fit in one block");
+
+// Blocks handed between the submitting task and the writer
+typedef struct {
+    int index;                    // Block to write, -1 for none
+    bool finish;                  // Then append the index and close the file
+} block_msg_t;
+
+static uint8_t *s_blocks[BLOCK_COUNT];
+static QueueHandle_t s_free_blocks = NULL;
+static QueueHandle_t s_full_blocks = NULL;
+static SemaphoreHandle_t s_finished = NULL;
+static TaskHandle_t s_writer_task = NULL;
+
+// Block being filled (only touched by the submitting task)
+static int s_active = -1;
+static size_t s_fill = 0;
+static uint32_t s_sequence = 0;
+
+// Open recording (only touched by the writer task while recording)
+static char s_path[32];
+static char s_index_path[32];
+static FILE *s_file = NULL;
+static FILE *s_index_file = NULL;
+static uint32_t s_file_offset = 0;
+static uint32_t s_index_chunk[INDEX_CHUNK];
+static uint32_t s_index_fill = 0;
+static uint32_t s_index_count = 0;
+
+static sdmmc_card_t *s_card = NULL;
+static atomic_bool s_recording = false;
+
+static atomic_uint s_recorded = 0;
+static atomic_uint s_dropped = 0;
+static atomic_uint s_samples = 0;
+static atomic_uint s_payload_bytes = 0;
+static atomic_uint s_blocks_written = 0;
+static atomic_uint s_write_errors = 0;
+static atomic_uint s_max_write_us = 0;
+
+#ifdef CONFIG_DATA_COLLECTION_ENCODING_DELTA
+static inline uint32_t zigzag(int32_t d)
+{
+    return ((uint32_t)d << 1) ^ (uint32_t)(d >> 31);
+}
+
+// Width of the widest zigzag delta in the window
+static int delta_bits(const uint16_t *codes, int count)
+{
+    uint32_t all = 0;
+    for (int i = 1; i < count; i++) {
+        all |= zigzag((int32_t)(codes[i] & 0x0FFF) - (int32_t)(codes[i - 1] & 0x0FFF));
+    }
+    return all ? 32 - __builtin_clz(all) : 0;
+}
+
+static size_t encode_delta(const uint16_t *codes, int count, int bits, uint8_t *out)
+{
+    uint16_t first = codes[0] & 0x0FFF;
+    out[0] = (uint8_t)first;
+    out[1] = (uint8_t)(first >> 8);
+    size_t o = 2;
+
+    // At most 7 pending + 13 new bits
+    uint32_t acc = 0;
+    int pending = 0;
+    for (int i = 1; i < count; i++) {
+        acc |= zigzag((int32_t)(codes[i] & 0x0FFF) - (int32_t)(codes[i - 1] & 0x0FFF)) << pending;
+        pending += bits;
+        while (pending >= 8) {
+            out[o++] = (uint8_t)acc;
+            acc >>= 8;
+            pending -= 8;
+        }
+    }
+    if (pending > 0) {
+        out[o++] = (uint8_t)acc;
+    }
+    return o;
+}
+#endif
+
+static void flush_index_chunk(void)
+{
+    if (s_index_fill > 0 &&
+        fwrite(s_index_chunk, sizeof(uint32_t), s_index_fill, s_index_file) != s_index_fill) {
+        atomic_fetch_add(&s_write_errors, 1);
+    }
+    s_index_fill = 0;
+}
+
+// Append the file offset of every record in a block just written
+static void index_block(const uint8_t *block, uint32_t block_offset)
+{
+    size_t pos = 0;
+    while (pos + sizeof(data_record_header_t) <= BLOCK_SIZE) {
+        data_record_header_t header;
+        memcpy(&header, block + pos, sizeof(header));
+        if (header.magic != DATA_RECORD_MAGIC) {
+            break;
+        }
+        s_index_chunk[s_index_fill++] = block_offset + pos;
+        s_index_count++;
+        if (s_index_fill == INDEX_CHUNK) {
+            flush_index_chunk();
+        }
+        pos += sizeof(header) + header.payload_bytes;
+    }
+}
+
+// Bound what a power loss costs: everything up to here is on the card
+static void sync_recording(void)
+{
+    flush_index_chunk();
+    fflush(s_index_file);
+    fsync(fileno(s_index_file));
+    fflush(s_file);
+    fsync(fileno(s_file));
+}
+
+static void write_block(int index)
+{
+    int64_t start = esp_timer_get_time();
+    size_t written = fwrite(s_blocks[index], 1, BLOCK_SIZE, s_file);
+    uint32_t elapsed = (uint32_t)(esp_timer_get_time() - start);
+
+    if (written != BLOCK_SIZE) {
+        atomic_fetch_add(&s_write_errors, 1);
+        ESP_LOGE(TAG, "Block write failed (%u/%u bytes)", (unsigned)written, BLOCK_SIZE);
     } else {
-        ESP_LOGW(TAG, "Failed to open data file");
-    }
-}
-
-void data_collection_start(const char *source, const char *label) {
-    (void)source; // Unused parameter
-    
-    if (!s_data_file || s_collecting) return;
-    
-    s_collecting = true;
-    s_sample_count = 0;
-    
-    // Store label for later
-    strncpy(s_current_label, label, sizeof(s_current_label) - 1);
-    s_current_label[sizeof(s_current_label) - 1] = '\0';
-    
-    #ifdef CONFIG_DETAILED_LOGGING
-    ESP_LOGI(TAG, "Starting collection: source=%s, label=%s", source, label);
-    #endif
-}
-
-void data_collection_add_sample(float sample) {
-    if (!s_collecting || !s_data_file) return;
-    
-    // Buffer sample for later writing
-    static float sample_buffer[256];
-    if (s_sample_count < 256) {
-        sample_buffer[s_sample_count] = sample;
-        s_sample_count++;
-    }
-    
-    // Write when buffer is full
-    if (s_sample_count >= 256) {
-        data_collection_finish_binary(sample_buffer, s_sample_count);
-        s_sample_count = 0;
-    }
-}
-
-// Optimized binary write
-void data_collection_finish_binary(float *samples, int count) {
-    if (!s_collecting || !s_data_file || count == 0) return;
-    
-    data_header_t header = {
-        .timestamp = esp_timer_get_time(),
-        .source_id = 1,  // ESP32 source
-        .label_len = (uint8_t)strlen(s_current_label),
-        .sample_count = (uint16_t)count
+        index_block(s_blocks[index], s_file_offset);
+        if ((atomic_fetch_add(&s_blocks_written, 1) + 1) % CONFIG_DATA_COLLECTION_SYNC_BLOCKS == 0) {
+            sync_recording();
+        }
+    }
+    s_file_offset += written;
+
+    uint32_t prev = atomic_load(&s_max_write_us);
+    while (elapsed > prev && !atomic_compare_exchange_weak(&s_max_write_us, &prev, elapsed)) {
+    }
+}
+
+// Sector-sized staging for the index section
+static uint8_t s_sector[DATA_SECTOR_SIZE];
+static size_t s_sector_fill = 0;
+
+static void emit(const void *data, size_t len)
+{
+    const uint8_t *src = data;
+    while (len > 0) {
+        size_t n = DATA_SECTOR_SIZE - s_sector_fill;
+        if (n > len) n = len;
+        memcpy(s_sector + s_sector_fill, src, n);
+        s_sector_fill += n;
+        src += n;
+        len -= n;
+        if (s_sector_fill == DATA_SECTOR_SIZE) {
+            if (fwrite(s_sector, 1, DATA_SECTOR_SIZE, s_file) != DATA_SECTOR_SIZE) {
+                atomic_fetch_add(&s_write_errors, 1);
+            }
+            s_sector_fill = 0;
+        }
+    }
+}
+
+// Copy the sidecar index to the end of the file, add the trailer, close
+static void finish_recording(void)
+{
+    flush_index_chunk();
+    fclose(s_index_file);
+    s_index_file = NULL;
+
+    data_index_header_t header = { .magic = DATA_INDEX_MAGIC, .record_count = s_index_count };
+    data_index_trailer_t trailer = { .magic = DATA_TRAILER_MAGIC, .index_offset = s_file_offset };
+    s_sector_fill = 0;
+    emit(&header, sizeof(header));
+
+    FILE *sidecar = fopen(s_index_path, "rb");
+    size_t n;
+    while (sidecar && (n = fread(s_index_chunk, sizeof(uint32_t), INDEX_CHUNK, sidecar)) > 0) {
+        emit(s_index_chunk, n * sizeof(uint32_t));
+    }
+
+    // Zero pad so the trailer lands in the last 8 bytes of a sector
+    static const uint8_t zeros[DATA_SECTOR_SIZE];
+    size_t room = DATA_SECTOR_SIZE - s_sector_fill;
+    size_t pad = (room >= sizeof(trailer)) ? room - sizeof(trailer) 
+                                           : room + DATA_SECTOR_SIZE - sizeof(trailer);
+    emit(zeros, pad);
+    emit(&trailer, sizeof(trailer));
+
+    fflush(s_file);
+    fsync(fileno(s_file));
+    fclose(s_file);
+    s_file = NULL;
+
+    if (sidecar) {
+        fclose(sidecar);
+        remove(s_index_path);
+    } else {
+        atomic_fetch_add(&s_write_errors, 1);
+        ESP_LOGE(TAG, "Index sidecar %s missing; index is empty", s_index_path);
+    }
+    ESP_LOGI(TAG, "Closed %s: %lu records indexed", s_path, (unsigned long)s_index_count);
+}
+
+static void writer_task(void *arg)
+{
+    block_msg_t msg;
+
+    while (1) {
+        xQueueReceive(s_full_blocks, &msg, portMAX_DELAY);
+
+        if (msg.index >= 0) {
+            write_block(msg.index);
+            xQueueSend(s_free_blocks, &msg.index, portMAX_DELAY);
+        }
+        if (msg.finish) {
+            finish_recording();
+            xSemaphoreGive(s_finished);
+        }
+    }
+}
+
+static esp_err_t mount_card(void)
+{
+    esp_vfs_fat_sdmmc_mount_config_t mount_config = {
+        .format_if_mount_failed = false,
+        .max_files = 3,                 // Recording, sidecar index, probe
+        .allocation_unit_size = BLOCK_SIZE,
     };
-    
-    // Write header
-    fwrite(&header, sizeof(header), 1, s_data_file);
-    
-    // Write label
-    fwrite(s_current_label, 1, header.label_len, s_data_file);
-    
-    // Write samples
-    fwrite(samples, sizeof(float), count, s_data_file);
-    
-    fflush(s_data_file);
-    s_collecting = false;
-    
-    #ifdef CONFIG_DETAILED_LOGGING
-    ESP_LOGI(TAG, "Collection finished: %d samples", count);
-    #endif
-}
-
-void data_collection_finish(void) {
-    // Legacy function for compatibility
-    s_collecting = false;
-}
\ No newline at end of file
+
+    sdmmc_host_t host = SDSPI_HOST_DEFAULT();
+    spi_bus_config_t bus_config = {
+        .mosi_io_num = CONFIG_DATA_COLLECTION_SD_MOSI,
+        .miso_io_num = CONFIG_DATA_COLLECTION_SD_MISO,
+        .sclk_io_num = CONFIG_DATA_COLLECTION_SD_CLK,
+        .quadwp_io_num = -1,
+        .quadhd_io_num = -1,
+        .max_transfer_sz = BLOCK_SIZE,
+    };
+    esp_err_t ret = spi_bus_initialize(host.slot, &bus_config, SDSPI_DEFAULT_DMA);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "SPI bus init failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    sdspi_device_config_t slot_config = SDSPI_DEVICE_CONFIG_DEFAULT();
+    slot_config.gpio_cs = CONFIG_DATA_COLLECTION_SD_CS;
+    slot_config.host_id = host.slot;
+
+    ret = esp_vfs_fat_sdspi_mount(MOUNT_POINT, &host, &slot_config, &mount_config, &s_card);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "SD card mount failed: %s", esp_err_to_name(ret));
+        spi_bus_free(host.slot);
+        return ret;
+    }
+    return ESP_OK;
+}
+
+// Create the next free /sdcard/rec_NNNN.bin, its index sidecar and header
+static esp_err_t open_recording(void)
+{
+    int i;
+    for (i = 0; i < 10000; i++) {
+        snprintf(s_path, sizeof(s_path), MOUNT_POINT "/rec_%04d.bin", i);
+        FILE *f = fopen(s_path, "rb");
+        if (!f) {
+            break;
+        }
+        fclose(f);
+    }
+    if (i == 10000) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    snprintf(s_index_path, sizeof(s_index_path), MOUNT_POINT "/rec_%04d.idx", i);
+
+    s_file = fopen(s_path, "wb");
+    s_index_file = s_file ? fopen(s_index_path, "wb") : NULL;
+    if (!s_index_file) {
+        if (s_file) {
+            fclose(s_file);
+            s_file = NULL;
+        }
+        return ESP_FAIL;
+    }
+
+    uint8_t sector[DATA_SECTOR_SIZE] = {0};
+    data_file_header_t header = {
+        .magic = DATA_FILE_MAGIC,
+        .version = DATA_FILE_VERSION,
+        .header_size = DATA_SECTOR_SIZE,
+        .block_size = BLOCK_SIZE,
+        .sample_rate_hz = ML_SAMPLE_RATE_HZ,
+        .window_size = ML_WINDOW_SIZE,
+        .adc_bits = 12,
+    };
+    memcpy(sector, &header, sizeof(header));
+    if (fwrite(sector, 1, sizeof(sector), s_file) != sizeof(sector)) {
+        fclose(s_index_file);
+        fclose(s_file);
+        s_index_file = NULL;
+        s_file = NULL;
+        return ESP_FAIL;
+    }
+
+    s_file_offset = DATA_SECTOR_SIZE;
+    s_index_fill = 0;
+    s_index_count = 0;
+    s_sequence = 0;
+    ESP_LOGI(TAG, "Recording to %s", s_path);
+    return ESP_OK;
+}
+
+esp_err_t data_collection_init(void)
+{
+    if (s_writer_task) {
+        return ESP_OK;
+    }
+
+    esp_err_t ret = mount_card();
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    // One extra slot for a finish message when no block is being filled
+    s_free_blocks = xQueueCreate(BLOCK_COUNT, sizeof(int));
+    s_full_blocks = xQueueCreate(BLOCK_COUNT + 1, sizeof(block_msg_t));
+    s_finished = xSemaphoreCreateBinary();
+    if (!s_free_blocks || !s_full_blocks || !s_finished) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    // DMA-capable internal RAM so the SPI driver doesn't bounce-buffer
+    for (int i = 0; i < BLOCK_COUNT; i++) {
+        s_blocks[i] = heap_caps_aligned_alloc(4, BLOCK_SIZE, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+        if (!s_blocks[i]) {
+            ESP_LOGE(TAG, "Failed to allocate %u byte block", BLOCK_SIZE);
+            return ESP_ERR_NO_MEM;
+        }
+        xQueueSend(s_free_blocks, &i, 0);
+    }
+
+    if (xTaskCreatePinnedToCore(writer_task, "sd_writer", WRITER_STACK_SIZE, NULL,
+                                WRITER_PRIORITY, &s_writer_task, WRITER_CORE) != pdPASS) {
+        s_writer_task = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "SD recorder ready: %d x %u byte blocks", BLOCK_COUNT, BLOCK_SIZE);
+    return ESP_OK;
+}
+
+// Zero pad the active block and hand it to the writer
+static void submit_block(bool finish)
+{
+    if (s_active >= 0) {
+        memset(s_blocks[s_active] + s_fill, 0, BLOCK_SIZE - s_fill);
+    }
+    block_msg_t msg = { .index = s_active, .finish = finish };
+    xQueueSend(s_full_blocks, &msg, portMAX_DELAY);  // Never waits: sized for every block in flight
+    s_active = -1;
+    s_fill = 0;
+}
+
+esp_err_t data_collection_start(void)
+{
+    if (!s_writer_task) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (atomic_load(&s_recording)) {
+        return ESP_OK;
+    }
+
+    esp_err_t ret = open_recording();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create recording file: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    atomic_store(&s_recording, true);
+    return ESP_OK;
+}
+
+void data_collection_stop(void)
+{
+    if (!atomic_exchange(&s_recording, false)) {
+        return;
+    }
+    submit_block(true);
+    xSemaphoreTake(s_finished, portMAX_DELAY);
+}
+
+bool data_collection_active(void)
+{
+    return atomic_load(&s_recording);
+}
+
+bool data_collection_submit(const uint16_t *codes, int count, int64_t start_us,
+                            int64_t end_us, ml_class_t label, uint8_t flags)
+{
+    if (!atomic_load(&s_recording) || !codes || count <= 0 || count > ML_WINDOW_SIZE) {
+        return false;
+    }
+
+    uint32_t sequence = s_sequence++;
+
+    // Reserve the PACKED12 size; delta is only used when smaller
+    if (s_active >= 0 && s_fill + sizeof(data_record_header_t) + SAMPLE_PACKED12_BYTES(count) > BLOCK_SIZE) {
+        submit_block(false);
+    }
+    if (s_active < 0 && xQueueReceive(s_free_blocks, &s_active, 0) != pdTRUE) {
+        // Both blocks are waiting on the card
+        s_active = -1;
+        atomic_fetch_add(&s_dropped, 1);
+        return false;
+    }
+
+    data_record_header_t header = {
+        .magic = DATA_RECORD_MAGIC,
+        .sample_count = (uint16_t)count,
+        .sequence = sequence,
+        .start_us = start_us,
+        .end_us = end_us,
+        .label = (int8_t)label,
+        .flags = flags,
+        .encoding = DATA_ENCODING_PACKED12,
+    };
+    uint8_t *dst = s_blocks[s_active] + s_fill;
+    uint8_t *payload = dst + sizeof(header);
+    size_t payload_bytes;
+
+#ifdef CONFIG_DATA_COLLECTION_ENCODING_DELTA
+    int bits = delta_bits(codes, count);
+    if (DELTA_BYTES(count, bits) < SAMPLE_PACKED12_BYTES(count)) {
+        header.encoding = DATA_ENCODING_DELTA;
+        header.delta_bits = (uint8_t)bits;
+        payload_bytes = encode_delta(codes, count, bits, payload);
+    } else
+#endif
+    {
+        payload_bytes = sample_pack12(codes, count, payload);
+    }
+
+    header.payload_bytes = (uint16_t)payload_bytes;
+    memcpy(dst, &header, sizeof(header));
+    s_fill += sizeof(header) + payload_bytes;
+
+    atomic_fetch_add(&s_recorded, 1);
+    atomic_fetch_add(&s_samples, count);
+    atomic_fetch_add(&s_payload_bytes, payload_bytes);
+    return true;
+}
+
+void data_collection_get_stats(data_collection_stats_t *stats)
+{
+    if (!stats) return;
+
+    stats->windows_recorded = atomic_load(&s_recorded);
+    stats->windows_dropped = atomic_load(&s_dropped);
+    stats->samples_recorded = atomic_load(&s_samples);
+    stats->payload_bytes = atomic_load(&s_payload_bytes);
+    stats->blocks_written = atomic_load(&s_blocks_written);
+    stats->write_errors = atomic_load(&s_write_errors);
+    stats->max_write_us = atomic_load(&s_max_write_us);
+}
+
+#endif /* CONFIG_DATA_COLLECTION_ENABLE */
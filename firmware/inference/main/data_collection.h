@@ -4,19 +4,154 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include "esp_err.h"
+#include "ml_contract.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-void data_collection_init(void);
-void data_collection_start(const char *source, const char *label);
-void data_collection_add_sample(float sample);
-void data_collection_finish(void);
-void data_collection_finish_binary(float *samples, int count);
+/*
+ * Only built with CONFIG_DATA_COLLECTION_ENABLE.
+ *
+ * Recording file layout, version 2 (all little endian):
+ *   - one 512-byte file header sector (data_file_header_t, zero padded)
+ *   - blocks of block_size bytes, each holding whole records back to back
+ *     and zero padded; a record magic of 0 ends the block
+ *   - record = data_record_header_t + payload_bytes of encoded samples
+ *   - index (written by data_collection_stop()): data_index_header_t,
+ *     one uint32 file offset per record, zero padding to a whole sector,
+ *     and data_index_trailer_t in the file's last 8 bytes
+ * Every write is a whole number of sectors at a sector-aligned offset.
+ * Until the index is written it lives in a sidecar file (.idx) holding
+ * the same uint32 offsets, so an interrupted capture stays seekable. Both
+ * files are synced every CONFIG_DATA_COLLECTION_SYNC_BLOCKS blocks.
+ *
+ * Payload encodings:
+ *   DATA_ENCODING_PACKED12: sample_pack12() layout (sample_codec.h)
+ *   DATA_ENCODING_DELTA: first code as uint16, then sample_count - 1
+ *     zigzag-encoded deltas of delta_bits each, packed LSB first.
+ *     Used only when smaller than PACKED12.
+ */
+#define DATA_FILE_MAGIC         0x31434557u   // "WEC1"
+#define DATA_FILE_VERSION       2
+#define DATA_RECORD_MAGIC       0x5752u       // "RW"
+#define DATA_INDEX_MAGIC        0x58444957u   // "WIDX"
+#define DATA_TRAILER_MAGIC      0x444E4557u   // "WEND"
+#define DATA_SECTOR_SIZE        512
+
+typedef enum {
+    DATA_ENCODING_PACKED12 = 0,
+    DATA_ENCODING_DELTA = 1,
+} data_encoding_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;               // DATA_FILE_MAGIC
+    uint16_t version;             // DATA_FILE_VERSION
+    uint16_t header_size;         // DATA_SECTOR_SIZE
+    uint32_t block_size;          // Bytes per block, multiple of DATA_SECTOR_SIZE
+    uint32_t sample_rate_hz;
+    uint16_t window_size;         // ML_WINDOW_SIZE at capture time
+    uint16_t adc_bits;
+} data_file_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint16_t magic;               // DATA_RECORD_MAGIC
+    uint16_t sample_count;
+    uint32_t sequence;            // Submitted windows, dropped ones included
+    int64_t start_us;             // First sample, generator clock (clock_sync)
+    int64_t end_us;               // Last sample, generator clock (clock_sync)
+    int8_t label;                 // ml_class_t, ML_CLASS_UNKNOWN if unlabeled
+    uint8_t flags;                // DATA_RECORD_FLAG_*
+    uint8_t encoding;             // data_encoding_t
+    uint8_t delta_bits;           // Bits per delta (DATA_ENCODING_DELTA)
+    uint16_t payload_bytes;
+} data_record_header_t;
+
+#define DATA_RECORD_FLAG_TRANSITION  0x01   // Label changed inside the window
+#define DATA_RECORD_FLAG_LOCAL_CLOCK 0x02   // Not synced yet: times are esp_timer
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;               // DATA_INDEX_MAGIC
+    uint32_t record_count;        // uint32 offsets that follow
+} data_index_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;               // DATA_TRAILER_MAGIC
+    uint32_t index_offset;        // File offset of data_index_header_t
+} data_index_trailer_t;
+
+// Recorder counters
+typedef struct {
+    uint32_t windows_recorded;
+    uint32_t windows_dropped;     // No free buffer: writer behind the SD card
+    uint32_t samples_recorded;
+    uint32_t payload_bytes;       // Encoded sample bytes (2 per sample raw)
+    uint32_t blocks_written;
+    uint32_t write_errors;
+    uint32_t max_write_us;        // Slowest block write
+} data_collection_stats_t;
+
+/**
+ * @brief Mount the SD card and start the writer task
+ *
+ * The writer task owns all SD access; callers only copy windows into a
+ * RAM block. Safe to call once; fails if the card can't be mounted.
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t data_collection_init(void);
+
+/**
+ * @brief Start accepting windows
+ *
+ * @return ESP_OK, or an error if a new recording file can't be created
+ */
+esp_err_t data_collection_start(void);
+
+/**
+ * @brief Stop accepting windows, flush the partly filled block and
+ *        append the index
+ *
+ * Call from the task that submits windows. Blocks until the writer task
+ * has closed the file; a later data_collection_start() opens a new one.
+ */
+void data_collection_stop(void);
+
+/**
+ * @brief Check whether windows are being recorded
+ *
+ * @return true between data_collection_start() and data_collection_stop()
+ */
+bool data_collection_active(void);
+
+/**
+ * @brief Queue one window for recording (never blocks)
+ *
+ * Encodes the codes into the active block; the block is handed to the
+ * writer task when full. If both blocks are busy the window is dropped
+ * and counted.
+ *
+ * @param codes Raw ADC codes
+ * @param count Number of codes (at most ML_WINDOW_SIZE)
+ * @param start_us First sample time (generator clock)
+ * @param end_us Last sample time (generator clock)
+ * @param label Ground truth label (ML_CLASS_UNKNOWN if unlabeled)
+ * @param flags DATA_RECORD_FLAG_* bits
+ * @return true if the window was queued
+ */
+bool data_collection_submit(const uint16_t *codes, int count, int64_t start_us,
+                            int64_t end_us, ml_class_t label, uint8_t flags);
+
+/**
+ * @brief Get recorder counters
+ *
+ * @param stats Output counters
+ */
+void data_collection_get_stats(data_collection_stats_t *stats);
 
 #ifdef __cplusplus
 }
 #endif
 
-#endif /* DATA_COLLECTION_H */
\ No newline at end of file
+#endif /* DATA_COLLECTION_H */
@@ -0,0 +1,111 @@
+#include "decimator.h"
+#include <math.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Cutoff as a fraction of the output Nyquist frequency
+#define CUTOFF_FRACTION 0.84
+
+bool decimator_init(decimator_t *d, int factor) {
+    if (!d || factor < 2 || factor > DECIMATOR_MAX_FACTOR) {
+        return false;
+    }
+    memset(d, 0, sizeof(decimator_t));
+    d->factor = factor;
+    d->taps = factor * DECIMATOR_TAPS_PER_PHASE;
+
+    // Windowed sinc, cutoff in cycles per input sample
+    double fc = CUTOFF_FRACTION * 0.5 / factor;
+    double centre = (d->taps - 1) / 2.0;
+    double h[DECIMATOR_MAX_TAPS];
+    double sum = 0.0;
+    for (int k = 0; k < d->taps; k++) {
+        double t = k - centre;
+        double sinc = (t == 0.0) ? 2.0 * fc : sin(2.0 * M_PI * fc * t) / (M_PI * t);
+        double window = 0.54 - 0.46 * cos(2.0 * M_PI * k / (d->taps - 1));
+        h[k] = sinc * window;
+        sum += h[k];
+    }
+
+    // Quantize to Q15 and put the rounding residue on the centre taps,
+    // so the DC gain is exactly 1
+    int32_t total = 0;
+    for (int k = 0; k < d->taps; k++) {
+        d->coeffs[k] = (int16_t)lround(h[k] / sum * 32768.0);
+        total += d->coeffs[k];
+    }
+    int32_t residue = 32768 - total;
+    d->coeffs[d->taps / 2] += (int16_t)(residue / 2);
+    d->coeffs[d->taps / 2 - 1] += (int16_t)(residue - residue / 2);
+
+    decimator_reset(d);
+    return true;
+}
+
+void decimator_reset(decimator_t *d) {
+    if (!d) {
+        return;
+    }
+    memset(d->history, 0, sizeof(d->history));
+    d->pos = 0;
+    d->phase = 0;
+    d->primed = false;
+}
+
+static inline uint16_t filter_output(const decimator_t *d) {
+    const int16_t *x = &d->history[d->pos];
+    int32_t acc = 1 << 14;
+    for (int k = 0; k < d->taps; k++) {
+        acc += (int32_t)d->coeffs[k] * x[k];
+    }
+    int32_t code = (acc >> 15) + ML_ADC_MIDSCALE;
+    if (code < ML_ADC_MIN) {
+        code = ML_ADC_MIN;
+    } else if (code > ML_ADC_MAX) {
+        code = ML_ADC_MAX;
+    }
+    return (uint16_t)code;
+}
+
+bool decimator_push(decimator_t *d, uint16_t code, uint16_t *out) {
+    int16_t x = (int16_t)((int32_t)code - ML_ADC_MIDSCALE);
+    if (!d->primed) {
+        // Hold the first input back through the whole history
+        for (int k = 0; k < 2 * d->taps; k++) {
+            d->history[k] = x;
+        }
+        d->primed = true;
+    }
+
+    // Newest first: history[pos + k] is the input k samples ago
+    d->pos = (d->pos == 0) ? d->taps - 1 : d->pos - 1;
+    d->history[d->pos] = x;
+    d->history[d->pos + d->taps] = x;
+
+    if (++d->phase < d->factor) {
+        return false;
+    }
+    d->phase = 0;
+    *out = filter_output(d);
+    return true;
+}
+
+int decimator_process(decimator_t *d, const uint16_t *codes, int num_codes, uint16_t *out) {
+    if (!d || !codes || !out) {
+        return 0;
+    }
+    int written = 0;
+    for (int i = 0; i < num_codes; i++) {
+        if (decimator_push(d, codes[i], &out[written])) {
+            written++;
+        }
+    }
+    return written;
+}
+
+float decimator_delay(const decimator_t *d) {
+    return d ? (d->taps - 1) / 2.0f : 0.0f;
+}
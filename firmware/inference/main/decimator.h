@@ -0,0 +1,93 @@
+#ifndef DECIMATOR_H
+#define DECIMATOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ml_contract.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DECIMATOR_MAX_FACTOR      8
+#define DECIMATOR_TAPS_PER_PHASE  16
+#define DECIMATOR_MAX_TAPS        (DECIMATOR_MAX_FACTOR * DECIMATOR_TAPS_PER_PHASE)
+
+/**
+ * @brief Decimating low-pass FIR for raw ADC codes
+ *
+ * Hamming-windowed sinc with DECIMATOR_TAPS_PER_PHASE taps per phase,
+ * cut off at 0.84 of the output Nyquist frequency, Q15 coefficients
+ * summing to exactly 1.0 so mid-scale stays mid-scale. The cutoff is the
+ * -6 dB point: the passband is already down about 3.5 dB at 0.8 of the
+ * output Nyquist frequency. Everything above 1.2x it is rejected by at
+ * least 54.4 dB at factor 2 and about 56 dB at factors 4 and 8, with the
+ * Q15 rounding included. Only the outputs
+ * that are kept get computed (the polyphase form): one multiply-accumulate
+ * per phase tap for each input code. Outputs are 12-bit codes again, so
+ * the gain from oversampling is the averaged-out ADC noise, not
+ * extra resolution.
+ */
+typedef struct {
+    int16_t coeffs[DECIMATOR_MAX_TAPS];        // Q15, coeffs[0] weights the newest input
+    int16_t history[2 * DECIMATOR_MAX_TAPS];   // Centred inputs, stored twice (no wrap)
+    int taps;
+    int factor;
+    int pos;                                   // Newest input in history
+    int phase;                                 // Inputs since the last output
+    bool primed;                               // History holds real inputs
+} decimator_t;
+
+/**
+ * @brief Design the filter for a decimation factor and clear its history
+ *
+ * @param d Decimator
+ * @param factor Input codes per output code (2..DECIMATOR_MAX_FACTOR)
+ * @return true on success
+ */
+bool decimator_init(decimator_t *d, int factor);
+
+/**
+ * @brief Forget the history (e.g. after a sampling gap)
+ *
+ * The next input fills the whole history, so the first outputs carry no
+ * start-up transient.
+ *
+ * @param d Decimator
+ */
+void decimator_reset(decimator_t *d);
+
+/**
+ * @brief Feed one input code
+ *
+ * @param d Decimator
+ * @param code Raw ADC code
+ * @param out Output code, written when one is due
+ * @return true every factor-th input, when *out is written
+ */
+bool decimator_push(decimator_t *d, uint16_t code, uint16_t *out);
+
+/**
+ * @brief Feed a block of input codes
+ *
+ * @param d Decimator
+ * @param codes Raw ADC codes, oldest first
+ * @param num_codes Number of input codes
+ * @param out Output codes (up to num_codes / factor + 1)
+ * @return int Output codes written
+ */
+int decimator_process(decimator_t *d, const uint16_t *codes, int num_codes, uint16_t *out);
+
+/**
+ * @brief Group delay of the filter
+ *
+ * @param d Decimator
+ * @return float Delay in input samples (linear phase, so for all frequencies)
+ */
+float decimator_delay(const decimator_t *d);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DECIMATOR_H */
@@ -0,0 +1,167 @@
+// degradation.c - Step down to cheaper models under sustained backlog
+#include "degradation.h"
+#include "adc_sampling.h"
+#include "model_registry.h"
+#include "ml_contract.h"
+#include "esp_log.h"
+#include <string.h>
+
+#ifdef CONFIG_INFERENCE_DEGRADATION
+
+static const char *TAG = "DEGRADATION";
+
+#define EPOCH_WINDOWS       CONFIG_INFERENCE_DEGRADATION_EPOCH
+#define BACKLOG_PCT         CONFIG_INFERENCE_DEGRADATION_BACKLOG_PCT
+#define HEADROOM_PCT        CONFIG_INFERENCE_DEGRADATION_HEADROOM_PCT
+#define RECOVER_EPOCHS      CONFIG_INFERENCE_DEGRADATION_RECOVER_EPOCHS
+#define MAX_HOLD_EPOCHS     (RECOVER_EPOCHS << 6)
+#define PROBATION_EPOCHS    RECOVER_EPOCHS  // A retried tier failing this soon backs off
+
+// Below one queued window on average: the consumer keeps up
+#define IDLE_UTILIZATION    (100 / CONFIG_ADC_WINDOW_POOL_DEPTH)
+
+static const model_type_t s_ladder[] = {
+    MODEL_CNN_FLOAT32, MODEL_CNN_INT8, MODEL_MLP_INT8, MODEL_NONE,
+};
+#define LADDER_LENGTH (sizeof(s_ladder) / sizeof(s_ladder[0]))
+
+static const char *tier_name(model_type_t type)
+{
+    const model_registry_entry_t *entry = model_registry_get(type);
+    return entry ? entry->name : "heuristic";
+}
+
+static uint32_t drops_now(void)
+{
+    return adc_window_overruns() + adc_sampling_pool_overflows();
+}
+
+static void start_epoch(degradation_t *d)
+{
+    d->windows = 0;
+    d->busy_us = 0;
+    d->utilization_sum = 0;
+    d->drops_seen = drops_now();
+}
+
+bool degradation_init(degradation_t *d, inference_engine_t *engine)
+{
+    memset(d, 0, sizeof(degradation_t));
+    d->budget_us = (uint32_t)((uint64_t)CONFIG_ADC_WINDOW_HOP * 1000000ULL / ML_SAMPLE_RATE_HZ);
+    if (!engine || !engine->initialized || engine->config.mode != INFERENCE_MODE_TFLITE) {
+        return false;
+    }
+
+    // Enter the ladder at the configured model, or just above MLP_INT8
+    model_type_t top = engine->config.model_type;
+    uint32_t first = 2;
+    for (uint32_t i = 0; i < LADDER_LENGTH; i++) {
+        if (s_ladder[i] == top) {
+            first = i + 1;
+        }
+    }
+    d->tiers[d->tier_count++] = top;
+    for (uint32_t i = first; i < LADDER_LENGTH && d->tier_count < DEGRADATION_MAX_TIERS; i++) {
+        if (s_ladder[i] != MODEL_NONE && !inference_preload_model(engine, s_ladder[i])) {
+            continue;
+        }
+        d->tiers[d->tier_count++] = s_ladder[i];
+    }
+    for (uint32_t i = 0; i < d->tier_count; i++) {
+        d->hold_epochs[i] = RECOVER_EPOCHS;
+    }
+    start_epoch(d);
+
+    ESP_LOGI(TAG, "%u tiers from %s, budget %u us per window",
+             (unsigned)d->tier_count, tier_name(top), (unsigned)d->budget_us);
+    return d->tier_count > 1;
+}
+
+static bool switch_tier(degradation_t *d, inference_engine_t *engine, uint32_t tier)
+{
+    if (!inference_switch_model(engine, d->tiers[tier])) {
+        ESP_LOGE(TAG, "Failed to switch to %s", tier_name(d->tiers[tier]));
+        return false;
+    }
+    d->tier = tier;
+    d->clean_epochs = 0;
+    d->epochs_in_tier = 0;
+
+    // Producer preprocessing follows the new model
+    preprocess_format_t format;
+    if (inference_input_format(engine, &format)) {
+        adc_window_set_input_format(&format);
+    }
+    return true;
+}
+
+bool degradation_update(degradation_t *d, inference_engine_t *engine, uint32_t busy_us)
+{
+    if (d->tier_count < 2) {
+        return false;
+    }
+
+    d->windows++;
+    d->busy_us += busy_us;
+    d->utilization_sum += adc_window_utilization();
+    if (d->windows < EPOCH_WINDOWS) {
+        return false;
+    }
+
+    uint32_t drops = drops_now() - d->drops_seen;
+    uint32_t utilization = d->utilization_sum / d->windows;
+    uint32_t busy_avg = (uint32_t)(d->busy_us / d->windows);
+    start_epoch(d);
+    d->epochs_in_tier++;
+
+    bool changed = false;
+    if (drops > 0 || utilization > BACKLOG_PCT) {
+        if (d->tier + 1 < d->tier_count) {
+            // A retried tier that fails straight away waits longer next time
+            if (d->retrying && d->epochs_in_tier <= PROBATION_EPOCHS &&
+                d->hold_epochs[d->tier] < MAX_HOLD_EPOCHS) {
+                d->hold_epochs[d->tier] *= 2;
+            }
+            ESP_LOGW(TAG, "Backlog (%u dropped, ring %u%%, %u us/window): %s -> %s",
+                     (unsigned)drops, (unsigned)utilization, (unsigned)busy_avg,
+                     tier_name(d->tiers[d->tier]), tier_name(d->tiers[d->tier + 1]));
+            changed = switch_tier(d, engine, d->tier + 1);
+            if (changed) {
+                d->step_downs++;
+                d->retrying = false;
+            }
+        }
+        d->clean_epochs = 0;
+        return changed;
+    }
+
+    // A tier that outlives its probation is trusted again
+    if (d->retrying && d->epochs_in_tier > PROBATION_EPOCHS) {
+        d->hold_epochs[d->tier] = RECOVER_EPOCHS;
+    }
+
+    if (utilization < IDLE_UTILIZATION && busy_avg * 100 < d->budget_us * HEADROOM_PCT) {
+        d->clean_epochs++;
+    } else {
+        d->clean_epochs = 0;
+    }
+
+    if (d->tier > 0 && d->clean_epochs >= d->hold_epochs[d->tier - 1]) {
+        ESP_LOGI(TAG, "Headroom (%u us/window of %u): %s -> %s",
+                 (unsigned)busy_avg, (unsigned)d->budget_us,
+                 tier_name(d->tiers[d->tier]), tier_name(d->tiers[d->tier - 1]));
+        changed = switch_tier(d, engine, d->tier - 1);
+        if (changed) {
+            d->step_ups++;
+            d->retrying = true;
+        }
+    }
+    return changed;
+}
+
+void degradation_restart_epoch(degradation_t *d)
+{
+    start_epoch(d);
+}
+
+#endif /* CONFIG_INFERENCE_DEGRADATION */
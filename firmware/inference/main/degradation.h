@@ -0,0 +1,82 @@
+#ifndef DEGRADATION_H
+#define DEGRADATION_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "inference.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Models the policy steps through, most expensive first
+#define DEGRADATION_MAX_TIERS 4
+
+// Backlog-driven model degradation (CONFIG_INFERENCE_DEGRADATION)
+typedef struct {
+    model_type_t tiers[DEGRADATION_MAX_TIERS]; // MODEL_NONE = heuristic
+    uint32_t tier_count;
+    uint32_t tier;                 // Index of the running tier
+    uint32_t hold_epochs[DEGRADATION_MAX_TIERS]; // Clean epochs before retrying a tier
+    uint32_t clean_epochs;         // Consecutive epochs with headroom
+    uint32_t epochs_in_tier;
+    bool retrying;                 // Running tier was entered by a step up
+
+    // Current epoch
+    uint32_t windows;
+    uint64_t busy_us;
+    uint32_t utilization_sum;
+    uint32_t drops_seen;           // Ring overruns + pool overflows at epoch start
+
+    uint32_t budget_us;            // One hop of samples
+    uint32_t step_downs;
+    uint32_t step_ups;
+} degradation_t;
+
+/**
+ * @brief Build the ladder below the engine's model and preload its sessions
+ *
+ * The ladder is CNN_F32 -> CNN_INT8 -> MLP_INT8 -> heuristic, entered at
+ * the configured model (other models enter above MLP_INT8). Sessions are
+ * built now, so a step down never waits for an interpreter; tiers that
+ * fail to build are left out. Only TFLite engines degrade.
+ *
+ * @param d Policy state
+ * @param engine Initialized inference engine
+ * @return true if there is anything to step down to
+ */
+bool degradation_init(degradation_t *d, inference_engine_t *engine);
+
+/**
+ * @brief Account one processed window and apply the policy (consumer only)
+ *
+ * Every CONFIG_INFERENCE_DEGRADATION_EPOCH windows the epoch is judged:
+ * any dropped window or pool overflow, or a ring occupancy above
+ * CONFIG_INFERENCE_DEGRADATION_BACKLOG_PCT, steps one tier down at once.
+ * An empty ring with the consumer busy for less than
+ * CONFIG_INFERENCE_DEGRADATION_HEADROOM_PCT of a hop is headroom; after
+ * enough such epochs the tier above is retried. Every retry that fails
+ * doubles the epochs needed before the next one.
+ *
+ * @param d Policy state
+ * @param engine Inference engine to switch
+ * @param busy_us Time the consumer spent on this window
+ * @return true if the model changed (the producer's input format is updated)
+ */
+bool degradation_update(degradation_t *d, inference_engine_t *engine, uint32_t busy_us);
+
+/**
+ * @brief Discard the current epoch after a deliberate stall
+ *
+ * Windows dropped while the consumer was busy with something planned,
+ * such as a benchmark batch, say nothing about the model.
+ *
+ * @param d Policy state
+ */
+void degradation_restart_epoch(degradation_t *d);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DEGRADATION_H */
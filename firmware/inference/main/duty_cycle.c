@@ -0,0 +1,222 @@
+// duty_cycle.c - Burst acquisition with light sleep between decisions
+#include "duty_cycle.h"
+#include "adc_sampling.h"
+#include "system_monitor.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_pm.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include <string.h>
+
+#ifdef CONFIG_DUTY_CYCLE_ENABLE
+
+static const char *TAG = "DUTY_CYCLE";
+
+#define DECISION_TIMEOUT_MS     1000    // Decision window dropped as an overrun
+#define STATS_LOG_INTERVAL      32      // Decisions between statistics lines
+
+typedef struct {
+    ml_class_t cls;
+    float confidence;
+} decision_t;
+
+static QueueHandle_t s_decision_queue = NULL;
+static esp_pm_lock_handle_t s_burst_lock = NULL;
+
+// Written by the ADC task, read by anyone under the lock
+static duty_cycle_stats_t s_stats;
+static float s_energy_uj = 0.0f;
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+esp_err_t duty_cycle_init(void)
+{
+    if (!s_decision_queue) {
+        s_decision_queue = xQueueCreate(1, sizeof(decision_t));
+        if (!s_decision_queue) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    s_stats.period_ms = CONFIG_DUTY_CYCLE_MIN_PERIOD_MS;
+
+#ifdef CONFIG_PM_ENABLE
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = CONFIG_DUTY_CYCLE_MIN_CPU_MHZ,
+#ifdef CONFIG_FREERTOS_USE_TICKLESS_IDLE
+        .light_sleep_enable = true,
+#endif
+    };
+    esp_err_t ret = esp_pm_configure(&pm_config);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Power management not configured: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    // Bursts run at full speed; DFS only lowers the clock between them
+    ret = esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "duty_burst", &s_burst_lock);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "No burst PM lock: %s", esp_err_to_name(ret));
+    }
+
+#ifdef CONFIG_FREERTOS_USE_TICKLESS_IDLE
+    s_stats.light_sleep = true;
+#endif
+    ESP_LOGI(TAG, "DFS %d-%d MHz, light sleep %s; %d windows per decision every %d-%d ms",
+             CONFIG_DUTY_CYCLE_MIN_CPU_MHZ, CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+             s_stats.light_sleep ? "on" : "off (enable FREERTOS_USE_TICKLESS_IDLE)",
+             CONFIG_DUTY_CYCLE_BURST_WINDOWS, CONFIG_DUTY_CYCLE_MIN_PERIOD_MS,
+             CONFIG_DUTY_CYCLE_MAX_PERIOD_MS);
+    return s_stats.light_sleep ? ESP_OK : ESP_ERR_NOT_SUPPORTED;
+#else
+    ESP_LOGW(TAG, "PM_ENABLE is off: idling between bursts without light sleep");
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+static void record_cycle(uint32_t period_ms, bool decided, int64_t awake_us, int64_t asleep_us)
+{
+    // Awake time is charged at full power: the CPU and ADC are both on
+    float sleep_mw = s_stats.light_sleep ? CONFIG_POWER_LIGHT_SLEEP_UW / 1000.0f
+                                         : (float)CONFIG_POWER_IDLE_MW;
+    float energy_uj = METRICS_ENERGY_UJ(CONFIG_POWER_ACTIVE_MW, awake_us) +
+                      METRICS_ENERGY_UJ(sleep_mw, asleep_us);
+
+    portENTER_CRITICAL(&s_stats_lock);
+    s_stats.period_ms = period_ms;
+    if (decided) {
+        s_stats.decisions++;
+    } else {
+        s_stats.missed_decisions++;
+    }
+    s_stats.awake_us += awake_us;
+    s_stats.asleep_us += asleep_us;
+    s_energy_uj += energy_uj;
+    portEXIT_CRITICAL(&s_stats_lock);
+}
+
+void duty_cycle_run(adc_continuous_handle_t handle)
+{
+    ml_class_t last_cls = ML_CLASS_UNKNOWN;
+    bool last_gated = false;
+    uint32_t period_ms = CONFIG_DUTY_CYCLE_MIN_PERIOD_MS;
+    TickType_t wake = xTaskGetTickCount();
+
+    if (!s_decision_queue) {
+        ESP_LOGE(TAG, "Not initialized, sampling continuously");
+        return;
+    }
+    // adc_sampling_init() leaves the ADC running
+    adc_sampling_pause(handle);
+
+    while (1) {
+        int64_t burst_start = esp_timer_get_time();
+        if (s_burst_lock) {
+            esp_pm_lock_acquire(s_burst_lock);
+        }
+        xQueueReset(s_decision_queue);
+
+        // No ADC interval metrics: they would include the sleep
+        bool decision_submitted = false;
+        bool gated = false;           // The signal gate rejected the decision window
+        if (adc_sampling_resume(handle) == ESP_OK) {
+            // Every input gets the burst; input 0's last window decides
+            int decision_countdown = CONFIG_DUTY_CYCLE_BURST_WINDOWS;
+            for (int i = 0; i < CONFIG_DUTY_CYCLE_BURST_WINDOWS * ADC_STREAM_COUNT; i++) {
+                adc_window_t *window = adc_window_fill(handle);
+                if (!window) {
+                    break;
+                }
+                bool last = (window->channel == 0 && --decision_countdown == 0);
+                if (last) {
+                    window->flags |= ADC_WINDOW_FLAG_DECISION;
+                }
+                bool submitted = adc_window_submit(window);
+                if (last) {
+                    decision_submitted = submitted;
+                    gated = (window->flags & ADC_WINDOW_FLAG_REJECTED) != 0;
+                }
+            }
+            adc_sampling_pause(handle);
+        }
+
+        // No signal is a decision too, taken without the inference task
+        decision_t decision = { .cls = ML_CLASS_UNKNOWN, .confidence = 0.0f };
+        bool decided = gated ||
+                       (decision_submitted &&
+                        xQueueReceive(s_decision_queue, &decision,
+                                      pdMS_TO_TICKS(DECISION_TIMEOUT_MS)) == pdTRUE);
+        if (s_burst_lock) {
+            esp_pm_lock_release(s_burst_lock);
+        }
+        int64_t awake_us = esp_timer_get_time() - burst_start;
+
+        // Back off while the signal (or its absence) stays put, react at once when it changes
+        bool confident = (gated && last_gated) ||
+                         (decided && decision.cls != ML_CLASS_UNKNOWN && decision.cls == last_cls &&
+                          decision.confidence * 100.0f >= CONFIG_DUTY_CYCLE_CONFIDENT_PCT);
+        if (confident) {
+            period_ms *= 2;
+            if (period_ms > CONFIG_DUTY_CYCLE_MAX_PERIOD_MS) {
+                period_ms = CONFIG_DUTY_CYCLE_MAX_PERIOD_MS;
+            }
+        } else {
+            period_ms = CONFIG_DUTY_CYCLE_MIN_PERIOD_MS;
+        }
+        last_cls = decided ? decision.cls : ML_CLASS_UNKNOWN;
+        last_gated = gated;
+
+        // Idle until the deadline: tickless idle enters light sleep here
+        int64_t sleep_start = esp_timer_get_time();
+        if (xTaskDelayUntil(&wake, pdMS_TO_TICKS(period_ms)) == pdFALSE) {
+            // Burst overran the period: start the schedule again from now
+            wake = xTaskGetTickCount();
+        }
+        record_cycle(period_ms, decided, awake_us, esp_timer_get_time() - sleep_start);
+
+        if (decided && s_stats.decisions % STATS_LOG_INTERVAL == 0) {
+            duty_cycle_stats_t stats;
+            duty_cycle_get_stats(&stats);
+            uint64_t total_us = stats.awake_us + stats.asleep_us;
+            ESP_LOGI(TAG, "%u decisions (%u missed), period %u ms, awake %.1f%%, "
+                     "%.1f uJ/decision, %.2f mW average",
+                     (unsigned)stats.decisions, (unsigned)stats.missed_decisions,
+                     (unsigned)stats.period_ms,
+                     total_us ? 100.0f * stats.awake_us / total_us : 0.0f,
+                     stats.energy_uj_per_decision, stats.average_power_mw);
+        }
+    }
+}
+
+void duty_cycle_report_decision(ml_class_t cls, float confidence)
+{
+    if (!s_decision_queue) {
+        return;
+    }
+    decision_t decision = {
+        .cls = cls,
+        .confidence = confidence,
+    };
+    xQueueOverwrite(s_decision_queue, &decision);
+}
+
+void duty_cycle_get_stats(duty_cycle_stats_t *stats)
+{
+    if (!stats) {
+        return;
+    }
+
+    portENTER_CRITICAL(&s_stats_lock);
+    *stats = s_stats;
+    float energy_uj = s_energy_uj;
+    portEXIT_CRITICAL(&s_stats_lock);
+
+    uint32_t cycles = stats->decisions + stats->missed_decisions;
+    uint64_t total_us = stats->awake_us + stats->asleep_us;
+    stats->energy_uj_per_decision = cycles ? energy_uj / cycles : 0.0f;
+    // uJ per us is W
+    stats->average_power_mw = total_us ? energy_uj * 1000.0f / total_us : 0.0f;
+}
+
+#endif /* CONFIG_DUTY_CYCLE_ENABLE */
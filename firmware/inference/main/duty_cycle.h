@@ -0,0 +1,68 @@
+#ifndef DUTY_CYCLE_H
+#define DUTY_CYCLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_adc/adc_continuous.h"
+#include "ml_contract.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Duty-cycle statistics since boot
+typedef struct {
+    uint32_t decisions;
+    uint32_t period_ms;           // Current decision period
+    uint32_t missed_decisions;    // Bursts whose decision never arrived
+    uint64_t awake_us;            // Acquisition and inference
+    uint64_t asleep_us;           // Between bursts (light sleep if enabled)
+    float energy_uj_per_decision; // Estimate from CONFIG_POWER_* figures
+    float average_power_mw;
+    bool light_sleep;             // Automatic light sleep is configured
+} duty_cycle_stats_t;
+
+/**
+ * @brief Configure DFS and automatic light sleep (CONFIG_DUTY_CYCLE_ENABLE)
+ *
+ * Light sleep needs CONFIG_PM_ENABLE and CONFIG_FREERTOS_USE_TICKLESS_IDLE;
+ * without them bursts still run, but the chip only idles between them.
+ *
+ * @return esp_err_t ESP_OK if light sleep is enabled
+ */
+esp_err_t duty_cycle_init(void);
+
+/**
+ * @brief Acquisition loop of the ADC task in duty-cycle mode
+ *
+ * Resumes the ADC, submits CONFIG_DUTY_CYCLE_BURST_WINDOWS windows (the
+ * last flagged ADC_WINDOW_FLAG_DECISION), pauses it and waits for the
+ * decision, then sleeps until the next deadline. Confident repeats of
+ * the same class double the period up to the maximum; anything else
+ * returns it to the minimum. Returns only if duty_cycle_init() failed.
+ *
+ * @param handle ADC handle from adc_sampling_init()
+ */
+void duty_cycle_run(adc_continuous_handle_t handle);
+
+/**
+ * @brief Report the result of a burst's decision window (inference task)
+ *
+ * @param cls Decided class (ML_CLASS_UNKNOWN if inference failed)
+ * @param confidence Decided (voted) confidence
+ */
+void duty_cycle_report_decision(ml_class_t cls, float confidence);
+
+/**
+ * @brief Get duty-cycle statistics
+ *
+ * @param stats Output statistics
+ */
+void duty_cycle_get_stats(duty_cycle_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DUTY_CYCLE_H */
@@ -0,0 +1,58 @@
+"""
+Generate the output class map of the trained models (run by
+main/CMakeLists.txt at build time).
+
+The training notebook label-encodes the class names, so model output k is
+the k-th name of training_summary.json's dataset.classes (alphabetical),
+not ml_class_t k. Writes class_map.c with ml_trained_class_map
+(ml_contract.h), used for compiled-in models and for model store entries
+without a map of their own. gen_model_store.py maps names the same way.
+"""
+import argparse
+import json
+
+# ml_class_t order (ml_contract.h)
+CLASSES = ['SINE', 'SQUARE', 'TRIANGLE', 'SAWTOOTH', 'NOISE']
+CLASS_UNKNOWN = -1
+MAX_OUTPUTS = 8     # ML_MAX_MODEL_OUTPUTS
+
+
+def read_labels(summary_path):
+    with open(summary_path) as f:
+        labels = json.load(f)['dataset']['classes']
+    if not labels or len(labels) > MAX_OUTPUTS:
+        raise SystemExit('%s: %d classes, the firmware maps 1..%d'
+                         % (summary_path, len(labels), MAX_OUTPUTS))
+    return labels
+
+
+def class_map(labels):
+    """ml_class_t of each output; labels without a class are dropped on the device"""
+    return [CLASSES.index(name.upper()) if name.upper() in CLASSES else CLASS_UNKNOWN
+            for name in labels]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--summary', required=True, help='training_summary.json')
+    parser.add_argument('--output', required=True, help='Generated C file')
+    args = parser.parse_args()
+
+    labels = read_labels(args.summary)
+    classes = class_map(labels)
+    for name, cls in zip(labels, classes):
+        if cls == CLASS_UNKNOWN:
+            print('gen_class_map: no ml_class_t for "%s", its output is ignored' % name)
+
+    with open(args.output, 'w') as f:
+        f.write('// Generated by gen_class_map.py - do not edit\n')
+        f.write('#include "ml_contract.h"\n\n')
+        f.write('// Outputs: %s\n' % ', '.join(labels))
+        f.write('const ml_class_map_t ml_trained_class_map = {\n')
+        f.write('    .count = %d,\n' % len(classes))
+        f.write('    .classes = { %s },\n' % ', '.join(str(c) for c in classes))
+        f.write('};\n')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,69 @@
+"""
+Convert .tflite models into the C arrays in arrays/ (run by hand after
+training; the output is checked in).
+
+Same layout as `xxd -i`, but the array is const and carries
+MODEL_DATA_ATTR from model_data.h: 16-byte aligned for TFLite Micro and
+grouped in their own flash rodata section.
+
+    python main/gen_model_arrays.py --models models --output arrays
+"""
+import argparse
+import os
+
+HEADER = '''#ifndef {guard}
+#define {guard}
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {{
+#endif
+
+extern const unsigned char {name}[];
+extern const unsigned int {name}_len;
+
+#ifdef __cplusplus
+}}
+#endif
+
+#endif  // {guard}'''
+
+
+def c_array(name, data, per_row=12):
+    rows = []
+    for i in range(0, len(data), per_row):
+        rows.append('  ' + ', '.join('0x%02x' % b for b in data[i:i + per_row]))
+    return ',\n'.join(rows)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--models', required=True, help='Directory of .tflite files')
+    parser.add_argument('--output', required=True, help='Directory for the .c/.h pairs')
+    args = parser.parse_args()
+
+    for filename in sorted(os.listdir(args.models)):
+        stem, ext = os.path.splitext(filename)
+        if ext != '.tflite':
+            continue
+        with open(os.path.join(args.models, filename), 'rb') as f:
+            data = f.read()
+        name = stem + '_tflite'
+
+        with open(os.path.join(args.output, stem + '.c'), 'w') as f:
+            f.write('#include "model_data.h"\n')
+            f.write('#include "%s.h"\n\n' % stem)
+            f.write('const unsigned char %s[] MODEL_DATA_ATTR = {\n' % name)
+            f.write(c_array(name, data))
+            f.write('\n};\n')
+            f.write('const unsigned int %s_len = %d;\n' % (name, len(data)))
+        header = os.path.join(args.output, stem + '.h')
+        if not os.path.exists(header):
+            with open(header, 'w') as f:
+                f.write(HEADER.format(guard=stem.upper() + '_H_', name=name) + '\n')
+        print('%s: %d bytes' % (name, len(data)))
+
+
+if __name__ == '__main__':
+    main()
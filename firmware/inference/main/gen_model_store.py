@@ -0,0 +1,115 @@
+"""
+Pack .tflite models into a model store image (run by main/CMakeLists.txt
+with CONFIG_MODEL_STORE_PARTITION, or by hand for an update).
+
+The layout is documented in model_store.h. The image is flashed to the
+first model slot by `idf.py flash`; for an update, stream it through
+model_store_ota_*() or write it to the other slot with
+`parttool.py write_partition --partition-name models1 --input models.bin`
+after raising --generation above the running image's.
+
+Each entry carries the model's output class map, from the label order in
+training_summary.json (--summary, by default the one next to the models),
+so a model trained on other classes or another order needs no new
+firmware.
+"""
+import argparse
+import os
+import struct
+import zlib
+
+from gen_class_map import MAX_OUTPUTS, class_map, read_labels
+
+MAGIC = 0x534C444D  # "MDLS"
+VERSION = 2
+ALIGN = 16
+MAX_MODELS = 8
+FLAG_INT8 = 0x01
+
+HEADER = struct.Struct('<IHHII')        # model_store_header_t
+ENTRY = struct.Struct('<BBBBIIII12s%db' % MAX_OUTPUTS)   # model_store_entry_t
+
+# model_type_t values, registry names and the file each is trained into
+MODELS = [
+    (0, 'CNN_F32', 'cnn_float32_model.tflite', False),
+    (1, 'CNN_INT8', 'cnn_int8_model.tflite', True),
+    (2, 'MLP_F32', 'mlp_float32_model.tflite', False),
+    (3, 'MLP_INT8', 'mlp_int8_model.tflite', True),
+    (4, 'HYBRID_F32', 'hybrid_float32_model.tflite', False),
+    (5, 'HYBRID_INT8', 'hybrid_int8_model.tflite', True),
+]
+
+
+def align(n):
+    return (n + ALIGN - 1) & ~(ALIGN - 1)
+
+
+def parse_arena(values):
+    arenas = {}
+    for value in values:
+        name, _, size = value.partition('=')
+        arenas[name.upper()] = int(size, 0)
+    return arenas
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--models', required=True, help='Directory of .tflite files')
+    parser.add_argument('--output', required=True, help='Store image')
+    parser.add_argument('--summary',
+                        help='training_summary.json with the class order (default: in --models)')
+    parser.add_argument('--only', nargs='*', default=None,
+                        help='Registry names to pack (default: every model found)')
+    parser.add_argument('--arena', action='append', default=[], metavar='NAME=BYTES',
+                        help='Arena hint, skips on-device calibration')
+    parser.add_argument('--generation', type=int, default=1,
+                        help='Slot generation; the highest valid one is loaded')
+    parser.add_argument('--max-size', type=lambda v: int(v, 0), default=0,
+                        help='Fail if the image exceeds this (the slot size)')
+    args = parser.parse_args()
+
+    classes = class_map(read_labels(args.summary or
+                                    os.path.join(args.models, 'training_summary.json')))
+    padded = classes + [0] * (MAX_OUTPUTS - len(classes))
+
+    arenas = parse_arena(args.arena)
+    wanted = [n.upper() for n in args.only] if args.only is not None else None
+    models = []
+    for model_type, name, filename, is_int8 in MODELS:
+        path = os.path.join(args.models, filename)
+        if (wanted is not None and name not in wanted) or not os.path.exists(path):
+            continue
+        with open(path, 'rb') as f:
+            models.append((model_type, name, f.read(), is_int8))
+    if not models:
+        parser.error('no models found in %s' % args.models)
+    if len(models) > MAX_MODELS:
+        parser.error('at most %d models per image' % MAX_MODELS)
+
+    offset = align(HEADER.size + ENTRY.size * len(models))
+    entries = b''
+    blobs = []
+    for model_type, name, data, is_int8 in models:
+        entries += ENTRY.pack(model_type, FLAG_INT8 if is_int8 else 0, len(classes), 0, offset,
+                              len(data), arenas.get(name, 0), zlib.crc32(data), name.encode(),
+                              *padded)
+        blobs.append((offset, data))
+        offset = align(offset + len(data))
+
+    image = bytearray(offset)
+    image[:HEADER.size] = HEADER.pack(MAGIC, VERSION, len(models), args.generation,
+                                      zlib.crc32(entries))
+    image[HEADER.size:HEADER.size + len(entries)] = entries
+    for start, data in blobs:
+        image[start:start + len(data)] = data
+
+    if args.max_size and len(image) > args.max_size:
+        parser.error('image is %d bytes, slot holds %d' % (len(image), args.max_size))
+    with open(args.output, 'wb') as f:
+        f.write(image)
+    print('Model store: %d models, %d bytes, generation %d'
+          % (len(models), len(image), args.generation))
+
+
+if __name__ == '__main__':
+    main()
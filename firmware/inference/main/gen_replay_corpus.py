@@ -0,0 +1,160 @@
+"""
+Generate the fixed window corpus replayed by the benchmark firmware mode
+(run by main/CMakeLists.txt at build time when BENCHMARK_REPLAY_MODE is set).
+
+Writes replay_corpus.c with the raw ADC codes and labels declared in
+benchmark_replay.h, plus the test accuracy of each model family from
+training_summary.json. The corpus is either windows from an SD capture
+(rec_NNNN.bin, data_collection.h format v2) or a synthetic,
+seeded set shaped like the generator's DAC output, so every build
+replays exactly the same inputs.
+"""
+import argparse
+import json
+import math
+import os
+import random
+import struct
+
+# ml_class_t order (ml_contract.h)
+CLASSES = ['SINE', 'SQUARE', 'TRIANGLE', 'SAWTOOTH']
+
+# model_type_t order (benchmark.h) -> training_summary.json key
+MODEL_ACCURACY_KEYS = ['cnn_accuracy', 'cnn_accuracy', 'mlp_accuracy', 'mlp_accuracy',
+                       'hybrid_accuracy', 'hybrid_accuracy']
+
+SEED = 20240601
+TABLE_SIZE = 256    # Generator LUT length: one period per 256 samples at 20 kHz
+
+
+def generator_lut(cls, i):
+    """8-bit DAC value of the generator's waveform tables (waveform_tables.c)"""
+    if cls == 0:
+        return int(127.0 + 127.0 * math.sin(2.0 * math.pi * i / TABLE_SIZE))
+    if cls == 1:
+        return 255 if i < TABLE_SIZE // 2 else 0
+    if cls == 2:
+        if i < TABLE_SIZE // 2:
+            return int(2.0 * 255.0 * i / TABLE_SIZE)
+        return int(255.0 - 2.0 * 255.0 * (i - TABLE_SIZE // 2) / TABLE_SIZE)
+    return int(255.0 * i / (TABLE_SIZE - 1))
+
+
+def synthetic_corpus(size, count):
+    """Balanced classes with random phase, gain, offset and noise"""
+    rng = random.Random(SEED)
+    windows = []
+    for w in range(count):
+        cls = w % len(CLASSES)
+        phase = rng.randrange(TABLE_SIZE)
+        gain = rng.uniform(0.85, 1.0)
+        offset = rng.uniform(-40.0, 40.0)
+        codes = []
+        for i in range(size):
+            dac = generator_lut(cls, (i + phase) % TABLE_SIZE)
+            code = 2048 + (dac - 127.5) * 16.0 * gain + offset + rng.gauss(0.0, 6.0)
+            codes.append(min(max(int(round(code)), 0), 4095))
+        windows.append((cls, codes))
+    return windows, 'synthetic seed %d' % SEED
+
+
+def decode_record(data, offset):
+    magic, count, _, _, _, label, flags, encoding, bits, length = \
+        struct.unpack_from('<HHIqqbBBBH', data, offset)
+    payload = data[offset + 30:offset + 30 + length]
+    if encoding == 1:
+        codes = [payload[0] | (payload[1] << 8)]
+        acc = int.from_bytes(payload[2:], 'little')
+        mask = (1 << bits) - 1
+        for i in range(count - 1):
+            z = (acc >> (i * bits)) & mask
+            codes.append(codes[-1] + ((z >> 1) ^ -(z & 1)))
+    else:
+        codes = []
+        for i in range(0, count, 2):
+            b0, b1 = payload[i // 2 * 3], payload[i // 2 * 3 + 1]
+            codes.append(b0 | ((b1 & 0x0F) << 8))
+            if i + 1 < count:
+                codes.append((b1 >> 4) | (payload[i // 2 * 3 + 2] << 4))
+    return label, flags, codes
+
+
+def capture_corpus(path, size, count):
+    """Labeled, non-transition windows of the configured size from a capture"""
+    with open(path, 'rb') as f:
+        data = f.read()
+    magic, version, header_size, block_size = struct.unpack_from('<IHHI', data, 0)
+    if magic != 0x31434557 or version != 2:
+        raise SystemExit('%s: not a version 2 capture' % path)
+
+    trailer_magic, index_offset = struct.unpack_from('<II', data, len(data) - 8)
+    if trailer_magic == 0x444E4557:
+        _, records = struct.unpack_from('<II', data, index_offset)
+        offsets = struct.unpack_from('<%dI' % records, data, index_offset + 8)
+    else:
+        offsets = []
+        for block in range(header_size, len(data) - block_size + 1, block_size):
+            pos = block
+            while pos + 30 <= block + block_size:
+                rmagic, = struct.unpack_from('<H', data, pos)
+                if rmagic != 0x5752:
+                    break
+                offsets.append(pos)
+                pos += 30 + struct.unpack_from('<H', data, pos + 28)[0]
+
+    windows = []
+    for offset in offsets:
+        label, flags, codes = decode_record(data, offset)
+        if 0 <= label < len(CLASSES) and not flags & 0x01 and len(codes) == size:
+            windows.append((label, codes))
+            if len(windows) == count:
+                break
+    if not windows:
+        raise SystemExit('%s: no labeled %d-sample windows' % (path, size))
+    return windows, 'capture %s' % os.path.basename(path)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--size', type=int, required=True, help='Window size (samples)')
+    parser.add_argument('--windows', type=int, required=True, help='Windows in the corpus')
+    parser.add_argument('--summary', required=True, help='training_summary.json')
+    parser.add_argument('--capture', default='', help='SD capture to take windows from')
+    parser.add_argument('--output', required=True, help='Generated C file')
+    args = parser.parse_args()
+
+    if args.capture:
+        windows, source = capture_corpus(args.capture, args.size, args.windows)
+    else:
+        windows, source = synthetic_corpus(args.size, args.windows)
+
+    with open(args.summary) as f:
+        performance = json.load(f).get('model_performance', {})
+    reference = [float(performance.get(key, -1.0)) for key in MODEL_ACCURACY_KEYS]
+
+    with open(args.output, 'w') as f:
+        f.write('// Generated by gen_replay_corpus.py - do not edit\n')
+        f.write('#include "benchmark_replay.h"\n\n')
+        f.write('_Static_assert(ML_WINDOW_SIZE == %d, "replay corpus generated for another size");\n'
+                % args.size)
+        f.write('_Static_assert(MODEL_TYPE_COUNT == %d, "reference accuracies out of date");\n\n'
+                % len(reference))
+        f.write('const char replay_corpus_source[] = "%s";\n' % source)
+        f.write('const uint32_t replay_corpus_windows = %d;\n\n' % len(windows))
+        f.write('const float replay_reference_accuracy[MODEL_TYPE_COUNT] = {\n    %s\n};\n\n'
+                % ', '.join('%.6ff' % a for a in reference))
+        f.write('const int8_t replay_corpus_labels[] = {\n')
+        for i in range(0, len(windows), 16):
+            f.write('    ' + ', '.join(str(cls) for cls, _ in windows[i:i + 16]) + ',\n')
+        f.write('};\n\n')
+        f.write('const uint16_t replay_corpus_codes[][ML_WINDOW_SIZE] = {\n')
+        for _, codes in windows:
+            f.write('    {\n')
+            for i in range(0, len(codes), 16):
+                f.write('        ' + ', '.join('%4d' % c for c in codes[i:i + 16]) + ',\n')
+            f.write('    },\n')
+        f.write('};\n')
+
+
+if __name__ == '__main__':
+    main()
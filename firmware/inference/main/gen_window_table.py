@@ -0,0 +1,63 @@
+"""
+Generate the preprocessing window coefficient tables for the configured
+window size (run by main/CMakeLists.txt at build time).
+
+Writes window_table.c with the float and Q15 coefficients declared in
+window_table.h, so no cosf() runs on the device for ML_WINDOW_SIZE.
+"""
+import argparse
+import math
+import struct
+
+WINDOWS = {
+    # Symmetric (periodic=False) forms, w[0] = w[n-1]
+    'hann': lambda i, n: 0.5 - 0.5 * math.cos(2 * math.pi * i / (n - 1)),
+    'hamming': lambda i, n: 0.54 - 0.46 * math.cos(2 * math.pi * i / (n - 1)),
+    'blackman': lambda i, n: (0.42 - 0.5 * math.cos(2 * math.pi * i / (n - 1))
+                              + 0.08 * math.cos(4 * math.pi * i / (n - 1))),
+}
+
+
+def float32(x):
+    """Round through single precision so the table matches the device math."""
+    return struct.unpack('f', struct.pack('f', x))[0]
+
+
+def format_rows(values, fmt, per_row=8):
+    rows = []
+    for i in range(0, len(values), per_row):
+        rows.append('    ' + ', '.join(fmt(v) for v in values[i:i + per_row]) + ',')
+    return '\n'.join(rows)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--size', type=int, required=True, help='Window size (samples)')
+    parser.add_argument('--window', choices=sorted(WINDOWS), required=True)
+    parser.add_argument('--output', required=True, help='Generated C file')
+    args = parser.parse_args()
+
+    n = args.size
+    if n < 2:
+        parser.error('window size must be at least 2')
+
+    coefficients = [float32(WINDOWS[args.window](i, n)) for i in range(n)]
+    # Clamp tiny negative values (Blackman end points) to an exact 0
+    coefficients = [max(c, 0.0) for c in coefficients]
+    q15 = [min(int(round(c * 32768.0)), 32767) for c in coefficients]
+
+    with open(args.output, 'w') as f:
+        f.write('// Generated by gen_window_table.py - do not edit\n')
+        f.write('#include "window_table.h"\n\n')
+        f.write('_Static_assert(ML_WINDOW_SIZE == %d, "window table generated for another size");\n\n' % n)
+        f.write('const char ml_window_name[] = "%s";\n\n' % args.window)
+        f.write('const float ml_window_table[ML_WINDOW_SIZE] __attribute__((aligned(16))) = {\n')
+        f.write(format_rows(coefficients, lambda v: '%.9ef' % v, per_row=4))
+        f.write('\n};\n\n')
+        f.write('const int16_t ml_window_table_q15[ML_WINDOW_SIZE] __attribute__((aligned(16))) = {\n')
+        f.write(format_rows(q15, lambda v: '%6d' % v))
+        f.write('\n};\n')
+
+
+if __name__ == '__main__':
+    main()
@@ -6,7 +6,12 @@
 #include "signal_processing.h"
 #include "preprocessing.h"
 #include "system_monitor.h"
+#include "stage_trace.h"
 #include "tflite_wrapper.h"
+#include "model_registry.h"
+#include "spectral_features.h"
+#include "window_stats.h"
+#include "ml_contract.h"
 #include <string.h>
 #include <math.h>
 #include <stdlib.h>
@@ -14,76 +19,90 @@
 // FreeRTOS includes
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 
-// Include the single selected model based on Kconfig
+// Model selected in Kconfig (data comes from the model registry)
 #ifdef CONFIG_MODEL_CNN_INT8
-    #include "cnn_int8_model.h"
     #define SELECTED_MODEL_TYPE MODEL_CNN_INT8
-    #define SELECTED_MODEL_DATA cnn_int8_model_tflite
-    #define SELECTED_MODEL_SIZE cnn_int8_model_tflite_len
 #elif CONFIG_MODEL_CNN_FLOAT32
-    #include "cnn_float32_model.h"
     #define SELECTED_MODEL_TYPE MODEL_CNN_FLOAT32
-    #define SELECTED_MODEL_DATA cnn_float32_model_tflite
-    #define SELECTED_MODEL_SIZE cnn_float32_model_tflite_len
 #elif CONFIG_MODEL_MLP_FLOAT32
-    #include "mlp_float32_model.h"
     #define SELECTED_MODEL_TYPE MODEL_MLP_FLOAT32
-    #define SELECTED_MODEL_DATA mlp_float32_model_tflite
-    #define SELECTED_MODEL_SIZE mlp_float32_model_tflite_len
 #elif CONFIG_MODEL_MLP_INT8
-    #include "mlp_int8_model.h"
     #define SELECTED_MODEL_TYPE MODEL_MLP_INT8
-    #define SELECTED_MODEL_DATA mlp_int8_model_tflite
-    #define SELECTED_MODEL_SIZE mlp_int8_model_tflite_len
 #elif CONFIG_MODEL_HYBRID_FLOAT32
-    #include "hybrid_float32_model.h"
     #define SELECTED_MODEL_TYPE MODEL_HYBRID_FLOAT32
-    #define SELECTED_MODEL_DATA hybrid_float32_model_tflite
-    #define SELECTED_MODEL_SIZE hybrid_float32_model_tflite_len
 #elif CONFIG_MODEL_HYBRID_INT8
-    #include "hybrid_int8_model.h"
     #define SELECTED_MODEL_TYPE MODEL_HYBRID_INT8
-    #define SELECTED_MODEL_DATA hybrid_int8_model_tflite
-    #define SELECTED_MODEL_SIZE hybrid_int8_model_tflite_len
+#elif CONFIG_MODEL_CASCADE
+    // Last cascade stage; MLP_INT8 is acquired alongside it
+    #define SELECTED_MODEL_TYPE MODEL_CNN_INT8
+#elif CONFIG_MODEL_ENSEMBLE
+    // Primary member; the partner comes from the config
+    #define SELECTED_MODEL_TYPE ENSEMBLE_PRIMARY_MODEL
+#elif CONFIG_MODEL_CNN_STREAMING
+    // Whole-window counterpart; the split models are not in the registry
+    #define SELECTED_MODEL_TYPE MODEL_CNN_INT8
 #elif CONFIG_MODEL_HEURISTIC_ONLY
     // No TFLite model included
     #define SELECTED_MODEL_TYPE MODEL_NONE
-    #define SELECTED_MODEL_DATA NULL
-    #define SELECTED_MODEL_SIZE 0
+#elif CONFIG_MODEL_FFT_CLASSIFIER
+    // Spectral classifier, no TFLite model or arena
+    #define SELECTED_MODEL_TYPE MODEL_NONE
 #else
     #warning "No model selected in Kconfig, defaulting to heuristic only"
     #define SELECTED_MODEL_TYPE MODEL_NONE
-    #define SELECTED_MODEL_DATA NULL
-    #define SELECTED_MODEL_SIZE 0
 #endif
 
 // Set TFLITE_ENABLED flag
 #if defined(CONFIG_MODEL_CNN_INT8) || defined(CONFIG_MODEL_CNN_FLOAT32) || \
     defined(CONFIG_MODEL_MLP_FLOAT32) || defined(CONFIG_MODEL_MLP_INT8) || \
-    defined(CONFIG_MODEL_HYBRID_FLOAT32) || defined(CONFIG_MODEL_HYBRID_INT8)
+    defined(CONFIG_MODEL_HYBRID_FLOAT32) || defined(CONFIG_MODEL_HYBRID_INT8) || \
+    defined(CONFIG_MODEL_CASCADE) || defined(CONFIG_MODEL_ENSEMBLE) || \
+    defined(CONFIG_MODEL_CNN_STREAMING)
     #define TFLITE_ENABLED 1
 #else
     #define TFLITE_ENABLED 0
     #pragma message("TensorFlow Lite disabled - using heuristic inference")
 #endif
 
-static const char *TAG = "INFERENCE";
+#ifdef CONFIG_MODEL_CNN_STREAMING
+#include "cnn_stream_features_int8_model.h"
+#include "cnn_stream_head_int8_model.h"
+#endif
 
-// Class names
-static const char* s_class_names[] = {"SINE", "SQUARE", "TRIANGLE", "SAWTOOTH"};
-#define NUM_CLASSES 4
+static const char *TAG = "INFERENCE";
 
 // Helper function: Convert class name to index
 int class_name_to_index(const char *class_name) {
-    for (int i = 0; i < NUM_CLASSES; i++) {
-        if (strcmp(class_name, s_class_names[i]) == 0) {
-            return i;
-        }
+    return (int)ml_class_from_string(class_name);
+}
+
+// Result of a single-class decision (rule-based classifiers): the
+// confidence goes to that class, the remainder is spread over the others
+static void set_class_result(inference_result_t *result, ml_class_t cls, float confidence) {
+    float other = (1.0f - confidence) / (ML_WAVEFORM_CLASS_COUNT - 1);
+    for (int i = 0; i < ML_WAVEFORM_CLASS_COUNT; i++) {
+        result->probabilities[i] = (i == cls) ? confidence : other;
     }
-    return -1;
+    result->num_classes = ML_WAVEFORM_CLASS_COUNT;
+    result->predicted_class = cls;
+    result->confidence = confidence;
+    result->is_voted_result = false;
+}
+
+// Result from a filled probability vector
+static void set_probability_result(inference_result_t *result, int num_classes) {
+    int best = ml_argmax(result->probabilities, num_classes);
+    result->num_classes = num_classes;
+    result->predicted_class = (ml_class_t)best;
+    result->confidence = result->probabilities[best];
+    result->is_voted_result = false;
 }
 
+static void extract_frequency_features(float *samples, int num_samples, int zero_crossings,
+                                       signal_features_t *features);
+
 // Extract features for heuristic classification (optimized)
 void extract_features(float *samples, int num_samples, signal_features_t *features) {
     if (!samples || !features || num_samples == 0) {
@@ -139,85 +158,224 @@ void extract_features(float *samples, int num_samples, signal_features_t *featur
     features->symmetry_score = (total_avg > 1e-6f) ? 
                                fabsf(positive_avg - negative_avg) / total_avg : 0.0f;
     
-    // Simple frequency estimation (without full FFT)
+    extract_frequency_features(samples, num_samples, zero_crossings, features);
+}
+
+// Time-domain features from raw-window moments (unwindowed, around the
+// window mean); frequency features still come from the preprocessed window
+static void extract_features_from_moments(const window_moments_t *moments,
+                                          float *samples, int num_samples,
+                                          signal_features_t *features) {
+    memset(features, 0, sizeof(signal_features_t));
+    if (moments->count == 0) {
+        return;
+    }
+    
+    float n = (float)moments->count;
+    float mean = moments->sum / n;
+    float variance = (float)moments->sum_sq / n - mean * mean;
+    float rms = sqrtf(fmaxf(variance, 0.0f));
+    
+    // Code units; the usual thresholds are relative to a unit peak
+    float center = ML_ADC_MIDSCALE + mean;
+    float peak = fmaxf(moments->max_code - center, center - moments->min_code);
+    float avg_rect = moments->sum_abs / n;
+    
+    features->zero_crossing_rate = moments->zero_crossings / n;
+    features->crest_factor = (rms > 0.001f * peak) ? peak / rms : 0.0f;
+    features->form_factor = (avg_rect > 0.001f * peak) ? rms / avg_rect : 0.0f;
+    
+    float positive_avg = moments->positive_count > 0 ? 
+                         (float)moments->positive_sum / moments->positive_count : 0.0f;
+    float negative_avg = moments->negative_count > 0 ? 
+                         (float)moments->negative_sum / moments->negative_count : 0.0f;
+    float total_avg = positive_avg + negative_avg;
+    
+    features->symmetry_score = (total_avg > 1e-6f * peak) ? 
+                               fabsf(positive_avg - negative_avg) / total_avg : 0.0f;
+    
+    extract_frequency_features(samples, num_samples, moments->zero_crossings, features);
+}
+
+// Dominant frequency and harmonic content
+static void extract_frequency_features(float *samples, int num_samples, int zero_crossings,
+                                       signal_features_t *features) {
+    #ifdef CONFIG_INFERENCE_USE_FFT
+    // Fundamental and harmonic content from the spectrum
+    spectral_features_t spectral;
+    if (extract_spectral_features(samples, num_samples, ML_SAMPLE_RATE_HZ, &spectral)) {
+        features->dominant_frequency = spectral.fundamental_hz;
+        features->harmonic_ratio = spectral.harmonic_ratio;
+        return;
+    }
+    #endif
+    
+    // Frequency estimate from zero crossings (two per period)
     if (zero_crossings > 2) {
-        // Estimate frequency from zero crossings
-        features->dominant_frequency = (float)zero_crossings * 10000.0f / num_samples; // Approx
-        features->harmonic_ratio = 0.1f;  // Default low harmonic content
+        features->dominant_frequency = (float)zero_crossings * (ML_SAMPLE_RATE_HZ / 2.0f) / num_samples;
+        features->harmonic_ratio = 0.0f;  // Unknown without a spectrum
     } else {
         features->dominant_frequency = 0.0f;
         features->harmonic_ratio = 0.0f;
     }
 }
 
-// Heuristic inference based on features (optimized)
-static bool heuristic_inference(float *samples, int num_samples, inference_result_t *result) {
-    signal_features_t features;
-    extract_features(samples, num_samples, &features);
+// Confidence from how far a feature clears its split (as spectral_classify)
+static float split_confidence(float value, float threshold, float scale) {
+    float margin = fabsf(value - threshold) / scale;
+    if (margin > 1.0f) margin = 1.0f;
+    return 0.5f + 0.5f * margin;
+}
+
+// Heuristic decision tree over extracted features. Each leaf's confidence
+// is scaled by the narrowest margin on the way to it.
+static bool classify_features(const signal_features_t *f, inference_result_t *result) {
+    signal_features_t features = *f;
     
     // Optimized decision tree
-    int predicted_class;
+    ml_class_t predicted_class;
     float confidence;
+    float margin = split_confidence(features.zero_crossing_rate, 0.4f, 0.4f);
     
     if (features.zero_crossing_rate > 0.4f) {
-        // Sine or Triangle (high zero crossings)
-        if (features.harmonic_ratio < 0.3f) {
-            predicted_class = 0; // SINE
+        // Sine or Triangle (high zero crossings); triangle harmonics are ~12%
+        margin = fminf(margin, split_confidence(features.harmonic_ratio, 0.05f, 0.05f));
+        if (features.harmonic_ratio < 0.05f) {
+            predicted_class = ML_CLASS_SINE;
             confidence = 0.85f;
         } else {
-            predicted_class = 2; // TRIANGLE
+            predicted_class = ML_CLASS_TRIANGLE;
             confidence = 0.75f;
         }
     } else if (features.crest_factor > 1.5f) {
         // Square wave
-        predicted_class = 1; // SQUARE
+        margin = fminf(margin, split_confidence(features.crest_factor, 1.5f, 0.5f));
+        predicted_class = ML_CLASS_SQUARE;
         confidence = 0.8f;
     } else {
         // Default to sawtooth
-        predicted_class = 3; // SAWTOOTH
+        margin = fminf(margin, split_confidence(features.crest_factor, 1.5f, 0.5f));
+        predicted_class = ML_CLASS_SAWTOOTH;
         confidence = 0.7f;
     }
     
-    // Add small variation
-    confidence *= (0.9f + 0.1f * ((float)rand() / RAND_MAX));
+    set_class_result(result, predicted_class, confidence * margin);
+    return true;
+}
+
+// Heuristic inference based on features (optimized)
+static bool heuristic_inference(float *samples, int num_samples, inference_result_t *result) {
+    signal_features_t features;
+    extract_features(samples, num_samples, &features);
+    return classify_features(&features, result);
+}
+
+// Spectral inference: harmonic decay separates the four waveforms.
+// Returns false, with no answer, when neither the window nor the stream's
+// span (may be NULL) has usable harmonics.
+static bool spectral_inference(float *samples, int num_samples, const spectral_span_t *span,
+                               inference_result_t *result) {
+    spectral_features_t features;
+    if (!extract_spectral_features_span(span, samples, num_samples, ML_SAMPLE_RATE_HZ, 
+                                        &features)) {
+        // Too few periods even in the span, or harmonics above Nyquist
+        return false;
+    }
+    
+    float confidence;
+    ml_class_t predicted_class = spectral_classify(&features, &confidence);
+    set_class_result(result, predicted_class, confidence);
     
-    strncpy(result->predicted_class, s_class_names[predicted_class], 
-            sizeof(result->predicted_class) - 1);
-    result->predicted_class[sizeof(result->predicted_class) - 1] = '\0';
-    result->confidence = confidence;
-    result->num_classes = NUM_CLASSES;
-    result->is_voted_result = false;
+    #ifdef CONFIG_DETAILED_LOGGING
+    ESP_LOGI(TAG, "FFT: f0=%.0f Hz H2=%.2f p=%.2f rolloff=%.0f Hz", 
+             features.fundamental_hz, features.harmonic_amplitude[2],
+             features.odd_decay_exponent, features.spectral_rolloff_hz);
+    #endif
     
     return true;
 }
 
+// Spectral inference, with the heuristic for windows it can't decide
+static bool fft_inference(float *samples, int num_samples, const spectral_span_t *span,
+                          inference_result_t *result) {
+    return spectral_inference(samples, num_samples, span, result) ||
+           heuristic_inference(samples, num_samples, result);
+}
+
+// Span of the selected stream, extended with the window being run (NULL
+// in modes without spectral classification)
+static const spectral_span_t *stream_span(const inference_engine_t *engine) {
+    return engine->spans ? &engine->spans[engine->stream] : NULL;
+}
+
+// Modes that classify from the spectrum, where a span lets a fundamental
+// with one period per window be analyzed
+static bool uses_spectral_span(const inference_config_t *config) {
+    #ifdef CONFIG_INFERENCE_USE_FFT
+    if (config->mode == INFERENCE_MODE_CASCADE) {
+        return true;
+    }
+    #endif
+    // The voted path's cheap classifier stands in for the model
+    bool skips = config->enable_voting && config->decisive_skip > 0 &&
+                 (config->mode == INFERENCE_MODE_TFLITE || config->mode == INFERENCE_MODE_ENSEMBLE);
+    return config->mode == INFERENCE_MODE_FFT_BASED || skips;
+}
+
+#if TFLITE_ENABLED
+// Quantize (if needed) a float window into a session and invoke it
+static bool session_inference(tflite_session_t *session, float *samples, int num_samples,
+                              inference_result_t *result) {
+    tflite_input_view_t view;
+    if (!tflite_session_input(session, &view) || view.elements < (size_t)num_samples) {
+        ESP_LOGE(TAG, "Input tensor does not fit the window");
+        return false;
+    }
+    
+    if (view.type == TFLITE_INPUT_INT8) {
+        uint64_t quantize_start = esp_timer_get_time();
+        if (!quantize_samples_int8(samples, num_samples, view.scale, view.zero_point,
+                                   (int8_t *)view.data)) {
+            return false;
+        }
+        metrics_record_stage(METRIC_STAGE_QUANTIZE, (uint32_t)(esp_timer_get_time() - quantize_start));
+        stage_trace_mark(STAGE_TRACE_QUANTIZED);
+    } else {
+        memcpy(view.data, samples, num_samples * sizeof(float));
+        stage_trace_mark(STAGE_TRACE_PREPROCESSED);
+    }
+    
+    int num_classes = 0;
+    uint64_t invoke_start = esp_timer_get_time();
+    bool success = tflite_session_invoke(session, result->probabilities,
+                                         INFERENCE_MAX_CLASSES, &num_classes);
+    metrics_record_stage(METRIC_STAGE_INVOKE, (uint32_t)(esp_timer_get_time() - invoke_start));
+    stage_trace_mark(STAGE_TRACE_INVOKED);
+    
+    if (success) {
+        set_probability_result(result, num_classes);
+    }
+    return success;
+}
+#endif
+
 // TFLite inference using C wrapper
 static bool tflite_inference(inference_engine_t *engine, float *samples, int num_samples, inference_result_t *result) {
     #if TFLITE_ENABLED
-    if (!engine->model_data || engine->model_size == 0) {
-        ESP_LOGW(TAG, "No TFLite model available");
+    if (!engine->interpreter) {
+        ESP_LOGW(TAG, "No TFLite session available");
         return false;
     }
     
-    bool success = tflite_inference_cpp(
-        engine->model_data,
-        engine->model_size,
-        samples,
-        num_samples,
-        result->predicted_class,
-        sizeof(result->predicted_class),
-        &result->confidence
-    );
+    bool success = session_inference((tflite_session_t *)engine->interpreter, 
+                                      samples, num_samples, result);
     
+    #ifdef CONFIG_DETAILED_LOGGING
     if (success) {
-        result->num_classes = NUM_CLASSES;  // Update based on actual model output if needed
-        result->is_voted_result = false;
-        
-        #ifdef CONFIG_DETAILED_LOGGING
         ESP_LOGI(TAG, "TFLite inference: %s (%.2f)", 
-                 result->predicted_class, result->confidence);
-        #endif
+                 ml_class_to_string(result->predicted_class), result->confidence);
     }
+    #endif
     
     return success;
     #else
@@ -226,6 +384,274 @@ static bool tflite_inference(inference_engine_t *engine, float *samples, int num
     #endif
 }
 
+// Cheap classifier first; escalate while the answer is below the
+// stage's acceptance confidence. moments (may be NULL) spare the
+// heuristic a pass over the samples, span (may be NULL) lets the spectral
+// classifier see more periods than the window holds.
+static bool cascade_inference(inference_engine_t *engine, float *samples, int num_samples,
+                              const window_moments_t *moments, const spectral_span_t *span,
+                              inference_result_t *result) {
+    inference_cascade_t *c = &engine->cascade;
+    uint64_t start_time = esp_timer_get_time();
+    
+    #ifdef CONFIG_INFERENCE_USE_FFT
+    // No spectral answer escalates: the heuristic fallback is not trusted
+    bool success = spectral_inference(samples, num_samples, span, result);
+    #else
+    bool success;
+    if (moments) {
+        signal_features_t features;
+        extract_features_from_moments(moments, samples, num_samples, &features);
+        success = classify_features(&features, result);
+    } else {
+        success = heuristic_inference(samples, num_samples, result);
+    }
+    #endif
+    metrics_record_stage(METRIC_STAGE_INVOKE, (uint32_t)(esp_timer_get_time() - start_time));
+    stage_trace_mark(STAGE_TRACE_INVOKED);
+    
+    // TFLite stages record their own quantize and Invoke times. A stage
+    // that fails leaves the earlier answer, and its credit, in place.
+    int stage = CASCADE_STAGE_CHEAP;
+    int answered = CASCADE_STAGE_CHEAP;
+    while (stage < CASCADE_STAGE_COUNT - 1 &&
+           (!success || result->confidence < c->accept_confidence[stage])) {
+        stage++;
+        #if TFLITE_ENABLED
+        inference_result_t escalated;
+        memset(&escalated, 0, sizeof(inference_result_t));
+        if (c->sessions[stage] &&
+            session_inference((tflite_session_t *)c->sessions[stage], samples, 
+                              num_samples, &escalated)) {
+            *result = escalated;
+            success = true;
+            answered = stage;
+        }
+        #endif
+    }
+    
+    if (success) {
+        c->windows++;
+        c->accepted[answered]++;
+        c->total_cost_us += esp_timer_get_time() - start_time;
+    }
+    return success;
+}
+
+void inference_cascade_log_stats(const inference_engine_t *engine) {
+    if (!engine || engine->mode != INFERENCE_MODE_CASCADE) return;
+    
+    const inference_cascade_t *c = &engine->cascade;
+    if (c->windows == 0) return;
+    
+    uint32_t escalated = c->windows - c->accepted[CASCADE_STAGE_CHEAP];
+    ESP_LOGI(TAG, "Cascade: %u windows, %.1f%% escalated (cheap %u, MLP %u, CNN %u), "
+             "avg cost %llu us/window",
+             (unsigned)c->windows, 100.0f * escalated / c->windows,
+             (unsigned)c->accepted[CASCADE_STAGE_CHEAP],
+             (unsigned)c->accepted[CASCADE_STAGE_MLP],
+             (unsigned)c->accepted[CASCADE_STAGE_CNN],
+             (unsigned long long)(c->total_cost_us / c->windows));
+}
+
+#if TFLITE_ENABLED
+#define ENSEMBLE_WORKER_STACK 8192
+
+#ifndef CONFIG_FREERTOS_UNICORE
+// Invokes the secondary member whenever the caller has filled its input
+static void ensemble_worker_task(void *arg) {
+    inference_ensemble_t *e = (inference_ensemble_t *)arg;
+    
+    while (1) {
+        xSemaphoreTake((SemaphoreHandle_t)e->start, portMAX_DELAY);
+        if (e->stop) {
+            break;
+        }
+        uint64_t start = esp_timer_get_time();
+        e->worker_ok = tflite_session_invoke((tflite_session_t *)e->sessions[ENSEMBLE_SECONDARY],
+                                             e->worker_probabilities, INFERENCE_MAX_CLASSES,
+                                             &e->worker_classes);
+        e->worker_us = (uint32_t)(esp_timer_get_time() - start);
+        xSemaphoreGive((SemaphoreHandle_t)e->done);
+    }
+    
+    xSemaphoreGive((SemaphoreHandle_t)e->done);
+    vTaskDelete(NULL);
+}
+#endif
+
+// Worker on the core the caller does not run on, at the caller's
+// priority so the acquisition task still preempts it
+static void ensemble_start_worker(inference_ensemble_t *e) {
+    #ifndef CONFIG_FREERTOS_UNICORE
+    e->start = xSemaphoreCreateBinary();
+    e->done = xSemaphoreCreateBinary();
+    e->stop = false;
+    TaskHandle_t worker = NULL;
+    if (e->start && e->done &&
+        xTaskCreatePinnedToCore(ensemble_worker_task, "ensemble", ENSEMBLE_WORKER_STACK, e,
+                                uxTaskPriorityGet(NULL), &worker,
+                                1 - xPortGetCoreID()) == pdPASS) {
+        e->worker = worker;
+        ESP_LOGI(TAG, "Ensemble worker on core %d", 1 - xPortGetCoreID());
+        return;
+    }
+    #endif
+    
+    if (e->start) vSemaphoreDelete((SemaphoreHandle_t)e->start);
+    if (e->done) vSemaphoreDelete((SemaphoreHandle_t)e->done);
+    e->start = e->done = NULL;
+    ESP_LOGW(TAG, "No ensemble worker: members run one after the other");
+}
+
+static void ensemble_stop_worker(inference_ensemble_t *e) {
+    if (!e->worker) return;
+    
+    e->stop = true;
+    xSemaphoreGive((SemaphoreHandle_t)e->start);
+    xSemaphoreTake((SemaphoreHandle_t)e->done, portMAX_DELAY);
+    vSemaphoreDelete((SemaphoreHandle_t)e->start);
+    vSemaphoreDelete((SemaphoreHandle_t)e->done);
+    e->worker = e->start = e->done = NULL;
+}
+
+static bool ensemble_acquire(inference_ensemble_t *e) {
+    for (int m = 0; m < ENSEMBLE_MEMBER_COUNT; m++) {
+        e->sessions[m] = model_registry_acquire(e->models[m], true);
+        if (!e->sessions[m]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Weighted average of the members' softmax outputs in one pass. A member
+// that failed is left out; the gate scales each weight by the member's
+// top probability, so a confident member outvotes an unsure one. Scores
+// are by ml_class_t, so members may cover different classes.
+static bool ensemble_fuse(inference_ensemble_t *e, const float *primary, int primary_classes,
+                          bool primary_ok, inference_result_t *result) {
+    const float *probs[ENSEMBLE_MEMBER_COUNT] = { primary, e->worker_probabilities };
+    int classes[ENSEMBLE_MEMBER_COUNT] = { primary_classes, e->worker_classes };
+    bool ok[ENSEMBLE_MEMBER_COUNT] = { primary_ok, e->worker_ok };
+    
+    float weights[ENSEMBLE_MEMBER_COUNT];
+    int num_classes = 0;
+    int best[ENSEMBLE_MEMBER_COUNT] = { -1, -1 };
+    float total = 0.0f;
+    for (int m = 0; m < ENSEMBLE_MEMBER_COUNT; m++) {
+        weights[m] = 0.0f;
+        if (!ok[m] || classes[m] <= 0) continue;
+        
+        best[m] = ml_argmax(probs[m], classes[m]);
+        weights[m] = e->weights[m];
+        if (e->fusion == ENSEMBLE_FUSION_GATED) {
+            weights[m] *= probs[m][best[m]];
+        }
+        if (classes[m] > num_classes) num_classes = classes[m];
+        total += weights[m];
+    }
+    if (best[ENSEMBLE_PRIMARY] < 0 && best[ENSEMBLE_SECONDARY] < 0) {
+        return false;
+    }
+    
+    // Zero weights (e.g. a 0% member that is the only survivor): plain average
+    if (total <= 0.0f) {
+        for (int m = 0; m < ENSEMBLE_MEMBER_COUNT; m++) {
+            weights[m] = (best[m] >= 0) ? 1.0f : 0.0f;
+            total += weights[m];
+        }
+    }
+    
+    for (int i = 0; i < num_classes; i++) {
+        float sum = 0.0f;
+        for (int m = 0; m < ENSEMBLE_MEMBER_COUNT; m++) {
+            if (weights[m] > 0.0f && i < classes[m]) sum += weights[m] * probs[m][i];
+        }
+        result->probabilities[i] = sum / total;
+    }
+    set_probability_result(result, num_classes);
+    
+    if (best[ENSEMBLE_PRIMARY] >= 0 && best[ENSEMBLE_SECONDARY] >= 0 &&
+        best[ENSEMBLE_PRIMARY] != best[ENSEMBLE_SECONDARY]) {
+        e->disagreements++;
+    }
+    return true;
+}
+
+// Both inputs must be filled. The window's Invoke stage is the wall-clock
+// time until both members are done, i.e. the slower one, not the sum.
+static bool ensemble_invoke(inference_engine_t *engine, inference_result_t *result) {
+    inference_ensemble_t *e = &engine->ensemble;
+    uint64_t start = esp_timer_get_time();
+    
+    if (e->worker) {
+        xSemaphoreGive((SemaphoreHandle_t)e->start);
+    }
+    
+    float primary[INFERENCE_MAX_CLASSES];
+    int primary_classes = 0;
+    bool primary_ok = tflite_session_invoke((tflite_session_t *)e->sessions[ENSEMBLE_PRIMARY],
+                                            primary, INFERENCE_MAX_CLASSES, &primary_classes);
+    uint64_t primary_us = esp_timer_get_time() - start;
+    
+    if (e->worker) {
+        xSemaphoreTake((SemaphoreHandle_t)e->done, portMAX_DELAY);
+    } else {
+        uint64_t secondary_start = esp_timer_get_time();
+        e->worker_ok = tflite_session_invoke((tflite_session_t *)e->sessions[ENSEMBLE_SECONDARY],
+                                             e->worker_probabilities, INFERENCE_MAX_CLASSES,
+                                             &e->worker_classes);
+        e->worker_us = (uint32_t)(esp_timer_get_time() - secondary_start);
+    }
+    uint32_t wall_us = (uint32_t)(esp_timer_get_time() - start);
+    metrics_record_stage(METRIC_STAGE_INVOKE, wall_us);
+    stage_trace_mark(STAGE_TRACE_INVOKED);
+    
+    if (!ensemble_fuse(e, primary, primary_classes, primary_ok, result)) {
+        return false;
+    }
+    e->windows++;
+    e->invoke_us[ENSEMBLE_PRIMARY] += primary_us;
+    e->invoke_us[ENSEMBLE_SECONDARY] += e->worker_us;
+    e->wall_us += wall_us;
+    return true;
+}
+#endif
+
+void inference_ensemble_log_stats(const inference_engine_t *engine) {
+    if (!engine || engine->mode != INFERENCE_MODE_ENSEMBLE) return;
+    
+    const inference_ensemble_t *e = &engine->ensemble;
+    if (e->windows == 0) return;
+    
+    ESP_LOGI(TAG, "Ensemble: %u windows, %.1f%% disagreed, Invoke %llu + %llu us on two cores, "
+             "%llu us wall clock per window",
+             (unsigned)e->windows, 100.0f * e->disagreements / e->windows,
+             (unsigned long long)(e->invoke_us[ENSEMBLE_PRIMARY] / e->windows),
+             (unsigned long long)(e->invoke_us[ENSEMBLE_SECONDARY] / e->windows),
+             (unsigned long long)(e->wall_us / e->windows));
+}
+
+static void voter_reset(inference_voter_t *v) {
+    memset(v, 0, sizeof(inference_voter_t));
+    v->voted_class = -1;
+}
+
+// A model change invalidates every stream's history
+static void voting_reset_all(inference_engine_t *engine) {
+    for (int i = 0; i < INFERENCE_MAX_STREAMS; i++) {
+        voter_reset(&engine->voters[i]);
+    }
+}
+
+#ifdef CONFIG_MODEL_CNN_STREAMING
+static bool streaming_init(inference_engine_t *engine);
+static void streaming_destroy(inference_streaming_t *s);
+static bool streaming_run(inference_engine_t *engine, const uint16_t *codes, int num_samples,
+                          inference_result_t *result);
+#endif
+
 // Initialize inference engine
 bool inference_init(inference_engine_t *engine, inference_config_t *config) {
     if (!engine || !config) {
@@ -236,40 +662,161 @@ bool inference_init(inference_engine_t *engine, inference_config_t *config) {
     memset(engine, 0, sizeof(inference_engine_t));
     engine->config = *config;
     engine->mode = config->mode;
+    voting_reset_all(engine);
+    
+    if (uses_spectral_span(config)) {
+        engine->spans = heap_caps_calloc(INFERENCE_MAX_STREAMS, sizeof(spectral_span_t),
+                                         MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (!engine->spans) {
+            ESP_LOGW(TAG, "No memory for spectral spans: one window per spectrum");
+        }
+    }
     
     #if TFLITE_ENABLED
     if (config->mode == INFERENCE_MODE_TFLITE) {
-        // Use the model selected in Kconfig
-        engine->model_data = (void*)SELECTED_MODEL_DATA;
-        engine->model_size = SELECTED_MODEL_SIZE;
+        // Use the configured model, falling back to the Kconfig selection
+        model_type_t type = (config->model_type != MODEL_NONE) ? config->model_type
+                                                                : SELECTED_MODEL_TYPE;
+        const model_registry_entry_t *entry = model_registry_get(type);
+        if (!entry || !entry->data) {
+            ESP_LOGE(TAG, "Failed to load model data for model type %d", type);
+            return false;
+        }
+        
+        engine->config.model_type = type;
         
-        if (!engine->model_data || engine->model_size == 0) {
-            ESP_LOGE(TAG, "Failed to load model data for Kconfig-selected model");
+        // Build the interpreter once and pin it; every inference_run() reuses it
+        engine->interpreter = model_registry_acquire(type, true);
+        if (!engine->interpreter) {
+            ESP_LOGE(TAG, "Failed to create TFLite session");
             return false;
         }
+        // Read after acquiring: the registry may have moved the data to RAM
+        engine->model_data = (void*)entry->data;
+        engine->model_size = entry->size;
         
-        ESP_LOGI(TAG, "Loaded Kconfig-selected model type %d (%u bytes)", 
-                 SELECTED_MODEL_TYPE, (unsigned int)engine->model_size);
+        ESP_LOGI(TAG, "Loaded model %s (%u bytes%s)", 
+                 entry->name, (unsigned int)engine->model_size,
+                 entry->in_ram ? ", in RAM" : "");
+        engine->active_model = type;
+        engine->acquired_models = 1u << type;
         
-        // Check arena size requirement
         #ifdef CONFIG_DETAILED_LOGGING
-        size_t arena_size = tflite_get_arena_size(engine->model_data, engine->model_size);
-        if (arena_size > 0) {
-            ESP_LOGI(TAG, "TFLite arena required: %u bytes", (unsigned int)arena_size);
-        }
+        ESP_LOGI(TAG, "TFLite arena: %u bytes",
+                 (unsigned int)tflite_session_arena_size((tflite_session_t *)engine->interpreter));
         #endif
         
         engine->initialized = true;
         return true;
     }
+    
+    if (config->mode == INFERENCE_MODE_CASCADE) {
+        // Acceptance grows stricter the cheaper the stage
+        float threshold = config->confidence_threshold;
+        float margin = config->cascade_margin;
+        inference_cascade_t *c = &engine->cascade;
+        c->accept_confidence[CASCADE_STAGE_CHEAP] = threshold + (1.0f - threshold) * margin;
+        c->accept_confidence[CASCADE_STAGE_MLP] = threshold + (1.0f - threshold) * margin / 2.0f;
+        c->accept_confidence[CASCADE_STAGE_CNN] = 0.0f;
+        
+        c->sessions[CASCADE_STAGE_MLP] = model_registry_acquire(MODEL_MLP_INT8, true);
+        c->sessions[CASCADE_STAGE_CNN] = model_registry_acquire(MODEL_CNN_INT8, true);
+        if (!c->sessions[CASCADE_STAGE_MLP] || !c->sessions[CASCADE_STAGE_CNN]) {
+            ESP_LOGE(TAG, "Failed to create cascade TFLite sessions");
+            return false;
+        }
+        const model_registry_entry_t *entry = model_registry_get(MODEL_CNN_INT8);
+        engine->model_data = (void *)entry->data;
+        engine->model_size = entry->size;
+        engine->interpreter = c->sessions[CASCADE_STAGE_CNN];
+        engine->config.model_type = MODEL_CNN_INT8;
+        engine->active_model = MODEL_CNN_INT8;
+        engine->acquired_models = (1u << MODEL_MLP_INT8) | (1u << MODEL_CNN_INT8);
+        
+        engine->initialized = true;
+        ESP_LOGI(TAG, "Cascade engine initialized: accept cheap >= %.2f, MLP >= %.2f",
+                 c->accept_confidence[CASCADE_STAGE_CHEAP], 
+                 c->accept_confidence[CASCADE_STAGE_MLP]);
+        return true;
+    }
+    
+    if (config->mode == INFERENCE_MODE_ENSEMBLE) {
+        inference_ensemble_t *e = &engine->ensemble;
+        e->models[ENSEMBLE_PRIMARY] = (config->model_type != MODEL_NONE) ? config->model_type
+                                                                          : SELECTED_MODEL_TYPE;
+        e->models[ENSEMBLE_SECONDARY] = config->ensemble_partner;
+        e->weights[ENSEMBLE_PRIMARY] = config->ensemble_weight;
+        e->weights[ENSEMBLE_SECONDARY] = 1.0f - config->ensemble_weight;
+        e->fusion = config->ensemble_fusion;
+        if (e->models[ENSEMBLE_PRIMARY] == e->models[ENSEMBLE_SECONDARY] ||
+            !model_registry_get(e->models[ENSEMBLE_SECONDARY]) || !ensemble_acquire(e)) {
+            ESP_LOGE(TAG, "Failed to create ensemble TFLite sessions");
+            return false;
+        }
+        const model_registry_entry_t *entry = model_registry_get(e->models[ENSEMBLE_PRIMARY]);
+        engine->model_data = (void *)entry->data;
+        engine->model_size = entry->size;
+        engine->interpreter = e->sessions[ENSEMBLE_PRIMARY];
+        engine->config.model_type = e->models[ENSEMBLE_PRIMARY];
+        engine->active_model = e->models[ENSEMBLE_PRIMARY];
+        engine->acquired_models = (1u << e->models[ENSEMBLE_PRIMARY]) |
+                                  (1u << e->models[ENSEMBLE_SECONDARY]);
+        ensemble_start_worker(e);
+        
+        engine->initialized = true;
+        ESP_LOGI(TAG, "Ensemble engine initialized: %s + %s, weights %.2f/%.2f%s",
+                 entry->name, model_registry_get(e->models[ENSEMBLE_SECONDARY])->name,
+                 e->weights[ENSEMBLE_PRIMARY], e->weights[ENSEMBLE_SECONDARY],
+                 e->fusion == ENSEMBLE_FUSION_GATED ? ", confidence gated" : "");
+        return true;
+    }
+    #endif
+    
+    #ifdef CONFIG_MODEL_CNN_STREAMING
+    if (config->mode == INFERENCE_MODE_STREAMING) {
+        if (!streaming_init(engine)) {
+            ESP_LOGE(TAG, "Failed to create streaming TFLite sessions");
+            return false;
+        }
+        inference_streaming_t *s = &engine->streaming;
+        engine->model_data = (void *)cnn_stream_features_int8_model_tflite;
+        engine->model_size = cnn_stream_features_int8_model_tflite_len +
+                             cnn_stream_head_int8_model_tflite_len;
+        engine->interpreter = s->features;
+        engine->active_model = MODEL_NONE;  // Neither model is in the registry
+        
+        engine->initialized = true;
+        ESP_LOGI(TAG, "Streaming engine initialized: %d-sample chunks, %d per window, "
+                 "%d per hop, %d states, %d features",
+                 s->chunk, s->window_chunks, s->hop_chunks, s->num_states, s->num_features);
+        return true;
+    }
     #endif
     
-    // Fallback modes (heuristic/simulated)
+    // Fallback modes (FFT/heuristic/simulated)
+    engine->active_model = MODEL_NONE;
     engine->initialized = true;
-    ESP_LOGI(TAG, "Heuristic inference engine initialized");
+    ESP_LOGI(TAG, "%s inference engine initialized",
+             config->mode == INFERENCE_MODE_FFT_BASED ? "FFT" : "Heuristic");
     return true;
 }
 
+// Timestamp a completed inference. Latency is recorded per stage by the
+// callers; windows are counted once, end to end, by the pipeline.
+static void record_inference(inference_result_t *result) {
+    result->timestamp_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    
+    #ifdef CONFIG_ENABLE_MEMORY_METRICS
+    metrics_record_memory_usage();
+    #endif
+}
+
+#if TFLITE_ENABLED
+static bool ensemble_run(inference_engine_t *engine, const uint16_t *codes, const float *samples,
+                         int num_samples, const void *input,
+                         const preprocess_format_t *input_format, inference_result_t *result);
+#endif
+
 // Run inference based on configured mode
 bool inference_run(inference_engine_t *engine, 
                    float *samples, 
@@ -293,80 +840,784 @@ bool inference_run(inference_engine_t *engine,
     }
     #endif
     
-    uint64_t start_time = esp_timer_get_time();
-    
     bool success = false;
     
-    switch (engine->mode) {
-        #if TFLITE_ENABLED
-        case INFERENCE_MODE_TFLITE:
-            success = tflite_inference(engine, samples, num_samples, result);
-            break;
-        #endif
-        case INFERENCE_MODE_HEURISTIC:
-        case INFERENCE_MODE_FFT_BASED:
-        case INFERENCE_MODE_SIMULATED:
-        default:
+    #if TFLITE_ENABLED
+    if (engine->mode == INFERENCE_MODE_TFLITE) {
+        // Times its quantize and Invoke stages separately
+        success = tflite_inference(engine, samples, num_samples, result);
+    } else if (engine->mode == INFERENCE_MODE_CASCADE) {
+        success = cascade_inference(engine, samples, num_samples, NULL, NULL, result);
+    } else if (engine->mode == INFERENCE_MODE_ENSEMBLE) {
+        success = ensemble_run(engine, NULL, samples, num_samples, NULL, NULL, result);
+    } else if (engine->mode == INFERENCE_MODE_STREAMING) {
+        // Its chunks are raw codes, not the preprocessed float window
+        ESP_LOGE(TAG, "Streaming mode runs on raw ADC windows only");
+        return false;
+    } else
+    #endif
+    {
+        uint64_t start_time = esp_timer_get_time();
+        if (engine->mode == INFERENCE_MODE_FFT_BASED) {
+            success = fft_inference(samples, num_samples, NULL, result);
+        } else {
             success = heuristic_inference(samples, num_samples, result);
-            break;
+        }
+        metrics_record_stage(METRIC_STAGE_INVOKE, (uint32_t)(esp_timer_get_time() - start_time));
+        stage_trace_mark(STAGE_TRACE_INVOKED);
     }
     
     if (success) {
-        uint64_t end_time = esp_timer_get_time();
-        uint64_t inference_time = end_time - start_time;
-        
-        result->timestamp_ms = (uint32_t)(end_time / 1000);
-        
-        // Record metrics
-        metrics_record_inference_time(inference_time);
-        #ifdef CONFIG_ENABLE_MEMORY_METRICS
-        metrics_record_memory_usage();
-        #endif
+        record_inference(result);
     }
     
     return success;
 }
 
-// Process inference result (simplified)
-void process_inference_result(inference_result_t *result, 
-                              const char *ground_truth,
-                              clock_sync_t *sync) {
-    if (!result) return;
-    
-    #ifdef CONFIG_DETAILED_LOGGING
-    uint32_t timestamp = sync ? get_synchronized_timestamp(sync) : result->timestamp_ms;
-    ESP_LOGI(TAG, "Inference: %s (%.2f) at %u ms", 
-             result->predicted_class, result->confidence, timestamp);
-    #endif
-    
-    if (ground_truth) {
-        #ifdef CONFIG_DETAILED_LOGGING
-        ESP_LOGI(TAG, "Ground truth: %s", ground_truth);
-        #endif
-        
-        if (strcmp(result->predicted_class, ground_truth) == 0) {
-            metrics_record_correct_prediction();
-            #ifdef CONFIG_DETAILED_LOGGING
-            ESP_LOGI(TAG, "✓ CORRECT");
-            #endif
-        } else {
-            metrics_record_incorrect_prediction();
-            #ifdef CONFIG_DETAILED_LOGGING
-            ESP_LOGW(TAG, "✗ INCORRECT (expected: %s)", ground_truth);
-            #endif
-        }
-    }
+// Scratch for non-TFLite modes on the raw-window path
+static float s_window_samples[ML_WINDOW_SIZE] __attribute__((aligned(16)));
+
+// Run inference directly on a raw ADC window (no voting)
+static const preprocess_format_t s_float_format = { .type = PREPROCESS_OUTPUT_FLOAT32 };
+
+// Preprocessed window usable as-is for the given format
+static const void *prepared_input(const void *input, const preprocess_format_t *input_format,
+                                  const preprocess_format_t *wanted) {
+    return (input && preprocess_format_equal(input_format, wanted)) ? input : NULL;
 }
 
-void inference_deinit(inference_engine_t *engine) {
-    if (engine) {
-        engine->initialized = false;
+static size_t format_element_size(const preprocess_format_t *format) {
+    return format->type == PREPROCESS_OUTPUT_INT8 ? sizeof(int8_t) : sizeof(float);
+}
+
+#if TFLITE_ENABLED
+// Int8 formats carry 1/scale in fixed point: preprocessing into them is
+// integer-only
+static void input_view_format(const tflite_input_view_t *view, preprocess_format_t *format) {
+    if (view->type == TFLITE_INPUT_INT8) {
+        preprocess_format_int8(format, view->scale, view->zero_point);
+    } else {
+        memset(format, 0, sizeof(preprocess_format_t));
+        format->type = PREPROCESS_OUTPUT_FLOAT32;
     }
 }
 
-void inference_get_memory_usage(inference_engine_t *engine, 
-                                size_t *ram_kb, 
-                                size_t *flash_kb) {
+// Fill a session's input from the cheapest source: a window already in
+// the tensor's format, else the float window, else the raw codes
+static bool fill_session_input(tflite_session_t *session, const uint16_t *codes,
+                               const float *samples, int num_samples, const void *input,
+                               const preprocess_format_t *input_format,
+                               tflite_input_view_t *view) {
+    if (!tflite_session_input(session, view) || view->elements < (size_t)num_samples) {
+        ESP_LOGE(TAG, "Input tensor does not fit the window");
+        return false;
+    }
+    
+    preprocess_format_t format;
+    input_view_format(view, &format);
+    const void *ready = prepared_input(input, input_format, &format);
+    if (ready) {
+        memcpy(view->data, ready, num_samples * format_element_size(&format));
+        stage_trace_mark(STAGE_TRACE_PREPROCESSED);
+        return true;
+    }
+    
+    bool filled;
+    uint64_t start = esp_timer_get_time();
+    if (samples && format.type == PREPROCESS_OUTPUT_INT8) {
+        filled = quantize_samples_int8(samples, num_samples, view->scale, view->zero_point,
+                                       (int8_t *)view->data);
+        metrics_record_stage(METRIC_STAGE_QUANTIZE, (uint32_t)(esp_timer_get_time() - start));
+        stage_trace_mark(STAGE_TRACE_QUANTIZED);
+    } else if (samples) {
+        memcpy(view->data, samples, num_samples * sizeof(float));
+        stage_trace_mark(STAGE_TRACE_PREPROCESSED);
+        filled = true;
+    } else {
+        filled = preprocess_codes(&format, codes, num_samples, view->data);
+        metrics_record_stage(METRIC_STAGE_PREPROCESS, (uint32_t)(esp_timer_get_time() - start));
+        stage_trace_mark(STAGE_TRACE_PREPROCESSED);
+    }
+    return filled;
+}
+
+// The secondary copies the primary's input when their quantization matches
+static bool ensemble_run(inference_engine_t *engine, const uint16_t *codes, const float *samples,
+                         int num_samples, const void *input,
+                         const preprocess_format_t *input_format, inference_result_t *result) {
+    inference_ensemble_t *e = &engine->ensemble;
+    tflite_input_view_t primary;
+    if (!fill_session_input((tflite_session_t *)e->sessions[ENSEMBLE_PRIMARY], codes, samples,
+                            num_samples, input, input_format, &primary)) {
+        return false;
+    }
+    
+    preprocess_format_t primary_format;
+    input_view_format(&primary, &primary_format);
+    tflite_input_view_t secondary;
+    if (!fill_session_input((tflite_session_t *)e->sessions[ENSEMBLE_SECONDARY], codes, samples,
+                            num_samples, primary.data, &primary_format, &secondary)) {
+        return false;
+    }
+    return ensemble_invoke(engine, result);
+}
+#endif
+
+#ifdef CONFIG_MODEL_CNN_STREAMING
+// Streaming state of one stream, allocated at init
+typedef struct {
+    bool primed;                            // States continue from the stream's last window
+    int next;                               // Ring slot of the next chunk's features
+    int32_t sums[STREAMING_MAX_FEATURES];   // Ring total per feature, in quantized steps
+    int8_t *ring;                           // window_chunks x num_features chunk features
+    uint8_t *states;                        // States saved while another stream is resident
+} streaming_context_t;
+
+static streaming_context_t *streaming_context(const inference_streaming_t *s, int stream) {
+    return (streaming_context_t *)s->contexts + stream;
+}
+
+static size_t view_bytes(const tflite_input_view_t *view) {
+    return view->elements * (view->type == TFLITE_INPUT_INT8 ? sizeof(int8_t) : sizeof(float));
+}
+
+static bool same_shape(const tflite_tensor_info_t *a, const tflite_tensor_info_t *b) {
+    if (a->rank != b->rank || a->view.type != b->view.type) {
+        return false;
+    }
+    for (int i = 0; i < a->rank; i++) {
+        if (a->dims[i] != b->dims[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Each state input is paired with the output of the same shape; what is
+// left over is the chunk input and the chunk features output
+static bool streaming_bind_tensors(inference_streaming_t *s) {
+    tflite_session_t *features = (tflite_session_t *)s->features;
+    int inputs = tflite_session_tensor_count(features, false);
+    int outputs = tflite_session_tensor_count(features, true);
+    if (inputs != outputs || inputs - 1 > STREAMING_MAX_STATES) {
+        ESP_LOGE(TAG, "Feature model has %d inputs and %d outputs", inputs, outputs);
+        return false;
+    }
+    
+    uint32_t paired = 0;   // Bit per output
+    s->chunk_input = -1;
+    for (int i = 0; i < inputs; i++) {
+        tflite_tensor_info_t in, out;
+        if (!tflite_session_tensor(features, false, i, &in)) {
+            return false;
+        }
+        int match = -1;
+        for (int o = 0; o < outputs && match < 0; o++) {
+            if (!(paired & (1u << o)) && tflite_session_tensor(features, true, o, &out) &&
+                same_shape(&in, &out)) {
+                match = o;
+            }
+        }
+        if (match >= 0) {
+            paired |= 1u << match;
+            s->state_input[s->num_states] = i;
+            s->state_output[s->num_states] = match;
+            s->num_states++;
+            s->state_bytes += view_bytes(&in.view);
+        } else if (s->chunk_input < 0) {
+            s->chunk_input = i;
+            s->chunk = (int)in.view.elements;
+        } else {
+            ESP_LOGE(TAG, "Feature model input %d has no state output", i);
+            return false;
+        }
+    }
+    
+    s->features_output = -1;
+    for (int o = 0; o < outputs; o++) {
+        if (!(paired & (1u << o))) {
+            s->features_output = o;
+        }
+    }
+    tflite_tensor_info_t out;
+    if (s->chunk_input < 0 || s->features_output < 0 ||
+        !tflite_session_tensor(features, true, s->features_output, &out) ||
+        out.view.type != TFLITE_INPUT_INT8 || out.view.elements > STREAMING_MAX_FEATURES) {
+        ESP_LOGE(TAG, "Feature model needs a chunk input and an int8 features output");
+        return false;
+    }
+    s->num_features = (int)out.view.elements;
+    
+    tflite_input_view_t head;
+    if (!tflite_session_input((tflite_session_t *)s->head, &head) ||
+        head.elements != (size_t)s->num_features) {
+        ESP_LOGE(TAG, "Head model does not take %d features", s->num_features);
+        return false;
+    }
+    return true;
+}
+
+static bool streaming_init(inference_engine_t *engine) {
+    inference_streaming_t *s = &engine->streaming;
+    s->resident_stream = -1;
+    s->features = tflite_session_create(cnn_stream_features_int8_model_tflite,
+                                        cnn_stream_features_int8_model_tflite_len);
+    s->head = tflite_session_create(cnn_stream_head_int8_model_tflite,
+                                    cnn_stream_head_int8_model_tflite_len);
+    if (!s->features || !s->head ||
+        !tflite_session_set_class_map((tflite_session_t *)s->head, &ml_trained_class_map) ||
+        !streaming_bind_tensors(s)) {
+        streaming_destroy(s);
+        return false;
+    }
+    
+    // Whole chunks per window and per hop
+    int hop = (int)engine->config.window_hop;
+    if (s->chunk <= 0 || ML_WINDOW_SIZE % s->chunk != 0 ||
+        ML_WINDOW_SIZE / s->chunk > STREAMING_MAX_CHUNKS ||
+        hop <= 0 || hop > ML_WINDOW_SIZE || hop % s->chunk != 0) {
+        ESP_LOGE(TAG, "Window %d / hop %d are not whole %d-sample chunks",
+                 ML_WINDOW_SIZE, hop, s->chunk);
+        streaming_destroy(s);
+        return false;
+    }
+    s->window_chunks = ML_WINDOW_SIZE / s->chunk;
+    s->hop_chunks = hop / s->chunk;
+    
+    size_t ring_bytes = (size_t)s->window_chunks * s->num_features;
+    size_t per_stream = ring_bytes + s->state_bytes;
+    uint8_t *block = heap_caps_calloc(1, INFERENCE_MAX_STREAMS * (sizeof(streaming_context_t) +
+                                      per_stream), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!block) {
+        streaming_destroy(s);
+        return false;
+    }
+    s->contexts = block;
+    uint8_t *buffers = block + INFERENCE_MAX_STREAMS * sizeof(streaming_context_t);
+    for (int i = 0; i < INFERENCE_MAX_STREAMS; i++) {
+        streaming_context_t *ctx = streaming_context(s, i);
+        ctx->ring = (int8_t *)(buffers + i * per_stream);
+        ctx->states = buffers + i * per_stream + ring_bytes;
+    }
+    return true;
+}
+
+static void streaming_destroy(inference_streaming_t *s) {
+    tflite_session_destroy((tflite_session_t *)s->features);
+    tflite_session_destroy((tflite_session_t *)s->head);
+    heap_caps_free(s->contexts);
+    s->features = NULL;
+    s->head = NULL;
+    s->contexts = NULL;
+}
+
+// Copy every state between the input tensors and a stream's buffer
+static void streaming_move_states(const inference_streaming_t *s, streaming_context_t *ctx,
+                                  bool save) {
+    uint8_t *saved = ctx->states;
+    for (int k = 0; k < s->num_states; k++) {
+        tflite_tensor_info_t in;
+        tflite_session_tensor((tflite_session_t *)s->features, false, s->state_input[k], &in);
+        size_t bytes = view_bytes(&in.view);
+        if (save) {
+            memcpy(saved, in.view.data, bytes);
+        } else {
+            memcpy(in.view.data, saved, bytes);
+        }
+        saved += bytes;
+    }
+}
+
+// States of the other streams stay in their buffers
+static streaming_context_t *streaming_make_resident(inference_streaming_t *s, int stream) {
+    streaming_context_t *ctx = streaming_context(s, stream);
+    if (s->resident_stream != stream) {
+        if (s->resident_stream >= 0) {
+            streaming_move_states(s, streaming_context(s, s->resident_stream), true);
+        }
+        if (ctx->primed) {
+            streaming_move_states(s, ctx, false);
+        }
+        s->resident_stream = stream;
+    }
+    return ctx;
+}
+
+// Zero states (the causal padding seen in training) and an empty ring
+static void streaming_clear(const inference_streaming_t *s, streaming_context_t *ctx,
+                            int8_t features_zero_point) {
+    for (int k = 0; k < s->num_states; k++) {
+        tflite_tensor_info_t in;
+        tflite_session_tensor((tflite_session_t *)s->features, false, s->state_input[k], &in);
+        if (in.view.type == TFLITE_INPUT_INT8) {
+            memset(in.view.data, (int8_t)in.view.zero_point, in.view.elements);
+        } else {
+            memset(in.view.data, 0, view_bytes(&in.view));
+        }
+    }
+    memset(ctx->ring, features_zero_point, (size_t)s->window_chunks * s->num_features);
+    memset(ctx->sums, 0, sizeof(ctx->sums));
+    ctx->next = 0;
+}
+
+// New states become the next chunk's input, requantized if their
+// quantization differs
+static void streaming_carry_states(const inference_streaming_t *s) {
+    tflite_session_t *features = (tflite_session_t *)s->features;
+    for (int k = 0; k < s->num_states; k++) {
+        tflite_tensor_info_t in, out;
+        tflite_session_tensor(features, false, s->state_input[k], &in);
+        tflite_session_tensor(features, true, s->state_output[k], &out);
+        if (in.view.type != TFLITE_INPUT_INT8 ||
+            (in.view.scale == out.view.scale && in.view.zero_point == out.view.zero_point)) {
+            memcpy(in.view.data, out.view.data, view_bytes(&in.view));
+            continue;
+        }
+        const int8_t *from = (const int8_t *)out.view.data;
+        int8_t *to = (int8_t *)in.view.data;
+        float ratio = out.view.scale / in.view.scale;
+        for (size_t i = 0; i < in.view.elements; i++) {
+            int32_t q = (int32_t)lrintf((from[i] - out.view.zero_point) * ratio) +
+                        in.view.zero_point;
+            to[i] = (int8_t)(q < -128 ? -128 : (q > 127 ? 127 : q));
+        }
+    }
+}
+
+// Chunk samples are code / ML_ADC_MIDSCALE - 1: no window function or
+// normalization, both of which need the whole window
+static bool streaming_fill_chunk(const tflite_input_view_t *view, const uint16_t *codes, int n) {
+    float *x = (view->type == TFLITE_INPUT_FLOAT32) ? (float *)view->data : s_window_samples;
+    for (int i = 0; i < n; i++) {
+        x[i] = codes[i] * (1.0f / ML_ADC_MIDSCALE) - 1.0f;
+    }
+    if (view->type == TFLITE_INPUT_INT8) {
+        return quantize_samples_int8(x, n, view->scale, view->zero_point, (int8_t *)view->data);
+    }
+    return true;
+}
+
+// Feature layers on the window's new chunks (all of them after a restart),
+// then the head on the average of the last window_chunks chunk features:
+// the full model's global average pool
+static bool streaming_run(inference_engine_t *engine, const uint16_t *codes, int num_samples,
+                          inference_result_t *result) {
+    inference_streaming_t *s = &engine->streaming;
+    if (num_samples != ML_WINDOW_SIZE) {
+        ESP_LOGE(TAG, "Streaming mode needs whole %d-sample windows", ML_WINDOW_SIZE);
+        return false;
+    }
+    tflite_session_t *features = (tflite_session_t *)s->features;
+    tflite_tensor_info_t chunk_in, features_out;
+    tflite_session_tensor(features, false, s->chunk_input, &chunk_in);
+    tflite_session_tensor(features, true, s->features_output, &features_out);
+    
+    streaming_context_t *ctx = streaming_make_resident(s, engine->stream);
+    int first = s->window_chunks - s->hop_chunks;
+    if (!ctx->primed) {
+        streaming_clear(s, ctx, (int8_t)features_out.view.zero_point);
+        first = 0;
+        s->restarts++;
+    }
+    
+    uint64_t start = esp_timer_get_time();
+    for (int c = first; c < s->window_chunks; c++) {
+        if (!streaming_fill_chunk(&chunk_in.view, codes + c * s->chunk, s->chunk) ||
+            !tflite_session_invoke_raw(features)) {
+            ctx->primed = false;
+            return false;
+        }
+        streaming_carry_states(s);
+        
+        // Ring sums stay exact: only the evicted chunk's features leave them
+        const int8_t *q = (const int8_t *)features_out.view.data;
+        int8_t *slot = ctx->ring + ctx->next * s->num_features;
+        for (int f = 0; f < s->num_features; f++) {
+            ctx->sums[f] += q[f] - slot[f];
+            slot[f] = q[f];
+        }
+        ctx->next = (ctx->next + 1) % s->window_chunks;
+        s->chunks++;
+    }
+    ctx->primed = true;
+    uint64_t head_start = esp_timer_get_time();
+    
+    tflite_session_t *head = (tflite_session_t *)s->head;
+    tflite_input_view_t head_in;
+    tflite_session_input(head, &head_in);
+    float *mean = (head_in.type == TFLITE_INPUT_FLOAT32) ? (float *)head_in.data : s_window_samples;
+    float step = features_out.view.scale / s->window_chunks;
+    for (int f = 0; f < s->num_features; f++) {
+        mean[f] = ctx->sums[f] * step;
+    }
+    if (head_in.type == TFLITE_INPUT_INT8 &&
+        !quantize_samples_int8(mean, s->num_features, head_in.scale, head_in.zero_point,
+                               (int8_t *)head_in.data)) {
+        return false;
+    }
+    
+    int num_classes = 0;
+    bool success = tflite_session_invoke(head, result->probabilities, INFERENCE_MAX_CLASSES,
+                                         &num_classes);
+    uint64_t end = esp_timer_get_time();
+    metrics_record_stage(METRIC_STAGE_INVOKE, (uint32_t)(end - start));
+    stage_trace_mark(STAGE_TRACE_INVOKED);
+    s->feature_us += head_start - start;
+    s->head_us += end - head_start;
+    s->windows++;
+    if (success) {
+        set_probability_result(result, num_classes);
+    }
+    return success;
+}
+#endif
+
+void inference_streaming_reset(inference_engine_t *engine) {
+    if (!engine) return;
+    if (engine->spans) {
+        spectral_span_reset(&engine->spans[engine->stream]);
+    }
+    #ifdef CONFIG_MODEL_CNN_STREAMING
+    if (engine->mode != INFERENCE_MODE_STREAMING || !engine->streaming.contexts) return;
+    streaming_context(&engine->streaming, engine->stream)->primed = false;
+    #endif
+}
+
+void inference_streaming_log_stats(const inference_engine_t *engine) {
+    if (!engine || engine->mode != INFERENCE_MODE_STREAMING) return;
+    
+    const inference_streaming_t *s = &engine->streaming;
+    if (s->windows == 0 || s->chunks == 0) return;
+    ESP_LOGI(TAG, "Streaming: %lu windows, %.2f chunks/window, %lu restarts, "
+             "feature %llu us/chunk, head %llu us/window",
+             (unsigned long)s->windows, (float)s->chunks / s->windows,
+             (unsigned long)s->restarts, (unsigned long long)(s->feature_us / s->chunks),
+             (unsigned long long)(s->head_us / s->windows));
+}
+
+bool inference_input_format(const inference_engine_t *engine, preprocess_format_t *format) {
+    if (!engine || !engine->initialized || !format) {
+        return false;
+    }
+    
+    memset(format, 0, sizeof(preprocess_format_t));
+    // Streaming converts each new chunk itself: nothing to preprocess ahead
+    format->type = (engine->mode == INFERENCE_MODE_STREAMING) ? PREPROCESS_OUTPUT_NONE
+                                                              : PREPROCESS_OUTPUT_FLOAT32;
+    
+    #if TFLITE_ENABLED
+    // The ensemble's secondary copies the primary's input when it can
+    tflite_input_view_t view;
+    if ((engine->mode == INFERENCE_MODE_TFLITE || engine->mode == INFERENCE_MODE_ENSEMBLE) &&
+        engine->interpreter &&
+        tflite_session_input((tflite_session_t *)engine->interpreter, &view)) {
+        input_view_format(&view, format);
+    }
+    #endif
+    return true;
+}
+
+static bool run_window_once(inference_engine_t *engine,
+                            const uint16_t *codes,
+                            int num_samples,
+                            const window_moments_t *moments,
+                            const void *input,
+                            const preprocess_format_t *input_format,
+                            inference_result_t *result) {
+    if (!engine || !engine->initialized || !codes || !result || 
+        num_samples <= 0 || num_samples > ML_WINDOW_SIZE) {
+        ESP_LOGE(TAG, "Invalid parameters for inference_run_window");
+        return false;
+    }
+    
+    window_moments_t computed;
+    if (!moments) {
+        window_moments_compute(codes, num_samples, &computed);
+        moments = &computed;
+    }
+    
+    // Validate the raw signal from its moments (no float window needed)
+    #ifdef CONFIG_ENABLE_SIGNAL_VALIDATION
+    signal_stats_t stats;
+    window_moments_to_stats(moments, &stats);
+    signal_quality_t quality = validate_signal_stats(&stats);
+    if (quality != SIGNAL_OK) {
+        #ifdef CONFIG_DETAILED_LOGGING
+        ESP_LOGW(TAG, "Poor signal quality: %d", quality);
+        #endif
+        return false;
+    }
+    #endif
+    
+    memset(result, 0, sizeof(inference_result_t));
+    bool success = false;
+    
+    #if TFLITE_ENABLED
+    if (engine->mode == INFERENCE_MODE_ENSEMBLE) {
+        success = ensemble_run(engine, codes, NULL, num_samples, input, input_format, result);
+        if (success) {
+            record_inference(result);
+        }
+        return success;
+    }
+    #ifdef CONFIG_MODEL_CNN_STREAMING
+    if (engine->mode == INFERENCE_MODE_STREAMING) {
+        success = streaming_run(engine, codes, num_samples, result);
+        if (success) {
+            record_inference(result);
+        }
+        return success;
+    }
+    #endif
+    if (engine->mode == INFERENCE_MODE_TFLITE && engine->interpreter) {
+        tflite_session_t *session = (tflite_session_t *)engine->interpreter;
+        tflite_input_view_t view;
+        if (!tflite_session_input(session, &view) || view.elements < (size_t)num_samples) {
+            ESP_LOGE(TAG, "Input tensor does not fit the window");
+            return false;
+        }
+        
+        preprocess_format_t format;
+        input_view_format(&view, &format);
+        const void *ready = prepared_input(input, input_format, &format);
+        
+        // Copy the producer's preprocessed window, or preprocess (and
+        // quantize) straight into the input tensor
+        bool filled = true;
+        if (ready) {
+            memcpy(view.data, ready, num_samples * format_element_size(&format));
+            stage_trace_mark(STAGE_TRACE_PREPROCESSED);
+        } else {
+            uint64_t preprocess_start = esp_timer_get_time();
+            filled = preprocess_codes(&format, codes, num_samples, view.data);
+            metrics_record_stage(METRIC_STAGE_PREPROCESS,
+                                 (uint32_t)(esp_timer_get_time() - preprocess_start));
+            stage_trace_mark(STAGE_TRACE_PREPROCESSED);
+        }
+        if (!filled) {
+            return false;
+        }
+        
+        int num_classes = 0;
+        uint64_t invoke_start = esp_timer_get_time();
+        success = tflite_session_invoke(session, result->probabilities, 
+                                        INFERENCE_MAX_CLASSES, &num_classes);
+        metrics_record_stage(METRIC_STAGE_INVOKE, (uint32_t)(esp_timer_get_time() - invoke_start));
+        stage_trace_mark(STAGE_TRACE_INVOKED);
+        if (success) {
+            set_probability_result(result, num_classes);
+            record_inference(result);
+        }
+        return success;
+    }
+    #endif
+    
+    float *samples = (float *)prepared_input(input, input_format, &s_float_format);
+    if (!samples) {
+        uint64_t preprocess_start = esp_timer_get_time();
+        if (!preprocess_codes_float(codes, num_samples, s_window_samples)) {
+            return false;
+        }
+        metrics_record_stage(METRIC_STAGE_PREPROCESS,
+                             (uint32_t)(esp_timer_get_time() - preprocess_start));
+        stage_trace_mark(STAGE_TRACE_PREPROCESSED);
+        samples = s_window_samples;
+    }
+    
+    if (engine->mode == INFERENCE_MODE_CASCADE) {
+        // Records its stage timings itself
+        success = cascade_inference(engine, samples, num_samples, moments, 
+                                    stream_span(engine), result);
+    } else {
+        uint64_t invoke_start = esp_timer_get_time();
+        if (engine->mode == INFERENCE_MODE_FFT_BASED) {
+            success = fft_inference(samples, num_samples, stream_span(engine), result);
+        } else {
+            signal_features_t features;
+            extract_features_from_moments(moments, samples, num_samples, &features);
+            success = classify_features(&features, result);
+        }
+        metrics_record_stage(METRIC_STAGE_INVOKE, (uint32_t)(esp_timer_get_time() - invoke_start));
+        stage_trace_mark(STAGE_TRACE_INVOKED);
+    }
+    
+    if (success) {
+        record_inference(result);
+    }
+    return success;
+}
+
+// Process inference result (simplified)
+void process_inference_result(inference_result_t *result, 
+                              ml_class_t ground_truth,
+                              clock_sync_t *sync) {
+    if (!result) return;
+    
+    #ifdef CONFIG_DETAILED_LOGGING
+    uint32_t timestamp = sync ? get_synchronized_timestamp(sync) : result->timestamp_ms;
+    ESP_LOGI(TAG, "Inference: %s (%.2f) at %u ms", 
+             ml_class_to_string(result->predicted_class), result->confidence, timestamp);
+    #endif
+    
+    if (ground_truth != ML_CLASS_UNKNOWN) {
+        #ifdef CONFIG_DETAILED_LOGGING
+        ESP_LOGI(TAG, "Ground truth: %s", ml_class_to_string(ground_truth));
+        #endif
+        
+        if (result->predicted_class == ground_truth) {
+            metrics_record_correct_prediction();
+            #ifdef CONFIG_DETAILED_LOGGING
+            ESP_LOGI(TAG, "✓ CORRECT");
+            #endif
+        } else {
+            metrics_record_incorrect_prediction();
+            #ifdef CONFIG_DETAILED_LOGGING
+            ESP_LOGW(TAG, "✗ INCORRECT (expected: %s)", ml_class_to_string(ground_truth));
+            #endif
+        }
+    }
+}
+
+bool inference_preload_model(inference_engine_t *engine, model_type_t type) {
+    #if TFLITE_ENABLED
+    if (!engine || !engine->initialized || engine->config.mode != INFERENCE_MODE_TFLITE ||
+        !model_registry_get(type)) {
+        return false;
+    }
+    if (engine->acquired_models & (1u << type)) {
+        return true;
+    }
+    if (!model_registry_acquire(type, true)) {
+        ESP_LOGW(TAG, "Failed to preload model type %d", type);
+        return false;
+    }
+    engine->acquired_models |= 1u << type;
+    return true;
+    #else
+    return false;
+    #endif
+}
+
+bool inference_switch_model(inference_engine_t *engine, model_type_t type) {
+    #if TFLITE_ENABLED
+    if (!engine || !engine->initialized || engine->config.mode != INFERENCE_MODE_TFLITE) {
+        return false;
+    }
+    if (type == engine->active_model) {
+        return true;
+    }
+    
+    if (type == MODEL_NONE) {
+        engine->mode = INFERENCE_MODE_HEURISTIC;
+        engine->interpreter = NULL;
+    } else {
+        if (!inference_preload_model(engine, type)) {
+            return false;
+        }
+        // Already resident: returns the existing session
+        const model_registry_entry_t *entry = model_registry_get(type);
+        engine->interpreter = model_registry_acquire(type, true);
+        engine->model_data = (void *)entry->data;
+        engine->model_size = entry->size;
+        engine->mode = INFERENCE_MODE_TFLITE;
+    }
+    engine->active_model = type;
+    
+    // Confidences of different models are not comparable
+    voting_reset_all(engine);
+    return true;
+    #else
+    return false;
+    #endif
+}
+
+bool inference_reload_models(inference_engine_t *engine) {
+    #if TFLITE_ENABLED
+    if (!engine || !engine->initialized || !model_registry_update_pending()) {
+        return false;
+    }
+    
+    // Every session is rebuilt on the new weights
+    uint32_t wanted = engine->acquired_models;
+    engine->acquired_models = 0;
+    engine->interpreter = NULL;
+    memset(engine->cascade.sessions, 0, sizeof(engine->cascade.sessions));
+    memset(engine->ensemble.sessions, 0, sizeof(engine->ensemble.sessions));
+    bool loaded = model_registry_reload();
+    
+    for (int type = 0; type < MODEL_TYPE_COUNT; type++) {
+        if ((wanted & (1u << type)) && model_registry_acquire((model_type_t)type, true)) {
+            engine->acquired_models |= 1u << type;
+        }
+    }
+    
+    if (engine->mode == INFERENCE_MODE_CASCADE) {
+        engine->cascade.sessions[CASCADE_STAGE_MLP] = model_registry_acquire(MODEL_MLP_INT8, true);
+        engine->cascade.sessions[CASCADE_STAGE_CNN] = model_registry_acquire(MODEL_CNN_INT8, true);
+        engine->interpreter = engine->cascade.sessions[CASCADE_STAGE_CNN];
+        if (!engine->interpreter || !engine->cascade.sessions[CASCADE_STAGE_MLP]) {
+            ESP_LOGE(TAG, "Cascade models missing after reload, using the heuristic");
+            engine->mode = INFERENCE_MODE_HEURISTIC;
+        }
+    } else if (engine->mode == INFERENCE_MODE_ENSEMBLE) {
+        // The worker is idle between windows; it picks up the new sessions
+        inference_ensemble_t *e = &engine->ensemble;
+        engine->interpreter = ensemble_acquire(e) ? e->sessions[ENSEMBLE_PRIMARY] : NULL;
+        if (!engine->interpreter) {
+            ESP_LOGE(TAG, "Ensemble models missing after reload, using the heuristic");
+            ensemble_stop_worker(e);
+            engine->mode = INFERENCE_MODE_HEURISTIC;
+        }
+    } else if (engine->mode == INFERENCE_MODE_TFLITE) {
+        // Already resident: returns the rebuilt session
+        engine->interpreter = model_registry_acquire(engine->active_model, true);
+        if (!engine->interpreter) {
+            ESP_LOGE(TAG, "Model type %d missing after reload, using the heuristic",
+                     engine->active_model);
+            engine->mode = INFERENCE_MODE_HEURISTIC;
+            engine->active_model = MODEL_NONE;
+        }
+    }
+    if (engine->interpreter) {
+        const model_registry_entry_t *entry = model_registry_get(engine->active_model);
+        engine->model_data = (void *)entry->data;
+        engine->model_size = entry->size;
+    }
+    
+    voting_reset_all(engine);
+    return loaded;
+    #else
+    return false;
+    #endif
+}
+
+void inference_deinit(inference_engine_t *engine) {
+    if (engine) {
+        #if TFLITE_ENABLED
+        ensemble_stop_worker(&engine->ensemble);
+        #ifdef CONFIG_MODEL_CNN_STREAMING
+        streaming_destroy(&engine->streaming);
+        #endif
+        for (int type = 0; type < MODEL_TYPE_COUNT; type++) {
+            if (engine->acquired_models & (1u << type)) {
+                model_registry_unload((model_type_t)type);
+            }
+        }
+        #endif
+        heap_caps_free(engine->spans);
+        engine->spans = NULL;
+        memset(&engine->cascade, 0, sizeof(inference_cascade_t));
+        memset(&engine->ensemble, 0, sizeof(inference_ensemble_t));
+        memset(&engine->streaming, 0, sizeof(inference_streaming_t));
+        engine->interpreter = NULL;
+        engine->acquired_models = 0;
+        engine->initialized = false;
+    }
+}
+
+void inference_get_memory_usage(inference_engine_t *engine, 
+                                size_t *ram_kb, 
+                                size_t *flash_kb) {
     if (ram_kb) *ram_kb = 0;
     if (flash_kb) *flash_kb = 0;
     
@@ -379,8 +1630,27 @@ void inference_get_memory_usage(inference_engine_t *engine,
         if (ram_kb) {
             // Estimate RAM usage
             if (engine->mode == INFERENCE_MODE_TFLITE) {
-                size_t arena_size = tflite_get_arena_size(engine->model_data, engine->model_size);
+                size_t arena_size = tflite_session_arena_size((tflite_session_t *)engine->interpreter);
                 *ram_kb = (arena_size + 1023) / 1024;  // Round up to KB
+            } else if (engine->mode == INFERENCE_MODE_CASCADE) {
+                size_t arena_size = 0;
+                for (int i = 0; i < CASCADE_STAGE_COUNT; i++) {
+                    arena_size += tflite_session_arena_size(
+                        (tflite_session_t *)engine->cascade.sessions[i]);
+                }
+                *ram_kb = (arena_size + 1023) / 1024;
+            } else if (engine->mode == INFERENCE_MODE_ENSEMBLE) {
+                size_t arena_size = 0;
+                for (int i = 0; i < ENSEMBLE_MEMBER_COUNT; i++) {
+                    arena_size += tflite_session_arena_size(
+                        (tflite_session_t *)engine->ensemble.sessions[i]);
+                }
+                *ram_kb = (arena_size + 1023) / 1024;
+            } else if (engine->mode == INFERENCE_MODE_STREAMING) {
+                size_t arena_size =
+                    tflite_session_arena_size((tflite_session_t *)engine->streaming.features) +
+                    tflite_session_arena_size((tflite_session_t *)engine->streaming.head);
+                *ram_kb = (arena_size + 1023) / 1024;
             } else {
                 *ram_kb = 2;  // Heuristic inference uses minimal RAM
             }
@@ -389,25 +1659,259 @@ void inference_get_memory_usage(inference_engine_t *engine,
     }
 }
 
-// Keep the original header functions
+// ===== Temporal voting =====
+
+void inference_voting_reset(inference_engine_t *engine) {
+    if (!engine) return;
+    voter_reset(&engine->voters[engine->stream]);
+}
+
+void inference_select_stream(inference_engine_t *engine, int stream) {
+    if (!engine || stream < 0 || stream >= INFERENCE_MAX_STREAMS) return;
+    engine->stream = stream;
+}
+
+// Add one result to the history; returns true if the vote is decisive
+static bool voter_add(inference_voter_t *v, const inference_config_t *cfg, 
+                      const inference_result_t *latest) {
+    uint32_t window = cfg->voting_window;
+    if (window < 1) window = 1;
+    if (window > VOTING_MAX_WINDOW) window = VOTING_MAX_WINDOW;
+    
+    int num_classes = latest->num_classes;
+    if (num_classes > VOTING_MAX_CLASSES) num_classes = VOTING_MAX_CLASSES;
+    v->num_classes = num_classes;
+    
+    if (v->head >= window) v->head = 0;
+    v->classes[v->head] = (int8_t)latest->predicted_class;
+    v->confidences[v->head] = latest->confidence;
+    v->head = (v->head + 1) % window;
+    if (v->filled < window) v->filled++;
+    
+    // Exponential average of the probability vector, weighted by confidence
+    float alpha = (cfg->ema_alpha > 0.0f ? cfg->ema_alpha : 0.5f) * latest->confidence;
+    if (alpha > 1.0f) alpha = 1.0f;
+    for (int k = 0; k < num_classes; k++) {
+        v->scores[k] += alpha * (latest->probabilities[k] - v->scores[k]);
+    }
+    
+    uint32_t counts[VOTING_MAX_CLASSES] = {0};
+    float conf_sums[VOTING_MAX_CLASSES] = {0};
+    for (uint32_t i = 0; i < v->filled; i++) {
+        int c = v->classes[i];
+        if (c >= 0 && c < num_classes) {
+            counts[c]++;
+            conf_sums[c] += v->confidences[i];
+        }
+    }
+    
+    int winner = 0;
+    if (cfg->voting_method == VOTING_EMA) {
+        float total = 0.0f;
+        for (int k = 0; k < num_classes; k++) {
+            total += v->scores[k];
+        }
+        winner = ml_argmax(v->scores, num_classes);
+        for (int k = 0; k < num_classes; k++) {
+            v->probabilities[k] = (total > 1e-6f) ? v->scores[k] / total : 0.0f;
+        }
+    } else {
+        // Most votes; ties go to the higher summed confidence
+        for (int k = 1; k < num_classes; k++) {
+            if (counts[k] > counts[winner] ||
+                (counts[k] == counts[winner] && conf_sums[k] > conf_sums[winner])) {
+                winner = k;
+            }
+        }
+        // Vote shares weighted by confidence
+        for (int k = 0; k < num_classes; k++) {
+            v->probabilities[k] = conf_sums[k] / v->filled;
+        }
+    }
+    v->voted_class = winner;
+    v->voted_confidence = v->probabilities[winner];
+    
+    // Decisive: full, unanimous history and a confident vote (0 disables)
+    return cfg->decisive_confidence > 0.0f &&
+           v->filled == window &&
+           counts[winner] == window &&
+           v->voted_confidence >= cfg->decisive_confidence;
+}
+
+// Largest change in raw moments since the decisive vote that still counts
+// as the same signal: RMS and mean as a share of the decisive RMS, zero
+// crossings as a share of the decisive count (at least a few, for noise)
+#define VOTING_DRIFT_RMS_FRACTION         0.15f
+#define VOTING_DRIFT_CROSSINGS_FRACTION   0.25f
+#define VOTING_DRIFT_MIN_CROSSINGS        4
+
+// Whether a window's moments moved away from those of the decisive vote
+static bool moments_drifted(const window_moments_t *anchor, const window_moments_t *latest) {
+    if (anchor->count == 0 || latest->count == 0) {
+        return true;
+    }
+    float anchor_mean = (float)anchor->sum / anchor->count;
+    float latest_mean = (float)latest->sum / latest->count;
+    float anchor_rms = sqrtf(fmaxf((float)anchor->sum_sq / anchor->count - 
+                                   anchor_mean * anchor_mean, 0.0f));
+    float latest_rms = sqrtf(fmaxf((float)latest->sum_sq / latest->count - 
+                                   latest_mean * latest_mean, 0.0f));
+    float level_drift = VOTING_DRIFT_RMS_FRACTION * anchor_rms;
+    
+    int crossing_drift = (int)(VOTING_DRIFT_CROSSINGS_FRACTION * anchor->zero_crossings);
+    if (crossing_drift < VOTING_DRIFT_MIN_CROSSINGS) {
+        crossing_drift = VOTING_DRIFT_MIN_CROSSINGS;
+    }
+    
+    return fabsf(latest_rms - anchor_rms) > level_drift ||
+           fabsf(latest_mean - anchor_mean) > level_drift ||
+           abs((int)latest->zero_crossings - (int)anchor->zero_crossings) > crossing_drift;
+}
+
+// Cheap classifier used while the vote is decisive. Only a spectral
+// answer counts: the heuristic fallback can't tell the waveforms apart.
+static bool cheap_inference(float *samples, const uint16_t *codes, int num_samples,
+                            const spectral_span_t *span, inference_result_t *result) {
+    memset(result, 0, sizeof(inference_result_t));
+    
+    float *window = samples;
+    if (!window) {
+        if (!preprocess_codes_float(codes, num_samples, s_window_samples)) {
+            return false;
+        }
+        window = s_window_samples;
+    }
+    
+    uint64_t start_time = esp_timer_get_time();
+    bool success = spectral_inference(window, num_samples, span, result);
+    metrics_record_stage(METRIC_STAGE_INVOKE, (uint32_t)(esp_timer_get_time() - start_time));
+    stage_trace_mark(STAGE_TRACE_INVOKED);
+    if (!success) {
+        return false;
+    }
+    record_inference(result);
+    return true;
+}
+
+static void fill_voted_result(const inference_voter_t *v, inference_result_t *result) {
+    memcpy(result->probabilities, v->probabilities, v->num_classes * sizeof(float));
+    result->num_classes = v->num_classes;
+    result->predicted_class = (ml_class_t)v->voted_class;
+    result->confidence = v->voted_confidence;
+    result->is_voted_result = true;
+}
+
+// One voted decision from either a float window or a raw ADC window
+static bool voted_run(inference_engine_t *engine, const inference_config_t *cfg,
+                      float *samples, const uint16_t *codes, int num_samples,
+                      const window_moments_t *moments, const void *input,
+                      const preprocess_format_t *input_format, inference_result_t *final_result) {
+    inference_voter_t *v = &engine->voters[engine->stream];
+    inference_result_t latest;
+    
+    window_moments_t computed;
+    if (codes && !moments) {
+        window_moments_compute(codes, num_samples, &computed);
+        moments = &computed;
+    }
+    
+    if (v->skip_remaining > 0 && v->voted_class >= 0) {
+        // Raw windows must also still look like the decisive one
+        bool steady = !moments || !v->anchored || !moments_drifted(&v->anchor, moments);
+        // A producer-preprocessed float window saves the cheap path a pass
+        float *window = codes ? (float *)prepared_input(input, input_format, &s_float_format) : samples;
+        if (steady &&
+            cheap_inference(window, codes, num_samples, codes ? stream_span(engine) : NULL,
+                            &latest) &&
+            (int)latest.predicted_class == v->voted_class &&
+            latest.confidence >= cfg->confidence_threshold) {
+            v->skip_remaining--;
+            v->skipped_runs++;
+            *final_result = latest;
+            fill_voted_result(v, final_result);
+            return true;
+        }
+        // Cheap classifier no longer agrees: ask the model
+        v->skip_remaining = 0;
+    }
+    
+    bool success = codes ? run_window_once(engine, codes, num_samples, moments, 
+                                           input, input_format, &latest)
+                         : inference_run(engine, samples, num_samples, &latest);
+    if (!success) {
+        return false;
+    }
+    v->model_runs++;
+    
+    *final_result = latest;
+    if (latest.predicted_class < 0 || latest.predicted_class >= VOTING_MAX_CLASSES) {
+        // Not a votable class: pass through
+        return true;
+    }
+    
+    bool decisive = voter_add(v, cfg, &latest);
+    fill_voted_result(v, final_result);
+    
+    // Only worth skipping when the model is the expensive path
+    if (decisive && (engine->mode == INFERENCE_MODE_TFLITE ||
+                     engine->mode == INFERENCE_MODE_ENSEMBLE)) {
+        v->skip_remaining = cfg->decisive_skip;
+        v->anchored = (moments != NULL);
+        if (moments) {
+            v->anchor = *moments;
+        }
+        #ifdef CONFIG_DETAILED_LOGGING
+        ESP_LOGI(TAG, "Vote decisive: %s (%.2f), skipping %u model runs",
+                 ml_class_to_string((ml_class_t)v->voted_class), v->voted_confidence, 
+                 (unsigned)cfg->decisive_skip);
+        #endif
+    }
+    
+    return true;
+}
+
+// Run inference on a raw ADC window, voting if enabled in the engine config
+bool inference_run_prepared(inference_engine_t *engine,
+                            const uint16_t *codes,
+                            int num_samples,
+                            const window_moments_t *moments,
+                            const void *input,
+                            const preprocess_format_t *input_format,
+                            inference_result_t *result) {
+    if (engine && engine->initialized && engine->spans && codes &&
+        num_samples > 0 && num_samples <= ML_WINDOW_SIZE) {
+        // Every window extends the span, whichever path classifies it
+        spectral_span_push(&engine->spans[engine->stream], codes, num_samples,
+                           (int)engine->config.window_hop);
+    }
+    if (engine && engine->initialized && engine->config.enable_voting) {
+        if (!codes || !result || num_samples <= 0 || num_samples > ML_WINDOW_SIZE) {
+            ESP_LOGE(TAG, "Invalid parameters for inference_run_window");
+            return false;
+        }
+        return voted_run(engine, &engine->config, NULL, codes, num_samples, moments, 
+                         input, input_format, result);
+    }
+    return run_window_once(engine, codes, num_samples, moments, input, input_format, result);
+}
+
+bool inference_run_window(inference_engine_t *engine,
+                          const uint16_t *codes,
+                          int num_samples,
+                          const window_moments_t *moments,
+                          inference_result_t *result) {
+    return inference_run_prepared(engine, codes, num_samples, moments, NULL, NULL, result);
+}
+
 bool inference_run_with_voting(inference_engine_t *engine,
                                inference_config_t *config,
                                float *samples,
                                int buffer_size,
                                inference_result_t *final_result) {
-    // Simple implementation - average confidence over last N inferences
-    static inference_result_t results[10];
-    static int result_idx = 0;
-    
-    // Run single inference
-    if (!inference_run(engine, samples, buffer_size, &results[result_idx])) {
+    if (!engine || !engine->initialized || !samples || !final_result) {
         return false;
     }
     
-    // Simple voting: just return the latest result
-    // For proper voting, you'd track multiple results and choose the most common
-    memcpy(final_result, &results[result_idx], sizeof(inference_result_t));
-    
-    result_idx = (result_idx + 1) % 10;
-    return true;
-}
\ No newline at end of file
+    return voted_run(engine, config ? config : &engine->config, 
+                     samples, NULL, buffer_size, NULL, NULL, NULL, final_result);
+}
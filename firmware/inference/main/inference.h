@@ -6,6 +6,10 @@
 #include <stddef.h>
 #include "clock_sync.h"
 #include "benchmark.h"
+#include "window_stats.h"
+#include "preprocessing.h"
+#include "spectral_features.h"
+#include "ml_contract.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -16,9 +20,55 @@ typedef enum {
     INFERENCE_MODE_TFLITE,
     INFERENCE_MODE_SIMULATED,
     INFERENCE_MODE_HEURISTIC,
-    INFERENCE_MODE_FFT_BASED
+    INFERENCE_MODE_FFT_BASED,
+    INFERENCE_MODE_CASCADE,   // Cheap classifier, escalating to MLP_INT8 then CNN_INT8
+    INFERENCE_MODE_ENSEMBLE,  // Two models at once, one per core, probabilities fused
+    INFERENCE_MODE_STREAMING  // Split CNN: feature layers per new chunk, head per window
 } inference_mode_t;
 
+// Temporal aggregation of consecutive results
+typedef enum {
+    VOTING_MAJORITY,          // Most frequent class over the last voting_window results
+    VOTING_EMA                // Confidence-weighted exponential average of class scores
+} voting_method_t;
+
+#define VOTING_MAX_WINDOW 16
+#define VOTING_MAX_CLASSES ML_CLASS_COUNT
+#define INFERENCE_MAX_STREAMS 4     // Independent voting histories (ADC channels)
+
+// Cascade stages, cheapest first
+typedef enum {
+    CASCADE_STAGE_CHEAP,      // FFT or heuristic classifier
+    CASCADE_STAGE_MLP,        // MLP_INT8
+    CASCADE_STAGE_CNN,        // CNN_INT8, always accepted
+    CASCADE_STAGE_COUNT
+} cascade_stage_t;
+
+// Ensemble members
+typedef enum {
+    ENSEMBLE_PRIMARY,         // config.model_type, runs in the calling task
+    ENSEMBLE_SECONDARY,       // config.ensemble_partner, runs on the other core
+    ENSEMBLE_MEMBER_COUNT
+} ensemble_member_t;
+
+// Ensemble member models in Kconfig: the first runs on the inference core
+#if defined(CONFIG_INFERENCE_ENSEMBLE_CNN_HYBRID)
+#define ENSEMBLE_PRIMARY_MODEL    MODEL_CNN_INT8
+#define ENSEMBLE_SECONDARY_MODEL  MODEL_HYBRID_INT8
+#elif defined(CONFIG_INFERENCE_ENSEMBLE_MLP_HYBRID)
+#define ENSEMBLE_PRIMARY_MODEL    MODEL_MLP_INT8
+#define ENSEMBLE_SECONDARY_MODEL  MODEL_HYBRID_INT8
+#else
+#define ENSEMBLE_PRIMARY_MODEL    MODEL_CNN_INT8
+#define ENSEMBLE_SECONDARY_MODEL  MODEL_MLP_INT8
+#endif
+
+// How member probabilities are combined
+typedef enum {
+    ENSEMBLE_FUSION_WEIGHTED, // Fixed weights
+    ENSEMBLE_FUSION_GATED     // Weights scaled per window by each member's confidence
+} ensemble_fusion_t;
+
 // Inference configuration
 typedef struct {
     inference_mode_t mode;
@@ -27,18 +77,107 @@ typedef struct {
     uint32_t voting_window;
     bool enable_voting;
     bool enable_fft;
+    voting_method_t voting_method;
+    float ema_alpha;          // EMA weight of the newest result (0..1]
+    float decisive_confidence;// Voted confidence that counts as decisive
+    uint32_t decisive_skip;   // Model runs replaced by the cheap classifier once decisive
+    float cascade_margin;     // Cascade: share of (1 - confidence_threshold) the cheap
+                              // stage must add to be accepted (half of it for the MLP)
+    model_type_t ensemble_partner;   // Ensemble: secondary model
+    float ensemble_weight;    // Ensemble: primary's weight, the secondary gets the rest
+    ensemble_fusion_t ensemble_fusion;
+    uint32_t window_hop;      // Streaming, spectral span: new samples at the end of each window
 } inference_config_t;
 
-// Inference result
+// Largest class vector carried in a result
+#define INFERENCE_MAX_CLASSES ML_CLASS_COUNT
+
+// Inference result (caller-owned; no heap behind it)
 typedef struct {
-    char predicted_class[32];
-    float confidence;
-    float *probabilities;
+    ml_class_t predicted_class;
+    float confidence;                            // probabilities[predicted_class]
+    float probabilities[INFERENCE_MAX_CLASSES];  // Per-class scores, num_classes valid
     int num_classes;
     uint32_t timestamp_ms;
+    uint32_t window_id;                          // Source adc_window_t::sequence
     bool is_voted_result;
 } inference_result_t;
 
+// Voting state (per stream)
+typedef struct {
+    int8_t classes[VOTING_MAX_WINDOW];   // Ring of recent class indices
+    float confidences[VOTING_MAX_WINDOW];
+    uint32_t head;
+    uint32_t filled;
+    float scores[VOTING_MAX_CLASSES];    // EMA class scores
+    float probabilities[VOTING_MAX_CLASSES]; // Voted class distribution
+    int num_classes;
+    int voted_class;                     // -1 until the first vote
+    float voted_confidence;
+    uint32_t skip_remaining;             // Cheap-classifier runs left
+    window_moments_t anchor;             // Raw moments of the decisive vote's window
+    bool anchored;                       // anchor is valid (raw windows only)
+    uint32_t model_runs;
+    uint32_t skipped_runs;
+} inference_voter_t;
+
+// Cascade state and statistics (per engine)
+typedef struct {
+    void *sessions[CASCADE_STAGE_COUNT];          // TFLite sessions (NULL for the cheap stage)
+    float accept_confidence[CASCADE_STAGE_COUNT]; // Confidence that ends the cascade
+    uint32_t windows;
+    uint32_t accepted[CASCADE_STAGE_COUNT];       // Windows decided at each stage
+    uint64_t total_cost_us;
+} inference_cascade_t;
+
+// Ensemble state and statistics (per engine)
+typedef struct {
+    void *sessions[ENSEMBLE_MEMBER_COUNT];        // TFLite sessions
+    model_type_t models[ENSEMBLE_MEMBER_COUNT];
+    float weights[ENSEMBLE_MEMBER_COUNT];
+    ensemble_fusion_t fusion;
+    void *worker;             // Task invoking the secondary (NULL: both run in the caller)
+    void *start;              // Caller -> worker: secondary input is ready
+    void *done;               // Worker -> caller: secondary output is ready
+    bool stop;                // Worker exits at the next start
+    bool worker_ok;
+    int worker_classes;
+    uint32_t worker_us;
+    float worker_probabilities[INFERENCE_MAX_CLASSES];
+    uint32_t windows;
+    uint32_t disagreements;   // Members' top classes differed
+    uint64_t invoke_us[ENSEMBLE_MEMBER_COUNT];    // Per member, summed
+    uint64_t wall_us;         // Max of the two per window, summed
+} inference_ensemble_t;
+
+// Largest streaming feature model the engine binds
+#define STREAMING_MAX_STATES 4
+#define STREAMING_MAX_FEATURES 128
+#define STREAMING_MAX_CHUNKS 16   // Chunks per window
+
+// Streaming state and statistics (per engine)
+typedef struct {
+    void *features;           // TFLite session: chunk + states -> chunk features + states
+    void *head;               // TFLite session: window features -> class scores
+    int chunk;                // Samples per feature Invoke
+    int window_chunks;        // Chunk features averaged into one decision
+    int hop_chunks;           // Chunks each window adds
+    int num_features;
+    int chunk_input;          // Tensor indices in the feature session
+    int features_output;
+    int num_states;
+    int state_input[STREAMING_MAX_STATES];    // Paired by shape
+    int state_output[STREAMING_MAX_STATES];
+    size_t state_bytes;       // All states of one stream
+    void *contexts;           // Per stream: saved states and chunk feature ring
+    int resident_stream;      // Stream whose states sit in the input tensors (-1: none)
+    uint32_t windows;
+    uint32_t chunks;          // Feature Invokes
+    uint32_t restarts;        // Windows that rebuilt a stream's states from scratch
+    uint64_t feature_us;
+    uint64_t head_us;
+} inference_streaming_t;
+
 // Inference engine
 typedef struct {
     void *model_data;
@@ -49,6 +188,14 @@ typedef struct {
     void *output_tensor;
     bool initialized;
     inference_config_t config;
+    inference_voter_t voters[INFERENCE_MAX_STREAMS];
+    int stream;                   // Stream the next run votes into
+    inference_cascade_t cascade;
+    inference_ensemble_t ensemble;
+    inference_streaming_t streaming;
+    spectral_span_t *spans;       // Per stream, in spectral modes (NULL otherwise)
+    model_type_t active_model;    // Model running now (config.model_type unless switched)
+    uint32_t acquired_models;     // Bit per model_type_t this engine holds a session of
 } inference_engine_t;
 
 // Feature extraction structure
@@ -84,13 +231,75 @@ bool inference_run(inference_engine_t *engine,
                    int num_samples, 
                    inference_result_t *result);
 
+/**
+ * @brief Run inference on a raw ADC window
+ * 
+ * Preprocessing is fused with the conversion from ADC codes. For TFLite
+ * models the result is written (and quantized) directly into the input
+ * tensor; other modes preprocess into an internal float buffer.
+ * Signal validation and the heuristic's time-domain features use the
+ * window's raw moments instead of rescanning the samples.
+ * @param engine Inference engine
+ * @param codes Raw ADC codes (not modified)
+ * @param num_samples Number of samples (at most ML_WINDOW_SIZE)
+ * @param moments Moments of the window (NULL to compute them here)
+ * @param result Inference result
+ * @return true if inference successful
+ */
+bool inference_run_window(inference_engine_t *engine,
+                          const uint16_t *codes,
+                          int num_samples,
+                          const window_moments_t *moments,
+                          inference_result_t *result);
+
+/**
+ * @brief Format a raw window must be preprocessed into for this engine
+ * 
+ * The model's input tensor type and quantization for TFLite, float
+ * samples otherwise. Lets the acquisition side preprocess ahead of time.
+ * @param engine Inference engine
+ * @param format Output format
+ * @return true if the engine is initialized
+ */
+bool inference_input_format(const inference_engine_t *engine, preprocess_format_t *format);
+
+/**
+ * @brief Run inference on a raw ADC window preprocessed by the caller
+ * 
+ * Same as inference_run_window(), but when input_format matches
+ * inference_input_format() the preprocessed input is copied into the
+ * model instead of being recomputed from the codes.
+ * @param engine Inference engine
+ * @param codes Raw ADC codes (not modified)
+ * @param num_samples Number of samples (at most ML_WINDOW_SIZE)
+ * @param moments Moments of the window (NULL to compute them here)
+ * @param input Preprocessed window (may be NULL)
+ * @param input_format Format of input (may be NULL)
+ * @param result Inference result
+ * @return true if inference successful
+ */
+bool inference_run_prepared(inference_engine_t *engine,
+                            const uint16_t *codes,
+                            int num_samples,
+                            const window_moments_t *moments,
+                            const void *input,
+                            const preprocess_format_t *input_format,
+                            inference_result_t *result);
+
 /**
  * @brief Run inference with voting system
  * 
+ * Aggregates successive results with config->voting_method. Once the vote
+ * is decisive (all recent votes agree, confidence >= decisive_confidence)
+ * the next decisive_skip model runs are replaced by the spectral/heuristic
+ * classifier; the model runs again as soon as that disagrees with the
+ * vote or drops below confidence_threshold. inference_run_window()
+ * applies the same voting when engine->config.enable_voting is set.
+ * 
  * @param engine Inference engine
- * @param config Inference configuration
- * @param samples Input samples (circular buffer)
- * @param buffer_size Total buffer size
+ * @param config Inference configuration (NULL to use the engine's)
+ * @param samples Input samples (preprocessed window)
+ * @param buffer_size Number of samples
  * @param final_result Final voted result
  * @return true if successful
  */
@@ -100,6 +309,95 @@ bool inference_run_with_voting(inference_engine_t *engine,
                                int buffer_size,
                                inference_result_t *final_result);
 
+/**
+ * @brief Clear the voting history (e.g. after a known signal change)
+ * 
+ * Only the history of the selected stream is cleared.
+ * @param engine Inference engine
+ */
+void inference_voting_reset(inference_engine_t *engine);
+
+/**
+ * @brief Select the stream whose voting history later runs use
+ * 
+ * Windows of different ADC channels share the engine's model but not
+ * their votes. Until called, everything votes into stream 0.
+ * @param engine Inference engine
+ * @param stream Stream index (0..INFERENCE_MAX_STREAMS-1)
+ */
+void inference_select_stream(inference_engine_t *engine, int stream);
+
+/**
+ * @brief Start the selected stream's carried state over
+ * 
+ * Streaming mode then runs the whole next window through the feature
+ * layers instead of only its new chunks, and spectral modes stop
+ * analyzing spans across the break. Call when the next window does not
+ * directly follow the stream's last one (dropped or shed windows,
+ * sampling gaps); no-op in the other modes.
+ * @param engine Inference engine
+ */
+void inference_streaming_reset(inference_engine_t *engine);
+
+/**
+ * @brief Build a model's session ahead of a later inference_switch_model()
+ * 
+ * The session is resident, so switching to it never rebuilds an
+ * interpreter. TFLite mode only.
+ * @param engine Inference engine
+ * @param type Model type
+ * @return true if the session is ready
+ */
+bool inference_preload_model(inference_engine_t *engine, model_type_t type);
+
+/**
+ * @brief Run a different model from the next window on
+ * 
+ * For engines initialized in TFLite mode. MODEL_NONE switches to the
+ * heuristic classifier. The voting history is cleared, and the input
+ * format may change: republish inference_input_format() to the producer.
+ * @param engine Inference engine
+ * @param type Model type (MODEL_NONE for the heuristic)
+ * @return true if switched
+ */
+bool inference_switch_model(inference_engine_t *engine, model_type_t type);
+
+/**
+ * @brief Swap in a pending model store update between two windows
+ * 
+ * Rebuilds every session the engine holds on the new weights, keeping the
+ * running model; models the update lacks fall back to the heuristic.
+ * Must run in the task that runs inference. Republish
+ * inference_input_format() afterwards: quantization may have changed.
+ * @param engine Inference engine
+ * @return true if new models were loaded
+ */
+bool inference_reload_models(inference_engine_t *engine);
+
+/**
+ * @brief Log cascade escalation rates and average cost per window
+ * 
+ * No-op unless the engine runs in INFERENCE_MODE_CASCADE.
+ * @param engine Inference engine
+ */
+void inference_cascade_log_stats(const inference_engine_t *engine);
+
+/**
+ * @brief Log ensemble disagreement and per-core versus wall-clock Invoke time
+ * 
+ * No-op unless the engine runs in INFERENCE_MODE_ENSEMBLE.
+ * @param engine Inference engine
+ */
+void inference_ensemble_log_stats(const inference_engine_t *engine);
+
+/**
+ * @brief Log streaming feature and head Invoke times and state restarts
+ * 
+ * No-op unless the engine runs in INFERENCE_MODE_STREAMING.
+ * @param engine Inference engine
+ */
+void inference_streaming_log_stats(const inference_engine_t *engine);
+
 /**
  * @brief Extract features from signal for heuristic classification
  * 
@@ -113,11 +411,11 @@ void extract_features(float *samples, int num_samples, signal_features_t *featur
  * @brief Process inference result (logging, metrics, etc.)
  * 
  * @param result Inference result
- * @param ground_truth Ground truth label (if available)
+ * @param ground_truth Ground truth class (ML_CLASS_UNKNOWN if unlabeled)
  * @param sync Clock synchronization info
  */
 void process_inference_result(inference_result_t *result, 
-                              const char *ground_truth,
+                              ml_class_t ground_truth,
                               clock_sync_t *sync);
 
 /**
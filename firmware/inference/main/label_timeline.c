@@ -0,0 +1,88 @@
+#include "label_timeline.h"
+#include <string.h>
+
+static const label_change_t *change_at(const label_timeline_t *t, uint32_t i) {
+    return &t->changes[(t->head + i) % LABEL_TIMELINE_DEPTH];
+}
+
+void label_timeline_init(label_timeline_t *timeline) {
+    if (!timeline) return;
+    memset(timeline, 0, sizeof(label_timeline_t));
+}
+
+void label_timeline_add(label_timeline_t *timeline, int64_t time_us, ml_class_t label) {
+    if (!timeline) return;
+    
+    if (timeline->count > 0) {
+        const label_change_t *latest = change_at(timeline, timeline->count - 1);
+        if (latest->label == label) {
+            return;
+        }
+        if (time_us < latest->time_us) {
+            time_us = latest->time_us;
+        }
+    }
+    
+    if (timeline->count == LABEL_TIMELINE_DEPTH) {
+        // Drop the oldest change
+        timeline->head = (timeline->head + 1) % LABEL_TIMELINE_DEPTH;
+        timeline->count--;
+    }
+    
+    label_change_t *slot = &timeline->changes[(timeline->head + timeline->count) % LABEL_TIMELINE_DEPTH];
+    slot->time_us = time_us;
+    slot->label = label;
+    timeline->count++;
+}
+
+bool label_timeline_lookup(const label_timeline_t *timeline, int64_t start_us, int64_t end_us,
+                           label_span_t *span) {
+    if (!timeline || !span) return false;
+    
+    span->label = ML_CLASS_UNKNOWN;
+    span->coverage = 0.0f;
+    span->transition = false;
+    if (end_us <= start_us || timeline->count == 0) {
+        return false;
+    }
+    
+    // Time each class was active inside the span
+    int64_t active_us[ML_CLASS_COUNT] = {0};
+    int labels_seen = 0;
+    
+    for (uint32_t i = 0; i < timeline->count; i++) {
+        const label_change_t *c = change_at(timeline, i);
+        int64_t from = c->time_us;
+        int64_t to = (i + 1 < timeline->count) ? change_at(timeline, i + 1)->time_us : INT64_MAX;
+        
+        if (from < start_us) from = start_us;
+        if (to > end_us) to = end_us;
+        if (to <= from) {
+            continue;
+        }
+        
+        labels_seen++;
+        if (c->label >= 0 && c->label < ML_CLASS_COUNT) {
+            active_us[c->label] += to - from;
+        }
+    }
+    
+    // A change strictly inside the span makes it a transition window
+    int64_t first = change_at(timeline, 0)->time_us;
+    span->transition = labels_seen > 1 || (first > start_us && first < end_us);
+    
+    int best = -1;
+    for (int k = 0; k < ML_CLASS_COUNT; k++) {
+        if (active_us[k] > 0 && (best < 0 || active_us[k] > active_us[best])) {
+            best = k;
+        }
+    }
+    if (best < 0) {
+        return false;
+    }
+    
+    span->label = (ml_class_t)best;
+    span->coverage = (float)active_us[best] / (float)(end_us - start_us);
+    return true;
+}
+
@@ -0,0 +1,77 @@
+#ifndef LABEL_TIMELINE_H
+#define LABEL_TIMELINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ml_contract.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LABEL_TIMELINE_DEPTH 16
+
+// One ground-truth change: 'label' is active from time_us on
+typedef struct {
+    int64_t time_us;
+    ml_class_t label;
+} label_change_t;
+
+/**
+ * @brief Recent ground-truth changes in generator time
+ * 
+ * Keeps the last LABEL_TIMELINE_DEPTH changes so a window can be scored
+ * against the label that was actually active while it was sampled, not
+ * whichever label arrived last.
+ */
+typedef struct {
+    label_change_t changes[LABEL_TIMELINE_DEPTH];
+    uint32_t head;                // Index of the oldest change
+    uint32_t count;
+} label_timeline_t;
+
+// Ground truth of one window span
+typedef struct {
+    ml_class_t label;             // Majority label (ML_CLASS_UNKNOWN if none)
+    float coverage;               // Fraction of the span covered by 'label'
+    bool transition;              // Label changed inside the span
+} label_span_t;
+
+/**
+ * @brief Reset a timeline to empty
+ * 
+ * @param timeline Timeline
+ */
+void label_timeline_init(label_timeline_t *timeline);
+
+/**
+ * @brief Record a label change
+ * 
+ * Repeats of the current label are ignored. Changes must arrive in time
+ * order; a change earlier than the latest one is clamped to it.
+ * 
+ * @param timeline Timeline
+ * @param time_us Generator time the label became active
+ * @param label New label
+ */
+void label_timeline_add(label_timeline_t *timeline, int64_t time_us, ml_class_t label);
+
+/**
+ * @brief Find the label active for the majority of [start_us, end_us]
+ * 
+ * Time before the oldest retained change counts as unknown.
+ * 
+ * @param timeline Timeline
+ * @param start_us Span start (generator time)
+ * @param end_us Span end (generator time)
+ * @param span Output span ground truth
+ * @return true if any part of the span has a known label
+ */
+bool label_timeline_lookup(const label_timeline_t *timeline, int64_t start_us, int64_t end_us,
+                           label_span_t *span);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LABEL_TIMELINE_H */
@@ -10,67 +10,163 @@
 
 static const char *TAG = "METRICS";
 
-static metrics_t s_metrics = {0};
-static portMUX_TYPE s_metrics_mutex = portMUX_INITIALIZER_UNLOCKED;
+// Per-core counter blocks: a core only ever writes its own block, with
+// relaxed atomics so tasks preempting each other on that core stay
+// consistent without disabling interrupts. Readers merge the blocks.
+typedef struct {
+    uint32_t count;
+    uint32_t total_lo;            // 64-bit total split for 32-bit atomics
+    uint32_t total_hi;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint32_t buckets[METRICS_HISTOGRAM_BUCKETS];
+} stage_block_t;
+
+typedef struct {
+    stage_block_t stages[METRIC_STAGE_COUNT];
+    uint32_t correct_predictions;
+    uint32_t total_predictions;
+    uint32_t transition_correct;
+    uint32_t transition_predictions;
+    uint32_t detections_missed;
+    uint32_t windows_dropped;
+    uint32_t windows_gapped;
+    uint32_t windows_rejected[SIGNAL_GATE_COUNT];
+} core_block_t;
+
+static core_block_t s_blocks[portNUM_PROCESSORS];
+
+// Startup milestones, set once
+static uint32_t s_engine_ready_ms = 0;
+static uint32_t s_first_decision_ms = 0;
+
+// Heap figures are sampled by one task at a time
+static size_t s_peak_heap_usage = 0;
+static size_t s_current_heap_usage = 0;
+
+#define RELAXED __ATOMIC_RELAXED
+
+static inline core_block_t *local_block(void)
+{
+    return &s_blocks[xPortGetCoreID()];
+}
+
+static int bucket_index(uint32_t us)
+{
+    if (us < 4) {
+        return (int)us;
+    }
+    int octave = 31 - __builtin_clz(us);
+    int index = 4 * (octave - 1) + (int)((us >> (octave - 2)) & 3);
+    return index < METRICS_HISTOGRAM_BUCKETS ? index : METRICS_HISTOGRAM_BUCKETS - 1;
+}
+
+// Largest value that maps to a bucket
+static uint32_t bucket_upper_us(int index)
+{
+    if (index < 4) {
+        return (uint32_t)index;
+    }
+    int octave = index / 4 + 1;
+    uint32_t sub = index % 4;
+    return ((4 + sub + 1) << (octave - 2)) - 1;
+}
+
+static void reset_blocks(void)
+{
+    memset(s_blocks, 0, sizeof(s_blocks));
+    for (int c = 0; c < portNUM_PROCESSORS; c++) {
+        for (int i = 0; i < METRIC_STAGE_COUNT; i++) {
+            s_blocks[c].stages[i].min_us = UINT32_MAX;
+        }
+    }
+    s_peak_heap_usage = 0;
+    s_current_heap_usage = 0;
+}
 
 void metrics_init(void)
 {
-    portENTER_CRITICAL(&s_metrics_mutex);
-    memset(&s_metrics, 0, sizeof(metrics_t));
-    s_metrics.min_inference_time_us = UINT64_MAX;
-    portEXIT_CRITICAL(&s_metrics_mutex);
-    
+    reset_blocks();
     ESP_LOGI(TAG, "Metrics system initialized");
 }
 
-void metrics_record_inference_time(uint64_t time_us)
+void metrics_record_stage(metric_stage_t stage, uint32_t duration_us)
 {
-    portENTER_CRITICAL(&s_metrics_mutex);
+    if (stage < 0 || stage >= METRIC_STAGE_COUNT) return;
     
-    s_metrics.total_inference_time_us += time_us;
-    s_metrics.inference_count++;
+    stage_block_t *b = &local_block()->stages[stage];
     
-    if (time_us < s_metrics.min_inference_time_us) {
-        s_metrics.min_inference_time_us = time_us;
-    }
+    __atomic_fetch_add(&b->count, 1, RELAXED);
+    __atomic_fetch_add(&b->buckets[bucket_index(duration_us)], 1, RELAXED);
     
-    if (time_us > s_metrics.max_inference_time_us) {
-        s_metrics.max_inference_time_us = time_us;
+    // Carry into the high word on wrap
+    uint32_t old = __atomic_fetch_add(&b->total_lo, duration_us, RELAXED);
+    if (old + duration_us < old) {
+        __atomic_fetch_add(&b->total_hi, 1, RELAXED);
     }
     
-    portEXIT_CRITICAL(&s_metrics_mutex);
+    uint32_t cur = __atomic_load_n(&b->min_us, RELAXED);
+    while (duration_us < cur &&
+           !__atomic_compare_exchange_n(&b->min_us, &cur, duration_us, true, RELAXED, RELAXED)) {
+    }
+    cur = __atomic_load_n(&b->max_us, RELAXED);
+    while (duration_us > cur &&
+           !__atomic_compare_exchange_n(&b->max_us, &cur, duration_us, true, RELAXED, RELAXED)) {
+    }
 }
 
 void metrics_record_adc_time(uint64_t timestamp)
 {
     static uint64_t last_timestamp = 0;
     
-    portENTER_CRITICAL(&s_metrics_mutex);
-    
-    if (last_timestamp > 0) {
-        uint64_t delta = timestamp - last_timestamp;
-        s_metrics.total_adc_time_us += delta;
-        s_metrics.adc_sample_count++;
+    if (last_timestamp > 0 && timestamp > last_timestamp) {
+        metrics_record_stage(METRIC_STAGE_ADC_INTERVAL, (uint32_t)(timestamp - last_timestamp));
     }
-    
     last_timestamp = timestamp;
-    
-    portEXIT_CRITICAL(&s_metrics_mutex);
 }
 
 void metrics_record_correct_prediction(void)
 {
-    portENTER_CRITICAL(&s_metrics_mutex);
-    s_metrics.correct_predictions++;
-    s_metrics.total_predictions++;
-    portEXIT_CRITICAL(&s_metrics_mutex);
+    core_block_t *b = local_block();
+    __atomic_fetch_add(&b->correct_predictions, 1, RELAXED);
+    __atomic_fetch_add(&b->total_predictions, 1, RELAXED);
 }
 
 void metrics_record_incorrect_prediction(void)
 {
-    portENTER_CRITICAL(&s_metrics_mutex);
-    s_metrics.total_predictions++;
-    portEXIT_CRITICAL(&s_metrics_mutex);
+    __atomic_fetch_add(&local_block()->total_predictions, 1, RELAXED);
+}
+
+void metrics_record_transition_prediction(bool correct)
+{
+    core_block_t *b = local_block();
+    if (correct) {
+        __atomic_fetch_add(&b->transition_correct, 1, RELAXED);
+    }
+    __atomic_fetch_add(&b->transition_predictions, 1, RELAXED);
+}
+
+void metrics_record_missed_detection(void)
+{
+    __atomic_fetch_add(&local_block()->detections_missed, 1, RELAXED);
+}
+
+void metrics_record_dropped_windows(uint32_t dropped, bool gap)
+{
+    core_block_t *b = local_block();
+    if (dropped > 0) {
+        __atomic_fetch_add(&b->windows_dropped, dropped, RELAXED);
+    }
+    if (gap) {
+        __atomic_fetch_add(&b->windows_gapped, 1, RELAXED);
+    }
+}
+
+void metrics_record_rejected_window(uint8_t verdict)
+{
+    if (verdict < SIGNAL_GATE_COUNT) {
+        __atomic_fetch_add(&local_block()->windows_rejected[verdict], 1, RELAXED);
+    }
 }
 
 void metrics_record_memory_usage(void)
@@ -79,56 +175,176 @@ void metrics_record_memory_usage(void)
     size_t total_heap = heap_caps_get_total_size(MALLOC_CAP_DEFAULT);
     size_t used_heap = total_heap - free_heap;
     
-    portENTER_CRITICAL(&s_metrics_mutex);
+    s_current_heap_usage = used_heap;
+    if (used_heap > s_peak_heap_usage) {
+        s_peak_heap_usage = used_heap;
+    }
+}
+
+// Stamp a milestone unless it is already set; never 0 once set
+static uint32_t record_milestone(uint32_t *milestone)
+{
+    uint32_t now = (uint32_t)(esp_timer_get_time() / 1000);
+    if (now == 0) {
+        now = 1;
+    }
+    uint32_t expected = 0;
+    if (__atomic_compare_exchange_n(milestone, &expected, now, false, RELAXED, RELAXED)) {
+        return now;
+    }
+    return expected;
+}
+
+void metrics_record_engine_ready(void)
+{
+    record_milestone(&s_engine_ready_ms);
+}
+
+uint32_t metrics_record_first_decision(void)
+{
+    return record_milestone(&s_first_decision_ms);
+}
+
+void metrics_get_current(metrics_t *metrics)
+{
+    if (!metrics) return;
     
-    s_metrics.current_heap_usage = used_heap;
+    memset(metrics, 0, sizeof(metrics_t));
+    for (int i = 0; i < METRIC_STAGE_COUNT; i++) {
+        metrics->stages[i].min_us = UINT32_MAX;
+    }
     
-    if (used_heap > s_metrics.peak_heap_usage) {
-        s_metrics.peak_heap_usage = used_heap;
+    for (int c = 0; c < portNUM_PROCESSORS; c++) {
+        const core_block_t *b = &s_blocks[c];
+        
+        for (int i = 0; i < METRIC_STAGE_COUNT; i++) {
+            const stage_block_t *src = &b->stages[i];
+            metrics_histogram_t *dst = &metrics->stages[i];
+            
+            dst->count += __atomic_load_n(&src->count, RELAXED);
+            dst->total_us += ((uint64_t)__atomic_load_n(&src->total_hi, RELAXED) << 32) |
+                             __atomic_load_n(&src->total_lo, RELAXED);
+            uint32_t min_us = __atomic_load_n(&src->min_us, RELAXED);
+            uint32_t max_us = __atomic_load_n(&src->max_us, RELAXED);
+            if (min_us < dst->min_us) dst->min_us = min_us;
+            if (max_us > dst->max_us) dst->max_us = max_us;
+            for (int k = 0; k < METRICS_HISTOGRAM_BUCKETS; k++) {
+                dst->buckets[k] += __atomic_load_n(&src->buckets[k], RELAXED);
+            }
+        }
+        
+        metrics->correct_predictions += __atomic_load_n(&b->correct_predictions, RELAXED);
+        metrics->total_predictions += __atomic_load_n(&b->total_predictions, RELAXED);
+        metrics->transition_correct += __atomic_load_n(&b->transition_correct, RELAXED);
+        metrics->transition_predictions += __atomic_load_n(&b->transition_predictions, RELAXED);
+        metrics->detections_missed += __atomic_load_n(&b->detections_missed, RELAXED);
+        metrics->windows_dropped += __atomic_load_n(&b->windows_dropped, RELAXED);
+        metrics->windows_gapped += __atomic_load_n(&b->windows_gapped, RELAXED);
+        for (int k = 0; k < SIGNAL_GATE_COUNT; k++) {
+            metrics->windows_rejected[k] += __atomic_load_n(&b->windows_rejected[k], RELAXED);
+        }
     }
     
-    portEXIT_CRITICAL(&s_metrics_mutex);
+    for (int i = 0; i < METRIC_STAGE_COUNT; i++) {
+        if (metrics->stages[i].count == 0) {
+            metrics->stages[i].min_us = 0;
+        }
+    }
+    metrics->inference_count = metrics->stages[METRIC_STAGE_END_TO_END].count;
+    metrics->peak_heap_usage = s_peak_heap_usage;
+    metrics->current_heap_usage = s_current_heap_usage;
+    metrics->engine_ready_ms = __atomic_load_n(&s_engine_ready_ms, RELAXED);
+    metrics->first_decision_ms = __atomic_load_n(&s_first_decision_ms, RELAXED);
 }
 
-void metrics_get_current(metrics_t *metrics)
+uint32_t metrics_histogram_percentile(const metrics_histogram_t *histogram, float fraction)
 {
-    if (!metrics) return;
+    if (!histogram || histogram->count == 0) {
+        return 0;
+    }
+    
+    // Rank of the percentile sample, 1-based
+    uint64_t rank = (uint64_t)(fraction * histogram->count + 0.999999f);
+    if (rank == 0) rank = 1;
     
-    portENTER_CRITICAL(&s_metrics_mutex);
-    memcpy(metrics, &s_metrics, sizeof(metrics_t));
-    portEXIT_CRITICAL(&s_metrics_mutex);
+    uint64_t seen = 0;
+    for (int k = 0; k < METRICS_HISTOGRAM_BUCKETS; k++) {
+        seen += histogram->buckets[k];
+        if (seen >= rank) {
+            uint32_t upper = bucket_upper_us(k);
+            return upper < histogram->max_us ? upper : histogram->max_us;
+        }
+    }
+    return histogram->max_us;
 }
 
+static const char *s_stage_names[METRIC_STAGE_COUNT] = {
+    "adc_interval", "preprocess", "quantize", "invoke", "end_to_end", "detection"
+};
+
 void metrics_log_statistics(void)
 {
     metrics_t metrics;
     metrics_get_current(&metrics);
     
-    if (metrics.inference_count > 0) {
-        double avg_inference_time = (double)metrics.total_inference_time_us / metrics.inference_count;
-        double inference_frequency = 1000000.0 / avg_inference_time;
-        
-        ESP_LOGI(TAG, "=== Inference Statistics ===");
-        ESP_LOGI(TAG, "Total inferences: %u", metrics.inference_count);
-        ESP_LOGI(TAG, "Avg inference time: %.2f us", avg_inference_time);
-        ESP_LOGI(TAG, "Min inference time: %llu us", metrics.min_inference_time_us);
-        ESP_LOGI(TAG, "Max inference time: %llu us", metrics.max_inference_time_us);
-        ESP_LOGI(TAG, "Inference frequency: %.2f Hz", inference_frequency);
-        
-        if (metrics.total_predictions > 0) {
-            double accuracy = 100.0 * metrics.correct_predictions / metrics.total_predictions;
-            ESP_LOGI(TAG, "Accuracy: %.2f%% (%u/%u)", 
-                    accuracy, metrics.correct_predictions, metrics.total_predictions);
+    ESP_LOGI(TAG, "=== Inference Statistics ===");
+    ESP_LOGI(TAG, "Windows processed: %u", (unsigned)metrics.inference_count);
+    if (metrics.first_decision_ms > 0) {
+        ESP_LOGI(TAG, "Startup: engine ready at %u ms, first decision at %u ms",
+                (unsigned)metrics.engine_ready_ms, (unsigned)metrics.first_decision_ms);
+    }
+    ESP_LOGI(TAG, "=== Latency (us) ===");
+    for (int i = 0; i < METRIC_STAGE_COUNT; i++) {
+        const metrics_histogram_t *h = &metrics.stages[i];
+        if (h->count == 0) {
+            continue;
         }
+        ESP_LOGI(TAG, "%-12s n=%-7u avg=%-7llu p50=%-7u p95=%-7u p99=%-7u p99.9=%-7u max=%u",
+                 s_stage_names[i], (unsigned)h->count,
+                 (unsigned long long)(h->total_us / h->count),
+                 (unsigned)metrics_histogram_percentile(h, 0.50f),
+                 (unsigned)metrics_histogram_percentile(h, 0.95f),
+                 (unsigned)metrics_histogram_percentile(h, 0.99f),
+                 (unsigned)metrics_histogram_percentile(h, 0.999f),
+                 (unsigned)h->max_us);
     }
     
-    if (metrics.adc_sample_count > 0) {
-        double avg_adc_time = (double)metrics.total_adc_time_us / metrics.adc_sample_count;
-        double adc_frequency = 1000000.0 / avg_adc_time;
-        
-        ESP_LOGI(TAG, "=== ADC Statistics ===");
-        ESP_LOGI(TAG, "Avg ADC interval: %.2f us", avg_adc_time);
-        ESP_LOGI(TAG, "Effective ADC rate: %.2f Hz", adc_frequency);
+    const metrics_histogram_t *adc = &metrics.stages[METRIC_STAGE_ADC_INTERVAL];
+    if (adc->count > 0) {
+        ESP_LOGI(TAG, "Window rate: %.2f Hz", 1000000.0 * adc->count / adc->total_us);
+    }
+    
+    if (metrics.total_predictions > 0) {
+        double accuracy = 100.0 * metrics.correct_predictions / metrics.total_predictions;
+        ESP_LOGI(TAG, "Accuracy: %.2f%% (%u/%u)", 
+                accuracy, (unsigned)metrics.correct_predictions, (unsigned)metrics.total_predictions);
+    }
+    
+    if (metrics.transition_predictions > 0) {
+        ESP_LOGI(TAG, "Transition windows: %u (%u matched majority label)",
+                (unsigned)metrics.transition_predictions, (unsigned)metrics.transition_correct);
+    }
+    
+    const metrics_histogram_t *detection = &metrics.stages[METRIC_STAGE_DETECTION];
+    if (detection->count > 0 || metrics.detections_missed > 0) {
+        ESP_LOGI(TAG, "Switches detected: %u, missed: %u",
+                (unsigned)detection->count, (unsigned)metrics.detections_missed);
+    }
+    
+    if (metrics.windows_dropped > 0 || metrics.windows_gapped > 0) {
+        ESP_LOGW(TAG, "Windows dropped: %u, with missing samples: %u",
+                (unsigned)metrics.windows_dropped, (unsigned)metrics.windows_gapped);
+    }
+    
+    uint32_t rejected = 0;
+    for (int k = 0; k < SIGNAL_GATE_COUNT; k++) {
+        rejected += metrics.windows_rejected[k];
+    }
+    if (rejected > 0) {
+        ESP_LOGI(TAG, "Windows gated: %u idle, %u saturated, %u stuck",
+                (unsigned)metrics.windows_rejected[SIGNAL_GATE_IDLE],
+                (unsigned)metrics.windows_rejected[SIGNAL_GATE_SATURATED],
+                (unsigned)metrics.windows_rejected[SIGNAL_GATE_STUCK]);
     }
     
     ESP_LOGI(TAG, "=== Memory Statistics ===");
@@ -141,35 +357,6 @@ void metrics_log_statistics(void)
 
 void metrics_reset(void)
 {
-    portENTER_CRITICAL(&s_metrics_mutex);
-    memset(&s_metrics, 0, sizeof(metrics_t));
-    s_metrics.min_inference_time_us = UINT64_MAX;
-    portEXIT_CRITICAL(&s_metrics_mutex);
-    
+    reset_blocks();
     ESP_LOGI(TAG, "Metrics reset");
-}
-
-void metrics_monitor_task(void *arg)
-{
-    uint32_t last_inference_count = 0;
-    uint32_t last_adc_count = 0;
-    
-    while (1) {
-        vTaskDelay(5000 / portTICK_PERIOD_MS); // Log every 5 seconds
-        
-        metrics_t metrics;
-        metrics_get_current(&metrics);
-        
-        // Only log if there's new activity
-        if (metrics.inference_count > last_inference_count || 
-            metrics.adc_sample_count > last_adc_count) {
-            metrics_log_statistics();
-        }
-        
-        last_inference_count = metrics.inference_count;
-        last_adc_count = metrics.adc_sample_count;
-        
-        // Record memory usage periodically
-        metrics_record_memory_usage();
-    }
 }
\ No newline at end of file
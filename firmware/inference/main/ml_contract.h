@@ -15,16 +15,35 @@
 #pragma once
 
 #include <stdint.h>
+#include <string.h>
+#include "sdkconfig.h"
 
 // ===== ML INPUT CONTRACT =====
 
 /**
  * @brief Number of samples per inference window
  * 
- * This is the fundamental unit of ML inference. Changing this requires
- * retraining the model and updating preprocessing.
+ * This is the fundamental unit of ML inference. Set from Kconfig
+ * (INFERENCE_SAMPLE_WINDOW_SIZE); changing it requires retraining the
+ * model. Must be a power of 2 (FFT, sliding-window ring).
  */
+#ifdef CONFIG_INFERENCE_SAMPLE_WINDOW_SIZE
+#define ML_WINDOW_SIZE        CONFIG_INFERENCE_SAMPLE_WINDOW_SIZE
+#else
 #define ML_WINDOW_SIZE        256
+#endif
+
+/**
+ * @brief ADC sampling rate in Hz
+ * 
+ * Per channel, after decimation (ADC_SAMPLE_RATE_HZ). Sets the frequency
+ * axis of spectral features. Must match the signals used for training.
+ */
+#ifdef CONFIG_ADC_SAMPLE_RATE_HZ
+#define ML_SAMPLE_RATE_HZ     CONFIG_ADC_SAMPLE_RATE_HZ
+#else
+#define ML_SAMPLE_RATE_HZ     20000
+#endif
 
 /**
  * @brief Type of raw input samples
@@ -41,6 +60,14 @@ typedef uint16_t ml_input_t;
 #define ML_ADC_MIN            0
 #define ML_ADC_MAX            4095
 
+/**
+ * @brief ADC mid-scale code
+ * 
+ * Raw codes map to samples as x = code / ML_ADC_MIDSCALE - 1 before
+ * windowing and normalization.
+ */
+#define ML_ADC_MIDSCALE       2048
+
 /**
  * @brief Sample ordering specification
  * 
@@ -48,7 +75,7 @@ typedef uint16_t ml_input_t;
  * - samples[0] = oldest sample (t - (ML_WINDOW_SIZE-1) * Δt)
  * - samples[ML_WINDOW_SIZE-1] = newest sample (t)
  * 
- * Where Δt = 1 / SAMPLING_RATE_HZ
+ * Where Δt = 1 / ML_SAMPLE_RATE_HZ
  */
 
 // ===== ML OUTPUT CONTRACT =====
@@ -56,10 +83,13 @@ typedef uint16_t ml_input_t;
 /**
  * @brief ML classification output classes
  * 
- * Enumeration of signal types the ML model can identify.
- * The integer values must match training labels.
+ * Enumeration of signal types the ML model can identify. Models emit
+ * their outputs in training label order instead; an ml_class_map_t
+ * translates. Append new classes before ML_CLASS_COUNT (recorded
+ * labels and the generator's waveform indices use these values).
  */
 typedef enum {
+    ML_CLASS_UNKNOWN = -1,  /**< No class (unlabeled / not a model output) */
     ML_CLASS_SINE = 0,      /**< Sine wave */
     ML_CLASS_SQUARE = 1,    /**< Square wave */
     ML_CLASS_TRIANGLE = 2,  /**< Triangle wave */
@@ -68,6 +98,42 @@ typedef enum {
     ML_CLASS_COUNT          /**< Total number of classes */
 } ml_class_t;
 
+/**
+ * @brief Classes the rule-based classifiers choose between (the waveforms)
+ */
+#define ML_WAVEFORM_CLASS_COUNT  ML_CLASS_NOISE
+
+/**
+ * @brief Capacity of a model's class map (outputs per model)
+ */
+#define ML_MAX_MODEL_OUTPUTS  8
+
+/**
+ * @brief Model output index -> ml_class_t
+ * 
+ * Built once per model from its metadata (model store entry, or the
+ * training summary for compiled-in models), so postprocessing is one
+ * scatter and an argmax with no label strings. Outputs mapped to
+ * ML_CLASS_UNKNOWN (labels the firmware has no class for) are dropped.
+ */
+typedef struct {
+    uint8_t count;                          /**< Model outputs (0 = no map) */
+    int8_t classes[ML_MAX_MODEL_OUTPUTS];   /**< ml_class_t of each output */
+} ml_class_map_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Label order of models/training_summary.json (gen_class_map.py)
+ */
+extern const ml_class_map_t ml_trained_class_map;
+
+#ifdef __cplusplus
+}
+#endif
+
 /**
  * @brief ML inference result structure
  * 
@@ -91,15 +157,44 @@ typedef struct {
 /**
  * @brief Validate ML class is within valid range
  */
-#define ML_VALIDATE_CLASS(class) \
-    ((class) >= 0 && (class) < ML_CLASS_COUNT)
+#define ML_VALIDATE_CLASS(cls) \
+    ((cls) >= 0 && (cls) < ML_CLASS_COUNT)
 
 /**
  * @brief Convert ML class to string for logging
  */
-static inline const char* ml_class_to_string(ml_class_t class) {
+static inline const char* ml_class_to_string(ml_class_t cls) {
     static const char* strings[] = {
         "SINE", "SQUARE", "TRIANGLE", "SAWTOOTH", "NOISE"
     };
-    return (class >= 0 && class < ML_CLASS_COUNT) ? strings[class] : "INVALID";
-}
\ No newline at end of file
+    return (cls >= 0 && cls < ML_CLASS_COUNT) ? strings[cls] : "INVALID";
+}
+
+/**
+ * @brief Parse a class name (as sent by the generator) to an ML class
+ * 
+ * Only used at the I/O edge; results carry ml_class_t internally.
+ */
+static inline ml_class_t ml_class_from_string(const char* name) {
+    if (name) {
+        for (int i = 0; i < ML_CLASS_COUNT; i++) {
+            if (strcmp(name, ml_class_to_string((ml_class_t)i)) == 0) {
+                return (ml_class_t)i;
+            }
+        }
+    }
+    return ML_CLASS_UNKNOWN;
+}
+
+/**
+ * @brief Index of the largest score (0 if num_scores <= 0)
+ */
+static inline int ml_argmax(const float* scores, int num_scores) {
+    int best = 0;
+    for (int i = 1; i < num_scores; i++) {
+        if (scores[i] > scores[best]) {
+            best = i;
+        }
+    }
+    return best;
+}
@@ -7,10 +7,18 @@
 extern "C" {
 #endif
 
-// Placeholder for actual model data
-// In a real project, this would be generated by TensorFlow Lite
-extern const unsigned char g_model_data[];
-extern const size_t g_model_size;
+// Placement of the model flatbuffers in arrays/ (gen_model_arrays.py).
+// TFLite Micro reads weights in place, so tensor buffers must be 16-byte
+// aligned (whole, aligned cache line fills in the FC and CONV kernels);
+// one rodata section keeps all models together in flash, away from the
+// constants of the rest of the firmware.
+#define MODEL_DATA_ALIGN 16
+
+#ifdef ESP_PLATFORM
+#define MODEL_DATA_ATTR __attribute__((aligned(MODEL_DATA_ALIGN), section(".rodata.ml_models")))
+#else
+#define MODEL_DATA_ATTR __attribute__((aligned(MODEL_DATA_ALIGN)))
+#endif
 
 #ifdef __cplusplus
 }
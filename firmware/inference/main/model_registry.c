@@ -0,0 +1,383 @@
+// model_registry.c - All available models, one lazily built session each
+#include "model_registry.h"
+#include "model_data.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <string.h>
+
+#ifdef CONFIG_INFERENCE_ARENA_CACHE
+#include "arena_cache.h"
+#endif
+
+#ifdef CONFIG_MODEL_STORE_PARTITION
+#include "model_store.h"
+#else
+#include "cnn_int8_model.h"
+#include "cnn_float32_model.h"
+#include "mlp_int8_model.h"
+#include "mlp_float32_model.h"
+#include "hybrid_int8_model.h"
+#include "hybrid_float32_model.h"
+#endif
+
+static const char *TAG = "MODEL_REGISTRY";
+
+#define RESIDENT_BUDGET_BYTES (CONFIG_MODEL_REGISTRY_RESIDENT_BUDGET_KB * 1024)
+
+static model_registry_entry_t s_entries[MODEL_TYPE_COUNT];
+static bool s_registry_initialized = false;
+static SemaphoreHandle_t s_registry_mutex = NULL;
+
+// Shared scratch arena for non-resident models
+static uint8_t *s_scratch_arena = NULL;
+static size_t s_scratch_size = 0;
+static int s_scratch_tenant = -1;
+
+// Bytes held by dedicated (resident) arenas
+static size_t s_resident_bytes = 0;
+
+static bool valid_type(model_type_t type) {
+    return type >= 0 && type < MODEL_TYPE_COUNT;
+}
+
+#ifdef CONFIG_MODEL_STORE_PARTITION
+static const char *const s_names[MODEL_TYPE_COUNT] = {
+    [MODEL_CNN_FLOAT32]    = "CNN_F32",
+    [MODEL_CNN_INT8]       = "CNN_INT8",
+    [MODEL_MLP_FLOAT32]    = "MLP_F32",
+    [MODEL_MLP_INT8]       = "MLP_INT8",
+    [MODEL_HYBRID_FLOAT32] = "HYBRID_F32",
+    [MODEL_HYBRID_INT8]    = "HYBRID_INT8",
+};
+
+// Entries point into the mapped store; models it lacks have no data
+static void load_entries(void) {
+    for (int i = 0; i < MODEL_TYPE_COUNT; i++) {
+        model_store_model_t model = { 0 };
+        model_store_find((model_type_t)i, &model);
+        s_entries[i] = (model_registry_entry_t){
+            .type = (model_type_t)i,
+            .name = s_names[i],
+            .data = model.data,
+            .size = model.size,
+            .is_int8 = model.is_int8,
+            .arena_bytes = model.arena_hint,
+            .class_map = model.class_map.count ? model.class_map : ml_trained_class_map,
+        };
+    }
+}
+#endif
+
+void model_registry_init(void) {
+    if (s_registry_initialized) return;
+    
+    #ifdef CONFIG_MODEL_STORE_PARTITION
+    if (model_store_init() != ESP_OK) {
+        ESP_LOGE(TAG, "Model store unavailable: no models to run");
+    }
+    load_entries();
+    #else
+    const model_registry_entry_t table[MODEL_TYPE_COUNT] = {
+        [MODEL_CNN_FLOAT32]    = { MODEL_CNN_FLOAT32, "CNN_F32", cnn_float32_model_tflite,
+                                   cnn_float32_model_tflite_len, false },
+        [MODEL_CNN_INT8]       = { MODEL_CNN_INT8, "CNN_INT8", cnn_int8_model_tflite,
+                                   cnn_int8_model_tflite_len, true },
+        [MODEL_MLP_FLOAT32]    = { MODEL_MLP_FLOAT32, "MLP_F32", mlp_float32_model_tflite,
+                                   mlp_float32_model_tflite_len, false },
+        [MODEL_MLP_INT8]       = { MODEL_MLP_INT8, "MLP_INT8", mlp_int8_model_tflite,
+                                   mlp_int8_model_tflite_len, true },
+        [MODEL_HYBRID_FLOAT32] = { MODEL_HYBRID_FLOAT32, "HYBRID_F32", hybrid_float32_model_tflite,
+                                   hybrid_float32_model_tflite_len, false },
+        [MODEL_HYBRID_INT8]    = { MODEL_HYBRID_INT8, "HYBRID_INT8", hybrid_int8_model_tflite,
+                                   hybrid_int8_model_tflite_len, true },
+    };
+    memcpy(s_entries, table, sizeof(s_entries));
+    for (int i = 0; i < MODEL_TYPE_COUNT; i++) {
+        s_entries[i].class_map = ml_trained_class_map;
+    }
+    #endif
+    
+    #ifdef CONFIG_INFERENCE_ARENA_CACHE
+    // Without it every model is calibrated as before
+    arena_cache_init();
+    #endif
+    
+    s_registry_mutex = xSemaphoreCreateMutex();
+    s_registry_initialized = true;
+    
+    ESP_LOGI(TAG, "Model registry initialized: %d models", MODEL_TYPE_COUNT);
+}
+
+#ifdef CONFIG_INFERENCE_ARENA_CACHE
+// Calibration from the previous boot, looked up once per model data
+static void restore_plan_locked(model_registry_entry_t *entry) {
+    if (entry->plan_checked || !entry->data) return;
+    
+    entry->plan_checked = true;
+    entry->plan_cached = arena_cache_restore(entry->name, entry->data, entry->size);
+}
+
+// Once a model has been calibrated for real, keep the result for next boot
+static void save_plan_locked(model_registry_entry_t *entry) {
+    if (entry->plan_cached || !entry->data) return;
+    
+    entry->plan_cached = arena_cache_save(entry->name, entry->data, entry->size);
+}
+#endif
+
+static size_t arena_bytes_locked(model_registry_entry_t *entry) {
+    #ifdef CONFIG_INFERENCE_ARENA_CACHE
+    restore_plan_locked(entry);
+    #endif
+    if (entry->arena_bytes == 0 && entry->data) {
+        entry->arena_bytes = tflite_get_arena_size((void *)entry->data, entry->size);
+        #ifdef CONFIG_INFERENCE_ARENA_CACHE
+        save_plan_locked(entry);
+        #endif
+    }
+    return entry->arena_bytes;
+}
+
+size_t model_registry_arena_bytes(model_type_t type) {
+    if (!valid_type(type)) return 0;
+    
+    model_registry_init();
+    
+    xSemaphoreTake(s_registry_mutex, portMAX_DELAY);
+    size_t bytes = arena_bytes_locked(&s_entries[type]);
+    xSemaphoreGive(s_registry_mutex);
+    return bytes;
+}
+
+// Scratch arena is sized for the largest model so any tenant fits
+static bool ensure_scratch_arena(void) {
+    if (s_scratch_arena) return true;
+    
+    size_t size = 0;
+    for (int i = 0; i < MODEL_TYPE_COUNT; i++) {
+        size_t need = arena_bytes_locked(&s_entries[i]);
+        if (need > size) size = need;
+    }
+    if (size == 0) return false;
+    
+    s_scratch_arena = heap_caps_aligned_alloc(16, size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!s_scratch_arena) {
+        s_scratch_arena = heap_caps_aligned_alloc(16, size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+    if (!s_scratch_arena) {
+        ESP_LOGE(TAG, "Failed to allocate %u byte scratch arena", (unsigned)size);
+        return false;
+    }
+    
+    s_scratch_size = size;
+    ESP_LOGI(TAG, "Scratch arena: %u bytes", (unsigned)size);
+    return true;
+}
+
+#ifdef CONFIG_INFERENCE_MODEL_IN_RAM
+#define ARENA_INTERNAL_MAX_BYTES     (CONFIG_INFERENCE_ARENA_INTERNAL_MAX_KB * 1024)
+#define ARENA_INTERNAL_RESERVE_BYTES (CONFIG_INFERENCE_ARENA_INTERNAL_RESERVE_KB * 1024)
+
+// Weights read through the flash cache miss on every pass over a model
+// larger than the cache; a DRAM copy is read at full speed. The arena has
+// priority: the copy is only made if the arena still fits internal RAM
+// where tflite_wrapper would place it there. Copies stay until the
+// entries are reloaded, so the calibration moves with the data once.
+static void copy_to_ram_locked(model_registry_entry_t *entry, size_t arena_bytes) {
+    if (entry->in_ram || !entry->data) return;
+    
+    size_t internal_arena = (arena_bytes <= ARENA_INTERNAL_MAX_BYTES) ? arena_bytes : 0;
+    size_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (largest < entry->size + internal_arena + ARENA_INTERNAL_RESERVE_BYTES) {
+        ESP_LOGI(TAG, "%s stays in flash (%u bytes, %u free)", entry->name,
+                 (unsigned)entry->size, (unsigned)largest);
+        return;
+    }
+    
+    // Flatbuffer tensors are 16-byte aligned relative to the buffer start
+    unsigned char *copy = heap_caps_aligned_alloc(MODEL_DATA_ALIGN, entry->size,
+                                                  MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!copy) return;
+    memcpy(copy, entry->data, entry->size);
+    
+    tflite_move_calibration(entry->data, copy);
+    entry->data = copy;
+    entry->in_ram = true;
+    ESP_LOGI(TAG, "%s copied to internal RAM (%u bytes)", entry->name, (unsigned)entry->size);
+}
+
+static void free_ram_copies_locked(void) {
+    for (int i = 0; i < MODEL_TYPE_COUNT; i++) {
+        if (s_entries[i].in_ram) {
+            heap_caps_free((void *)s_entries[i].data);
+            s_entries[i].data = NULL;
+            s_entries[i].in_ram = false;
+        }
+    }
+}
+#endif
+
+static void unload_locked(model_registry_entry_t *entry) {
+    if (!entry->session) return;
+    
+    tflite_session_destroy(entry->session);
+    entry->session = NULL;
+    
+    if (s_scratch_tenant == (int)entry->type) {
+        s_scratch_tenant = -1;
+    } else if (entry->resident) {
+        size_t held = entry->arena_bytes;
+        s_resident_bytes = (s_resident_bytes > held) ? s_resident_bytes - held : 0;
+    }
+    entry->resident = false;
+}
+
+// A model whose outputs the map does not describe would report wrong classes
+static tflite_session_t *checked_session_locked(model_registry_entry_t *entry) {
+    if (entry->session && !tflite_session_set_class_map(entry->session, &entry->class_map)) {
+        ESP_LOGE(TAG, "%s: class map does not match the model", entry->name);
+        unload_locked(entry);
+    }
+    return entry->session;
+}
+
+static tflite_session_t *acquire_locked(model_registry_entry_t *entry, bool resident) {
+    if (entry->session && (entry->resident || !resident)) {
+        return entry->session;
+    }
+    
+    // Promote a scratch tenant to its own arena
+    if (entry->session) {
+        if (entry->borrowers > 0) {
+            ESP_LOGW(TAG, "%s is borrowed: can't move it out of the scratch arena", entry->name);
+            return NULL;
+        }
+        unload_locked(entry);
+    }
+    
+    if (!entry->data) return NULL;
+    
+    size_t need = arena_bytes_locked(entry);
+    if (need == 0) return NULL;
+    
+    if (resident || s_resident_bytes + need <= RESIDENT_BUDGET_BYTES) {
+        #ifdef CONFIG_INFERENCE_MODEL_IN_RAM
+        if (resident) {
+            copy_to_ram_locked(entry, need);
+        }
+        #endif
+        entry->session = tflite_session_create(entry->data, entry->size);
+        if (entry->session) {
+            entry->resident = true;
+            s_resident_bytes += need;
+            #ifdef CONFIG_INFERENCE_ARENA_CACHE
+            // Calibrated just now if the arena size came from the store
+            save_plan_locked(entry);
+            #endif
+        }
+        return checked_session_locked(entry);
+    }
+    
+    if (!ensure_scratch_arena()) return NULL;
+    
+    if (s_scratch_tenant >= 0) {
+        model_registry_entry_t *tenant = &s_entries[s_scratch_tenant];
+        if (tenant->borrowers > 0) {
+            ESP_LOGW(TAG, "Scratch arena borrowed by %s: %s not loaded", tenant->name, entry->name);
+            return NULL;
+        }
+        unload_locked(tenant);
+    }
+    
+    entry->session = tflite_session_create_in_arena(entry->data, entry->size,
+                                                    s_scratch_arena, s_scratch_size);
+    if (entry->session) {
+        entry->resident = false;
+        s_scratch_tenant = entry->type;
+    }
+    return checked_session_locked(entry);
+}
+
+tflite_session_t *model_registry_acquire(model_type_t type, bool resident) {
+    if (!valid_type(type)) return NULL;
+    
+    model_registry_init();
+    
+    xSemaphoreTake(s_registry_mutex, portMAX_DELAY);
+    tflite_session_t *session = acquire_locked(&s_entries[type], resident);
+    if (session && !resident) {
+        s_entries[type].borrowers++;
+    }
+    xSemaphoreGive(s_registry_mutex);
+    
+    if (!session) {
+        ESP_LOGE(TAG, "Failed to load %s", s_entries[type].name);
+    }
+    return session;
+}
+
+void model_registry_release(model_type_t type) {
+    if (!valid_type(type) || !s_registry_initialized) return;
+    
+    xSemaphoreTake(s_registry_mutex, portMAX_DELAY);
+    if (s_entries[type].borrowers > 0) {
+        s_entries[type].borrowers--;
+    }
+    xSemaphoreGive(s_registry_mutex);
+}
+
+void model_registry_unload(model_type_t type) {
+    if (!valid_type(type) || !s_registry_initialized) return;
+    
+    xSemaphoreTake(s_registry_mutex, portMAX_DELAY);
+    if (s_entries[type].borrowers > 0) {
+        ESP_LOGW(TAG, "%s is borrowed: not unloaded", s_entries[type].name);
+    } else {
+        unload_locked(&s_entries[type]);
+    }
+    xSemaphoreGive(s_registry_mutex);
+}
+
+const model_registry_entry_t *model_registry_get(model_type_t type) {
+    if (!valid_type(type)) return NULL;
+    
+    model_registry_init();
+    return &s_entries[type];
+}
+
+bool model_registry_update_pending(void) {
+    #ifdef CONFIG_MODEL_STORE_PARTITION
+    return s_registry_initialized && model_store_update_pending();
+    #else
+    return false;
+    #endif
+}
+
+bool model_registry_reload(void) {
+    #ifdef CONFIG_MODEL_STORE_PARTITION
+    if (!model_registry_update_pending()) return false;
+    
+    xSemaphoreTake(s_registry_mutex, portMAX_DELAY);
+    // No session may outlive the mapping its weights come from
+    for (int i = 0; i < MODEL_TYPE_COUNT; i++) {
+        unload_locked(&s_entries[i]);
+    }
+    #ifdef CONFIG_INFERENCE_MODEL_IN_RAM
+    free_ram_copies_locked();
+    #endif
+    esp_err_t ret = model_store_activate_update();
+    load_entries();
+    
+    // Models may have grown: size the scratch arena again on demand
+    heap_caps_free(s_scratch_arena);
+    s_scratch_arena = NULL;
+    s_scratch_size = 0;
+    xSemaphoreGive(s_registry_mutex);
+    
+    return ret == ESP_OK;
+    #else
+    return false;
+    #endif
+}
@@ -0,0 +1,114 @@
+#ifndef MODEL_REGISTRY_H
+#define MODEL_REGISTRY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "benchmark.h"
+#include "tflite_wrapper.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Registry entry for one model (compiled in, or mapped from the model store)
+typedef struct {
+    model_type_t type;
+    const char *name;
+    const unsigned char *data;    // NULL if the model store lacks the model
+    size_t size;
+    bool is_int8;
+    size_t arena_bytes;           // Calibrated arena requirement (0 = not yet known)
+    ml_class_map_t class_map;     // Output order of the model
+    tflite_session_t *session;    // Lazily created interpreter
+    bool resident;                // Session owns a dedicated arena
+    uint32_t borrowers;           // Non-resident acquires not yet released
+    bool in_ram;                  // data is a copy in internal DRAM
+    bool plan_checked;            // Arena cache looked up for this data
+    bool plan_cached;             // Arena cache holds the current calibration
+} model_registry_entry_t;
+
+/**
+ * @brief Initialize the model registry (idempotent)
+ */
+void model_registry_init(void);
+
+/**
+ * @brief Get a ready-to-run session for a model, creating it on first use
+ * 
+ * Resident requests always get a dedicated arena. Other models get one
+ * while the resident budget allows, otherwise they time-share the scratch
+ * arena and evict whichever model used it last. With
+ * CONFIG_INFERENCE_MODEL_IN_RAM a resident model's flatbuffer is first
+ * copied out of flash when internal RAM has room for it and its arena.
+ * 
+ * Every non-resident acquire must be paired with model_registry_release():
+ * until then the session is borrowed and nothing evicts it, so acquiring
+ * another model that needs the scratch arena fails instead. Resident
+ * sessions stay until model_registry_unload() or model_registry_reload().
+ * 
+ * @param type Model type
+ * @param resident true to pin the model with its own arena
+ * @return tflite_session_t* Session (NULL on error)
+ */
+tflite_session_t *model_registry_acquire(model_type_t type, bool resident);
+
+/**
+ * @brief Return a session borrowed with model_registry_acquire(type, false)
+ * 
+ * The session stays loaded; once no borrower is left it may be evicted.
+ * 
+ * @param type Model type
+ */
+void model_registry_release(model_type_t type);
+
+/**
+ * @brief Destroy a model's session and release its arena
+ * 
+ * A borrowed session is left alone.
+ * 
+ * @param type Model type
+ */
+void model_registry_unload(model_type_t type);
+
+/**
+ * @brief Get a registry entry
+ * 
+ * @param type Model type
+ * @return const model_registry_entry_t* Entry (NULL if type is invalid)
+ */
+const model_registry_entry_t *model_registry_get(model_type_t type);
+
+/**
+ * @brief Get the calibrated arena requirement of a model
+ * 
+ * @param type Model type
+ * @return size_t Arena bytes (0 on error)
+ */
+size_t model_registry_arena_bytes(model_type_t type);
+
+/**
+ * @brief A model store update is waiting to be swapped in
+ * 
+ * Always false unless CONFIG_MODEL_STORE_PARTITION is set.
+ * 
+ * @return true if model_registry_reload() would load new models
+ */
+bool model_registry_update_pending(void);
+
+/**
+ * @brief Swap in a pending model store update
+ * 
+ * Destroys every session and remaps the entries onto the new slot; the
+ * caller must own every session (no inference in flight) and acquire
+ * them again afterwards. Entries without data are missing from the store.
+ * 
+ * @return true if new models were loaded
+ */
+bool model_registry_reload(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MODEL_REGISTRY_H */
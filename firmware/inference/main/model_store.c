@@ -0,0 +1,355 @@
+// model_store.c - Memory-mapped model partitions with A/B updates
+#include "model_store.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include <string.h>
+#include <stddef.h>
+
+#ifdef CONFIG_MODEL_STORE_PARTITION
+
+static const char *TAG = "MODEL_STORE";
+
+#define SLOT_COUNT          2
+#define FLASH_SECTOR_SIZE   4096
+
+// Must match gen_model_store.py
+_Static_assert(sizeof(model_store_header_t) == 16, "model store header layout");
+_Static_assert(sizeof(model_store_entry_t) == 40, "model store entry layout");
+_Static_assert(offsetof(model_store_entry_t, classes) == MODEL_STORE_ENTRY_V1, "version 1 entry prefix");
+
+typedef struct {
+    const esp_partition_t *partition;
+    uint32_t generation;              // 0 = no valid image
+} store_slot_t;
+
+static store_slot_t s_slots[SLOT_COUNT];
+static int s_slot_count = 0;
+
+// Mapped slot; only the inference task remaps it
+static int s_active = -1;
+static const uint8_t *s_map = NULL;
+static esp_partition_mmap_handle_t s_map_handle;
+static model_store_header_t s_header;
+
+// Written by the updating task, polled by the inference task
+static int s_pending = -1;
+static portMUX_TYPE s_state_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Update in progress
+static int s_ota_slot = -1;
+static size_t s_ota_size = 0;
+static size_t s_ota_written = 0;
+static model_store_header_t s_ota_header;
+
+static size_t entry_size(uint16_t version)
+{
+    return version == 1 ? MODEL_STORE_ENTRY_V1 : sizeof(model_store_entry_t);
+}
+
+// Entry of either version; fields a version 1 entry lacks read as 0
+static void read_entry(const uint8_t *base, const model_store_header_t *header, int index,
+                       model_store_entry_t *entry)
+{
+    size_t size = entry_size(header->version);
+    memset(entry, 0, sizeof(*entry));
+    memcpy(entry, base + sizeof(model_store_header_t) + index * size, size);
+}
+
+// Check a slot image against a header (which may not be in flash yet)
+static bool validate_image(const uint8_t *base, size_t size, const model_store_header_t *header)
+{
+    if (header->magic != MODEL_STORE_MAGIC ||
+        (header->version != MODEL_STORE_VERSION && header->version != 1) ||
+        header->count == 0 || header->count > MODEL_STORE_MAX_MODELS) {
+        return false;
+    }
+    size_t table_bytes = header->count * entry_size(header->version);
+    if (sizeof(model_store_header_t) + table_bytes > size) {
+        return false;
+    }
+    if (esp_rom_crc32_le(0, base + sizeof(model_store_header_t), table_bytes) != header->table_crc) {
+        ESP_LOGW(TAG, "Table CRC mismatch");
+        return false;
+    }
+
+    for (int i = 0; i < header->count; i++) {
+        model_store_entry_t entry;
+        read_entry(base, header, i, &entry);
+        if (entry.type >= MODEL_TYPE_COUNT || entry.offset % MODEL_STORE_ALIGN != 0 ||
+            entry.class_count > MODEL_STORE_MAX_CLASSES ||
+            entry.offset < sizeof(model_store_header_t) + table_bytes ||
+            entry.size == 0 || entry.offset > size || entry.size > size - entry.offset) {
+            ESP_LOGW(TAG, "Entry %d out of bounds", i);
+            return false;
+        }
+        if (esp_rom_crc32_le(0, base + entry.offset, entry.size) != entry.crc32) {
+            ESP_LOGW(TAG, "Model %.12s CRC mismatch", entry.name);
+            return false;
+        }
+    }
+    return true;
+}
+
+static esp_err_t map_slot(int slot, const uint8_t **base, esp_partition_mmap_handle_t *handle)
+{
+    const esp_partition_t *p = s_slots[slot].partition;
+    const void *ptr = NULL;
+    esp_err_t ret = esp_partition_mmap(p, 0, p->size, ESP_PARTITION_MMAP_DATA, &ptr, handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to map %s: %s", p->label, esp_err_to_name(ret));
+        return ret;
+    }
+    *base = (const uint8_t *)ptr;
+    return ESP_OK;
+}
+
+// Generation of a valid slot in flash, 0 otherwise
+static uint32_t probe_slot(int slot)
+{
+    const uint8_t *base;
+    esp_partition_mmap_handle_t handle;
+    if (map_slot(slot, &base, &handle) != ESP_OK) {
+        return 0;
+    }
+    model_store_header_t header;
+    memcpy(&header, base, sizeof(header));
+    bool valid = validate_image(base, s_slots[slot].partition->size, &header);
+    esp_partition_munmap(handle);
+    return valid ? header.generation : 0;
+}
+
+esp_err_t model_store_init(void)
+{
+    if (s_active >= 0) {
+        return ESP_OK;
+    }
+
+    esp_partition_iterator_t it = esp_partition_find(ESP_PARTITION_TYPE_DATA,
+                                                     MODEL_STORE_SUBTYPE, NULL);
+    for (; it && s_slot_count < SLOT_COUNT; it = esp_partition_next(it)) {
+        s_slots[s_slot_count++].partition = esp_partition_get(it);
+    }
+    esp_partition_iterator_release(it);
+    if (s_slot_count == 0) {
+        ESP_LOGE(TAG, "No model partition (data, subtype 0x%02x)", MODEL_STORE_SUBTYPE);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    int newest = -1;
+    for (int i = 0; i < s_slot_count; i++) {
+        s_slots[i].generation = probe_slot(i);
+        if (s_slots[i].generation > 0 &&
+            (newest < 0 || s_slots[i].generation > s_slots[newest].generation)) {
+            newest = i;
+        }
+    }
+    if (newest < 0) {
+        ESP_LOGE(TAG, "No valid model image in %d slots", s_slot_count);
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    esp_err_t ret = map_slot(newest, &s_map, &s_map_handle);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    memcpy(&s_header, s_map, sizeof(s_header));
+    s_active = newest;
+
+    ESP_LOGI(TAG, "%s: generation %u, %u models",
+             s_slots[newest].partition->label, (unsigned)s_header.generation,
+             (unsigned)s_header.count);
+    return ESP_OK;
+}
+
+bool model_store_find(model_type_t type, model_store_model_t *model)
+{
+    if (!s_map || !model) {
+        return false;
+    }
+    for (int i = 0; i < s_header.count; i++) {
+        model_store_entry_t entry;
+        read_entry(s_map, &s_header, i, &entry);
+        if (entry.type == (uint8_t)type) {
+            model->data = s_map + entry.offset;
+            model->size = entry.size;
+            model->arena_hint = entry.arena_hint;
+            model->is_int8 = (entry.flags & MODEL_STORE_FLAG_INT8) != 0;
+            model->class_map.count = entry.class_count;
+            memcpy(model->class_map.classes, entry.classes, sizeof(model->class_map.classes));
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t model_store_generation(void)
+{
+    return s_map ? s_header.generation : 0;
+}
+
+bool model_store_update_pending(void)
+{
+    return __atomic_load_n(&s_pending, __ATOMIC_ACQUIRE) >= 0;
+}
+
+esp_err_t model_store_activate_update(void)
+{
+    portENTER_CRITICAL(&s_state_lock);
+    int slot = s_pending;
+    portEXIT_CRITICAL(&s_state_lock);
+    if (slot < 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    const uint8_t *base;
+    esp_partition_mmap_handle_t handle;
+    esp_err_t ret = map_slot(slot, &base, &handle);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (s_map) {
+        esp_partition_munmap(s_map_handle);
+    }
+    s_map = base;
+    s_map_handle = handle;
+    memcpy(&s_header, s_map, sizeof(s_header));
+
+    portENTER_CRITICAL(&s_state_lock);
+    s_active = slot;
+    __atomic_store_n(&s_pending, -1, __ATOMIC_RELEASE);
+    portEXIT_CRITICAL(&s_state_lock);
+
+    ESP_LOGI(TAG, "Switched to %s generation %u", s_slots[slot].partition->label,
+             (unsigned)s_header.generation);
+    return ESP_OK;
+}
+
+esp_err_t model_store_ota_begin(size_t image_size)
+{
+    if (s_ota_slot >= 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (s_slot_count < SLOT_COUNT || s_active < 0) {
+        ESP_LOGE(TAG, "Updates need two model slots");
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    // The slot not mapped; a pending image there is overwritten
+    portENTER_CRITICAL(&s_state_lock);
+    int slot = 1 - s_active;
+    s_pending = -1;
+    portEXIT_CRITICAL(&s_state_lock);
+
+    const esp_partition_t *p = s_slots[slot].partition;
+    if (image_size < sizeof(model_store_header_t) || image_size > p->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    s_slots[slot].generation = 0;
+
+    // Flash cache is off while erasing: both cores stall briefly
+    size_t erase_size = (image_size + FLASH_SECTOR_SIZE - 1) & ~(FLASH_SECTOR_SIZE - 1);
+    esp_err_t ret = esp_partition_erase_range(p, 0, erase_size);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to erase %s: %s", p->label, esp_err_to_name(ret));
+        return ret;
+    }
+
+    s_ota_slot = slot;
+    s_ota_size = image_size;
+    s_ota_written = 0;
+    memset(&s_ota_header, 0, sizeof(s_ota_header));
+    ESP_LOGI(TAG, "Writing %u byte image to %s", (unsigned)image_size, p->label);
+    return ESP_OK;
+}
+
+esp_err_t model_store_ota_write(const void *data, size_t size)
+{
+    if (s_ota_slot < 0 || !data) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (size > s_ota_size - s_ota_written) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    // The header is held back until the image has been verified
+    const uint8_t *bytes = (const uint8_t *)data;
+    if (s_ota_written < sizeof(model_store_header_t)) {
+        size_t n = sizeof(model_store_header_t) - s_ota_written;
+        if (n > size) {
+            n = size;
+        }
+        memcpy((uint8_t *)&s_ota_header + s_ota_written, bytes, n);
+        s_ota_written += n;
+        bytes += n;
+        size -= n;
+    }
+    if (size == 0) {
+        return ESP_OK;
+    }
+
+    esp_err_t ret = esp_partition_write(s_slots[s_ota_slot].partition, s_ota_written, bytes, size);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Write at %u failed: %s", (unsigned)s_ota_written, esp_err_to_name(ret));
+        return ret;
+    }
+    s_ota_written += size;
+    return ESP_OK;
+}
+
+esp_err_t model_store_ota_end(void)
+{
+    if (s_ota_slot < 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    int slot = s_ota_slot;
+    s_ota_slot = -1;
+    if (s_ota_written != s_ota_size) {
+        ESP_LOGE(TAG, "Image incomplete: %u of %u bytes",
+                 (unsigned)s_ota_written, (unsigned)s_ota_size);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    // Newer than whatever is mapped, regardless of what the image says
+    s_ota_header.generation = s_header.generation + 1;
+
+    const uint8_t *base;
+    esp_partition_mmap_handle_t handle;
+    esp_err_t ret = map_slot(slot, &base, &handle);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    bool valid = validate_image(base, s_ota_size, &s_ota_header);
+    esp_partition_munmap(handle);
+    if (!valid) {
+        ESP_LOGE(TAG, "Image rejected");
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    // Commit point: the slot is valid once its header is in flash
+    ret = esp_partition_write(s_slots[slot].partition, 0, &s_ota_header, sizeof(s_ota_header));
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Header write failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    s_slots[slot].generation = s_ota_header.generation;
+
+    portENTER_CRITICAL(&s_state_lock);
+    __atomic_store_n(&s_pending, slot, __ATOMIC_RELEASE);
+    portEXIT_CRITICAL(&s_state_lock);
+
+    ESP_LOGI(TAG, "Generation %u committed to %s", (unsigned)s_ota_header.generation,
+             s_slots[slot].partition->label);
+    return ESP_OK;
+}
+
+void model_store_ota_abort(void)
+{
+    if (s_ota_slot >= 0) {
+        ESP_LOGW(TAG, "Update abandoned after %u bytes", (unsigned)s_ota_written);
+        s_ota_slot = -1;
+    }
+}
+
+#endif /* CONFIG_MODEL_STORE_PARTITION */
@@ -0,0 +1,154 @@
+// model_store.h
+#ifndef MODEL_STORE_H
+#define MODEL_STORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "benchmark.h"
+#include "ml_contract.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Only built with CONFIG_MODEL_STORE_PARTITION.
+ *
+ * Models live in up to two data partitions of subtype MODEL_STORE_SUBTYPE
+ * (A/B slots, see partitions_models.csv) instead of the app image. The
+ * slot with a valid table and the highest generation is memory-mapped, and
+ * sessions read the flatbuffers straight from flash cache.
+ *
+ * Slot layout, version 2 (all little endian, written by gen_model_store.py):
+ *   - model_store_header_t
+ *   - count x model_store_entry_t
+ *   - model flatbuffers at MODEL_STORE_ALIGN-aligned offsets
+ * Version 1 images, whose entries end before 'classes', still load; their
+ * models get the training summary's class order.
+ * table_crc covers the entries, each entry's crc32 its model bytes; both
+ * are zlib CRC-32 (esp_rom_crc32_le(0, ...)). An update is written to
+ * the other slot with its header last, so an interrupted update leaves
+ * no valid magic and the running slot stays in use.
+ */
+#define MODEL_STORE_MAGIC       0x534C444Du   // "MDLS"
+#define MODEL_STORE_VERSION     2
+#define MODEL_STORE_ENTRY_V1    32            // Entry bytes of a version 1 image
+#define MODEL_STORE_SUBTYPE     0x40          // Custom data partition subtype
+#define MODEL_STORE_MAX_MODELS  8
+#define MODEL_STORE_ALIGN       16            // Flatbuffer alignment in the slot
+#define MODEL_STORE_MAX_CLASSES ML_MAX_MODEL_OUTPUTS
+
+#define MODEL_STORE_FLAG_INT8   0x01          // Quantized input/output
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;               // MODEL_STORE_MAGIC
+    uint16_t version;             // MODEL_STORE_VERSION
+    uint16_t count;               // Entries following the header
+    uint32_t generation;          // Highest valid generation is loaded
+    uint32_t table_crc;           // CRC-32 of the entries
+} model_store_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t type;                 // model_type_t
+    uint8_t flags;                // MODEL_STORE_FLAG_*
+    uint8_t class_count;          // Outputs listed in classes, 0 = no map
+    uint8_t reserved;
+    uint32_t offset;              // From the slot start
+    uint32_t size;                // Flatbuffer bytes
+    uint32_t arena_hint;          // Arena bytes, 0 = calibrate on first use
+    uint32_t crc32;               // CRC-32 of the flatbuffer
+    char name[12];                // NUL padded
+    int8_t classes[MODEL_STORE_MAX_CLASSES];  // ml_class_t of each output
+} model_store_entry_t;
+
+// One model of the mapped slot
+typedef struct {
+    const unsigned char *data;    // Memory-mapped flatbuffer
+    size_t size;
+    size_t arena_hint;
+    bool is_int8;
+    ml_class_map_t class_map;     // count 0 if the entry has none
+} model_store_model_t;
+
+/**
+ * @brief Find the model slots and map the newest valid one
+ *
+ * @return esp_err_t ESP_OK if a slot is mapped
+ */
+esp_err_t model_store_init(void);
+
+/**
+ * @brief Look up a model in the mapped slot
+ *
+ * @param type Model type
+ * @param model Output (valid until model_store_activate_update())
+ * @return true if the slot holds the model
+ */
+bool model_store_find(model_type_t type, model_store_model_t *model);
+
+/**
+ * @brief Generation of the mapped slot (0 if none)
+ */
+uint32_t model_store_generation(void);
+
+/**
+ * @brief A verified update is waiting in the other slot
+ *
+ * Cheap enough to poll once per window.
+ */
+bool model_store_update_pending(void);
+
+/**
+ * @brief Map the pending slot and unmap the current one
+ *
+ * Data returned by model_store_find() for the old slot becomes invalid:
+ * every session built on it must be destroyed first. Called by
+ * model_registry_reload().
+ *
+ * @return esp_err_t ESP_OK if the update is now mapped
+ */
+esp_err_t model_store_activate_update(void);
+
+/**
+ * @brief Start writing a store image to the inactive slot
+ *
+ * Erases the slot. The image is a complete gen_model_store.py output; its
+ * generation is replaced by one above the mapped slot's.
+ *
+ * @param image_size Image bytes that will be written
+ * @return esp_err_t ESP_OK on success
+ */
+esp_err_t model_store_ota_begin(size_t image_size);
+
+/**
+ * @brief Append image bytes (in order) to the slot being written
+ *
+ * @param data Image bytes
+ * @param size Byte count
+ * @return esp_err_t ESP_OK on success
+ */
+esp_err_t model_store_ota_write(const void *data, size_t size);
+
+/**
+ * @brief Verify the written slot and commit its header
+ *
+ * Checks the table and every model CRC through a mapping of the new slot,
+ * then writes the header. On success model_store_update_pending() turns
+ * true and the inference task swaps the models in between two windows.
+ *
+ * @return esp_err_t ESP_OK if the update is committed
+ */
+esp_err_t model_store_ota_end(void);
+
+/**
+ * @brief Abandon an update started with model_store_ota_begin()
+ */
+void model_store_ota_abort(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MODEL_STORE_H */
@@ -0,0 +1,131 @@
+#include "packet_decoder.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "PACKET_DECODER";
+
+#define FRAME_SIZE          sizeof(uart_packet_t)
+#define TYPE_OFFSET         offsetof(uart_packet_t, packet_type)
+#define LENGTH_OFFSET       offsetof(uart_packet_t, payload_length)
+
+// Highest type accepted (PKT_TYPE_COMMAND, from host tools)
+#define PACKET_TYPE_MAX     0x06
+
+void packet_decoder_init(packet_decoder_t *decoder, packet_handler_t on_packet,
+                         packet_line_handler_t on_line, void *ctx) {
+    if (!decoder) return;
+    
+    memset(decoder, 0, sizeof(packet_decoder_t));
+    decoder->on_packet = on_packet;
+    decoder->on_line = on_line;
+    decoder->ctx = ctx;
+}
+
+static void text_byte(packet_decoder_t *d, uint8_t byte) {
+    if (byte == '\n' || byte == '\r') {
+        if (d->text_length > 0) {
+            d->text[d->text_length] = 0;
+            if (d->on_line) {
+                d->on_line(d->text, d->ctx);
+            }
+        }
+        d->text_length = 0;
+    } else if (d->text_length < PACKET_TEXT_MAX - 1) {
+        d->text[d->text_length++] = (char)byte;
+    }
+}
+
+// Reject a frame as soon as its type or payload length is impossible
+static bool header_valid(const packet_decoder_t *d) {
+    if (d->frame_length > TYPE_OFFSET) {
+        uint8_t type = d->frame[TYPE_OFFSET];
+        if (type == 0 || type > PACKET_TYPE_MAX) {
+            return false;
+        }
+    }
+    if (d->frame_length > LENGTH_OFFSET && d->frame[LENGTH_OFFSET] > PACKET_MAX_PAYLOAD) {
+        return false;
+    }
+    return true;
+}
+
+// Drop the current sync byte and resume at the next one in the frame
+static void resync(packet_decoder_t *d) {
+    size_t next = 1;
+    while (next < d->frame_length && d->frame[next] != PACKET_SYNC_BYTE) {
+        next++;
+    }
+    d->frame_length -= next;
+    memmove(d->frame, d->frame + next, d->frame_length);
+}
+
+static void dispatch(packet_decoder_t *d) {
+    uart_packet_t packet;
+    memcpy(&packet, d->frame, FRAME_SIZE);
+    
+    // Retries repeat the whole packet; the generator reuses a sequence
+    // number after giving up on one, so that alone is not a retry
+    bool duplicate = d->has_sequence && packet.sequence == d->last_sequence &&
+                     packet.packet_type == d->last_type &&
+                     packet.payload_length == d->last_payload_length &&
+                     memcmp(packet.payload, d->last_payload, packet.payload_length) == 0;
+    if (duplicate) {
+        d->duplicates++;
+    } else if (d->has_sequence) {
+        uint16_t gap = (uint16_t)(packet.sequence - d->last_sequence - 1);
+        if (gap > 0 && gap < 0x8000) {
+            d->sequence_gaps += gap;
+            ESP_LOGW(TAG, "Missed %u packet(s) before seq %u", gap, packet.sequence);
+        }
+    }
+    d->last_sequence = packet.sequence;
+    d->has_sequence = true;
+    d->last_type = packet.packet_type;
+    d->last_payload_length = packet.payload_length;
+    memcpy(d->last_payload, packet.payload, packet.payload_length);
+    d->packets++;
+    
+    if (d->on_packet) {
+        d->on_packet(&packet, duplicate, d->ctx);
+    }
+}
+
+void packet_decoder_feed(packet_decoder_t *decoder, const uint8_t *data, size_t length) {
+    if (!decoder || !data) return;
+    
+    for (size_t i = 0; i < length; i++) {
+        if (decoder->frame_length == 0) {
+            // Hunting: anything but the sync byte is text
+            if (data[i] == PACKET_SYNC_BYTE) {
+                decoder->frame[decoder->frame_length++] = data[i];
+            } else {
+                text_byte(decoder, data[i]);
+            }
+            continue;
+        }
+        
+        decoder->frame[decoder->frame_length++] = data[i];
+        
+        while (decoder->frame_length > 0) {
+            if (!header_valid(decoder)) {
+                decoder->framing_errors++;
+                resync(decoder);
+                continue;
+            }
+            if (decoder->frame_length < FRAME_SIZE) {
+                break;
+            }
+            
+            uint8_t crc = calculate_crc8(decoder->frame, FRAME_SIZE - 1);
+            if (crc == decoder->frame[FRAME_SIZE - 1]) {
+                dispatch(decoder);
+                decoder->frame_length = 0;
+            } else {
+                decoder->crc_errors++;
+                ESP_LOGD(TAG, "CRC mismatch (got 0x%02X, want 0x%02X)", 
+                         decoder->frame[FRAME_SIZE - 1], crc);
+                resync(decoder);
+            }
+        }
+    }
+}
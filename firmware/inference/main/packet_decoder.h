@@ -0,0 +1,94 @@
+#ifndef PACKET_DECODER_H
+#define PACKET_DECODER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "clock_sync.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PACKET_SYNC_BYTE        0xAA
+#define PACKET_MAX_PAYLOAD      32
+#define PACKET_TEXT_MAX         64
+
+/**
+ * @brief Called for every packet that passes the CRC
+ * 
+ * @param packet Decoded packet (valid only during the call)
+ * @param duplicate true if this repeats the previous packet (a retry): same
+ *                  sequence number, type and payload
+ * @param ctx User context
+ */
+typedef void (*packet_handler_t)(const uart_packet_t *packet, bool duplicate, void *ctx);
+
+/**
+ * @brief Called for every ASCII line received outside a packet
+ * 
+ * @param line NUL-terminated line without its line ending
+ * @param ctx User context
+ */
+typedef void (*packet_line_handler_t)(char *line, void *ctx);
+
+/**
+ * @brief Streaming decoder for generator uart_packet_t frames
+ * 
+ * Bytes are fed as they arrive. The decoder hunts for the sync byte,
+ * rejects frames with an impossible type or payload length as soon as
+ * those bytes arrive, and checks the CRC8 over the full frame. After a
+ * bad frame it resumes at the next sync byte inside the rejected bytes,
+ * so a corrupted frame costs at most itself. Text outside frames (0xAA
+ * never occurs in ASCII) is split into lines for the legacy "LBL:" path.
+ */
+typedef struct {
+    uint8_t frame[sizeof(uart_packet_t)];
+    size_t frame_length;          // 0 while hunting
+    char text[PACKET_TEXT_MAX];
+    size_t text_length;
+    
+    // Previous packet, to tell retries from reused sequence numbers
+    uint16_t last_sequence;
+    bool has_sequence;
+    uint8_t last_type;
+    uint8_t last_payload_length;
+    uint8_t last_payload[PACKET_MAX_PAYLOAD];
+    
+    packet_handler_t on_packet;
+    packet_line_handler_t on_line;
+    void *ctx;
+    
+    // Statistics
+    uint32_t packets;             // Valid frames
+    uint32_t crc_errors;
+    uint32_t framing_errors;      // Bad type or payload length
+    uint32_t duplicates;          // Retries of the previous packet
+    uint32_t sequence_gaps;       // Frames missed between valid ones
+} packet_decoder_t;
+
+/**
+ * @brief Initialize a decoder
+ * 
+ * @param decoder Decoder
+ * @param on_packet Packet callback (may be NULL)
+ * @param on_line Text line callback (may be NULL)
+ * @param ctx Context passed to the callbacks
+ */
+void packet_decoder_init(packet_decoder_t *decoder, packet_handler_t on_packet,
+                         packet_line_handler_t on_line, void *ctx);
+
+/**
+ * @brief Feed received bytes, invoking the callbacks for complete frames and lines
+ * 
+ * @param decoder Decoder
+ * @param data Received bytes
+ * @param length Number of bytes
+ */
+void packet_decoder_feed(packet_decoder_t *decoder, const uint8_t *data, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PACKET_DECODER_H */
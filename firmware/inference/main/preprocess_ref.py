@@ -0,0 +1,161 @@
+"""
+Reference for the integer int8 preprocessing (preprocess_codes_int8() in
+preprocessing.c), to check the firmware bit for bit and to quantize
+training or calibration windows the way the device will.
+
+Every step uses the same integer arithmetic as the C kernel: the Q15
+window table of gen_window_table.py, the rounded Q(-8) windowed codes,
+the rounded mean, the per-window Q31 multiplier and round-half-up
+shifts. The float definition (ml_contract.h) is computed alongside; the
+two differ by at most 1 LSB.
+
+    python main/preprocess_ref.py --window hann --scale 0.0078125 \\
+        --zero-point 0 --codes windows.csv --output expected.csv
+    python main/preprocess_ref.py ... --codes windows.csv --check device.csv
+"""
+import argparse
+import csv
+import math
+import random
+import sys
+
+from gen_window_table import WINDOWS, float32
+
+ADC_MIDSCALE = 2048     # ML_ADC_MIDSCALE
+ADC_MAX = 4095          # ML_ADC_MAX
+
+
+def window_q15(n, window):
+    """ml_window_table_q15 (gen_window_table.py) for n samples"""
+    coefficients = [max(float32(WINDOWS[window](i, n)), 0.0) for i in range(n)]
+    return [min(int(round(c * 32768.0)), 32767) for c in coefficients], coefficients
+
+
+def c_div(a, b):
+    """C integer division (truncates toward zero)"""
+    q = abs(a) // abs(b)
+    return q if (a >= 0) == (b > 0) else -q
+
+
+def inverse_scale_fixed(scale):
+    """1/scale as (Q31 mantissa, exponent), as inverse_scale_fixed()"""
+    scale = float32(scale)
+    if scale <= 0.0:
+        raise ValueError('scale must be positive')
+    # A double quotient rounded to single is the correctly rounded single
+    # quotient (53 >= 2 * 24 + 2), i.e. the device's 1.0f / scale
+    mantissa, exponent = math.frexp(float32(1.0 / scale))
+    return int(mantissa * (1 << 31)), exponent
+
+
+def clamp8(q):
+    return -128 if q < -128 else (127 if q > 127 else q)
+
+
+def preprocess_int8(codes, scale, zero_point, window):
+    """Bit-exact preprocess_codes_int8()"""
+    n = len(codes)
+    w, _ = window_q15(n, window)
+    y = [(w[i] * (codes[i] - ADC_MIDSCALE) + 128) >> 8 for i in range(n)]
+
+    total = sum(y)
+    mean = c_div(total + n // 2, n) if total >= 0 else c_div(total - n // 2, n)
+    peak = max(max(y) - mean, mean - min(y))
+    if peak <= 0:
+        return [clamp8(zero_point)] * n
+
+    inv_q31, inv_exp = inverse_scale_fixed(scale)
+    b = peak.bit_length()
+    multiplier = ((inv_q31 << (b - 1)) + peak // 2) // peak
+    shift = 30 + b - inv_exp
+    if shift < 1 or shift > 62:
+        raise ValueError('scale out of range')
+    rounding = 1 << (shift - 1)
+    return [clamp8((((v - mean) * multiplier + rounding) >> shift) + zero_point) for v in y]
+
+
+def preprocess_float_int8(codes, scale, zero_point, window):
+    """The float definition, quantized: round(x / scale) + zero_point"""
+    n = len(codes)
+    _, w = window_q15(n, window)
+    y = [w[i] * (codes[i] / ADC_MIDSCALE - 1.0) for i in range(n)]
+    mean = sum(y) / n
+    peak = max(max(y) - mean, mean - min(y))
+    inv_peak = 1.0 / peak if peak > 1e-6 else 1.0
+    return [clamp8(int(round((v - mean) * inv_peak / scale)) + zero_point) for v in y]
+
+
+def read_rows(path):
+    with open(path, newline='') as f:
+        return [[int(v) for v in row] for row in csv.reader(f) if row]
+
+
+def synthetic_windows(count, n, seed):
+    """Noisy tones at random amplitude, offset and frequency, plus flat windows"""
+    rng = random.Random(seed)
+    windows = [[ADC_MIDSCALE] * n, [0] * n, [ADC_MAX] * n]
+    while len(windows) < count:
+        amplitude = rng.uniform(1, ADC_MIDSCALE)
+        offset = rng.uniform(amplitude, ADC_MAX - amplitude)
+        cycles = rng.uniform(0.5, n / 4)
+        windows.append([min(max(int(offset + amplitude * math.sin(2 * math.pi * cycles * i / n)
+                                    + rng.gauss(0, 4)), 0), ADC_MAX) for i in range(n)])
+    return windows
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--window', choices=sorted(WINDOWS), default='hann',
+                        help='Kconfig PREPROCESS_WINDOW')
+    parser.add_argument('--scale', type=float, required=True, help='Input tensor scale')
+    parser.add_argument('--zero-point', type=int, required=True, help='Input tensor zero point')
+    parser.add_argument('--codes', help='CSV of raw ADC windows, one per row')
+    parser.add_argument('--synthetic', type=int, default=0, metavar='N',
+                        help='Use N seeded synthetic windows instead of --codes')
+    parser.add_argument('--size', type=int, default=256, help='Synthetic window size')
+    parser.add_argument('--save-codes', help='Write the input windows as CSV (for the device)')
+    parser.add_argument('--output', help='Write the expected int8 windows as CSV')
+    parser.add_argument('--check', help='CSV of int8 windows from the device to compare')
+    args = parser.parse_args()
+
+    if args.codes:
+        windows = read_rows(args.codes)
+    elif args.synthetic:
+        windows = synthetic_windows(args.synthetic, args.size, 20240601)
+    else:
+        parser.error('--codes or --synthetic is required')
+
+    expected = [preprocess_int8(codes, args.scale, args.zero_point, args.window)
+                for codes in windows]
+
+    worst = 0
+    for codes, q in zip(windows, expected):
+        reference = preprocess_float_int8(codes, args.scale, args.zero_point, args.window)
+        worst = max(worst, max(abs(a - b) for a, b in zip(q, reference)))
+    print('%d windows, integer vs float path: max %d LSB' % (len(windows), worst))
+
+    if args.save_codes:
+        with open(args.save_codes, 'w', newline='') as f:
+            csv.writer(f).writerows(windows)
+    if args.output:
+        with open(args.output, 'w', newline='') as f:
+            csv.writer(f).writerows(expected)
+
+    if args.check:
+        device = read_rows(args.check)
+        if len(device) != len(expected):
+            print('%d device windows for %d inputs' % (len(device), len(expected)))
+            return 1
+        mismatched = [i for i, (a, b) in enumerate(zip(device, expected)) if a != b]
+        for i in mismatched[:10]:
+            j = next(k for k, (a, b) in enumerate(zip(device[i], expected[i])) if a != b)
+            print('window %d: first difference at sample %d (device %d, reference %d)'
+                  % (i, j, device[i][j], expected[i][j]))
+        print('%d of %d windows bit-exact' % (len(expected) - len(mismatched), len(expected)))
+        return 1 if mismatched else 0
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -2,19 +2,54 @@
 #include <math.h>
 #include <string.h>
 #include "esp_log.h"
+#include "ml_contract.h"
+#include "window_table.h"
 
+#ifdef CONFIG_USE_ESP_DSP
+#include "esp_dsp.h"
+#endif
+
+#if defined(CONFIG_DETAILED_ERROR_LOGS) || defined(CONFIG_USE_ESP_DSP)
 static const char *TAG = "PREPROCESSING";
+#endif
 
-// FFT workspace (optimized for actual window size)
-#define MAX_FFT_SIZE 256  // Reduced from 2048 to match SAMPLE_WINDOW_SIZE
+// FFT workspace, sized for a two-window spectral span
+#define MAX_FFT_SIZE PREPROCESS_MAX_SAMPLES
+_Static_assert((MAX_FFT_SIZE & (MAX_FFT_SIZE - 1)) == 0 && MAX_FFT_SIZE >= 4,
+               "ML_WINDOW_SIZE must be a power of 2 for the FFT");
 static float s_fft_workspace[MAX_FFT_SIZE] __attribute__((aligned(16)));
 
+// Real FFT of N samples = complex FFT of N/2 packed samples + split step.
+// Interleaved re/im buffer, laid out the way ESP-DSP expects.
+static float s_fft_complex[MAX_FFT_SIZE] __attribute__((aligned(16)));
+
+// Twiddles W_N^k = cos(2*pi*k/N) - j*sin(2*pi*k/N), k < N/2, and the
+// bit-reverse permutation for N/2 points. Built once per FFT size.
+static float s_twiddle_cos[MAX_FFT_SIZE / 2];
+static float s_twiddle_sin[MAX_FFT_SIZE / 2];
+static uint16_t s_bitrev[MAX_FFT_SIZE / 2];
+static int s_table_size = 0;
+
+#ifdef CONFIG_USE_ESP_DSP
+static bool s_dsp_initialized = false;
+#endif
+
+// Window coefficients for sizes other than ML_WINDOW_SIZE (which uses the
+// generated ml_window_table), built once per size
+static float s_window_runtime[MAX_FFT_SIZE] __attribute__((aligned(16)));
+static int s_window_runtime_size = 0;
+static int16_t s_window_runtime_q15[MAX_FFT_SIZE] __attribute__((aligned(16)));
+static int s_window_runtime_q15_size = 0;
+
+// Raw ADC code -> [-1, 1) sample
+#define ADC_CODE_SCALE (1.0f / ML_ADC_MIDSCALE)
+
 void preprocess_samples_fixed(float *samples, int num_samples, preprocessing_options_t options) {
     // FIXED ORDER: Windowing → DC removal → normalization
     
     // 1. Apply window FIRST to minimize edge effects
     if (options & PREPROCESS_WINDOWING) {
-        apply_hann_window(samples, num_samples);
+        apply_window(samples, num_samples);
     }
     
     // 2. Remove DC offset from windowed signal
@@ -64,9 +99,66 @@ void normalize_samples(float *samples, int num_samples) {
     }
 }
 
+// Configured window function, for sizes without a generated table
+static float window_coefficient(int i, int n) {
+    float phase = 2.0f * M_PI * i / (n - 1);
+    #if CONFIG_PREPROCESS_WINDOW_HAMMING
+    return 0.54f - 0.46f * cosf(phase);
+    #elif CONFIG_PREPROCESS_WINDOW_BLACKMAN
+    return fmaxf(0.42f - 0.5f * cosf(phase) + 0.08f * cosf(2.0f * phase), 0.0f);
+    #else
+    return 0.5f * (1.0f - cosf(phase));
+    #endif
+}
+
+static const float *window_table(int n) {
+    if (n == ML_WINDOW_SIZE) {
+        return ml_window_table;
+    }
+    if (n != s_window_runtime_size) {
+        for (int i = 0; i < n; i++) {
+            s_window_runtime[i] = window_coefficient(i, n);
+        }
+        s_window_runtime_size = n;
+    }
+    return s_window_runtime;
+}
+
+static const int16_t *window_table_q15(int n) {
+    if (n == ML_WINDOW_SIZE) {
+        return ml_window_table_q15;
+    }
+    if (n != s_window_runtime_q15_size) {
+        const float *w = window_table(n);
+        for (int i = 0; i < n; i++) {
+            int32_t q = (int32_t)lrintf(w[i] * 32768.0f);
+            s_window_runtime_q15[i] = (int16_t)(q > 32767 ? 32767 : q);
+        }
+        s_window_runtime_q15_size = n;
+    }
+    return s_window_runtime_q15;
+}
+
+void apply_window(float *samples, int num_samples) {
+    if (num_samples < 2 || num_samples > MAX_FFT_SIZE) return;
+    
+    const float *w = window_table(num_samples);
+    for (int i = 0; i < num_samples; i++) {
+        samples[i] *= w[i];
+    }
+}
+
 void apply_hann_window(float *samples, int num_samples) {
     if (num_samples < 2) return;  // Need at least 2 samples for Hann window
     
+    #if !CONFIG_PREPROCESS_WINDOW_HAMMING && !CONFIG_PREPROCESS_WINDOW_BLACKMAN
+    // Hann is the configured window: reuse its table
+    if (num_samples <= MAX_FFT_SIZE) {
+        apply_window(samples, num_samples);
+        return;
+    }
+    #endif
+    
     // Precompute constants for efficiency
     float pi_factor = 2.0f * M_PI / (num_samples - 1);
     
@@ -76,13 +168,270 @@ void apply_hann_window(float *samples, int num_samples) {
     }
 }
 
-bool compute_fft_fixed(float *samples, int num_samples) {
+// The kernels below are force-inlined and called with n = ML_WINDOW_SIZE
+// as a constant for the configured size, so the loops have a fixed trip
+// count over 16-byte aligned tables and the compiler can unroll them.
+#define PREPROCESS_KERNEL static inline __attribute__((always_inline))
+
+// Mean and 1/peak of the windowed, DC-removed signal (same order as
+// preprocess_samples_fixed), without materializing it. One pass:
+// max|y - mean| = max(y_max - mean, mean - y_min).
+PREPROCESS_KERNEL void float_window_stats(const uint16_t *codes, int n, const float *w, 
+                                          float *mean, float *inv_peak) {
+    float sum = 0.0f;
+    float y_min = INFINITY;
+    float y_max = -INFINITY;
+    for (int i = 0; i < n; i++) {
+        float y = w[i] * (codes[i] * ADC_CODE_SCALE - 1.0f);
+        sum += y;
+        if (y < y_min) y_min = y;
+        if (y > y_max) y_max = y;
+    }
+    float m = sum / n;
+    float peak = fmaxf(y_max - m, m - y_min);
+    
+    *mean = m;
+    // Same silent-window rule as normalize_samples(): leave unscaled
+    *inv_peak = (peak > 1e-6f) ? 1.0f / peak : 1.0f;
+}
+
+PREPROCESS_KERNEL void float_kernel(const uint16_t *codes, int n, const float *w, float *out) {
+    float mean, inv_peak;
+    float_window_stats(codes, n, w, &mean, &inv_peak);
+    
+    for (int i = 0; i < n; i++) {
+        out[i] = (w[i] * (codes[i] * ADC_CODE_SCALE - 1.0f) - mean) * inv_peak;
+    }
+}
+
+bool preprocess_codes_float(const uint16_t *codes, int num_samples, float *out) {
+    if (!codes || !out || num_samples < 2 || num_samples > MAX_FFT_SIZE) {
+        return false;
+    }
+    
+    if (num_samples == ML_WINDOW_SIZE) {
+        float_kernel(codes, ML_WINDOW_SIZE, ml_window_table, out);
+    } else {
+        float_kernel(codes, num_samples, window_table(num_samples), out);
+    }
+    return true;
+}
+
+// Windowed sample in Q(-8) of (code - midscale) * w: |y| < 2^18
+static inline int32_t windowed_code(uint16_t code, int16_t w_q15) {
+    return ((int32_t)w_q15 * ((int32_t)code - ML_ADC_MIDSCALE) + 128) >> 8;
+}
+
+PREPROCESS_KERNEL bool int8_kernel(const uint16_t *codes, int n, const int16_t *w,
+                                   int32_t inv_scale_q31, int inv_scale_exp,
+                                   int zero_point, int8_t *out) {
+    // Single reduction pass: sum, min and max of the windowed signal
+    int32_t sum = 0;
+    int32_t y_min = INT32_MAX;
+    int32_t y_max = INT32_MIN;
+    for (int i = 0; i < n; i++) {
+        int32_t y = windowed_code(codes[i], w[i]);
+        sum += y;
+        if (y < y_min) y_min = y;
+        if (y > y_max) y_max = y;
+    }
+    
+    int32_t mean = (sum >= 0) ? (sum + n / 2) / n
+                              : (sum - n / 2) / n;
+    int32_t peak = y_max - mean;
+    if (mean - y_min > peak) peak = mean - y_min;
+    
+    // Flat window: normalization is a no-op and the signal rounds to 0
+    if (peak <= 0) {
+        int8_t zp = (int8_t)(zero_point < -128 ? -128 : (zero_point > 127 ? 127 : zero_point));
+        memset(out, zp, n);
+        return true;
+    }
+    
+    // q = (y - mean) * (1/scale) / peak. With 2^(b-1) <= peak < 2^b the
+    // per-window multiplier inv_scale_q31 * 2^(b-1) / peak stays in
+    // [2^29, 2^31): one integer divide per window, none per sample.
+    int b = 32 - __builtin_clz((uint32_t)peak);
+    int64_t multiplier = ((((int64_t)inv_scale_q31) << (b - 1)) + peak / 2) / peak;
+    int shift = 30 + b - inv_scale_exp;
+    if (shift < 1 || shift > 62) {
+        return false;
+    }
+    const int64_t round = (int64_t)1 << (shift - 1);
+    
+    for (int i = 0; i < n; i++) {
+        int64_t d = windowed_code(codes[i], w[i]) - mean;
+        int32_t q = (int32_t)((d * multiplier + round) >> shift) + zero_point;
+        if (q < -128) q = -128;
+        if (q > 127) q = 127;
+        out[i] = (int8_t)q;
+    }
+    return true;
+}
+
+// 1/scale as a Q31 mantissa in [2^30, 2^31) and a binary exponent. The
+// float reciprocal has a 24-bit mantissa, so the Q31 value is exact.
+static bool inverse_scale_fixed(float scale, int32_t *q31, int *exponent) {
+    if (!(scale > 0.0f)) {
+        return false;
+    }
+    float mantissa = frexpf(1.0f / scale, exponent);
+    *q31 = (int32_t)ldexpf(mantissa, 31);
+    return *q31 > 0;
+}
+
+void preprocess_format_int8(preprocess_format_t *format, float scale, int zero_point) {
+    if (!format) return;
+    
+    memset(format, 0, sizeof(preprocess_format_t));
+    format->type = PREPROCESS_OUTPUT_INT8;
+    format->scale = scale;
+    format->zero_point = zero_point;
+    if (!inverse_scale_fixed(scale, &format->inv_scale_q31, &format->inv_scale_exp)) {
+        format->inv_scale_q31 = 0;
+    }
+}
+
+static bool codes_to_int8(const uint16_t *codes, int num_samples, int32_t inv_scale_q31,
+                          int inv_scale_exp, int zero_point, int8_t *out) {
+    if (!codes || !out || num_samples < 2 || num_samples > MAX_FFT_SIZE) {
+        return false;
+    }
+    
+    if (num_samples == ML_WINDOW_SIZE) {
+        return int8_kernel(codes, ML_WINDOW_SIZE, ml_window_table_q15, 
+                           inv_scale_q31, inv_scale_exp, zero_point, out);
+    }
+    return int8_kernel(codes, num_samples, window_table_q15(num_samples), 
+                       inv_scale_q31, inv_scale_exp, zero_point, out);
+}
+
+bool preprocess_codes_int8(const uint16_t *codes, int num_samples, 
+                           float scale, int zero_point, int8_t *out) {
+    int32_t inv_scale_q31;
+    int inv_scale_exp;
+    if (!inverse_scale_fixed(scale, &inv_scale_q31, &inv_scale_exp)) {
+        return false;
+    }
+    return codes_to_int8(codes, num_samples, inv_scale_q31, inv_scale_exp, zero_point, out);
+}
+
+bool quantize_samples_int8(const float *samples, int num_samples, 
+                           float scale, int zero_point, int8_t *out) {
+    if (!samples || !out || num_samples <= 0 || scale <= 0.0f) {
+        return false;
+    }
+    
+    const float inv_scale = 1.0f / scale;
+    for (int i = 0; i < num_samples; i++) {
+        int32_t q = (int32_t)lrintf(samples[i] * inv_scale) + zero_point;
+        if (q < -128) q = -128;
+        if (q > 127) q = 127;
+        out[i] = (int8_t)q;
+    }
+    return true;
+}
+
+bool preprocess_codes(const preprocess_format_t *format, const uint16_t *codes, 
+                      int num_samples, void *out) {
+    if (!format) {
+        return false;
+    }
+    
+    switch (format->type) {
+        case PREPROCESS_OUTPUT_FLOAT32:
+            return preprocess_codes_float(codes, num_samples, (float *)out);
+        case PREPROCESS_OUTPUT_INT8:
+            if (format->inv_scale_q31 > 0) {
+                return codes_to_int8(codes, num_samples, format->inv_scale_q31,
+                                     format->inv_scale_exp, format->zero_point, (int8_t *)out);
+            }
+            return preprocess_codes_int8(codes, num_samples, format->scale, 
+                                         format->zero_point, (int8_t *)out);
+        default:
+            return false;
+    }
+}
+
+bool preprocess_format_equal(const preprocess_format_t *a, const preprocess_format_t *b) {
+    if (!a || !b || a->type != b->type) {
+        return false;
+    }
+    if (a->type == PREPROCESS_OUTPUT_INT8) {
+        return a->scale == b->scale && a->zero_point == b->zero_point;
+    }
+    return true;
+}
+
+static void build_fft_tables(int n) {
+    int half = n / 2;
+    
+    for (int k = 0; k < half; k++) {
+        float angle = 2.0f * M_PI * k / n;
+        s_twiddle_cos[k] = cosf(angle);
+        s_twiddle_sin[k] = sinf(angle);
+    }
+    
+    int bits = 0;
+    while ((1 << bits) < half) bits++;
+    
+    for (int i = 0; i < half; i++) {
+        int rev = 0;
+        for (int b = 0; b < bits; b++) {
+            rev |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        s_bitrev[i] = (uint16_t)rev;
+    }
+    
+    s_table_size = n;
+}
+
+#ifndef CONFIG_USE_ESP_DSP
+// In-place iterative radix-2 DIT complex FFT of m points (m = n/2)
+static void complex_fft_radix2(float *data, int m, int n) {
+    for (int i = 0; i < m; i++) {
+        int j = s_bitrev[i];
+        if (j > i) {
+            float tr = data[2 * i], ti = data[2 * i + 1];
+            data[2 * i] = data[2 * j];
+            data[2 * i + 1] = data[2 * j + 1];
+            data[2 * j] = tr;
+            data[2 * j + 1] = ti;
+        }
+    }
+    
+    for (int len = 2; len <= m; len <<= 1) {
+        int half = len >> 1;
+        int step = n / len;  // Stride into the N-point twiddle table
+        
+        for (int i = 0; i < m; i += len) {
+            for (int j = 0; j < half; j++) {
+                float wr = s_twiddle_cos[j * step];
+                float wi = -s_twiddle_sin[j * step];
+                
+                float *a = &data[2 * (i + j)];
+                float *b = &data[2 * (i + j + half)];
+                
+                float vr = b[0] * wr - b[1] * wi;
+                float vi = b[0] * wi + b[1] * wr;
+                
+                b[0] = a[0] - vr;
+                b[1] = a[1] - vi;
+                a[0] += vr;
+                a[1] += vi;
+            }
+        }
+    }
+}
+#endif
+
+const float *compute_fft_magnitude(const float *samples, int num_samples) {
     // Check power of 2
-    if ((num_samples & (num_samples - 1)) != 0) {
+    if (num_samples < 4 || (num_samples & (num_samples - 1)) != 0) {
         #ifdef CONFIG_DETAILED_ERROR_LOGS
         ESP_LOGE(TAG, "FFT requires power of 2 samples, got %d", num_samples);
         #endif
-        return false;
+        return NULL;
     }
     
     // Check if size is supported
@@ -90,43 +439,69 @@ bool compute_fft_fixed(float *samples, int num_samples) {
         #ifdef CONFIG_DETAILED_ERROR_LOGS
         ESP_LOGE(TAG, "FFT size %d exceeds maximum %d", num_samples, MAX_FFT_SIZE);
         #endif
-        return false;
+        return NULL;
+    }
+    
+    if (s_table_size != num_samples) {
+        build_fft_tables(num_samples);
     }
     
-    // Simple FFT implementation for small sizes (2, 4, 8, 16, 32, 64, 128, 256)
-    // For ESP32, use built-in ESP-DSP if available, otherwise fallback
+    int n = num_samples;
+    int m = n / 2;
+    
+    // Pack even/odd samples as real/imaginary parts
+    memcpy(s_fft_complex, samples, n * sizeof(float));
+    
     #ifdef CONFIG_USE_ESP_DSP
-    // ESP-DSP implementation would go here
-    // For now, simulate FFT with magnitude calculation
+    if (!s_dsp_initialized) {
+        if (dsps_fft2r_init_fc32(NULL, MAX_FFT_SIZE / 2) != ESP_OK) {
+            ESP_LOGE(TAG, "ESP-DSP FFT init failed");
+            return NULL;
+        }
+        s_dsp_initialized = true;
+    }
+    dsps_fft2r_fc32(s_fft_complex, m);
+    dsps_bit_rev_fc32(s_fft_complex, m);
+    #else
+    complex_fft_radix2(s_fft_complex, m, n);
     #endif
     
-    // Copy samples to workspace
-    memcpy(s_fft_workspace, samples, num_samples * sizeof(float));
-    
-    // Simple DFT for small N (optimized for common sizes)
-    if (num_samples <= 64) {
-        // Simple DFT implementation
-        for (int k = 0; k < num_samples/2; k++) {
-            float real = 0.0f, imag = 0.0f;
-            for (int n = 0; n < num_samples; n++) {
-                float angle = 2.0f * M_PI * k * n / num_samples;
-                real += s_fft_workspace[n] * cosf(angle);
-                imag -= s_fft_workspace[n] * sinf(angle);
-            }
-            samples[k] = sqrtf(real*real + imag*imag);
-        }
-    } else {
-        // For larger sizes, use approximate FFT or skip
-        // This is a placeholder - in production, use ESP-DSP
-        for (int k = 0; k < num_samples/2; k++) {
-            samples[k] = fabsf(s_fft_workspace[k]);
-        }
+    // Split Z[k] into the spectrum of the real input:
+    // X[k] = (Z[k] + Z*[m-k]) / 2 - j * W_N^k * (Z[k] - Z*[m-k]) / 2
+    for (int k = 0; k < m; k++) {
+        int kc = (m - k) & (m - 1);
+        float ar = s_fft_complex[2 * k], ai = s_fft_complex[2 * k + 1];
+        float br = s_fft_complex[2 * kc], bi = -s_fft_complex[2 * kc + 1];
+        
+        float er = 0.5f * (ar + br);
+        float ei = 0.5f * (ai + bi);
+        float or_ = 0.5f * (ai - bi);
+        float oi = -0.5f * (ar - br);
+        
+        float c = s_twiddle_cos[k];
+        float sn = s_twiddle_sin[k];
+        
+        float xr = er + c * or_ + sn * oi;
+        float xi = ei + c * oi - sn * or_;
+        
+        s_fft_workspace[k] = sqrtf(xr * xr + xi * xi);
     }
     
+    return s_fft_workspace;
+}
+
+bool compute_fft_fixed(float *samples, int num_samples) {
+    const float *magnitude = compute_fft_magnitude(samples, num_samples);
+    if (!magnitude) {
+        return false;
+    }
+    
+    memcpy(samples, magnitude, (num_samples / 2) * sizeof(float));
+    
     // Zero out the second half
     for (int i = num_samples/2; i < num_samples; i++) {
         samples[i] = 0.0f;
     }
     
     return true;
-}
\ No newline at end of file
+}
@@ -4,11 +4,48 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "signal_processing.h"
+#include "ml_contract.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// Longest input the functions below take: spectral analysis may span two
+// consecutive windows (spectral_span_t)
+#define PREPROCESS_MAX_SAMPLES (2 * ML_WINDOW_SIZE)
+
+/**
+ * @brief Element type of a preprocessed window
+ */
+typedef enum {
+    PREPROCESS_OUTPUT_NONE = 0,   // Not preprocessed
+    PREPROCESS_OUTPUT_FLOAT32,    // preprocess_codes_float()
+    PREPROCESS_OUTPUT_INT8        // preprocess_codes_int8() with scale/zero_point
+} preprocess_output_type_t;
+
+/**
+ * @brief Format a raw window is preprocessed into (the model input layout)
+ */
+typedef struct {
+    preprocess_output_type_t type;
+    float scale;          // INT8 only
+    int zero_point;       // INT8 only
+    int32_t inv_scale_q31;// INT8: 1/scale = inv_scale_q31 * 2^(inv_scale_exp - 31),
+    int inv_scale_exp;    // set by preprocess_format_int8() (0 = derive per window)
+} preprocess_format_t;
+
+/**
+ * @brief Describe an int8 input tensor format
+ * 
+ * Also converts 1/scale to the fixed-point form preprocess_codes() uses,
+ * so preprocessing into this format needs no float operation at all.
+ * 
+ * @param format Output format
+ * @param scale Input tensor scale (> 0)
+ * @param zero_point Input tensor zero point
+ */
+void preprocess_format_int8(preprocess_format_t *format, float scale, int zero_point);
+
 /**
  * @brief Preprocess signal samples (FIXED ORDER)
  * 
@@ -18,6 +55,78 @@ extern "C" {
  */
 void preprocess_samples_fixed(float *samples, int num_samples, preprocessing_options_t options);
 
+/**
+ * @brief Preprocess a raw ADC window straight into float samples
+ * 
+ * Fused equivalent of converting codes to [-1, 1) and running
+ * preprocess_samples_fixed(PREPROCESS_ALL), in one output pass.
+ * 
+ * @param codes Raw ADC codes
+ * @param num_samples Number of samples (2..PREPROCESS_MAX_SAMPLES)
+ * @param out Output samples (may be a float input tensor)
+ * @return true if successful
+ */
+bool preprocess_codes_float(const uint16_t *codes, int num_samples, float *out);
+
+/**
+ * @brief Preprocess and quantize a raw ADC window straight into int8
+ * 
+ * Integer-only version of preprocess_codes_float() for int8 models: a Q15
+ * window table, one reduction pass for mean and peak, and the model's
+ * scale/zero-point folded into a single fixed-point multiplier, so
+ * q = round(x / scale) + zero_point (saturated) with no float math per
+ * sample; only 1/scale is converted here, preprocess_codes() with a
+ * preprocess_format_int8() format skips even that. Ties round up.
+ * Bit-exact with preprocess_ref.py and within 1 LSB of the float path.
+ * 
+ * @param codes 12-bit ADC codes (ML_ADC_MIN..ML_ADC_MAX)
+ * @param num_samples Number of samples (2..PREPROCESS_MAX_SAMPLES)
+ * @param scale Input tensor scale
+ * @param zero_point Input tensor zero point
+ * @param out Output (typically the int8 input tensor)
+ * @return true if successful
+ */
+bool preprocess_codes_int8(const uint16_t *codes, int num_samples, 
+                           float scale, int zero_point, int8_t *out);
+
+/**
+ * @brief Quantize float samples for an int8 input tensor
+ * 
+ * q = round(x / scale) + zero_point, saturated to [-128, 127], ties to
+ * even. For windows that are only available as floats; raw windows take
+ * preprocess_codes_int8().
+ * 
+ * @param samples Float samples
+ * @param num_samples Number of samples
+ * @param scale Input tensor scale
+ * @param zero_point Input tensor zero point
+ * @param out Output
+ * @return true if successful
+ */
+bool quantize_samples_int8(const float *samples, int num_samples, 
+                           float scale, int zero_point, int8_t *out);
+
+/**
+ * @brief Preprocess a raw ADC window into the given format
+ * 
+ * @param format Output format
+ * @param codes Raw ADC codes
+ * @param num_samples Number of samples (2..PREPROCESS_MAX_SAMPLES)
+ * @param out Output buffer of num_samples elements of format->type
+ * @return true if successful (false for PREPROCESS_OUTPUT_NONE)
+ */
+bool preprocess_codes(const preprocess_format_t *format, const uint16_t *codes, 
+                      int num_samples, void *out);
+
+/**
+ * @brief Check whether two formats produce identical output
+ * 
+ * @param a First format
+ * @param b Second format
+ * @return true if equal
+ */
+bool preprocess_format_equal(const preprocess_format_t *a, const preprocess_format_t *b);
+
 /**
  * @brief Remove DC offset (subtract mean)
  * 
@@ -34,6 +143,17 @@ void remove_dc_offset(float *samples, int num_samples);
  */
 void normalize_samples(float *samples, int num_samples);
 
+/**
+ * @brief Apply the configured window (Kconfig PREPROCESS_WINDOW) to samples
+ * 
+ * Uses the build-time table for ML_WINDOW_SIZE; other sizes build theirs
+ * once on first use.
+ * 
+ * @param samples Array of samples
+ * @param num_samples Number of samples (2..PREPROCESS_MAX_SAMPLES)
+ */
+void apply_window(float *samples, int num_samples);
+
 /**
  * @brief Apply Hann window to samples
  * 
@@ -42,6 +162,19 @@ void normalize_samples(float *samples, int num_samples);
  */
 void apply_hann_window(float *samples, int num_samples);
 
+/**
+ * @brief Compute the magnitude spectrum of real samples (no dynamic allocation)
+ * 
+ * Uses ESP-DSP dsps_fft2r_fc32 when CONFIG_USE_ESP_DSP is set, otherwise the
+ * in-tree radix-2 FFT. Input is not modified.
+ * 
+ * @param samples Input samples
+ * @param num_samples Number of samples (power of 2, 4..PREPROCESS_MAX_SAMPLES)
+ * @return const float* num_samples/2 magnitude bins in the internal
+ *         FFT workspace (valid until the next call), NULL on error
+ */
+const float *compute_fft_magnitude(const float *samples, int num_samples);
+
 /**
  * @brief Calculate FFT of samples using ESP-DSP (no dynamic allocation)
  * 
@@ -0,0 +1,51 @@
+#ifndef SAMPLE_CODEC_H
+#define SAMPLE_CODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Bytes needed to pack n 12-bit codes
+ */
+#define SAMPLE_PACKED12_BYTES(n)    (((n) * 3 + 1) / 2)
+
+/**
+ * @brief Pack 12-bit ADC codes at 1.5 bytes/sample
+ *
+ * Two codes per 3 bytes, first code in the low bits (byte0 = a[7:0],
+ * byte1 = a[11:8] | b[3:0] << 4, byte2 = b[11:4]); an odd count ends
+ * with 2 bytes. Shared by the SD recorder and the sample stream.
+ *
+ * @param codes Raw codes (upper 4 bits ignored)
+ * @param count Number of codes
+ * @param out Output, at least SAMPLE_PACKED12_BYTES(count) bytes
+ * @return Bytes written
+ */
+static inline size_t sample_pack12(const uint16_t *codes, int count, uint8_t *out)
+{
+    size_t o = 0;
+    int i = 0;
+    for (; i + 1 < count; i += 2) {
+        uint16_t a = codes[i] & 0x0FFF;
+        uint16_t b = codes[i + 1] & 0x0FFF;
+        out[o++] = (uint8_t)a;
+        out[o++] = (uint8_t)((a >> 8) | (b << 4));
+        out[o++] = (uint8_t)(b >> 4);
+    }
+    if (i < count) {
+        uint16_t a = codes[i] & 0x0FFF;
+        out[o++] = (uint8_t)a;
+        out[o++] = (uint8_t)(a >> 8);
+    }
+    return o;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SAMPLE_CODEC_H */
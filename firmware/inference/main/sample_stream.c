@@ -0,0 +1,279 @@
+// sample_stream.c - CRC-framed binary sample stream with host acknowledgements
+#include "sample_stream.h"
+#include "sample_codec.h"
+#include "clock_sync.h"
+#include "packet_decoder.h"
+#include "telemetry.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#ifdef CONFIG_SAMPLE_STREAM_ENABLE
+
+#ifdef CONFIG_SAMPLE_STREAM_USB_SERIAL_JTAG
+#include "driver/usb_serial_jtag.h"
+#else
+#include "driver/uart.h"
+#define STREAM_UART         UART_NUM_0     // Console port, USB bridge
+#endif
+
+static const char *TAG = "SAMPLE_STREAM";
+
+#define TX_BUFFER_SIZE      (CONFIG_SAMPLE_STREAM_TX_BUFFER_KB * 1024)
+#define RX_BUFFER_SIZE      256
+#define RX_TASK_STACK       3072
+#define RX_TASK_PRIORITY    2
+#define LOG_LINE_MAX        160
+
+#if CONFIG_FREERTOS_UNICORE
+#define RX_TASK_CORE        0
+#else
+#define RX_TASK_CORE        CONFIG_PIPELINE_ACQUISITION_CORE
+#endif
+
+#define SAMPLES_FRAME_MAX   (STREAM_FRAME_OVERHEAD + sizeof(stream_samples_header_t) + \
+                             SAMPLE_PACKED12_BYTES(ML_WINDOW_SIZE))
+
+_Static_assert(CONFIG_SAMPLE_STREAM_WINDOW_FRAMES < 32768, "window must fit the 16-bit sequence");
+_Static_assert(SAMPLES_FRAME_MAX <= TX_BUFFER_SIZE, "a full window must fit the TX buffer");
+
+static SemaphoreHandle_t s_tx_lock = NULL;
+static uint16_t s_next_sequence = 0;          // Guarded by s_tx_lock
+static atomic_uint s_acked = 0xFFFF;          // Last frame the host received
+
+// Only touched by the sample producer
+static uint8_t s_samples_frame[SAMPLES_FRAME_MAX];
+
+static atomic_uint s_frames_sent = 0;
+static atomic_uint s_blocks_dropped = 0;
+static atomic_uint s_logs_dropped = 0;
+static atomic_uint s_acks = 0;
+
+#ifdef CONFIG_SAMPLE_STREAM_USB_SERIAL_JTAG
+static esp_err_t transport_init(void)
+{
+    usb_serial_jtag_driver_config_t config = {
+        .tx_buffer_size = TX_BUFFER_SIZE,
+        .rx_buffer_size = RX_BUFFER_SIZE,
+    };
+    return usb_serial_jtag_driver_install(&config);
+}
+
+// The driver queues a write whole or not at all
+static bool transport_write(const uint8_t *data, size_t length)
+{
+    return usb_serial_jtag_write_bytes(data, length, 0) == (int)length;
+}
+
+static int transport_read(uint8_t *data, size_t length, TickType_t timeout)
+{
+    return usb_serial_jtag_read_bytes(data, length, timeout);
+}
+#else
+static esp_err_t transport_init(void)
+{
+    esp_err_t ret = uart_driver_install(STREAM_UART, RX_BUFFER_SIZE, TX_BUFFER_SIZE, 0, NULL, 0);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    return uart_set_baudrate(STREAM_UART, CONFIG_SAMPLE_STREAM_BAUD);
+}
+
+static bool transport_write(const uint8_t *data, size_t length)
+{
+    size_t free_bytes = 0;
+    if (uart_get_tx_buffer_free_size(STREAM_UART, &free_bytes) != ESP_OK || free_bytes < length) {
+        return false;
+    }
+    return uart_write_bytes(STREAM_UART, data, length) == (int)length;
+}
+
+static int transport_read(uint8_t *data, size_t length, TickType_t timeout)
+{
+    return uart_read_bytes(STREAM_UART, data, length, timeout);
+}
+#endif
+
+// Frames past the last acknowledgement
+static inline bool window_open(uint16_t sequence)
+{
+    uint16_t acked = (uint16_t)atomic_load_explicit(&s_acked, memory_order_relaxed);
+    return (uint16_t)(sequence - acked - 1) < CONFIG_SAMPLE_STREAM_WINDOW_FRAMES;
+}
+
+/*
+ * Frame the payload already placed after the header and send it whole.
+ * Never waits: a busy lock (another task mid-frame, or a log emitted by
+ * the transport itself), a closed window or a full TX buffer drops it.
+ */
+static bool send_frame(uint8_t type, uint8_t *frame, size_t payload_length)
+{
+    if (!s_tx_lock || xSemaphoreTake(s_tx_lock, 0) != pdTRUE) {
+        return false;
+    }
+
+    bool sent = false;
+    uint16_t sequence = s_next_sequence;
+    if (window_open(sequence)) {
+        stream_frame_header_t header = {
+            .sync_byte = PACKET_SYNC_BYTE,
+            .packet_type = type,
+            .sequence = sequence,
+            .timestamp_ms = (uint32_t)(esp_timer_get_time() / 1000),
+            .payload_length = (uint16_t)payload_length,
+        };
+        header.header_crc8 = calculate_crc8((const uint8_t *)&header, sizeof(header) - 1);
+        memcpy(frame, &header, sizeof(header));
+
+        uint8_t *payload = frame + sizeof(header);
+        payload[payload_length] = calculate_crc8(payload, payload_length);
+
+        sent = transport_write(frame, sizeof(header) + payload_length + 1);
+        if (sent) {
+            s_next_sequence = sequence + 1;
+            atomic_fetch_add_explicit(&s_frames_sent, 1, memory_order_relaxed);
+        }
+    }
+
+    xSemaphoreGive(s_tx_lock);
+    return sent;
+}
+
+// ESP_LOG sink while streaming
+static int stream_vprintf(const char *format, va_list args)
+{
+    uint8_t frame[STREAM_FRAME_OVERHEAD + LOG_LINE_MAX];
+    char *text = (char *)frame + sizeof(stream_frame_header_t);
+
+    int length = vsnprintf(text, LOG_LINE_MAX, format, args);
+    if (length < 0) {
+        return length;
+    }
+    size_t payload_length = (length < LOG_LINE_MAX) ? (size_t)length : LOG_LINE_MAX - 1;
+    if (!send_frame(STREAM_PKT_LOG, frame, payload_length)) {
+        atomic_fetch_add_explicit(&s_logs_dropped, 1, memory_order_relaxed);
+    }
+    return length;
+}
+
+// Count every frame sent so far as received: what the host missed
+// before it attached is gone either way
+static void reopen_window(void)
+{
+    xSemaphoreTake(s_tx_lock, portMAX_DELAY);
+    atomic_store_explicit(&s_acked, (uint16_t)(s_next_sequence - 1), memory_order_relaxed);
+    xSemaphoreGive(s_tx_lock);
+}
+
+static void on_host_packet(const uart_packet_t *packet, bool duplicate, void *ctx)
+{
+    if (packet->packet_type == PKT_TYPE_ACK) {
+        if (packet->payload_length == 1 && packet->payload[0] == STREAM_ACK_RESYNC) {
+            reopen_window();
+        } else {
+            atomic_store_explicit(&s_acked, packet->sequence, memory_order_relaxed);
+        }
+        atomic_fetch_add_explicit(&s_acks, 1, memory_order_relaxed);
+    } else if (packet->packet_type == PKT_TYPE_COMMAND) {
+        // The host is listening, whatever it missed before sending this
+        reopen_window();
+#ifdef CONFIG_TELEMETRY_ENABLE
+        // Idempotent: a sequence that repeats an ACK's is not a retry
+        telemetry_handle_command(packet->payload, packet->payload_length);
+#endif
+    }
+}
+
+// Host -> device: acknowledgement frames in the generator packet format
+static void stream_rx_task(void *arg)
+{
+    static packet_decoder_t decoder;
+    uint8_t data[64];
+
+    packet_decoder_init(&decoder, on_host_packet, NULL, NULL);
+    while (1) {
+        int n = transport_read(data, sizeof(data), pdMS_TO_TICKS(100));
+        if (n > 0) {
+            packet_decoder_feed(&decoder, data, (size_t)n);
+        }
+    }
+}
+
+esp_err_t sample_stream_init(void)
+{
+    if (s_tx_lock) {
+        return ESP_OK;
+    }
+
+    s_tx_lock = xSemaphoreCreateMutex();
+    if (!s_tx_lock) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Switching console to binary stream (window %d frames)",
+             CONFIG_SAMPLE_STREAM_WINDOW_FRAMES);
+    esp_err_t ret = transport_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Stream transport init failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    if (xTaskCreatePinnedToCore(stream_rx_task, "stream_rx", RX_TASK_STACK, NULL,
+                                RX_TASK_PRIORITY, NULL, RX_TASK_CORE) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_log_set_vprintf(stream_vprintf);
+    return ESP_OK;
+}
+
+bool sample_stream_send(const uint16_t *codes, int count, uint32_t window_sequence,
+                        int64_t start_us, ml_class_t label, uint8_t flags)
+{
+    if (!codes || count <= 0 || count > ML_WINDOW_SIZE) {
+        return false;
+    }
+
+    stream_samples_header_t header = {
+        .window_sequence = window_sequence,
+        .start_us = start_us,
+        .label = (int8_t)label,
+        .flags = flags,
+        .sample_count = (uint16_t)count,
+    };
+    uint8_t *payload = s_samples_frame + sizeof(stream_frame_header_t);
+    memcpy(payload, &header, sizeof(header));
+    size_t length = sizeof(header) + sample_pack12(codes, count, payload + sizeof(header));
+
+    if (!send_frame(STREAM_PKT_SAMPLES, s_samples_frame, length)) {
+        atomic_fetch_add_explicit(&s_blocks_dropped, 1, memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+bool sample_stream_send_frame(uint8_t type, uint8_t *frame, size_t payload_length)
+{
+    if (!frame || payload_length > UINT16_MAX) {
+        return false;
+    }
+    return send_frame(type, frame, payload_length);
+}
+
+void sample_stream_get_stats(sample_stream_stats_t *stats)
+{
+    if (!stats) return;
+
+    stats->frames_sent = atomic_load_explicit(&s_frames_sent, memory_order_relaxed);
+    stats->blocks_dropped = atomic_load_explicit(&s_blocks_dropped, memory_order_relaxed);
+    stats->logs_dropped = atomic_load_explicit(&s_logs_dropped, memory_order_relaxed);
+    stats->acks = atomic_load_explicit(&s_acks, memory_order_relaxed);
+}
+
+#endif /* CONFIG_SAMPLE_STREAM_ENABLE */
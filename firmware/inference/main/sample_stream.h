@@ -0,0 +1,126 @@
+#ifndef SAMPLE_STREAM_H
+#define SAMPLE_STREAM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "ml_contract.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Binary sample stream to the host collector (CONFIG_SAMPLE_STREAM_ENABLE).
+ *
+ * Frames follow the uart_packet_t layout with a 16-bit payload length:
+ *   stream_frame_header_t, payload_length bytes, CRC8 of the payload.
+ * Both CRCs use calculate_crc8(); the header CRC lets a receiver trust
+ * the length before the payload arrives. Sync byte is PACKET_SYNC_BYTE.
+ *
+ * Backpressure: the host acknowledges frames with standard generator
+ * uart_packet_t PKT_TYPE_ACK frames whose sequence is the last stream
+ * frame it received. At most CONFIG_SAMPLE_STREAM_WINDOW_FRAMES frames
+ * are sent past the last acknowledgement; beyond that (or when the TX
+ * buffer is full) blocks are dropped and counted, never waited for.
+ * A host that attaches has no frame to acknowledge yet, and the window
+ * may have closed long before: it sends an ACK whose one-byte payload is
+ * STREAM_ACK_RESYNC, which acknowledges every frame sent so far, and
+ * repeats it while no frame arrives. PKT_TYPE_COMMAND packets reopen the
+ * window the same way.
+ *
+ * While streaming, ESP_LOG output is sent as STREAM_PKT_LOG frames so
+ * text can't corrupt the binary stream. STREAM_PKT_TELEMETRY frames
+ * carry the binary metrics records of telemetry.h.
+ */
+#define STREAM_PKT_SAMPLES      0x10
+#define STREAM_PKT_LOG          0x11
+#define STREAM_PKT_TELEMETRY    0x12
+
+#define STREAM_ACK_RESYNC       0x01    // ACK payload: reopen the window from the next frame
+
+typedef struct __attribute__((packed)) {
+    uint8_t sync_byte;            // PACKET_SYNC_BYTE
+    uint8_t packet_type;          // STREAM_PKT_*
+    uint16_t sequence;            // Frame number, logs included
+    uint32_t timestamp_ms;        // esp_timer at send
+    uint16_t payload_length;
+    uint8_t header_crc8;          // Over the preceding header bytes
+} stream_frame_header_t;
+
+// Header plus the payload CRC
+#define STREAM_FRAME_OVERHEAD   (sizeof(stream_frame_header_t) + 1)
+
+// STREAM_PKT_SAMPLES payload: this header, then sample_pack12() codes
+typedef struct __attribute__((packed)) {
+    uint32_t window_sequence;     // adc_window_t sequence (gaps = lost blocks)
+    int64_t start_us;             // First sample, generator clock (clock_sync)
+    int8_t label;                 // ml_class_t, ML_CLASS_UNKNOWN if unlabeled
+    uint8_t flags;                // STREAM_FLAG_*
+    uint16_t sample_count;
+} stream_samples_header_t;
+
+#define STREAM_FLAG_TRANSITION   0x01   // Label changed inside the block
+#define STREAM_FLAG_LOCAL_CLOCK  0x02   // Not synced yet: times are esp_timer
+
+typedef struct {
+    uint32_t frames_sent;
+    uint32_t blocks_dropped;      // No acknowledgement window or TX space
+    uint32_t logs_dropped;
+    uint32_t acks;
+} sample_stream_stats_t;
+
+/**
+ * @brief Take over the stream port and start the acknowledgement reader
+ *
+ * Reconfigures the console UART to CONFIG_SAMPLE_STREAM_BAUD (or uses
+ * USB-Serial-JTAG) and redirects ESP_LOG into log frames.
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t sample_stream_init(void);
+
+/**
+ * @brief Send one block of new samples (never blocks)
+ *
+ * Called from one task only.
+ *
+ * @param codes Raw ADC codes
+ * @param count Number of codes (at most ML_WINDOW_SIZE)
+ * @param window_sequence Sequence of the window they came from
+ * @param start_us First sample time (generator clock)
+ * @param label Ground truth label (ML_CLASS_UNKNOWN if unlabeled)
+ * @param flags STREAM_FLAG_* bits
+ * @return true if the block was queued for transmission
+ */
+bool sample_stream_send(const uint16_t *codes, int count, uint32_t window_sequence,
+                        int64_t start_us, ml_class_t label, uint8_t flags);
+
+/**
+ * @brief Send a frame the caller built in place (never blocks)
+ *
+ * The payload goes at frame + sizeof(stream_frame_header_t), and
+ * the buffer needs STREAM_FRAME_OVERHEAD bytes more than the payload: the
+ * header and CRC are filled in here. Each buffer must be used by one task
+ * only. Dropped frames are not counted here.
+ *
+ * @param type STREAM_PKT_* type
+ * @param frame Frame buffer
+ * @param payload_length Payload bytes
+ * @return true if the frame was queued for transmission
+ */
+bool sample_stream_send_frame(uint8_t type, uint8_t *frame, size_t payload_length);
+
+/**
+ * @brief Get stream counters
+ *
+ * @param stats Output counters
+ */
+void sample_stream_get_stats(sample_stream_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SAMPLE_STREAM_H */
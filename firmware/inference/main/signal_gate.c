@@ -0,0 +1,65 @@
+#include "signal_gate.h"
+
+#ifdef CONFIG_SIGNAL_GATE
+
+#define MIN_P2P_CODES   CONFIG_SIGNAL_GATE_MIN_P2P_CODES
+#define RAIL_CODES      CONFIG_SIGNAL_GATE_RAIL_CODES
+#define MAX_DC_CODES    CONFIG_SIGNAL_GATE_MAX_DC_CODES
+#define NOISE_ZCR_PCT   CONFIG_SIGNAL_GATE_NOISE_ZCR_PCT
+
+signal_gate_t signal_gate_check(const window_moments_t *moments) {
+    if (!moments || moments->count == 0) {
+        return SIGNAL_GATE_PASS;
+    }
+
+    int32_t low = moments->min_code;
+    int32_t high = moments->max_code;
+    int32_t p2p = high - low;
+    int32_t n = (int32_t)moments->count;
+    int32_t offset = (moments->sum >= 0) ? (moments->sum + n / 2) / n
+                                         : (moments->sum - n / 2) / n;
+    int32_t mean = ML_ADC_MIDSCALE + offset;
+
+    // Clipped at both ends: the signal is larger than the input range
+    if (low <= ML_ADC_MIN + RAIL_CODES && high >= ML_ADC_MAX - RAIL_CODES) {
+        return SIGNAL_GATE_SATURATED;
+    }
+
+    if (p2p < MIN_P2P_CODES) {
+        // Flat: pinned to a rail, stuck off the bias point, or just quiet
+        if (mean <= ML_ADC_MIN + RAIL_CODES || mean >= ML_ADC_MAX - RAIL_CODES) {
+            return SIGNAL_GATE_SATURATED;
+        }
+        if (offset > MAX_DC_CODES || offset < -MAX_DC_CODES) {
+            return SIGNAL_GATE_STUCK;
+        }
+        return SIGNAL_GATE_IDLE;
+    }
+
+    // Somewhat larger, but crossing its mean like broadband noise
+    if (NOISE_ZCR_PCT > 0 && p2p < 2 * MIN_P2P_CODES &&
+        (int32_t)moments->zero_crossings * 100 >= NOISE_ZCR_PCT * n) {
+        return SIGNAL_GATE_IDLE;
+    }
+
+    return SIGNAL_GATE_PASS;
+}
+
+#else
+
+signal_gate_t signal_gate_check(const window_moments_t *moments) {
+    (void)moments;
+    return SIGNAL_GATE_PASS;
+}
+
+#endif /* CONFIG_SIGNAL_GATE */
+
+const char *signal_gate_to_string(signal_gate_t verdict) {
+    switch (verdict) {
+        case SIGNAL_GATE_PASS: return "pass";
+        case SIGNAL_GATE_IDLE: return "idle";
+        case SIGNAL_GATE_SATURATED: return "saturated";
+        case SIGNAL_GATE_STUCK: return "stuck";
+        default: return "unknown";
+    }
+}
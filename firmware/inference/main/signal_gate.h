@@ -0,0 +1,43 @@
+#ifndef SIGNAL_GATE_H
+#define SIGNAL_GATE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "window_stats.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Verdict of the acquisition-side gate on a raw window
+typedef enum {
+    SIGNAL_GATE_PASS = 0,
+    SIGNAL_GATE_IDLE,         // Quiet or noise-only input at the bias point
+    SIGNAL_GATE_SATURATED,    // Clipping both rails, or pinned to one
+    SIGNAL_GATE_STUCK,        // Flat away from the bias point
+    SIGNAL_GATE_COUNT
+} signal_gate_t;
+
+/**
+ * @brief Classify a raw window before it is queued for inference
+ *
+ * Works on the integer moments the producer keeps for every window
+ * (min/max, sum, zero crossings), in raw codes and before any
+ * normalization, so amplitude and offset are still visible. Thresholds
+ * are the SIGNAL_GATE_* Kconfig options.
+ *
+ * @param moments Raw-code moments of the window
+ * @return signal_gate_t SIGNAL_GATE_PASS, or why the window is not worth a model run
+ */
+signal_gate_t signal_gate_check(const window_moments_t *moments);
+
+/**
+ * @brief Short name of a verdict (for logs)
+ */
+const char *signal_gate_to_string(signal_gate_t verdict);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIGNAL_GATE_H */
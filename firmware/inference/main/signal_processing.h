@@ -23,6 +23,7 @@ typedef struct {
     float mean;
     float rms;
     float peak_to_peak;
+    float peak;               // max |sample|
     float zero_crossing_rate;
     float crest_factor;
     float snr_estimate;
@@ -41,6 +42,13 @@ typedef enum {
  */
 signal_quality_t validate_signal(float *samples, int num_samples);
 
+/**
+ * @brief Validate signal quality from precomputed statistics
+ * 
+ * Same checks as validate_signal(); uses mean, rms, peak_to_peak, peak.
+ */
+signal_quality_t validate_signal_stats(const signal_stats_t *stats);
+
 /**
  * @brief Calculate signal statistics
  */
@@ -16,52 +16,40 @@ signal_quality_t validate_signal(float *samples, int num_samples) {
         return SIGNAL_INVALID;
     }
     
-    float min = INFINITY, max = -INFINITY;
-    float sum = 0.0f, sum_sq = 0.0f;
-    int zero_crossings = 0;
-    
-    for (int i = 0; i < num_samples; i++) {
-        float val = samples[i];
-        sum += val;
-        sum_sq += val * val;
-        
-        if (val < min) min = val;
-        if (val > max) max = val;
-        
-        if (i > 0 && val * samples[i-1] < 0) {
-            zero_crossings++;
-        }
+    signal_stats_t stats;
+    calculate_signal_stats(samples, num_samples, &stats);
+    return validate_signal_stats(&stats);
+}
+
+signal_quality_t validate_signal_stats(const signal_stats_t *stats) {
+    if (!stats) {
+        return SIGNAL_INVALID;
     }
     
-    float mean = sum / num_samples;
-    float rms = sqrtf(sum_sq / num_samples);
-    float peak_to_peak = max - min;
-    float peak = fmaxf(fabsf(min), fabsf(max));
-    
     // Check for saturation
-    if (peak > DEFAULT_SATURATION_THRESHOLD) {
+    if (stats->peak > DEFAULT_SATURATION_THRESHOLD) {
         ESP_LOGW(TAG, "Signal saturated: peak=%.3f, threshold=%.3f", 
-                 peak, DEFAULT_SATURATION_THRESHOLD);
+                 stats->peak, DEFAULT_SATURATION_THRESHOLD);
         return SIGNAL_SATURATED;
     }
     
     // Check signal level
-    if (peak_to_peak < DEFAULT_MIN_AMPLITUDE) {
+    if (stats->peak_to_peak < DEFAULT_MIN_AMPLITUDE) {
         ESP_LOGW(TAG, "Signal too small: pp=%.3f, threshold=%.3f", 
-                 peak_to_peak, DEFAULT_MIN_AMPLITUDE);
+                 stats->peak_to_peak, DEFAULT_MIN_AMPLITUDE);
         return SIGNAL_TOO_SMALL;
     }
     
     // Check DC offset
-    if (fabsf(mean) > DEFAULT_MAX_DC_OFFSET) {
+    if (fabsf(stats->mean) > DEFAULT_MAX_DC_OFFSET) {
         ESP_LOGW(TAG, "DC offset too high: mean=%.3f, threshold=%.3f", 
-                 fabsf(mean), DEFAULT_MAX_DC_OFFSET);
+                 fabsf(stats->mean), DEFAULT_MAX_DC_OFFSET);
         return SIGNAL_DC_OFFSET;
     }
     
     // Check noise level (simplified SNR estimate)
-    float signal_power = fabsf(mean);
-    float total_power = rms;
+    float signal_power = fabsf(stats->mean);
+    float total_power = stats->rms;
     float noise_estimate = total_power - signal_power;
     
     if (noise_estimate > DEFAULT_MAX_NOISE) {
@@ -71,7 +59,7 @@ signal_quality_t validate_signal(float *samples, int num_samples) {
     }
     
     ESP_LOGD(TAG, "Signal OK: pp=%.3f, mean=%.3f, noise=%.3f, zcr=%.3f", 
-             peak_to_peak, mean, noise_estimate, (float)zero_crossings / num_samples);
+             stats->peak_to_peak, stats->mean, noise_estimate, stats->zero_crossing_rate);
     
     return SIGNAL_OK;
 }
@@ -107,8 +95,8 @@ void calculate_signal_stats(float *samples, int num_samples, signal_stats_t *sta
     stats->zero_crossing_rate = (float)zero_crossings / num_samples;
     
     // Calculate crest factor (peak / RMS)
-    float peak = fmaxf(fabsf(min), fabsf(max));
-    stats->crest_factor = (stats->rms > 0.001f) ? peak / stats->rms : 0.0f;
+    stats->peak = fmaxf(fabsf(min), fabsf(max));
+    stats->crest_factor = (stats->rms > 0.001f) ? stats->peak / stats->rms : 0.0f;
     
     // Simple SNR estimate
     float signal_power = fabsf(stats->mean);
@@ -0,0 +1,203 @@
+// spectral_features.c - Harmonic analysis for FFT-based classification
+#include "spectral_features.h"
+#include "preprocessing.h"
+#include <math.h>
+#include <string.h>
+
+// Classification thresholds
+#define SINE_MAX_HARMONIC_RATIO    0.05f   // Clean sine: harmonics < 5% of fundamental
+#define SAWTOOTH_MIN_EVEN_RATIO    0.20f   // Sawtooth: |H2|/|H1| ~ 0.5
+#define SQUARE_TRIANGLE_SPLIT      1.5f    // Odd decay: square p=1, triangle p=2
+#define ROLLOFF_FRACTION           0.85f
+
+// With fewer periods per window the Hann window's own sidelobes swamp the
+// harmonics, so no spectral decision is made (a span may still make one)
+#define MIN_FUNDAMENTAL_BIN        2
+
+// Preprocessed span for extract_spectral_features_span()
+static float s_span_samples[SPECTRAL_SPAN_SAMPLES] __attribute__((aligned(16)));
+
+// Energy of harmonic around bin, gathering Hann-window leakage from neighbours
+static float harmonic_energy(const float *mag, int num_bins, int bin, int half_width) {
+    float energy = 0.0f;
+    for (int b = bin - half_width; b <= bin + half_width; b++) {
+        if (b > 0 && b < num_bins) {
+            energy += mag[b] * mag[b];
+        }
+    }
+    return energy;
+}
+
+bool extract_spectral_features(const float *samples, int num_samples,
+                               float sample_rate_hz, spectral_features_t *features) {
+    if (!samples || !features) {
+        return false;
+    }
+    
+    memset(features, 0, sizeof(spectral_features_t));
+    
+    const float *mag = compute_fft_magnitude(samples, num_samples);
+    if (!mag) {
+        return false;
+    }
+    
+    int num_bins = num_samples / 2;
+    float bin_hz = sample_rate_hz / num_samples;
+    
+    // Fundamental and total energy in one pass (skip DC)
+    float total_energy = 0.0f;
+    float peak = 0.0f;
+    int f0 = 0;
+    for (int k = 1; k < num_bins; k++) {
+        float e = mag[k] * mag[k];
+        total_energy += e;
+        if (mag[k] > peak) {
+            peak = mag[k];
+            f0 = k;
+        }
+    }
+    
+    if (f0 < MIN_FUNDAMENTAL_BIN || f0 >= num_bins - 1 || total_energy <= 0.0f) {
+        return false;
+    }
+    
+    // Fractional fundamental (Gaussian interpolation suits the Hann main lobe)
+    float la = logf(fmaxf(mag[f0 - 1], 1e-12f));
+    float lb = logf(mag[f0]);
+    float lc = logf(fmaxf(mag[f0 + 1], 1e-12f));
+    float curvature = la - 2.0f * lb + lc;
+    float delta = (curvature < 0.0f) ? 0.5f * (la - lc) / curvature : 0.0f;
+    if (delta > 0.5f) delta = 0.5f;
+    if (delta < -0.5f) delta = -0.5f;
+    float f0_frac = f0 + delta;
+    
+    // Spectral rolloff
+    float target = ROLLOFF_FRACTION * total_energy;
+    float cumulative = 0.0f;
+    int rolloff_bin = num_bins - 1;
+    for (int k = 1; k < num_bins; k++) {
+        cumulative += mag[k] * mag[k];
+        if (cumulative >= target) {
+            rolloff_bin = k;
+            break;
+        }
+    }
+    
+    // Neighbouring harmonics overlap for very low fundamentals
+    int half_width = (f0 >= 3) ? 1 : 0;
+    
+    float h1_energy = harmonic_energy(mag, num_bins, f0, half_width);
+    if (h1_energy <= 0.0f) {
+        return false;
+    }
+    float h1 = sqrtf(h1_energy);
+    
+    float odd_energy = 0.0f, even_energy = 0.0f;
+    int max_n = 1;
+    features->harmonic_amplitude[1] = 1.0f;
+    for (int n = 2; n <= SPECTRAL_MAX_HARMONIC; n++) {
+        int bin = (int)lrintf(n * f0_frac);
+        if (bin + half_width >= num_bins) break;
+        
+        float e = harmonic_energy(mag, num_bins, bin, half_width);
+        features->harmonic_amplitude[n] = sqrtf(e) / h1;
+        if (n & 1) {
+            odd_energy += e;
+        } else {
+            even_energy += e;
+        }
+        max_n = n;
+    }
+    
+    // Odd/even decay needs at least the 3rd harmonic below Nyquist
+    if (max_n < 3) {
+        return false;
+    }
+    
+    // Least-squares fit of ln(|H_n|/|H_1|) = -p * ln(n) over odd harmonics
+    float num = 0.0f, den = 0.0f;
+    for (int n = 3; n <= max_n; n += 2) {
+        float a = fmaxf(features->harmonic_amplitude[n], 1e-6f);
+        float ln_n = logf((float)n);
+        num += ln_n * logf(a);
+        den += ln_n * ln_n;
+    }
+    
+    features->fundamental_bin = f0;
+    features->fundamental_hz = f0_frac * bin_hz;
+    features->num_harmonics = max_n;
+    features->harmonic_ratio = sqrtf(odd_energy + even_energy) / h1;
+    features->odd_even_ratio = (even_energy > 1e-12f) ? odd_energy / even_energy : 1e6f;
+    features->odd_decay_exponent = (den > 0.0f) ? -num / den : 0.0f;
+    features->spectral_rolloff_hz = rolloff_bin * bin_hz;
+    
+    return true;
+}
+
+bool extract_spectral_features_span(const spectral_span_t *span, const float *samples,
+                                    int num_samples, float sample_rate_hz,
+                                    spectral_features_t *features) {
+    if (extract_spectral_features(samples, num_samples, sample_rate_hz, features)) {
+        return true;
+    }
+    if (!span || span->filled < SPECTRAL_SPAN_SAMPLES ||
+        !preprocess_codes_float(span->codes, SPECTRAL_SPAN_SAMPLES, s_span_samples)) {
+        return false;
+    }
+    return extract_spectral_features(s_span_samples, SPECTRAL_SPAN_SAMPLES, 
+                                     sample_rate_hz, features);
+}
+
+void spectral_span_reset(spectral_span_t *span) {
+    if (span) {
+        span->filled = 0;
+    }
+}
+
+void spectral_span_push(spectral_span_t *span, const uint16_t *codes, int num_samples, int hop) {
+    if (!span || !codes || num_samples <= 0 || num_samples > SPECTRAL_SPAN_SAMPLES) {
+        return;
+    }
+    
+    // Overlapping windows repeat all but their last hop samples
+    int fresh = (span->filled > 0 && hop > 0 && hop < num_samples) ? hop : num_samples;
+    int keep = SPECTRAL_SPAN_SAMPLES - fresh;
+    if (keep > span->filled) keep = span->filled;
+    
+    memmove(span->codes + SPECTRAL_SPAN_SAMPLES - fresh - keep,
+            span->codes + SPECTRAL_SPAN_SAMPLES - keep, keep * sizeof(uint16_t));
+    memcpy(span->codes + SPECTRAL_SPAN_SAMPLES - fresh, codes + num_samples - fresh,
+           fresh * sizeof(uint16_t));
+    span->filled = keep + fresh;
+}
+
+static float margin_confidence(float value, float threshold, float scale) {
+    float margin = fabsf(value - threshold) / scale;
+    if (margin > 1.0f) margin = 1.0f;
+    return 0.5f + 0.5f * margin;
+}
+
+ml_class_t spectral_classify(const spectral_features_t *features, float *confidence) {
+    ml_class_t predicted;
+    float conf;
+    
+    if (features->harmonic_ratio < SINE_MAX_HARMONIC_RATIO) {
+        predicted = ML_CLASS_SINE;
+        conf = margin_confidence(features->harmonic_ratio, SINE_MAX_HARMONIC_RATIO,
+                                 SINE_MAX_HARMONIC_RATIO);
+    } else if (features->harmonic_amplitude[2] > SAWTOOTH_MIN_EVEN_RATIO) {
+        predicted = ML_CLASS_SAWTOOTH;
+        conf = margin_confidence(features->harmonic_amplitude[2], SAWTOOTH_MIN_EVEN_RATIO, 0.3f);
+    } else if (features->odd_decay_exponent < SQUARE_TRIANGLE_SPLIT) {
+        predicted = ML_CLASS_SQUARE;
+        conf = margin_confidence(features->odd_decay_exponent, SQUARE_TRIANGLE_SPLIT, 0.5f);
+    } else {
+        predicted = ML_CLASS_TRIANGLE;
+        conf = margin_confidence(features->odd_decay_exponent, SQUARE_TRIANGLE_SPLIT, 0.5f);
+    }
+    
+    if (confidence) {
+        *confidence = conf;
+    }
+    return predicted;
+}
@@ -0,0 +1,104 @@
+#ifndef SPECTRAL_FEATURES_H
+#define SPECTRAL_FEATURES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ml_contract.h"
+#include "preprocessing.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Highest harmonic examined (limited by Nyquist for the fundamental found)
+#define SPECTRAL_MAX_HARMONIC 9
+
+// Spectral features from one window
+typedef struct {
+    int fundamental_bin;          // Strongest non-DC bin
+    float fundamental_hz;
+    float harmonic_amplitude[SPECTRAL_MAX_HARMONIC + 1]; // |H_n| / |H_1|, index = n
+    int num_harmonics;            // Highest harmonic below Nyquist
+    float harmonic_ratio;         // sqrt(sum_{n>=2} |H_n|^2) / |H_1|
+    float odd_even_ratio;         // Odd (n>=3) / even harmonic energy
+    float odd_decay_exponent;     // p in |H_n| ~ 1/n^p over odd harmonics
+    float spectral_rolloff_hz;    // Frequency below which 85% of energy lies
+} spectral_features_t;
+
+// Recent samples of one stream: two windows, so a fundamental with a
+// single period per window still spans two FFT bins
+#define SPECTRAL_SPAN_SAMPLES PREPROCESS_MAX_SAMPLES
+
+// Contiguous raw ADC codes ending with the stream's newest window
+typedef struct {
+    uint16_t codes[SPECTRAL_SPAN_SAMPLES];  // Valid: the last 'filled', oldest first
+    int filled;
+} spectral_span_t;
+
+/**
+ * @brief Extract spectral features using the FFT from preprocessing.c
+ * 
+ * @param samples Input samples (windowed, DC removed)
+ * @param num_samples Number of samples (power of 2, <= SPECTRAL_SPAN_SAMPLES)
+ * @param sample_rate_hz Sampling rate
+ * @param features Output features
+ * @return true if the fundamental spans at least 2 bins and its 3rd
+ *         harmonic is below Nyquist (otherwise harmonics are unusable).
+ *         A 256-sample window at 20 kHz needs f0 >= ~156 Hz.
+ */
+bool extract_spectral_features(const float *samples, int num_samples,
+                               float sample_rate_hz, spectral_features_t *features);
+
+/**
+ * @brief Spectral features of a window, or of the span ending with it
+ * 
+ * Tries the preprocessed window first. If it holds too few periods and
+ * the span is full, the span's codes are preprocessed and analyzed
+ * instead, halving the lowest usable fundamental.
+ * 
+ * @param span Stream's span, already extended with the window (NULL for none)
+ * @param samples Preprocessed window
+ * @param num_samples Number of samples (power of 2)
+ * @param sample_rate_hz Sampling rate
+ * @param features Output features
+ * @return true if either analysis succeeded
+ */
+bool extract_spectral_features_span(const spectral_span_t *span, const float *samples,
+                                    int num_samples, float sample_rate_hz,
+                                    spectral_features_t *features);
+
+/**
+ * @brief Forget a stream's samples (after dropped windows or a gap)
+ * 
+ * @param span Span
+ */
+void spectral_span_reset(spectral_span_t *span);
+
+/**
+ * @brief Append a window's new samples to a span
+ * 
+ * @param span Span
+ * @param codes Raw ADC codes of the window
+ * @param num_samples Number of samples (at most SPECTRAL_SPAN_SAMPLES)
+ * @param hop New samples at the end of the window, as in
+ *            inference_config_t::window_hop (0: windows are disjoint)
+ */
+void spectral_span_push(spectral_span_t *span, const uint16_t *codes, int num_samples, int hop);
+
+/**
+ * @brief Classify waveform from harmonic structure
+ * 
+ * Sine: no harmonics. Sawtooth: even and odd harmonics (1/n).
+ * Square: odd harmonics decaying as 1/n. Triangle: odd harmonics as 1/n^2.
+ * 
+ * @param features Spectral features
+ * @param confidence Output confidence (0.0 to 1.0)
+ * @return ml_class_t Predicted class
+ */
+ml_class_t spectral_classify(const spectral_features_t *features, float *confidence);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SPECTRAL_FEATURES_H */
@@ -0,0 +1,161 @@
+// stage_trace.c - Cycle-count stage markers and per-stage duration rings
+#include "stage_trace.h"
+#include "esp_log.h"
+#include "esp_cpu.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Named after the stage that ends at the marker
+static const char *s_stage_names[STAGE_TRACE_MARK_COUNT] = {
+    "dma", "acquire", "publish", "queue_wait", "bookkeeping",
+    "input", "quantize", "invoke", "postprocess"
+};
+
+#ifdef CONFIG_STAGE_TRACE
+
+static const char *TAG = "STAGE_TRACE";
+
+#define RING_DEPTH      CONFIG_STAGE_TRACE_DEPTH
+#define CYCLES_PER_US   CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ
+
+// Written by the inference task only; readers may see a slot being
+// replaced, which only ever swaps one recent duration for another
+static uint32_t s_rings[STAGE_TRACE_MARK_COUNT][RING_DEPTH];
+static uint32_t s_ring_count[STAGE_TRACE_MARK_COUNT];
+
+// Trace each core's stage_trace_mark() stamps; only set from that core
+static stage_trace_t *s_active[portNUM_PROCESSORS];
+
+void stage_trace_init(void)
+{
+    memset(s_rings, 0, sizeof(s_rings));
+    memset(s_ring_count, 0, sizeof(s_ring_count));
+    ESP_LOGI(TAG, "Stage trace: %d windows per stage", RING_DEPTH);
+}
+
+void stage_trace_mark_at(stage_trace_t *trace, stage_trace_mark_t mark)
+{
+    trace->cycles[mark] = esp_cpu_get_cycle_count();
+    trace->reached |= (uint16_t)(1u << mark);
+    if (mark == STAGE_TRACE_SEALED) {
+        trace->sealed_us = esp_timer_get_time();
+    } else if (mark == STAGE_TRACE_DEQUEUED) {
+        trace->dequeued_us = esp_timer_get_time();
+    }
+}
+
+void stage_trace_activate(stage_trace_t *trace)
+{
+    s_active[xPortGetCoreID()] = trace;
+}
+
+void stage_trace_mark(stage_trace_mark_t mark)
+{
+    stage_trace_t *trace = s_active[xPortGetCoreID()];
+    if (trace) {
+        stage_trace_mark_at(trace, mark);
+    }
+}
+
+uint32_t stage_trace_stage_cycles(const stage_trace_t *trace, stage_trace_mark_t mark)
+{
+    if (!trace || mark <= STAGE_TRACE_DMA_COMPLETE || mark >= STAGE_TRACE_MARK_COUNT ||
+        !(trace->reached & (1u << mark))) {
+        return 0;
+    }
+
+    int previous = mark - 1;
+    while (previous >= 0 && !(trace->reached & (1u << previous))) {
+        previous--;
+    }
+    if (previous < 0) {
+        return 0;
+    }
+
+    // SEALED and DEQUEUED are stamped on every window that crosses over,
+    // in esp_timer time: the two cores' cycle counters are unrelated
+    if (previous < STAGE_TRACE_FIRST_CONSUMER && mark >= STAGE_TRACE_FIRST_CONSUMER) {
+        int64_t us = trace->dequeued_us - trace->sealed_us;
+        return us > 0 ? (uint32_t)(us * CYCLES_PER_US) : 0;
+    }
+    // Unsigned difference survives one counter wrap
+    return trace->cycles[mark] - trace->cycles[previous];
+}
+
+void stage_trace_commit(const stage_trace_t *trace)
+{
+    if (!trace) {
+        return;
+    }
+    for (int m = STAGE_TRACE_DMA_COMPLETE + 1; m < STAGE_TRACE_MARK_COUNT; m++) {
+        if (!(trace->reached & (1u << m))) {
+            continue;
+        }
+        uint32_t count = __atomic_load_n(&s_ring_count[m], __ATOMIC_RELAXED);
+        s_rings[m][count % RING_DEPTH] = stage_trace_stage_cycles(trace, (stage_trace_mark_t)m);
+        __atomic_store_n(&s_ring_count[m], count + 1, __ATOMIC_RELEASE);
+    }
+}
+
+int stage_trace_recent(stage_trace_mark_t mark, uint32_t *cycles, int max_count)
+{
+    if (mark < 0 || mark >= STAGE_TRACE_MARK_COUNT || !cycles || max_count <= 0) {
+        return 0;
+    }
+    uint32_t count = __atomic_load_n(&s_ring_count[mark], __ATOMIC_ACQUIRE);
+    int n = count < RING_DEPTH ? (int)count : RING_DEPTH;
+    if (n > max_count) {
+        n = max_count;
+    }
+    for (int i = 0; i < n; i++) {
+        cycles[i] = s_rings[mark][(count - 1 - i) % RING_DEPTH];
+    }
+    return n;
+}
+
+static int compare_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+void stage_trace_log_summary(void)
+{
+    static uint32_t sorted[RING_DEPTH];
+
+    ESP_LOGI(TAG, "=== Stage timing (us, last %d windows) ===", RING_DEPTH);
+    for (int m = STAGE_TRACE_DMA_COMPLETE + 1; m < STAGE_TRACE_MARK_COUNT; m++) {
+        int n = stage_trace_recent((stage_trace_mark_t)m, sorted, RING_DEPTH);
+        if (n == 0) {
+            continue;
+        }
+        qsort(sorted, n, sizeof(uint32_t), compare_u32);
+        ESP_LOGI(TAG, "%-12s n=%-4d p50=%-7u p90=%-7u max=%u", s_stage_names[m], n,
+                 (unsigned)(sorted[n / 2] / CYCLES_PER_US),
+                 (unsigned)(sorted[(n * 9) / 10] / CYCLES_PER_US),
+                 (unsigned)(sorted[n - 1] / CYCLES_PER_US));
+    }
+}
+
+#else
+
+void stage_trace_activate(stage_trace_t *trace)
+{
+    (void)trace;
+}
+
+void stage_trace_mark(stage_trace_mark_t mark)
+{
+    (void)mark;
+}
+
+#endif /* CONFIG_STAGE_TRACE */
+
+const char *stage_trace_stage_name(stage_trace_mark_t mark)
+{
+    return (mark >= 0 && mark < STAGE_TRACE_MARK_COUNT) ? s_stage_names[mark] : "unknown";
+}
@@ -0,0 +1,121 @@
+#ifndef STAGE_TRACE_H
+#define STAGE_TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Per-window stage markers from acquisition to decision
+ * (CONFIG_STAGE_TRACE).
+ *
+ * Each marker stores esp_cpu_get_cycle_count() on the core that reaches
+ * it. The two cores' counters are not related, so the handoff through the
+ * window ring (SEALED -> DEQUEUED) is also stamped with esp_timer.
+ * Every other stage is a cycle difference on one core. The stage ending at
+ * a marker runs from the previous marker the window reached; optional
+ * markers (PREPROCESSED, QUANTIZED, INVOKED) that a mode skips fold into
+ * the next stage. Cycles are converted at CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+ * so times read short while power management has the clock lowered.
+ */
+typedef enum {
+    STAGE_TRACE_DMA_COMPLETE = 0, // Conversion frame with the window's last sample read
+    STAGE_TRACE_PREPARED,         // Producer done: demux, moments, gate, preprocessing
+    STAGE_TRACE_SEALED,           // Published to the window ring
+    STAGE_TRACE_DEQUEUED,         // Taken by the inference task
+    STAGE_TRACE_DISPATCHED,       // Labels, recording, streaming, benchmark done
+    STAGE_TRACE_PREPROCESSED,     // Model input filled (copied or computed)
+    STAGE_TRACE_QUANTIZED,        // Separate float -> int8 step done
+    STAGE_TRACE_INVOKED,          // Model or classifier done
+    STAGE_TRACE_POSTPROCESSED,    // Result ready, voting included
+    STAGE_TRACE_MARK_COUNT
+} stage_trace_mark_t;
+
+// First marker reached on the inference core
+#define STAGE_TRACE_FIRST_CONSUMER  STAGE_TRACE_DEQUEUED
+
+typedef struct {
+    uint32_t cycles[STAGE_TRACE_MARK_COUNT];  // Cycle count at each marker reached
+    int64_t sealed_us;            // esp_timer at SEALED
+    int64_t dequeued_us;          // esp_timer at DEQUEUED
+    uint32_t sequence;            // adc_window_t sequence
+    uint16_t reached;             // Bit per stage_trace_mark_t
+    uint8_t channel;              // Stream index
+} stage_trace_t;
+
+/**
+ * @brief Clear the per-stage rings
+ */
+void stage_trace_init(void);
+
+/**
+ * @brief Stamp a marker of a window's trace now
+ *
+ * @param trace Window trace
+ * @param mark Marker
+ */
+void stage_trace_mark_at(stage_trace_t *trace, stage_trace_mark_t mark);
+
+/**
+ * @brief Make a trace the one stage_trace_mark() stamps on this core
+ *
+ * Lets inference.c mark its stages without passing the trace through
+ * every call. Pass NULL when the window is done.
+ *
+ * @param trace Window trace, or NULL
+ */
+void stage_trace_activate(stage_trace_t *trace);
+
+/**
+ * @brief Stamp a marker of this core's active trace (no-op if none)
+ *
+ * @param mark Marker
+ */
+void stage_trace_mark(stage_trace_mark_t mark);
+
+/**
+ * @brief Cycles of the stage ending at a marker
+ *
+ * @param trace Window trace
+ * @param mark Marker the stage ends at
+ * @return uint32_t Cycles, 0 if the window did not reach the marker
+ */
+uint32_t stage_trace_stage_cycles(const stage_trace_t *trace, stage_trace_mark_t mark);
+
+/**
+ * @brief Add a finished window's stages to the per-stage rings
+ *
+ * Called by the inference task only.
+ *
+ * @param trace Window trace
+ */
+void stage_trace_commit(const stage_trace_t *trace);
+
+/**
+ * @brief Copy the most recent durations of one stage, newest first
+ *
+ * @param mark Marker the stage ends at
+ * @param cycles Output
+ * @param max_count Capacity of cycles
+ * @return int Durations copied (up to CONFIG_STAGE_TRACE_DEPTH)
+ */
+int stage_trace_recent(stage_trace_mark_t mark, uint32_t *cycles, int max_count);
+
+/**
+ * @brief Log median, p90 and max of every stage over the rings
+ */
+void stage_trace_log_summary(void);
+
+/**
+ * @brief Short name of the stage ending at a marker (for logs)
+ */
+const char *stage_trace_stage_name(stage_trace_mark_t mark);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STAGE_TRACE_H */
@@ -4,14 +4,29 @@
 #include "freertos/task.h"
 #include "freertos/queue.h"
 #include "system_monitor.h"
+#include "adc_sampling.h"
+#include "telemetry.h"
+#include "stage_trace.h"
 #include <string.h>
 
 static const char *TAG = "SYSTEM_HEALTH";
 
-// Add this global to track UART connection status
-static bool s_uart_connected = false;
+#define HEALTH_SAMPLE_MS        500
+#define METRICS_LOG_MS          5000
+#ifdef CONFIG_TELEMETRY_ENABLE
+#define TELEMETRY_SAMPLES       (CONFIG_TELEMETRY_INTERVAL_MS / HEALTH_SAMPLE_MS)
+#endif
+#define HEALTH_EWMA_ALPHA       0.2f    // Weight of the newest sample
+
+// Written by the UART task, read by the sampler
 static uint32_t s_last_uart_activity = 0;
 
+// Cumulative counters at the previous sample
+static uint32_t s_last_predictions = 0;
+static uint32_t s_last_correct = 0;
+static uint32_t s_last_windows = 0;
+static uint64_t s_last_latency_us = 0;
+
 void health_init(system_health_t *health) {
     if (!health) return;
     
@@ -27,29 +42,21 @@ void health_init(system_health_t *health) {
     #endif
 }
 
+static float ewma(float average, float sample, bool first) {
+    return first ? sample : average + HEALTH_EWMA_ALPHA * (sample - average);
+}
+
 void update_system_health(system_health_t *health, 
-                          QueueHandle_t samples_queue, 
-                          QueueHandle_t labels_queue) {
-    if (!health) return;
+                          const metrics_t *metrics,
+                          uint32_t window_utilization) {
+    if (!health || !metrics) return;
     
-    // Check task status
-    TaskStatus_t tasks[5];  // Reduced from 10
-    uint32_t task_count = uxTaskGetSystemState(tasks, 5, NULL);
+    // A counter read, not a uxTaskGetSystemState() scheduler suspension
+    uint32_t task_count = uxTaskGetNumberOfTasks();
     health->task_count = (task_count > 63) ? 63 : task_count;
     
-    // Check queue utilization
-    if (samples_queue) {
-        UBaseType_t queue_messages = uxQueueMessagesWaiting(samples_queue);
-        UBaseType_t queue_spaces = uxQueueSpacesAvailable(samples_queue);
-        UBaseType_t total = queue_messages + queue_spaces;
-        
-        if (total > 0) {
-            uint32_t utilization = (queue_messages * 100) / total;
-            health->queue_utilization = (utilization > 127) ? 127 : utilization;
-        } else {
-            health->queue_utilization = 0;
-        }
-    }
+    // Window ring utilization
+    health->queue_utilization = (window_utilization > 127) ? 127 : window_utilization;
     
     // Check memory
     health->free_heap = esp_get_free_heap_size();
@@ -57,7 +64,26 @@ void update_system_health(system_health_t *health,
     
     // Update UART connection status
     uint32_t current_time = xTaskGetTickCount() * portTICK_PERIOD_MS;
-    health->uart_connected = ((current_time - s_last_uart_activity) < 5000);
+    uint32_t last_activity = __atomic_load_n(&s_last_uart_activity, __ATOMIC_RELAXED);
+    health->uart_connected = ((current_time - last_activity) < 5000);
+    
+    // Averages over what happened since the previous sample
+    uint32_t predictions = metrics->total_predictions - s_last_predictions;
+    if (predictions > 0) {
+        float accuracy = (float)(metrics->correct_predictions - s_last_correct) / predictions;
+        health->recent_accuracy = ewma(health->recent_accuracy, accuracy, s_last_predictions == 0);
+    }
+    const metrics_histogram_t *e2e = &metrics->stages[METRIC_STAGE_END_TO_END];
+    uint32_t windows = e2e->count - s_last_windows;
+    if (windows > 0) {
+        float latency_us = (float)(e2e->total_us - s_last_latency_us) / windows;
+        health->inference_time_avg = (uint32_t)ewma((float)health->inference_time_avg, latency_us,
+                                                    s_last_windows == 0);
+    }
+    s_last_predictions = metrics->total_predictions;
+    s_last_correct = metrics->correct_predictions;
+    s_last_windows = e2e->count;
+    s_last_latency_us = e2e->total_us;
     
     // Update health counter (wrap at 65535)
     health->health_counter = (health->health_counter + 1) & 0xFFFF;
@@ -65,7 +91,7 @@ void update_system_health(system_health_t *health,
 
 // Call this from UART receive callback
 void health_update_uart_activity(void) {
-    s_last_uart_activity = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    __atomic_store_n(&s_last_uart_activity, xTaskGetTickCount() * portTICK_PERIOD_MS, __ATOMIC_RELAXED);
 }
 
 system_state_t check_system_state(system_health_t *health) {
@@ -118,4 +144,61 @@ void log_system_health(system_health_t *health) {
     ESP_LOGI(TAG, "Avg inference time: %d us", health->inference_time_avg);
     ESP_LOGI(TAG, "Health counter: %u", health->health_counter);
     #endif
+}
+
+void metrics_monitor_task(void *arg) {
+    // Too large for the task stack next to metrics_log_statistics()
+    static metrics_t metrics;
+#ifndef CONFIG_TELEMETRY_ENABLE
+    uint32_t last_inference_count = 0;
+    uint32_t last_adc_count = 0;
+#endif
+    uint32_t samples = 0;
+    system_health_t health;
+    
+    health_init(&health);
+    TickType_t wake = xTaskGetTickCount();
+    
+    while (1) {
+        vTaskDelayUntil(&wake, pdMS_TO_TICKS(HEALTH_SAMPLE_MS));
+        
+        metrics_get_current(&metrics);
+        system_state_t previous = health.state;
+        update_system_health(&health, &metrics, adc_window_utilization());
+        if (check_system_state(&health) != previous) {
+            ESP_LOGW(TAG, "State %d -> %d (heap %u, accuracy %.2f, latency %u us)",
+                     previous, health.state, (unsigned)health.free_heap,
+                     health.recent_accuracy, (unsigned)health.inference_time_avg);
+        }
+        
+#ifdef CONFIG_TELEMETRY_ENABLE
+        // Raw records, idle or not: the host formats them
+        samples++;
+        if (samples % TELEMETRY_SAMPLES == 0 || telemetry_snapshot_requested()) {
+            telemetry_send_snapshot(&metrics, &health);
+        }
+        if (samples % (METRICS_LOG_MS / HEALTH_SAMPLE_MS) == 0) {
+            metrics_record_memory_usage();
+        }
+#else
+        if (++samples % (METRICS_LOG_MS / HEALTH_SAMPLE_MS) != 0) {
+            continue;
+        }
+        
+        // Only log if there's new activity
+        uint32_t adc_count = metrics.stages[METRIC_STAGE_ADC_INTERVAL].count;
+        if (metrics.inference_count > last_inference_count || adc_count > last_adc_count) {
+            metrics_log_statistics();
+#ifdef CONFIG_STAGE_TRACE
+            stage_trace_log_summary();
+#endif
+        }
+        
+        last_inference_count = metrics.inference_count;
+        last_adc_count = adc_count;
+        
+        // Record memory usage periodically
+        metrics_record_memory_usage();
+#endif
+    }
 }
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include <stddef.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
+#include "signal_gate.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -33,21 +34,56 @@ typedef struct {
     float recent_accuracy;
 } system_health_t;
 
-// Metrics structure
+// Timed pipeline stages
+typedef enum {
+    METRIC_STAGE_ADC_INTERVAL,    // Between consecutive windows
+    METRIC_STAGE_PREPROCESS,      // Raw codes -> model input
+    METRIC_STAGE_QUANTIZE,        // Separate float -> int8 conversion
+    METRIC_STAGE_INVOKE,          // Model (or classifier) run
+    METRIC_STAGE_END_TO_END,      // Last sample converted -> result ready
+    METRIC_STAGE_DETECTION,       // Generator switch output -> first result naming it
+    METRIC_STAGE_COUNT
+} metric_stage_t;
+
+// Log-scale buckets: exact below 4 us, then 4 per octave (<= 19% wide),
+// up to 2^25 us
+#define METRICS_HISTOGRAM_BUCKETS 96
+
+// Latency histogram of one stage
 typedef struct {
-    uint64_t total_inference_time_us;
-    uint64_t min_inference_time_us;
-    uint64_t max_inference_time_us;
-    uint32_t inference_count;
-    
-    uint64_t total_adc_time_us;
-    uint32_t adc_sample_count;
+    uint32_t count;
+    uint64_t total_us;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint32_t buckets[METRICS_HISTOGRAM_BUCKETS];
+} metrics_histogram_t;
+
+// Estimated energy at a constant power: mW x us = nJ. There is no power
+// monitor on the board; the CONFIG_POWER_* figures are bench measurements.
+#define METRICS_ENERGY_UJ(power_mw, duration_us) \
+    ((float)(power_mw) * (float)(duration_us) / 1000.0f)
+
+// Metrics structure (merged over all cores)
+typedef struct {
+    metrics_histogram_t stages[METRIC_STAGE_COUNT];
+    uint32_t inference_count;       // Windows processed end to end
     
     uint32_t correct_predictions;
     uint32_t total_predictions;
+    uint32_t transition_correct;      // Windows straddling a label change,
+    uint32_t transition_predictions;  // kept out of the accuracy above
+    uint32_t detections_missed;       // Switches superseded before being detected
+    uint32_t windows_dropped;         // Gaps in the window sequence seen by the consumer
+    uint32_t windows_gapped;          // Windows missing samples (ADC DMA pool overflow)
+    uint32_t windows_rejected[SIGNAL_GATE_COUNT]; // By signal gate verdict (PASS unused)
     
     size_t peak_heap_usage;
     size_t current_heap_usage;
+    
+    // Startup, in ms of esp_timer (ROM and bootloader time not included);
+    // 0 until reached. Kept across metrics_reset().
+    uint32_t engine_ready_ms;         // Inference engine and selected model ready
+    uint32_t first_decision_ms;       // First inference result
 } metrics_t;
 
 /**
@@ -61,11 +97,25 @@ void system_monitor_init(void);
 void health_init(system_health_t *health);
 
 /**
- * @brief Update system health status
+ * @brief Fold one sample of the metrics feed into the health state
+ * 
+ * Accuracy and latency are exponentially weighted averages over the
+ * predictions and windows since the previous sample. Called by
+ * metrics_monitor_task() at a low fixed rate; the pipeline itself only
+ * bumps the lock-free metrics counters.
+ * 
+ * @param health Health state
+ * @param metrics Current metrics (cumulative, as from metrics_get_current())
+ * @param window_utilization Occupancy of the sample window ring (percent)
  */
 void update_system_health(system_health_t *health, 
-                          QueueHandle_t samples_queue, 
-                          QueueHandle_t labels_queue);
+                          const metrics_t *metrics,
+                          uint32_t window_utilization);
+
+/**
+ * @brief Record UART activity (call for every received line)
+ */
+void health_update_uart_activity(void);
 
 /**
  * @brief Check current system state
@@ -73,12 +123,21 @@ void update_system_health(system_health_t *health,
 system_state_t check_system_state(system_health_t *health);
 
 /**
- * @brief Record inference time
+ * @brief Record one duration of a pipeline stage
+ * 
+ * Lock-free: each core updates its own counter block with relaxed
+ * atomics, and readers merge the blocks.
+ * 
+ * @param stage Stage
+ * @param duration_us Duration in microseconds
  */
-void metrics_record_inference_time(uint64_t time_us);
+void metrics_record_stage(metric_stage_t stage, uint32_t duration_us);
 
 /**
- * @brief Record ADC sampling time
+ * @brief Record the completion time of a window (ADC task only)
+ * 
+ * @param timestamp esp_timer time of the window; intervals go into
+ *        METRIC_STAGE_ADC_INTERVAL
  */
 void metrics_record_adc_time(uint64_t timestamp);
 
@@ -92,16 +151,67 @@ void metrics_record_correct_prediction(void);
  */
 void metrics_record_incorrect_prediction(void);
 
+/**
+ * @brief Record a prediction for a window that straddles a label change
+ * 
+ * @param correct Prediction matched the window's majority label
+ */
+void metrics_record_transition_prediction(bool correct);
+
+/**
+ * @brief Record a class switch that was never detected
+ * 
+ * Detected switches go into METRIC_STAGE_DETECTION with their latency;
+ * this counts the ones the next switch superseded first.
+ */
+void metrics_record_missed_detection(void);
+
+/**
+ * @brief Record windows lost before reaching the consumer
+ * 
+ * @param dropped Windows skipped in the sequence since the previous one
+ * @param gap The window itself is missing samples (ADC_WINDOW_FLAG_GAP)
+ */
+void metrics_record_dropped_windows(uint32_t dropped, bool gap);
+
+/**
+ * @brief Record a window the signal gate kept from inference
+ * 
+ * @param verdict signal_gate_t reason
+ */
+void metrics_record_rejected_window(uint8_t verdict);
+
 /**
  * @brief Record memory usage
  */
 void metrics_record_memory_usage(void);
 
 /**
- * @brief Get current metrics
+ * @brief Record that the inference engine is ready (first call counts)
+ */
+void metrics_record_engine_ready(void);
+
+/**
+ * @brief Record the first inference result (first call counts)
+ * 
+ * @return uint32_t Time to first decision in ms
+ */
+uint32_t metrics_record_first_decision(void);
+
+/**
+ * @brief Get current metrics, merged over all cores
  */
 void metrics_get_current(metrics_t *metrics);
 
+/**
+ * @brief Latency below which a fraction of a stage's samples fall
+ * 
+ * @param histogram Stage histogram
+ * @param fraction Percentile as a fraction (e.g. 0.999)
+ * @return uint32_t Upper edge of the bucket holding the percentile (us), 0 if empty
+ */
+uint32_t metrics_histogram_percentile(const metrics_histogram_t *histogram, float fraction);
+
 /**
  * @brief Log current statistics
  */
@@ -109,11 +219,14 @@ void metrics_log_statistics(void);
 
 /**
  * @brief Metrics monitoring task
+ * 
+ * Samples system health every 500 ms and logs the statistics every 5 s
+ * while the pipeline is active. With CONFIG_TELEMETRY_ENABLE it sends a
+ * binary snapshot every CONFIG_TELEMETRY_INTERVAL_MS instead.
  */
 void metrics_monitor_task(void *arg);
 
 void metrics_init(void);
-void metrics_record_inference_time(uint64_t time_us);
 void metrics_record_correct_prediction(void);
 void metrics_record_incorrect_prediction(void);
 void metrics_record_memory_usage(void);
@@ -0,0 +1,283 @@
+// telemetry.c - Binary metrics records over the sample stream
+#include "telemetry.h"
+#include "sample_stream.h"
+#include "model_registry.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <string.h>
+#include <stdatomic.h>
+
+#ifdef CONFIG_TELEMETRY_ENABLE
+
+static const char *TAG = "TELEMETRY";
+
+#define PAYLOAD_OFFSET      sizeof(stream_frame_header_t)
+#define HISTOGRAM_FRAME_MAX (STREAM_FRAME_OVERHEAD + sizeof(telemetry_header_t) + \
+                             sizeof(telemetry_histogram_t) + \
+                             METRICS_HISTOGRAM_BUCKETS * sizeof(telemetry_bucket_t))
+#define BENCHMARK_FRAME_MAX (STREAM_FRAME_OVERHEAD + sizeof(telemetry_header_t) + \
+                             sizeof(telemetry_benchmark_t) + \
+                             MODEL_TYPE_COUNT * sizeof(telemetry_model_t))
+#define PROFILE_FRAME_MAX   (STREAM_FRAME_OVERHEAD + sizeof(telemetry_header_t) + \
+                             sizeof(telemetry_op_profile_t) + \
+                             TELEMETRY_MAX_LAYERS * sizeof(telemetry_layer_t))
+#define TRACE_FRAME_MAX     (STREAM_FRAME_OVERHEAD + sizeof(telemetry_header_t) + \
+                             sizeof(telemetry_trace_t))
+#define STREAM_TX_BYTES     (CONFIG_SAMPLE_STREAM_TX_BUFFER_KB * 1024)
+
+_Static_assert(HISTOGRAM_FRAME_MAX <= STREAM_TX_BYTES, "a histogram record must fit the TX buffer");
+_Static_assert(BENCHMARK_FRAME_MAX <= STREAM_TX_BYTES, "a benchmark record must fit the TX buffer");
+_Static_assert(PROFILE_FRAME_MAX <= STREAM_TX_BYTES, "a profile record must fit the TX buffer");
+_Static_assert(TRACE_FRAME_MAX <= PROFILE_FRAME_MAX, "a trace record must fit the inference frame");
+_Static_assert(METRICS_HISTOGRAM_BUCKETS <= 255, "bucket index must fit a byte");
+
+// One frame buffer per sending task: the snapshot records are only built
+// by the metrics monitor, benchmark, profile and trace only by the
+// inference task
+static uint8_t s_snapshot_frame[HISTOGRAM_FRAME_MAX];
+static uint8_t s_inference_frame[PROFILE_FRAME_MAX > BENCHMARK_FRAME_MAX ?
+                                PROFILE_FRAME_MAX : BENCHMARK_FRAME_MAX];
+
+static uint16_t s_snapshot = 0;                 // Metrics monitor only
+static atomic_uint s_records_dropped = 0;
+static atomic_uint s_log_interval = CONFIG_INFERENCE_LOG_INTERVAL;
+static atomic_bool s_snapshot_requested = false;
+
+// Fill in the record header and send what the caller placed after it
+static bool send_record(uint8_t *frame, uint8_t type, uint16_t snapshot, size_t body_length)
+{
+    telemetry_header_t header = {
+        .record_type = type,
+        .version = TELEMETRY_VERSION,
+        .snapshot = snapshot,
+    };
+    memcpy(frame + PAYLOAD_OFFSET, &header, sizeof(header));
+
+    if (!sample_stream_send_frame(STREAM_PKT_TELEMETRY, frame, sizeof(header) + body_length)) {
+        atomic_fetch_add_explicit(&s_records_dropped, 1, memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+static inline uint8_t *record_body(uint8_t *frame)
+{
+    return frame + PAYLOAD_OFFSET + sizeof(telemetry_header_t);
+}
+
+static bool send_counters(const metrics_t *metrics, uint16_t snapshot)
+{
+    sample_stream_stats_t stream;
+    sample_stream_get_stats(&stream);
+
+    telemetry_counters_t counters = {
+        .uptime_ms = (uint32_t)(esp_timer_get_time() / 1000),
+        .inference_count = metrics->inference_count,
+        .correct_predictions = metrics->correct_predictions,
+        .total_predictions = metrics->total_predictions,
+        .transition_correct = metrics->transition_correct,
+        .transition_predictions = metrics->transition_predictions,
+        .detections_missed = metrics->detections_missed,
+        .windows_dropped = metrics->windows_dropped,
+        .windows_gapped = metrics->windows_gapped,
+        .heap_used = (uint32_t)metrics->current_heap_usage,
+        .heap_peak = (uint32_t)metrics->peak_heap_usage,
+        .stream_frames_sent = stream.frames_sent,
+        .stream_blocks_dropped = stream.blocks_dropped,
+        .stream_logs_dropped = stream.logs_dropped,
+        .records_dropped = atomic_load_explicit(&s_records_dropped, memory_order_relaxed),
+        .engine_ready_ms = metrics->engine_ready_ms,
+        .first_decision_ms = metrics->first_decision_ms,
+    };
+    memcpy(counters.windows_rejected, metrics->windows_rejected, sizeof(counters.windows_rejected));
+
+    memcpy(record_body(s_snapshot_frame), &counters, sizeof(counters));
+    return send_record(s_snapshot_frame, TELEMETRY_REC_COUNTERS, snapshot, sizeof(counters));
+}
+
+static bool send_health(const system_health_t *health, uint16_t snapshot)
+{
+    telemetry_health_t record = {
+        .state = (uint8_t)health->state,
+        .uart_connected = (uint8_t)health->uart_connected,
+        .queue_utilization = (uint8_t)health->queue_utilization,
+        .task_count = (uint8_t)health->task_count,
+        .health_counter = (uint16_t)health->health_counter,
+        .free_heap = (uint32_t)health->free_heap,
+        .min_free_heap = (uint32_t)health->min_free_heap,
+        .inference_time_avg_us = health->inference_time_avg,
+        .recent_accuracy = health->recent_accuracy,
+    };
+    memcpy(record_body(s_snapshot_frame), &record, sizeof(record));
+    return send_record(s_snapshot_frame, TELEMETRY_REC_HEALTH, snapshot, sizeof(record));
+}
+
+// Only the non-empty buckets: a stage rarely spans more than a few octaves
+static bool send_histogram(metric_stage_t stage, const metrics_histogram_t *h, uint16_t snapshot)
+{
+    uint8_t *body = record_body(s_snapshot_frame);
+    uint8_t *bucket = body + sizeof(telemetry_histogram_t);
+    int buckets = 0;
+    for (int k = 0; k < METRICS_HISTOGRAM_BUCKETS; k++) {
+        if (h->buckets[k] == 0) {
+            continue;
+        }
+        telemetry_bucket_t entry = { .index = (uint8_t)k, .count = h->buckets[k] };
+        memcpy(bucket, &entry, sizeof(entry));
+        bucket += sizeof(entry);
+        buckets++;
+    }
+
+    telemetry_histogram_t record = {
+        .stage = (uint8_t)stage,
+        .bucket_count = (uint8_t)buckets,
+        .count = h->count,
+        .total_us = h->total_us,
+        .min_us = h->min_us,
+        .max_us = h->max_us,
+    };
+    memcpy(body, &record, sizeof(record));
+    return send_record(s_snapshot_frame, TELEMETRY_REC_HISTOGRAM, snapshot,
+                       (size_t)(bucket - body));
+}
+
+bool telemetry_send_snapshot(const metrics_t *metrics, const system_health_t *health)
+{
+    if (!metrics || !health) {
+        return false;
+    }
+
+    uint16_t snapshot = s_snapshot++;
+    bool sent = send_counters(metrics, snapshot);
+    sent &= send_health(health, snapshot);
+    for (int i = 0; i < METRIC_STAGE_COUNT; i++) {
+        if (metrics->stages[i].count > 0) {
+            sent &= send_histogram((metric_stage_t)i, &metrics->stages[i], snapshot);
+        }
+    }
+    return sent;
+}
+
+bool telemetry_send_benchmark(void)
+{
+    model_benchmark_t results[MODEL_TYPE_COUNT];
+    int count = model_get_benchmark_results(results, MODEL_TYPE_COUNT);
+
+    uint8_t *body = record_body(s_inference_frame);
+    telemetry_benchmark_t record = { .model_count = (uint8_t)count };
+    memcpy(body, &record, sizeof(record));
+
+    uint8_t *entry = body + sizeof(record);
+    for (int i = 0; i < count; i++) {
+        const model_benchmark_t *r = &results[i];
+        telemetry_model_t model = {
+            .type = (int8_t)r->type,
+            .ops = r->ops,
+            .esp_nn_ops = r->esp_nn_ops,
+            .fallback_ops = r->fallback_ops,
+            .test_count = r->test_count,
+            .labeled_count = r->labeled_count,
+            .correct_count = r->correct_count,
+            .inference_time_us = r->inference_time_us,
+            .throughput_wps = r->throughput_wps,
+            .energy_uj = r->energy_uj,
+            .flash_size_kb = (uint16_t)r->flash_size_kb,
+            .ram_usage_kb = (uint16_t)r->ram_usage_kb,
+        };
+        if (r->name) {
+            strncpy(model.name, r->name, sizeof(model.name));
+        }
+        memcpy(entry, &model, sizeof(model));
+        entry += sizeof(model);
+    }
+    return send_record(s_inference_frame, TELEMETRY_REC_BENCHMARK, 0, (size_t)(entry - body));
+}
+
+bool telemetry_send_op_profile(model_type_t type, const tflite_session_t *session)
+{
+    static tflite_op_profile_t layers[TELEMETRY_MAX_LAYERS];
+    uint32_t invokes = 0;
+    int count = tflite_session_get_profile(session, layers, TELEMETRY_MAX_LAYERS, &invokes);
+    if (count == 0) {
+        return false;
+    }
+
+    uint8_t *body = record_body(s_inference_frame);
+    telemetry_op_profile_t record = {
+        .model_type = (int8_t)type,
+        .layer_count = (uint8_t)count,
+        .cpu_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .invokes = invokes,
+    };
+    memcpy(body, &record, sizeof(record));
+
+    uint8_t *entry = body + sizeof(record);
+    for (int i = 0; i < count; i++) {
+        telemetry_layer_t layer = {
+            .cycles = layers[i].cycles,
+            .calls = layers[i].calls,
+        };
+        if (layers[i].tag) {
+            strncpy(layer.tag, layers[i].tag, sizeof(layer.tag));
+        }
+        memcpy(entry, &layer, sizeof(layer));
+        entry += sizeof(layer);
+    }
+    return send_record(s_inference_frame, TELEMETRY_REC_OP_PROFILE, 0, (size_t)(entry - body));
+}
+
+bool telemetry_send_trace(const stage_trace_t *trace)
+{
+    if (!trace) {
+        return false;
+    }
+
+    telemetry_trace_t record = {
+        .sequence = trace->sequence,
+        .channel = trace->channel,
+        .mark_count = STAGE_TRACE_MARK_COUNT,
+        .reached = trace->reached,
+        .cpu_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .sealed_us = trace->sealed_us,
+        .dequeued_us = trace->dequeued_us,
+    };
+    memcpy(record.cycles, trace->cycles, sizeof(record.cycles));
+
+    memcpy(record_body(s_inference_frame), &record, sizeof(record));
+    return send_record(s_inference_frame, TELEMETRY_REC_TRACE, 0, sizeof(record));
+}
+
+void telemetry_handle_command(const uint8_t *payload, size_t length)
+{
+    if (!payload || length == 0) {
+        return;
+    }
+
+    switch (payload[0]) {
+        case TELEMETRY_CMD_LOG_INTERVAL:
+            if (length >= 3) {
+                uint16_t interval = (uint16_t)(payload[1] | (payload[2] << 8));
+                atomic_store_explicit(&s_log_interval, interval, memory_order_relaxed);
+                ESP_LOGI(TAG, "Logging every %u inferences", (unsigned)interval);
+            }
+            break;
+        case TELEMETRY_CMD_SNAPSHOT:
+            atomic_store_explicit(&s_snapshot_requested, true, memory_order_relaxed);
+            break;
+        default:
+            ESP_LOGW(TAG, "Unknown command 0x%02x", payload[0]);
+            break;
+    }
+}
+
+bool telemetry_snapshot_requested(void)
+{
+    return atomic_exchange_explicit(&s_snapshot_requested, false, memory_order_relaxed);
+}
+
+uint32_t telemetry_log_interval(void)
+{
+    return atomic_load_explicit(&s_log_interval, memory_order_relaxed);
+}
+
+#endif /* CONFIG_TELEMETRY_ENABLE */
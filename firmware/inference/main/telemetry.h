@@ -0,0 +1,219 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "system_monitor.h"
+#include "benchmark.h"
+#include "tflite_wrapper.h"
+#include "stage_trace.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Binary telemetry over the sample stream (CONFIG_TELEMETRY_ENABLE).
+ *
+ * Each STREAM_PKT_TELEMETRY frame holds one record: telemetry_header_t,
+ * then the record body (all little endian, decoded by
+ * telemetry_decode.py). Records of one snapshot share its number. A
+ * snapshot is COUNTERS, HEALTH and one HISTOGRAM per stage that has
+ * samples. BENCHMARK and OP_PROFILE follow each batch benchmark, TRACE
+ * every CONFIG_STAGE_TRACE_EXPORT_INTERVAL windows. Nothing
+ * is formatted on the device: counters and histogram buckets are sent
+ * raw and the host works out rates and percentiles.
+ *
+ * The host controls logging with PKT_TYPE_COMMAND packets (generator
+ * uart_packet_t format) on the stream port: payload[0] is a
+ * TELEMETRY_CMD_*, arguments follow.
+ */
+#define TELEMETRY_VERSION           2
+
+#define TELEMETRY_REC_COUNTERS      0x01
+#define TELEMETRY_REC_HEALTH        0x02
+#define TELEMETRY_REC_HISTOGRAM     0x03
+#define TELEMETRY_REC_BENCHMARK     0x04
+#define TELEMETRY_REC_OP_PROFILE    0x05
+#define TELEMETRY_REC_TRACE         0x06
+
+#define TELEMETRY_CMD_LOG_INTERVAL  0x01    // uint16: log every Nth inference (0 = none)
+#define TELEMETRY_CMD_SNAPSHOT      0x02    // Send a snapshot now
+
+#define TELEMETRY_NAME_LENGTH       16      // Model names, NUL padded
+#define TELEMETRY_TAG_LENGTH        20      // Operator names, NUL padded
+#define TELEMETRY_MAX_LAYERS        48
+
+typedef struct __attribute__((packed)) {
+    uint8_t record_type;          // TELEMETRY_REC_*
+    uint8_t version;              // TELEMETRY_VERSION
+    uint16_t snapshot;            // Shared by the records sent together
+} telemetry_header_t;
+
+// TELEMETRY_REC_COUNTERS: cumulative metrics_t counters
+typedef struct __attribute__((packed)) {
+    uint32_t uptime_ms;
+    uint32_t inference_count;
+    uint32_t correct_predictions;
+    uint32_t total_predictions;
+    uint32_t transition_correct;
+    uint32_t transition_predictions;
+    uint32_t detections_missed;
+    uint32_t windows_dropped;
+    uint32_t windows_gapped;
+    uint32_t windows_rejected[SIGNAL_GATE_COUNT];  // signal_gate_t order
+    uint32_t heap_used;
+    uint32_t heap_peak;
+    uint32_t stream_frames_sent;
+    uint32_t stream_blocks_dropped;
+    uint32_t stream_logs_dropped;
+    uint32_t records_dropped;     // Telemetry records the stream could not take
+    uint32_t engine_ready_ms;     // Startup milestones (metrics_t), 0 = not yet
+    uint32_t first_decision_ms;
+} telemetry_counters_t;
+
+// TELEMETRY_REC_HEALTH: the latest system_health_t sample
+typedef struct __attribute__((packed)) {
+    uint8_t state;                // system_state_t
+    uint8_t uart_connected;
+    uint8_t queue_utilization;    // Window ring, percent
+    uint8_t task_count;
+    uint16_t health_counter;
+    uint32_t free_heap;
+    uint32_t min_free_heap;
+    uint32_t inference_time_avg_us;
+    float recent_accuracy;
+} telemetry_health_t;
+
+// TELEMETRY_REC_HISTOGRAM: one metric_stage_t, then bucket_count
+// telemetry_bucket_t for its non-empty METRICS_HISTOGRAM_BUCKETS buckets
+typedef struct __attribute__((packed)) {
+    uint8_t stage;                // metric_stage_t
+    uint8_t bucket_count;
+    uint32_t count;
+    uint64_t total_us;
+    uint32_t min_us;
+    uint32_t max_us;
+} telemetry_histogram_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t index;
+    uint32_t count;
+} telemetry_bucket_t;
+
+// TELEMETRY_REC_BENCHMARK: model_count telemetry_model_t follow
+typedef struct __attribute__((packed)) {
+    uint8_t model_count;
+} telemetry_benchmark_t;
+
+typedef struct __attribute__((packed)) {
+    int8_t type;                  // model_type_t
+    uint8_t ops;
+    uint8_t esp_nn_ops;
+    uint8_t fallback_ops;
+    char name[TELEMETRY_NAME_LENGTH];
+    uint32_t test_count;
+    uint32_t labeled_count;
+    uint32_t correct_count;
+    uint32_t inference_time_us;
+    float throughput_wps;
+    float energy_uj;
+    uint16_t flash_size_kb;
+    uint16_t ram_usage_kb;
+} telemetry_model_t;
+
+// TELEMETRY_REC_OP_PROFILE: layer_count telemetry_layer_t follow, in
+// execution order
+typedef struct __attribute__((packed)) {
+    int8_t model_type;            // model_type_t
+    uint8_t layer_count;
+    uint16_t cpu_mhz;             // To convert cycles to time
+    uint32_t invokes;
+} telemetry_op_profile_t;
+
+typedef struct __attribute__((packed)) {
+    char tag[TELEMETRY_TAG_LENGTH];
+    uint64_t cycles;              // Summed over the invokes
+    uint32_t calls;
+} telemetry_layer_t;
+
+// TELEMETRY_REC_TRACE: the markers of one window (stage_trace_t). Cycles
+// before SEALED count on the acquisition core, from DEQUEUED on the
+// inference core; sealed_us and dequeued_us tie the two to esp_timer.
+typedef struct __attribute__((packed)) {
+    uint32_t sequence;
+    uint8_t channel;
+    uint8_t mark_count;           // STAGE_TRACE_MARK_COUNT
+    uint16_t reached;             // Bit per stage_trace_mark_t
+    uint16_t cpu_mhz;
+    int64_t sealed_us;
+    int64_t dequeued_us;
+    uint32_t cycles[STAGE_TRACE_MARK_COUNT];
+} telemetry_trace_t;
+
+/**
+ * @brief Send a metrics snapshot (metrics monitor task only)
+ *
+ * @param metrics Current metrics (as from metrics_get_current())
+ * @param health Latest health sample
+ * @return true if every record was queued
+ */
+bool telemetry_send_snapshot(const metrics_t *metrics, const system_health_t *health);
+
+/**
+ * @brief Send the benchmark results of every model (inference task only)
+ *
+ * @return true if the record was queued
+ */
+bool telemetry_send_benchmark(void);
+
+/**
+ * @brief Send a session's per-operator profile (inference task only)
+ *
+ * Nothing is sent unless CONFIG_INFERENCE_OP_PROFILING is set.
+ *
+ * @param type Model the session runs
+ * @param session Session handle
+ * @return true if the record was queued
+ */
+bool telemetry_send_op_profile(model_type_t type, const tflite_session_t *session);
+
+/**
+ * @brief Send the stage markers of one finished window (inference task only)
+ *
+ * @param trace Window trace
+ * @return true if the record was queued
+ */
+bool telemetry_send_trace(const stage_trace_t *trace);
+
+/**
+ * @brief Handle a PKT_TYPE_COMMAND payload from the host
+ *
+ * @param payload Command byte and arguments
+ * @param length Payload bytes
+ */
+void telemetry_handle_command(const uint8_t *payload, size_t length);
+
+/**
+ * @brief Take a snapshot request from the host, if one is pending
+ *
+ * @return true once per TELEMETRY_CMD_SNAPSHOT
+ */
+bool telemetry_snapshot_requested(void);
+
+/**
+ * @brief Per-inference log interval
+ *
+ * CONFIG_INFERENCE_LOG_INTERVAL until the host sends
+ * TELEMETRY_CMD_LOG_INTERVAL.
+ *
+ * @return uint32_t Log every Nth result, 0 = none
+ */
+uint32_t telemetry_log_interval(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TELEMETRY_H */
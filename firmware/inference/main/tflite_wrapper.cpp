@@ -1,18 +1,24 @@
 // tflite_wrapper.cpp
 #include <cstring>
 #include <cstdio>
+#include <new>
 
 // TensorFlow Lite includes
 #include "tensorflow/lite/micro/micro_interpreter.h"
 #include "tensorflow/lite/micro/micro_mutable_op_resolver.h"
 #include "tensorflow/lite/micro/micro_log.h"
 #include "tensorflow/lite/schema/schema_generated.h"
+#include "tensorflow/lite/schema/schema_utils.h"
 #include "tensorflow/lite/micro/micro_allocator.h"
 
 extern "C" {
+    #include "tflite_wrapper.h"
+    #include "preprocessing.h"
     #include "esp_log.h"
     #include "esp_heap_caps.h"
+    #include "esp_memory_utils.h"
     #include "esp_timer.h"
+    #include "esp_cpu.h"
 }
 
 static const char* TAG = "TFLITE_WRAPPER";
@@ -46,96 +52,535 @@ extern "C" {
     #endif
 }
 
-// Class names - must match those in inference.c
-static const char* s_class_names[] = {"SINE", "SQUARE", "TRIANGLE", "SAWTOOTH"};
-#define NUM_CLASSES 4
+// Number of builtin ops registered below - keep in sync with register_ops()
+constexpr int kNumOps = 22;
 
-// C++ implementation
-extern "C" bool tflite_inference_cpp(void* model_data, 
-                                     size_t model_size, 
-                                     float* samples, 
-                                     int num_samples, 
-                                     char* predicted_class, 
-                                     size_t class_len, 
-                                     float* confidence) {
-    
-    if (!model_data || model_size == 0 || !samples || !predicted_class || !confidence) {
+// Arena sizing and placement (see Kconfig "Signal Inference Configuration")
+constexpr size_t kArenaAlignment = 16;
+constexpr size_t kArenaHeadroomPct = CONFIG_INFERENCE_ARENA_HEADROOM_PCT;
+constexpr size_t kArenaProbeSize = CONFIG_INFERENCE_ARENA_PROBE_KB * 1024;
+constexpr size_t kArenaInternalMax = CONFIG_INFERENCE_ARENA_INTERNAL_MAX_KB * 1024;
+constexpr size_t kArenaInternalReserve = CONFIG_INFERENCE_ARENA_INTERNAL_RESERVE_KB * 1024;
+constexpr uint32_t kLatencyBudgetUs = CONFIG_INFERENCE_LATENCY_BUDGET_US;
+
+// One calibration record per distinct model (six models in arrays/)
+constexpr int kMaxCalibrations = 8;
+
+typedef struct {
+    const void* model_data;
+    size_t used_bytes;       // arena_used_bytes() after AllocateTensors()
+    uint32_t probe_invoke_us; // Invoke() time measured in the probe arena
+    bool probe_in_spiram;
+    bool seeded;             // From tflite_seed_arena_plan(), not measured this boot
+} arena_calibration_t;
+
+static arena_calibration_t s_calibrations[kMaxCalibrations];
+static int s_calibration_count = 0;
+
+// Op resolver shared by every session, populated once
+static tflite::MicroMutableOpResolver<kNumOps> s_resolver;
+static bool s_resolver_ready = false;
+
+#if CONFIG_INFERENCE_OP_PROFILING
+// Operators tracked per model, in execution order
+constexpr int kMaxProfiledOps = 48;
+
+// Accumulates CPU cycles per operator across Invoke() calls. The
+// interpreter reports one event per operator, in graph order, so the
+// event's position within an Invoke identifies the layer.
+class OpProfiler : public tflite::MicroProfilerInterface {
+public:
+    void BeginInvoke() {
+        cursor_ = 0;
+        invokes_++;
+    }
+
+    void Reset() {
+        memset(layers_, 0, sizeof(layers_));
+        layer_count_ = 0;
+        cursor_ = 0;
+        invokes_ = 0;
+        dropped_ = 0;
+    }
+
+    uint32_t BeginEvent(const char* tag) override {
+        if (cursor_ >= kMaxProfiledOps) {
+            dropped_++;
+            return kNoEvent;
+        }
+        uint32_t handle = cursor_++;
+        layer_t& layer = layers_[handle];
+        if (layer.tag != tag) {
+            // Events from AllocateTensors() or another graph layout: start over
+            layer.tag = tag;
+            layer.cycles = 0;
+            layer.calls = 0;
+        }
+        if (cursor_ > layer_count_) layer_count_ = cursor_;
+        layer.start = esp_cpu_get_cycle_count();
+        return handle;
+    }
+
+    void EndEvent(uint32_t handle) override {
+        if (handle == kNoEvent) return;
+        layer_t& layer = layers_[handle];
+        // Unsigned difference survives one counter wrap
+        layer.cycles += (uint32_t)(esp_cpu_get_cycle_count() - layer.start);
+        layer.calls++;
+    }
+
+    void Log(const char* name) const;
+
+    int Get(tflite_op_profile_t* out, int max_layers, uint32_t* invokes) const {
+        int count = (int)layer_count_ < max_layers ? (int)layer_count_ : max_layers;
+        for (int i = 0; i < count; i++) {
+            out[i].tag = layers_[i].tag;
+            out[i].cycles = layers_[i].cycles;
+            out[i].calls = layers_[i].calls;
+        }
+        if (invokes) *invokes = invokes_;
+        return count;
+    }
+
+private:
+    static constexpr uint32_t kNoEvent = UINT32_MAX;
+
+    typedef struct {
+        const char* tag;
+        uint32_t start;
+        uint64_t cycles;
+        uint32_t calls;
+    } layer_t;
+
+    layer_t layers_[kMaxProfiledOps] = {};
+    uint32_t layer_count_ = 0;
+    uint32_t cursor_ = 0;
+    uint32_t invokes_ = 0;
+    uint32_t dropped_ = 0;
+};
+
+void OpProfiler::Log(const char* name) const {
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < layer_count_; i++) {
+        total += layers_[i].cycles;
+    }
+    if (invokes_ == 0 || total == 0) {
+        ESP_LOGI(TAG, "%s: no profiled Invoke", name);
+        return;
+    }
+
+    const uint32_t mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+    ESP_LOGI(TAG, "=== %s: per-op profile, %u Invokes, %llu cycles (%llu us) each ===",
+                      name, (unsigned)invokes_, total / invokes_, total / invokes_ / mhz);
+    for (uint32_t i = 0; i < layer_count_; i++) {
+        const layer_t& layer = layers_[i];
+        uint64_t avg = layer.calls ? layer.cycles / layer.calls : 0;
+        ESP_LOGI(TAG, "  %2u %-18s %9llu cycles %7llu us %5.1f%%", (unsigned)i,
+                          layer.tag ? layer.tag : "?", avg, avg / mhz, 100.0 * layer.cycles / total);
+    }
+
+    // Same operators summed, to see which kernel type dominates
+    ESP_LOGI(TAG, "  by operator:");
+    for (uint32_t i = 0; i < layer_count_; i++) {
+        bool seen = false;
+        for (uint32_t j = 0; j < i && !seen; j++) {
+            seen = layers_[j].tag && layers_[i].tag && strcmp(layers_[j].tag, layers_[i].tag) == 0;
+        }
+        if (seen || !layers_[i].tag) continue;
+
+        uint64_t cycles = 0;
+        int count = 0;
+        for (uint32_t j = i; j < layer_count_; j++) {
+            if (layers_[j].tag && strcmp(layers_[j].tag, layers_[i].tag) == 0) {
+                cycles += layers_[j].cycles;
+                count++;
+            }
+        }
+        ESP_LOGI(TAG, "     %-18s x%-2d %5.1f%%", layers_[i].tag, count, 100.0 * cycles / total);
+    }
+    if (dropped_) {
+        ESP_LOGW(TAG, "  %u events beyond %d ops not profiled", (unsigned)dropped_, kMaxProfiledOps);
+    }
+}
+#endif
+
+// Persistent interpreter session: built once, reused for every window
+struct tflite_session_s {
+    tflite_session_s(const tflite::Model* model, uint8_t* arena_buf, size_t arena_len,
+                     bool in_spiram, bool owns)
+#if CONFIG_INFERENCE_OP_PROFILING
+        : interpreter(model, s_resolver, arena_buf, arena_len, nullptr, &profiler),
+#else
+        : interpreter(model, s_resolver, arena_buf, arena_len),
+#endif
+          arena(arena_buf),
+          arena_size(arena_len),
+          arena_in_spiram(in_spiram),
+          owns_arena(owns),
+          input(nullptr),
+          output(nullptr),
+          outputs(0),
+          class_span(0) {}
+
+#if CONFIG_INFERENCE_OP_PROFILING
+    OpProfiler profiler;  // Declared first: the interpreter keeps a pointer
+#endif
+    tflite::MicroInterpreter interpreter;
+    uint8_t* arena;
+    size_t arena_size;
+    bool arena_in_spiram;
+    bool owns_arena;  // false when built in a caller-provided (shared) arena
+    TfLiteTensor* input;
+    TfLiteTensor* output;
+    int outputs;                                // Output tensor elements
+    int class_span;                             // Highest mapped class + 1
+    int8_t class_of[ML_MAX_MODEL_OUTPUTS];      // ml_class_t of each output
+};
+
+static void register_ops(void) {
+    if (s_resolver_ready) return;
+
+    // Basic operations
+    s_resolver.AddFullyConnected();
+    s_resolver.AddSoftmax();
+    s_resolver.AddConv2D();
+    s_resolver.AddMaxPool2D();
+    s_resolver.AddReshape();
+    s_resolver.AddQuantize();
+
+    // Additional operations that might be needed for CNN models
+    s_resolver.AddExpandDims();
+    s_resolver.AddDequantize();
+    s_resolver.AddRelu();
+    s_resolver.AddAveragePool2D();
+    s_resolver.AddStridedSlice();
+    s_resolver.AddPack();
+    s_resolver.AddConcatenation();
+
+    // Elementwise / shape operations used by the hybrid models
+    s_resolver.AddMul();
+    s_resolver.AddAdd();
+    s_resolver.AddSub();
+    s_resolver.AddDiv();
+    s_resolver.AddPad();
+    s_resolver.AddMean();
+    s_resolver.AddSqueeze();
+    s_resolver.AddLeakyRelu();
+    s_resolver.AddTranspose();
+
+    s_resolver_ready = true;
+}
+
+static bool spiram_available(void) {
+    return heap_caps_get_total_size(MALLOC_CAP_SPIRAM) > 0;
+}
+
+static uint8_t* allocate_arena(size_t size, bool spiram) {
+    uint32_t caps = spiram ? (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+                           : (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    return (uint8_t*)heap_caps_aligned_alloc(kArenaAlignment, size, caps);
+}
+
+static arena_calibration_t* find_calibration(const void* model_data) {
+    for (int i = 0; i < s_calibration_count; i++) {
+        if (s_calibrations[i].model_data == model_data) {
+            return &s_calibrations[i];
+        }
+    }
+    return nullptr;
+}
+
+static void forget_calibration(arena_calibration_t* cal) {
+    *cal = s_calibrations[--s_calibration_count];
+}
+
+static void zero_input(tflite::MicroInterpreter& interpreter) {
+    TfLiteTensor* input = interpreter.input(0);
+    if (!input) return;
+
+    if (input->type == kTfLiteInt8) {
+        memset(input->data.int8, (int8_t)input->params.zero_point, input->bytes);
+    } else {
+        memset(input->data.raw, 0, input->bytes);
+    }
+}
+
+// Plan the model into a large probe arena and record what it really uses
+static arena_calibration_t* calibrate_model(const tflite::Model* model, const void* model_data) {
+    arena_calibration_t* cal = find_calibration(model_data);
+    if (cal) return cal;
+
+    if (s_calibration_count >= kMaxCalibrations) {
+        ESP_LOGE(TAG, "Arena calibration table full");
+        return nullptr;
+    }
+
+    // Probe in SPIRAM when present so calibration doesn't eat internal RAM
+    bool in_spiram = spiram_available();
+    uint32_t caps = in_spiram ? MALLOC_CAP_SPIRAM : MALLOC_CAP_INTERNAL;
+    size_t largest = heap_caps_get_largest_free_block(caps | MALLOC_CAP_8BIT);
+    if (!in_spiram) {
+        largest = (largest > kArenaInternalReserve) ? largest - kArenaInternalReserve : 0;
+    }
+    size_t probe_size = (largest < kArenaProbeSize) ? largest : kArenaProbeSize;
+    probe_size &= ~(kArenaAlignment - 1);
+
+    uint8_t* probe = probe_size ? allocate_arena(probe_size, in_spiram) : nullptr;
+    if (!probe) {
+        ESP_LOGE(TAG, "Failed to allocate %u byte calibration arena", (unsigned)probe_size);
+        return nullptr;
+    }
+
+    arena_calibration_t result = {};
+    bool ok = false;
+    {
+        tflite::MicroInterpreter interpreter(model, s_resolver, probe, probe_size);
+        if (interpreter.AllocateTensors() == kTfLiteOk) {
+            result.model_data = model_data;
+            result.used_bytes = interpreter.arena_used_bytes();
+            result.probe_in_spiram = in_spiram;
+
+            // One timed Invoke tells us whether this placement meets the budget
+            zero_input(interpreter);
+            uint64_t start_time = esp_timer_get_time();
+            interpreter.Invoke();
+            result.probe_invoke_us = (uint32_t)(esp_timer_get_time() - start_time);
+            ok = true;
+        }
+    }
+    heap_caps_free(probe);
+
+    if (!ok) {
+        ESP_LOGE(TAG, "Calibration failed: model needs more than %u bytes", (unsigned)probe_size);
+        return nullptr;
+    }
+
+    s_calibrations[s_calibration_count] = result;
+    ESP_LOGI(TAG, "Arena calibrated: %u bytes used, probe Invoke %u us (%s)",
+             (unsigned)result.used_bytes, (unsigned)result.probe_invoke_us,
+             result.probe_in_spiram ? "SPIRAM" : "internal");
+    return &s_calibrations[s_calibration_count++];
+}
+
+static size_t arena_size_for(const arena_calibration_t* cal) {
+    size_t size = cal->used_bytes + (cal->used_bytes * kArenaHeadroomPct) / 100;
+    return (size + kArenaAlignment - 1) & ~(kArenaAlignment - 1);
+}
+
+// Internal DRAM is faster but shared with ADC DMA buffers: use it when the
+// arena is small, or when SPIRAM would miss the latency budget, and only if
+// the internal reserve stays intact.
+static bool choose_spiram(const arena_calibration_t* cal, size_t size) {
+    if (!spiram_available()) return false;
+
+    size_t internal_free = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    bool internal_fits = internal_free >= size + kArenaInternalReserve;
+    if (!internal_fits) return true;
+
+    if (size <= kArenaInternalMax) return false;
+
+    bool over_budget = cal->probe_in_spiram && cal->probe_invoke_us > kLatencyBudgetUs;
+    return !over_budget;
+}
+
+// Kernel esp-tflite-micro runs for one operator. ESP-NN replaces the
+// int8 paths of these builtins; float32 tensors, dilated convolutions and
+// every other op use the portable reference kernels.
+static tflite_kernel_t operator_kernel(const tflite::Model* model,
+                                       const tflite::SubGraph* subgraph,
+                                       const tflite::Operator* op,
+                                       const char** reason) {
+    *reason = nullptr;
+    const tflite::OperatorCode* code = model->operator_codes()->Get(op->opcode_index());
+    tflite::BuiltinOperator builtin = tflite::GetBuiltinCode(code);
+
+    bool accelerated_op = false;
+    switch (builtin) {
+        case tflite::BuiltinOperator_CONV_2D:
+        case tflite::BuiltinOperator_DEPTHWISE_CONV_2D:
+        case tflite::BuiltinOperator_FULLY_CONNECTED:
+        case tflite::BuiltinOperator_AVERAGE_POOL_2D:
+        case tflite::BuiltinOperator_MAX_POOL_2D:
+        case tflite::BuiltinOperator_ADD:
+        case tflite::BuiltinOperator_MUL:
+        case tflite::BuiltinOperator_SOFTMAX:
+            accelerated_op = true;
+            break;
+        default:
+            break;
+    }
+    if (!accelerated_op) {
+        return TFLITE_KERNEL_REFERENCE;
+    }
+
+    #if !CONFIG_INFERENCE_ESP_NN
+    *reason = "ESP-NN disabled";
+    return TFLITE_KERNEL_FALLBACK;
+    #endif
+
+    const tflite::Tensor* input = subgraph->tensors()->Get(op->inputs()->Get(0));
+    if (input->type() != tflite::TensorType_INT8) {
+        *reason = "not int8";
+        return TFLITE_KERNEL_FALLBACK;
+    }
+
+    if (builtin == tflite::BuiltinOperator_CONV_2D) {
+        const tflite::Conv2DOptions* options = op->builtin_options_as_Conv2DOptions();
+        if (options && (options->dilation_w_factor() != 1 || options->dilation_h_factor() != 1)) {
+            *reason = "dilated";
+            return TFLITE_KERNEL_FALLBACK;
+        }
+    } else if (builtin == tflite::BuiltinOperator_DEPTHWISE_CONV_2D) {
+        const tflite::DepthwiseConv2DOptions* options =
+            op->builtin_options_as_DepthwiseConv2DOptions();
+        if (options && (options->dilation_w_factor() != 1 || options->dilation_h_factor() != 1)) {
+            *reason = "dilated";
+            return TFLITE_KERNEL_FALLBACK;
+        }
+    }
+    return TFLITE_KERNEL_ESP_NN;
+}
+
+static const tflite::Model* load_model(const void* model_data, size_t model_size) {
+    if (!model_data || model_size == 0) {
         ESP_LOGE(TAG, "Invalid parameters");
-        return false;
+        return nullptr;
     }
-    
+
     const tflite::Model* model = tflite::GetModel(model_data);
     if (model->version() != TFLITE_SCHEMA_VERSION) {
         ESP_LOGE(TAG, "Model schema version mismatch");
-        return false;
+        return nullptr;
     }
-    
-    // Create op resolver - increase the number significantly
-    static tflite::MicroMutableOpResolver<19> resolver;  // Increased from 12 to 20
 
-    // Basic operations
-    resolver.AddFullyConnected();
-    resolver.AddSoftmax();
-    resolver.AddConv2D();
-    resolver.AddMaxPool2D();
-    resolver.AddReshape();
-    resolver.AddQuantize();
+    register_ops();
+    return model;
+}
 
-    // Additional operations that might be needed for CNN models
-    resolver.AddExpandDims();
-    resolver.AddDequantize();
-    resolver.AddRelu();
-    resolver.AddAveragePool2D();
-    resolver.AddStridedSlice();
-    resolver.AddPack();
-    resolver.AddConcatenation();
-
-    // NEW: Add missing operations from error
-    resolver.AddMul();           // This was missing!
-    resolver.AddAdd();
-    resolver.AddSub();
-    resolver.AddDiv();
-    resolver.AddPad();
-    resolver.AddMean();
-    resolver.AddSqueeze();
-    resolver.AddLeakyRelu();
-    resolver.AddTranspose();     // Transpose operation
-    
-    // Allocate arena - start with 32KB and adjust based on your model
-    constexpr size_t kTensorArenaSize = 32 * 1024;
-    uint8_t* arena = nullptr;
-    
-    // Try SPIRAM first, then internal RAM
-    arena = (uint8_t*)heap_caps_malloc(kTensorArenaSize, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-    if (!arena) {
-        arena = (uint8_t*)malloc(kTensorArenaSize);
-        ESP_LOGW(TAG, "Using internal RAM for TFLite arena");
+static tflite_session_t* build_session(const tflite::Model* model, uint8_t* arena,
+                                       size_t arena_size, bool in_spiram, bool owns_arena) {
+    tflite_session_t* session = new (std::nothrow) tflite_session_s(model, arena, arena_size,
+                                                                     in_spiram, owns_arena);
+    if (!session) {
+        ESP_LOGE(TAG, "Failed to allocate interpreter");
+        if (owns_arena) heap_caps_free(arena);
+        return nullptr;
+    }
+
+    if (session->interpreter.AllocateTensors() != kTfLiteOk) {
+        ESP_LOGE(TAG, "Failed to allocate tensors");
+        tflite_session_destroy(session);
+        return nullptr;
+    }
+
+    session->input = session->interpreter.input(0);
+    session->output = session->interpreter.output(0);
+    if (!session->input || !session->output) {
+        ESP_LOGE(TAG, "Failed to get input/output tensors");
+        tflite_session_destroy(session);
+        return nullptr;
+    }
+
+    TfLiteTensor* output = session->output;
+    int count = output->dims->size > 1 ? output->dims->data[1] : 1;
+    if (count > ML_MAX_MODEL_OUTPUTS) {
+        ESP_LOGW(TAG, "Model has %d outputs, keeping %d", count, ML_MAX_MODEL_OUTPUTS);
+        count = ML_MAX_MODEL_OUTPUTS;
+    }
+    session->outputs = count;
+    session->class_span = count;
+    for (int i = 0; i < count; i++) {
+        session->class_of[i] = (int8_t)i;
+    }
+
+    return session;
+}
+
+static tflite_session_t* create_owned_session(const tflite::Model* model,
+                                              const arena_calibration_t* cal) {
+    size_t arena_size = arena_size_for(cal);
+    bool in_spiram = choose_spiram(cal, arena_size);
+    uint8_t* arena = allocate_arena(arena_size, in_spiram);
+    if (!arena && in_spiram) {
+        ESP_LOGW(TAG, "SPIRAM arena allocation failed, trying internal RAM");
+        in_spiram = false;
+        arena = allocate_arena(arena_size, in_spiram);
     }
-    
     if (!arena) {
-        ESP_LOGE(TAG, "Failed to allocate %lu bytes for TFLite arena", kTensorArenaSize);
-        return false;
+        ESP_LOGE(TAG, "Failed to allocate %u bytes for TFLite arena", (unsigned)arena_size);
+        return nullptr;
     }
-    
-    // Create interpreter
-    tflite::MicroInterpreter interpreter(model, resolver, arena, kTensorArenaSize);
-    
-    // Allocate tensors
-    TfLiteStatus allocate_status = interpreter.AllocateTensors();
-    if (allocate_status != kTfLiteOk) {
-        ESP_LOGE(TAG, "Failed to allocate tensors");
-        free(arena);
-        return false;
+    return build_session(model, arena, arena_size, in_spiram, true);
+}
+
+extern "C" tflite_session_t* tflite_session_create(const void* model_data, size_t model_size) {
+    const tflite::Model* model = load_model(model_data, model_size);
+    if (!model) {
+        return nullptr;
     }
-    
-    // Get input tensor
-    TfLiteTensor* input = interpreter.input(0);
-    if (!input) {
-        ESP_LOGE(TAG, "Failed to get input tensor");
-        free(arena);
+
+    arena_calibration_t* cal = calibrate_model(model, model_data);
+    if (!cal) {
+        return nullptr;
+    }
+
+    tflite_session_t* session = create_owned_session(model, cal);
+    if (!session && cal->seeded) {
+        // A plan from an earlier boot that no longer fits: measure again
+        ESP_LOGW(TAG, "Seeded arena plan failed, calibrating again");
+        forget_calibration(cal);
+        cal = calibrate_model(model, model_data);
+        session = cal ? create_owned_session(model, cal) : nullptr;
+    }
+    if (!session) {
+        return nullptr;
+    }
+
+    ESP_LOGI(TAG, "TFLite session ready: model=%u bytes, arena=%u/%u bytes in %s",
+             (unsigned)model_size, (unsigned)session->interpreter.arena_used_bytes(),
+             (unsigned)session->arena_size, session->arena_in_spiram ? "SPIRAM" : "internal RAM");
+
+    tflite_kernel_report_t kernels;
+    if (tflite_model_kernel_report(model_data, model_size, true, &kernels)) {
+        ESP_LOGI(TAG, "Kernels: %d/%d ops on ESP-NN, %d fell back to reference",
+                 kernels.esp_nn_ops, kernels.ops, kernels.fallback_ops);
+    }
+
+    return session;
+}
+
+extern "C" tflite_session_t* tflite_session_create_in_arena(const void* model_data,
+                                                           size_t model_size,
+                                                           void* arena,
+                                                           size_t arena_size) {
+    if (!arena || arena_size == 0) {
+        ESP_LOGE(TAG, "Invalid arena");
+        return nullptr;
+    }
+
+    const tflite::Model* model = load_model(model_data, model_size);
+    if (!model) {
+        return nullptr;
+    }
+
+    bool in_spiram = esp_ptr_external_ram(arena);
+    return build_session(model, (uint8_t*)arena, arena_size, in_spiram, false);
+}
+
+extern "C" bool tflite_session_run(tflite_session_t* session,
+                                   const float* samples,
+                                   int num_samples,
+                                   float* probabilities,
+                                   int max_classes,
+                                   int* num_classes) {
+
+    if (!session || !samples || !probabilities || !num_classes) {
+        ESP_LOGE(TAG, "Invalid parameters");
         return false;
     }
-    
+
+    TfLiteTensor* input = session->input;
+
     // Copy data to input tensor based on type
     bool input_processed = false;
     if (input->type == kTfLiteFloat32) {
@@ -146,109 +591,287 @@ extern "C" bool tflite_inference_cpp(void* model_data,
         }
     } else if (input->type == kTfLiteInt8) {
         if (input->bytes >= (size_t)num_samples) {
-            int8_t* input_data = input->data.int8;
-            float scale = input->params.scale;
-            int zero_point = input->params.zero_point;
-            
-            // Clamp values to int8 range
-            const int32_t min_val = -128;
-            const int32_t max_val = 127;
-            
-            for (int i = 0; i < num_samples; i++) {
-                float scaled_value = samples[i] / scale + zero_point;
-                int32_t quantized = static_cast<int32_t>(scaled_value);
-                
-                // Clamp to int8 range
-                if (quantized < min_val) quantized = min_val;
-                if (quantized > max_val) quantized = max_val;
-                
-                input_data[i] = static_cast<int8_t>(quantized);
-            }
-            input_processed = true;
+            // Rounds to nearest; truncation would bias every sample toward zero_point
+            input_processed = quantize_samples_int8(samples, num_samples, input->params.scale,
+                                                    input->params.zero_point, input->data.int8);
         }
     }
     
     if (!input_processed) {
         ESP_LOGE(TAG, "Failed to process input tensor");
-        free(arena);
         return false;
     }
     
-    // Run inference
+    return tflite_session_invoke(session, probabilities, max_classes, num_classes);
+}
+
+static bool tensor_view(const TfLiteTensor* tensor, tflite_input_view_t* view) {
+    if (tensor->type == kTfLiteFloat32) {
+        view->type = TFLITE_INPUT_FLOAT32;
+        view->data = tensor->data.f;
+        view->elements = tensor->bytes / sizeof(float);
+        view->scale = 1.0f;
+        view->zero_point = 0;
+    } else if (tensor->type == kTfLiteInt8) {
+        view->type = TFLITE_INPUT_INT8;
+        view->data = tensor->data.int8;
+        view->elements = tensor->bytes;
+        view->scale = tensor->params.scale;
+        view->zero_point = tensor->params.zero_point;
+    } else {
+        ESP_LOGE(TAG, "Unsupported tensor type: %d", tensor->type);
+        return false;
+    }
+    return true;
+}
+
+extern "C" bool tflite_session_input(tflite_session_t* session, tflite_input_view_t* view) {
+    if (!session || !view) return false;
+    return tensor_view(session->input, view);
+}
+
+extern "C" int tflite_session_tensor_count(const tflite_session_t* session, bool outputs) {
+    if (!session) return 0;
+    const tflite::MicroInterpreter& interpreter = session->interpreter;
+    return (int)(outputs ? interpreter.outputs_size() : interpreter.inputs_size());
+}
+
+extern "C" bool tflite_session_tensor(tflite_session_t* session, bool outputs, int index,
+                                      tflite_tensor_info_t* info) {
+    if (!session || !info || index < 0 || index >= tflite_session_tensor_count(session, outputs)) {
+        return false;
+    }
+
+    TfLiteTensor* tensor = outputs ? session->interpreter.output(index)
+                                   : session->interpreter.input(index);
+    if (!tensor || !tensor->dims || tensor->dims->size > TFLITE_MAX_DIMS) {
+        return false;
+    }
+    info->rank = tensor->dims->size;
+    for (int i = 0; i < info->rank; i++) {
+        info->dims[i] = tensor->dims->data[i];
+    }
+    return tensor_view(tensor, &info->view);
+}
+
+extern "C" bool tflite_session_set_class_map(tflite_session_t* session, const ml_class_map_t* map) {
+    if (!session || !map) return false;
+
+    if (map->count != session->outputs) {
+        ESP_LOGE(TAG, "Class map lists %d outputs, model has %d",
+                 (int)map->count, session->outputs);
+        return false;
+    }
+
+    int span = 0;
+    for (int i = 0; i < session->outputs; i++) {
+        int8_t cls = map->classes[i];
+        if (cls >= ML_CLASS_COUNT) {
+            cls = ML_CLASS_UNKNOWN;
+        }
+        session->class_of[i] = cls;
+        if (cls + 1 > span) {
+            span = cls + 1;
+        }
+    }
+    session->class_span = span;
+    return span > 0;
+}
+
+extern "C" bool tflite_session_invoke_raw(tflite_session_t* session) {
+    if (!session) return false;
+
+    #if CONFIG_INFERENCE_OP_PROFILING
+    session->profiler.BeginInvoke();
+    #endif
     uint64_t start_time = esp_timer_get_time();
-    TfLiteStatus invoke_status = interpreter.Invoke();
+    TfLiteStatus invoke_status = session->interpreter.Invoke();
     
     #ifdef CONFIG_DETAILED_LOGGING
     uint64_t inference_time = esp_timer_get_time() - start_time;
     ESP_LOGI(TAG, "TFLite inference time: %llu us", inference_time);
+    #else
+    (void)start_time;
     #endif
     
     if (invoke_status != kTfLiteOk) {
         ESP_LOGE(TAG, "Failed to invoke interpreter");
-        free(arena);
         return false;
     }
-    
-    // Get output tensor
-    TfLiteTensor* output = interpreter.output(0);
-    if (!output) {
-        ESP_LOGE(TAG, "Failed to get output tensor");
-        free(arena);
+    return true;
+}
+
+extern "C" bool tflite_session_invoke(tflite_session_t* session,
+                                      float* probabilities,
+                                      int max_classes,
+                                      int* num_classes) {
+
+    if (!session || !probabilities || !num_classes || max_classes <= 0) {
+        ESP_LOGE(TAG, "Invalid parameters");
+        return false;
+    }
+
+    if (!tflite_session_invoke_raw(session)) {
         return false;
     }
     
-    // Process output
-    float max_prob = 0.0f;
-    int max_index = 0;
+    TfLiteTensor* output = session->output;
+    int span = session->class_span < max_classes ? session->class_span : max_classes;
+    memset(probabilities, 0, span * sizeof(float));
     
+    // Dequantize each output into its class; unmapped outputs are dropped
     if (output->type == kTfLiteFloat32) {
-        float* output_data = output->data.f;
-        int num_classes = output->dims->size > 1 ? output->dims->data[1] : 1;
-        
-        for (int i = 0; i < num_classes; i++) {
-            float prob = output_data[i];
-            if (prob > max_prob) {
-                max_prob = prob;
-                max_index = i;
+        const float* output_data = output->data.f;
+        for (int i = 0; i < session->outputs; i++) {
+            int cls = session->class_of[i];
+            if (cls >= 0 && cls < span) {
+                probabilities[cls] = output_data[i];
             }
         }
     } else if (output->type == kTfLiteInt8) {
-        int8_t* output_data = output->data.int8;
+        const int8_t* output_data = output->data.int8;
         float scale = output->params.scale;
         int zero_point = output->params.zero_point;
-        int num_classes = output->dims->size > 1 ? output->dims->data[1] : 1;
         
-        for (int i = 0; i < num_classes; i++) {
-            float prob = (output_data[i] - zero_point) * scale;
-            if (prob > max_prob) {
-                max_prob = prob;
-                max_index = i;
+        for (int i = 0; i < session->outputs; i++) {
+            int cls = session->class_of[i];
+            if (cls >= 0 && cls < span) {
+                probabilities[cls] = (output_data[i] - zero_point) * scale;
             }
         }
     } else {
         ESP_LOGE(TAG, "Unsupported output tensor type: %d", output->type);
-        free(arena);
         return false;
     }
     
-    // Set output values
-    *confidence = max_prob;
-    
-    if (max_index < NUM_CLASSES) {
-        strncpy(predicted_class, s_class_names[max_index], class_len - 1);
-        predicted_class[class_len - 1] = '\0';
-    } else {
-        snprintf(predicted_class, class_len, "CLASS_%d", max_index);
-    }
-    
-    // Clean up
-    free(arena);
-    
+    *num_classes = span;
     return true;
 }
 
+extern "C" void tflite_session_destroy(tflite_session_t* session) {
+    if (!session) return;
+
+    uint8_t* arena = session->owns_arena ? session->arena : nullptr;
+    delete session;
+    if (arena) heap_caps_free(arena);
+}
+
 extern "C" size_t tflite_get_arena_size(void* model_data, size_t model_size) {
-    // This function is no longer needed with static arena size
-    // For ESP32 with TFLite Micro, we use a fixed arena size
-    return 32 * 1024; // 32KB default
-}
\ No newline at end of file
+    const tflite::Model* model = load_model(model_data, model_size);
+    if (!model) return 0;
+
+    arena_calibration_t* cal = calibrate_model(model, model_data);
+    return cal ? arena_size_for(cal) : 0;
+}
+
+extern "C" void tflite_move_calibration(const void* from, const void* to) {
+    arena_calibration_t* cal = find_calibration(from);
+    if (cal && !find_calibration(to)) {
+        cal->model_data = to;
+    }
+}
+
+extern "C" bool tflite_get_arena_plan(const void* model_data, tflite_arena_plan_t* plan) {
+    const arena_calibration_t* cal = find_calibration(model_data);
+    if (!cal || !plan) return false;
+
+    plan->used_bytes = (uint32_t)cal->used_bytes;
+    plan->probe_invoke_us = cal->probe_invoke_us;
+    plan->probe_in_spiram = cal->probe_in_spiram;
+    return true;
+}
+
+extern "C" bool tflite_seed_arena_plan(const void* model_data, const tflite_arena_plan_t* plan) {
+    if (!model_data || !plan || plan->used_bytes == 0) return false;
+    if (find_calibration(model_data) || s_calibration_count >= kMaxCalibrations) return false;
+
+    arena_calibration_t& cal = s_calibrations[s_calibration_count++];
+    cal = {};
+    cal.model_data = model_data;
+    cal.used_bytes = plan->used_bytes;
+    cal.probe_invoke_us = plan->probe_invoke_us;
+    cal.probe_in_spiram = plan->probe_in_spiram;
+    cal.seeded = true;
+    return true;
+}
+
+extern "C" size_t tflite_session_arena_size(const tflite_session_t* session) {
+    return session ? session->arena_size : 0;
+}
+
+extern "C" size_t tflite_session_arena_used(const tflite_session_t* session) {
+    return session ? session->interpreter.arena_used_bytes() : 0;
+}
+
+extern "C" bool tflite_session_arena_in_spiram(const tflite_session_t* session) {
+    return session ? session->arena_in_spiram : false;
+}
+
+extern "C" void tflite_session_reset_profile(tflite_session_t* session) {
+#if CONFIG_INFERENCE_OP_PROFILING
+    if (session) session->profiler.Reset();
+#else
+    (void)session;
+#endif
+}
+
+extern "C" void tflite_session_log_profile(const tflite_session_t* session, const char* name) {
+#if CONFIG_INFERENCE_OP_PROFILING
+    if (session) session->profiler.Log(name ? name : "model");
+#else
+    (void)session;
+    (void)name;
+#endif
+}
+
+extern "C" int tflite_session_get_profile(const tflite_session_t* session, tflite_op_profile_t* layers,
+                                          int max_layers, uint32_t* invokes) {
+    if (invokes) *invokes = 0;
+#if CONFIG_INFERENCE_OP_PROFILING
+    if (session && layers && max_layers > 0) {
+        return session->profiler.Get(layers, max_layers, invokes);
+    }
+#else
+    (void)session;
+    (void)layers;
+    (void)max_layers;
+#endif
+    return 0;
+}
+
+extern "C" bool tflite_model_kernel_report(const void* model_data, size_t model_size,
+                                           bool log_fallbacks, tflite_kernel_report_t* report) {
+    if (!report) return false;
+    memset(report, 0, sizeof(tflite_kernel_report_t));
+
+    const tflite::Model* model = load_model(model_data, model_size);
+    if (!model || !model->subgraphs() || model->subgraphs()->size() == 0) {
+        return false;
+    }
+
+    const tflite::SubGraph* subgraph = model->subgraphs()->Get(0);
+    const auto* operators = subgraph->operators();
+    if (!operators || !model->operator_codes()) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < operators->size(); i++) {
+        const tflite::Operator* op = operators->Get(i);
+        const char* reason = nullptr;
+        tflite_kernel_t kernel = operator_kernel(model, subgraph, op, &reason);
+
+        report->ops++;
+        if (kernel == TFLITE_KERNEL_ESP_NN) {
+            report->esp_nn_ops++;
+        } else if (kernel == TFLITE_KERNEL_FALLBACK) {
+            report->fallback_ops++;
+            if (log_fallbacks) {
+                tflite::BuiltinOperator builtin = tflite::GetBuiltinCode(
+                    model->operator_codes()->Get(op->opcode_index()));
+                ESP_LOGW(TAG, "Op %u %s: reference kernel (%s)", (unsigned)i,
+                         tflite::EnumNameBuiltinOperator(builtin), reason);
+            }
+        }
+    }
+    return true;
+}
@@ -2,42 +2,343 @@
 #ifndef TFLITE_WRAPPER_H
 #define TFLITE_WRAPPER_H
 
+#include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include "ml_contract.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 /**
- * @brief Run TFLite inference (C wrapper for C++ implementation)
+ * @brief Opaque persistent TFLite Micro session (interpreter + tensor arena)
+ */
+typedef struct tflite_session_s tflite_session_t;
+
+/**
+ * @brief Element type of a session's input tensor
+ */
+typedef enum {
+    TFLITE_INPUT_FLOAT32,
+    TFLITE_INPUT_INT8
+} tflite_input_type_t;
+
+/**
+ * @brief Writable view of a session's input tensor
+ * 
+ * Lets producers write preprocessed (and, for int8 models, quantized)
+ * samples directly into the tensor instead of staging them in a float
+ * buffer. real = (q - zero_point) * scale.
+ */
+typedef struct {
+    void *data;
+    size_t elements;
+    tflite_input_type_t type;
+    float scale;
+    int zero_point;
+} tflite_input_view_t;
+
+/**
+ * @brief Kernel that runs an operator
+ */
+typedef enum {
+    TFLITE_KERNEL_REFERENCE,   // No optimized kernel exists for the op
+    TFLITE_KERNEL_ESP_NN,      // ESP-NN optimized kernel
+    TFLITE_KERNEL_FALLBACK     // ESP-NN op type, but runs the reference path
+} tflite_kernel_t;
+
+/**
+ * @brief Kernel selection summary of a model's graph
+ */
+typedef struct {
+    int ops;            // Operators in the main subgraph
+    int esp_nn_ops;     // Run by ESP-NN kernels
+    int fallback_ops;   // ESP-NN op types silently using reference kernels
+} tflite_kernel_report_t;
+
+/**
+ * @brief Create a persistent session for a model
+ * 
+ * Parses the model, registers ops, allocates the tensor arena and runs
+ * AllocateTensors() once. The session is reused for every inference.
  * 
  * @param model_data Pointer to model data
  * @param model_size Size of model data in bytes
+ * @return tflite_session_t* Session handle (NULL on error)
+ */
+tflite_session_t* tflite_session_create(const void* model_data, size_t model_size);
+
+/**
+ * @brief Create a session inside a caller-owned arena
+ * 
+ * Used to time-share one scratch arena between idle models. The arena is
+ * not freed by tflite_session_destroy(); only one session may live in a
+ * given arena at a time.
+ * 
+ * @param model_data Pointer to model data
+ * @param model_size Size of model data in bytes
+ * @param arena Arena buffer (16-byte aligned)
+ * @param arena_size Arena size in bytes
+ * @return tflite_session_t* Session handle (NULL on error)
+ */
+tflite_session_t* tflite_session_create_in_arena(const void* model_data,
+                                                 size_t model_size,
+                                                 void* arena,
+                                                 size_t arena_size);
+
+/**
+ * @brief Run inference on a persistent session
+ * 
+ * @param session Session created by tflite_session_create()
  * @param samples Input samples
  * @param num_samples Number of samples
- * @param predicted_class Output buffer for predicted class name
- * @param class_len Length of predicted_class buffer
- * @param confidence Output confidence score
+ * @param probabilities Caller-owned buffer for the dequantized outputs
+ * @param max_classes Capacity of probabilities
+ * @param num_classes Output: number of classes written
+ * @return true if inference successful
+ */
+bool tflite_session_run(tflite_session_t* session,
+                        const float* samples,
+                        int num_samples,
+                        float* probabilities,
+                        int max_classes,
+                        int* num_classes);
+
+/**
+ * @brief Destroy a session and release its arena
+ * 
+ * @param session Session to destroy (NULL is ignored)
+ */
+void tflite_session_destroy(tflite_session_t* session);
+
+/**
+ * @brief Get a writable view of the session's input tensor
+ * 
+ * The view stays valid for the lifetime of the session.
+ * 
+ * @param session Session handle
+ * @param view Output view
+ * @return true if the input tensor type is supported
+ */
+bool tflite_session_input(tflite_session_t* session, tflite_input_view_t* view);
+
+// Largest tensor rank reported by tflite_session_tensor()
+#define TFLITE_MAX_DIMS 4
+
+/**
+ * @brief Shape and data of one input or output tensor of a session
+ */
+typedef struct {
+    tflite_input_view_t view;     // Data, element type and quantization
+    int rank;
+    int dims[TFLITE_MAX_DIMS];
+} tflite_tensor_info_t;
+
+/**
+ * @brief Count a session's input or output tensors
+ * 
+ * @param session Session handle
+ * @param outputs true for outputs, false for inputs
+ * @return int Tensors (0 if session is NULL)
+ */
+int tflite_session_tensor_count(const tflite_session_t* session, bool outputs);
+
+/**
+ * @brief Get one of a session's input or output tensors
+ * 
+ * For models with more than one input or output, e.g. state carried from
+ * one Invoke to the next. Like tflite_session_input(), the view stays
+ * valid for the lifetime of the session; output tensors are only
+ * meaningful after an Invoke.
+ * 
+ * @param session Session handle
+ * @param outputs true for an output tensor, false for an input tensor
+ * @param index Tensor index
+ * @param info Output
+ * @return true if the tensor exists and its type is supported
+ */
+bool tflite_session_tensor(tflite_session_t* session, bool outputs, int index,
+                           tflite_tensor_info_t* info);
+
+/**
+ * @brief Invoke the interpreter, leaving every output in its tensor
+ * 
+ * For models whose outputs are not class scores; read them with
+ * tflite_session_tensor().
+ * 
+ * @param session Session handle
+ * @return true if inference successful
+ */
+bool tflite_session_invoke_raw(tflite_session_t* session);
+
+/**
+ * @brief Set which ml_class_t each model output is
+ * 
+ * Until set, output k is reported as class k. The map must list exactly
+ * the model's outputs.
+ * 
+ * @param session Session handle
+ * @param map Class map (copied)
+ * @return true if the map fits the output tensor
+ */
+bool tflite_session_set_class_map(tflite_session_t* session, const ml_class_map_t* map);
+
+/**
+ * @brief Invoke the interpreter on the input tensor as already filled
+ * 
+ * Use after writing the input through tflite_session_input(). Outputs
+ * are dequantized into probabilities by ml_class_t (see
+ * tflite_session_set_class_map()); classes the model lacks read 0.
+ * 
+ * @param session Session handle
+ * @param probabilities Caller-owned buffer, indexed by ml_class_t
+ * @param max_classes Capacity of probabilities
+ * @param num_classes Output: entries written (highest mapped class + 1)
  * @return true if inference successful
  */
-bool tflite_inference_cpp(void* model_data, 
-                         size_t model_size, 
-                         float* samples, 
-                         int num_samples, 
-                         char* predicted_class, 
-                         size_t class_len, 
-                         float* confidence);
+bool tflite_session_invoke(tflite_session_t* session,
+                           float* probabilities,
+                           int max_classes,
+                           int* num_classes);
 
 /**
  * @brief Get required arena size for TFLite
  * 
+ * Calibrates the model on first call (arena_used_bytes() after planning in
+ * a probe arena) and caches the result. Includes the configured headroom.
+ * 
  * @param model_data Pointer to model data
  * @param model_size Size of model data in bytes
  * @return size_t Required arena size in bytes (0 on error)
  */
 size_t tflite_get_arena_size(void* model_data, size_t model_size);
 
+/**
+ * @brief Re-key a model's calibration after its data was copied
+ * 
+ * Lets a copy of the flatbuffer reuse the original's measurement instead
+ * of taking a calibration slot of its own; the original loses it.
+ * 
+ * @param from Model data that was calibrated
+ * @param to Identical model data at its new address
+ */
+void tflite_move_calibration(const void* from, const void* to);
+
+// Arena calibration of one model, as measured in the probe arena
+typedef struct {
+    uint32_t used_bytes;          // arena_used_bytes() after AllocateTensors()
+    uint32_t probe_invoke_us;     // Invoke() time in the probe arena
+    bool probe_in_spiram;         // Where that Invoke() ran
+} tflite_arena_plan_t;
+
+/**
+ * @brief Get a model's arena calibration
+ * 
+ * @param model_data Model data
+ * @param plan Output
+ * @return true if the model has been calibrated (or seeded)
+ */
+bool tflite_get_arena_plan(const void* model_data, tflite_arena_plan_t* plan);
+
+/**
+ * @brief Seed a model's arena calibration from an earlier measurement
+ * 
+ * Sizing and sessions of the model then skip the probe arena: its
+ * AllocateTensors() planning pass and the timed Invoke(). If a session
+ * cannot be built with the seeded size, tflite_session_create() drops the
+ * seed and calibrates the model again.
+ * 
+ * @param model_data Model data the plan was measured for
+ * @param plan Earlier calibration
+ * @return false if the model is already calibrated or the table is full
+ */
+bool tflite_seed_arena_plan(const void* model_data, const tflite_arena_plan_t* plan);
+
+/**
+ * @brief Get the arena size allocated for a session
+ * 
+ * @param session Session handle
+ * @return size_t Allocated arena bytes (0 if session is NULL)
+ */
+size_t tflite_session_arena_size(const tflite_session_t* session);
+
+/**
+ * @brief Get the arena bytes actually used by a session
+ * 
+ * @param session Session handle
+ * @return size_t arena_used_bytes() of the interpreter
+ */
+size_t tflite_session_arena_used(const tflite_session_t* session);
+
+/**
+ * @brief Check whether a session's arena was placed in SPIRAM
+ * 
+ * @param session Session handle
+ * @return true if arena is in SPIRAM, false if in internal DRAM
+ */
+bool tflite_session_arena_in_spiram(const tflite_session_t* session);
+
+/**
+ * @brief Clear a session's per-operator profile
+ * 
+ * No-op unless CONFIG_INFERENCE_OP_PROFILING is set.
+ * 
+ * @param session Session handle
+ */
+void tflite_session_reset_profile(tflite_session_t* session);
+
+/**
+ * @brief Log the per-operator cycle breakdown since the last reset
+ * 
+ * One line per layer in execution order (average cycles and share of the
+ * Invoke), then the share of each operator type. No-op unless
+ * CONFIG_INFERENCE_OP_PROFILING is set.
+ * 
+ * @param session Session handle
+ * @param name Model name for the report
+ */
+void tflite_session_log_profile(const tflite_session_t* session, const char* name);
+
+// One profiled layer (CONFIG_INFERENCE_OP_PROFILING)
+typedef struct {
+    const char* tag;          // Operator name, NULL if unknown
+    uint64_t cycles;          // Summed over the profiled Invokes
+    uint32_t calls;
+} tflite_op_profile_t;
+
+/**
+ * @brief Copy the per-operator profile since the last reset
+ * 
+ * The raw figures behind tflite_session_log_profile(), for binary
+ * telemetry.
+ * 
+ * @param session Session handle
+ * @param layers Output, one entry per layer in execution order
+ * @param max_layers Capacity of layers
+ * @param invokes Output: profiled Invokes (may be NULL)
+ * @return int Layers written; 0 unless CONFIG_INFERENCE_OP_PROFILING is set
+ */
+int tflite_session_get_profile(const tflite_session_t* session, tflite_op_profile_t* layers,
+                               int max_layers, uint32_t* invokes);
+
+/**
+ * @brief Work out which kernels a model's operators will run
+ * 
+ * Mirrors the esp-tflite-micro dispatch: ESP-NN handles the int8 paths of
+ * CONV_2D, DEPTHWISE_CONV_2D, FULLY_CONNECTED, pooling, ADD, MUL and
+ * SOFTMAX when CONFIG_INFERENCE_ESP_NN is set; float32 inputs and dilated
+ * convolutions fall back to the reference kernels.
+ * 
+ * @param model_data Pointer to model data
+ * @param model_size Size of model data in bytes
+ * @param log_fallbacks Log each operator that falls back, with the reason
+ * @param report Output summary
+ * @return true if the model could be parsed
+ */
+bool tflite_model_kernel_report(const void* model_data, size_t model_size,
+                                bool log_fallbacks, tflite_kernel_report_t* report);
+
 #ifdef __cplusplus
 }
 #endif
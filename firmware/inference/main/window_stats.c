@@ -0,0 +1,222 @@
+#include "window_stats.h"
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+
+// Sample indices are stored as uint16 in the min/max queues
+_Static_assert((ML_WINDOW_SIZE & (ML_WINDOW_SIZE - 1)) == 0 && ML_WINDOW_SIZE <= 32768,
+               "ML_WINDOW_SIZE must be a power of 2 <= 32768");
+
+#define RING_MASK (ML_WINDOW_SIZE - 1)
+
+// Rebuild the sign-dependent sums once the mean moves this many codes
+#define BASELINE_TOLERANCE_CODES 8
+
+static inline bool is_crossing(int32_t a, int32_t b, int32_t baseline) {
+    int32_t da = a - baseline;
+    int32_t db = b - baseline;
+    return (da > 0 && db < 0) || (da < 0 && db > 0);
+}
+
+static inline void add_signed(window_moments_t *m, int32_t code, int sign) {
+    int32_t d = code - m->baseline;
+    if (d > 0) {
+        m->sum_abs += sign * d;
+        m->positive_sum += sign * d;
+        m->positive_count += sign;
+    } else if (d < 0) {
+        m->sum_abs -= sign * d;
+        m->negative_sum -= sign * d;
+        m->negative_count += sign;
+    }
+}
+
+static void reset_signed(window_moments_t *m, int32_t baseline) {
+    m->baseline = baseline;
+    m->sum_abs = 0;
+    m->positive_sum = 0;
+    m->negative_sum = 0;
+    m->positive_count = 0;
+    m->negative_count = 0;
+    m->zero_crossings = 0;
+}
+
+static int32_t mean_code(const window_moments_t *m) {
+    if (m->count == 0) {
+        return ML_ADC_MIDSCALE;
+    }
+    int32_t half = (int32_t)m->count / 2;
+    int32_t offset = (m->sum >= 0) ? (m->sum + half) / (int32_t)m->count
+                                   : (m->sum - half) / (int32_t)m->count;
+    return ML_ADC_MIDSCALE + offset;
+}
+
+void window_moments_compute(const uint16_t *codes, int num_samples, window_moments_t *moments) {
+    memset(moments, 0, sizeof(window_moments_t));
+    if (!codes || num_samples <= 0) {
+        return;
+    }
+
+    uint16_t min_code = UINT16_MAX, max_code = 0;
+    for (int i = 0; i < num_samples; i++) {
+        int32_t d = (int32_t)codes[i] - ML_ADC_MIDSCALE;
+        moments->sum += d;
+        moments->sum_sq += (int64_t)d * d;
+        if (codes[i] < min_code) min_code = codes[i];
+        if (codes[i] > max_code) max_code = codes[i];
+    }
+    moments->count = num_samples;
+    moments->min_code = min_code;
+    moments->max_code = max_code;
+
+    // Second pass around the mean for the sign-dependent sums
+    reset_signed(moments, mean_code(moments));
+    for (int i = 0; i < num_samples; i++) {
+        add_signed(moments, codes[i], 1);
+        if (i > 0 && is_crossing(codes[i - 1], codes[i], moments->baseline)) {
+            moments->zero_crossings++;
+        }
+    }
+}
+
+void window_moments_to_stats(const window_moments_t *moments, signal_stats_t *stats) {
+    memset(stats, 0, sizeof(signal_stats_t));
+    if (!moments || moments->count == 0) {
+        return;
+    }
+
+    const float scale = 1.0f / ML_ADC_MIDSCALE;
+    float n = (float)moments->count;
+    float x_min = moments->min_code * scale - 1.0f;
+    float x_max = moments->max_code * scale - 1.0f;
+
+    stats->mean = moments->sum * scale / n;
+    stats->rms = sqrtf((float)moments->sum_sq / n) * scale;
+    stats->peak_to_peak = x_max - x_min;
+    stats->peak = fmaxf(fabsf(x_min), fabsf(x_max));
+    stats->zero_crossing_rate = moments->zero_crossings / n;
+    stats->crest_factor = (stats->rms > 0.001f) ? stats->peak / stats->rms : 0.0f;
+
+    float signal_power = fabsf(stats->mean);
+    stats->snr_estimate = (stats->rms - signal_power) > 0.001f ?
+                          signal_power / (stats->rms - signal_power) : 0.0f;
+}
+
+void sliding_window_reset(sliding_window_t *window) {
+    memset(window, 0, sizeof(sliding_window_t));
+    window->moments.baseline = ML_ADC_MIDSCALE;
+    window->moments.min_code = UINT16_MAX;
+}
+
+static void rebuild_signed(sliding_window_t *window, int32_t baseline) {
+    window_moments_t *m = &window->moments;
+    uint32_t first = window->total - m->count;
+
+    reset_signed(m, baseline);
+    for (uint32_t t = first; t < window->total; t++) {
+        uint16_t code = window->ring[t & RING_MASK];
+        add_signed(m, code, 1);
+        if (t > first && is_crossing(window->ring[(t - 1) & RING_MASK], code, baseline)) {
+            m->zero_crossings++;
+        }
+    }
+}
+
+static void push_one(sliding_window_t *window, uint16_t code) {
+    window_moments_t *m = &window->moments;
+    uint32_t t = window->total;
+    uint32_t slot = t & RING_MASK;
+
+    if (t >= ML_WINDOW_SIZE) {
+        // Evict sample t - N, which lives in the slot about to be reused
+        uint16_t old = window->ring[slot];
+        int32_t d = (int32_t)old - ML_ADC_MIDSCALE;
+        m->sum -= d;
+        m->sum_sq -= (int64_t)d * d;
+        add_signed(m, old, -1);
+        if (is_crossing(old, window->ring[(t + 1) & RING_MASK], m->baseline)) {
+            m->zero_crossings--;
+        }
+
+        uint16_t evicted = (uint16_t)(t - ML_WINDOW_SIZE);
+        if (window->max_len && window->max_queue[window->max_head] == evicted) {
+            window->max_head = (window->max_head + 1) & RING_MASK;
+            window->max_len--;
+        }
+        if (window->min_len && window->min_queue[window->min_head] == evicted) {
+            window->min_head = (window->min_head + 1) & RING_MASK;
+            window->min_len--;
+        }
+    } else {
+        m->count++;
+    }
+
+    if (t > 0 && is_crossing(window->ring[(t - 1) & RING_MASK], code, m->baseline)) {
+        m->zero_crossings++;
+    }
+
+    window->ring[slot] = code;
+    int32_t d = (int32_t)code - ML_ADC_MIDSCALE;
+    m->sum += d;
+    m->sum_sq += (int64_t)d * d;
+    add_signed(m, code, 1);
+
+    // Monotonic queues: drop entries the new sample dominates
+    while (window->max_len &&
+           window->ring[window->max_queue[(window->max_head + window->max_len - 1) & RING_MASK] & RING_MASK] <= code) {
+        window->max_len--;
+    }
+    window->max_queue[(window->max_head + window->max_len) & RING_MASK] = (uint16_t)t;
+    window->max_len++;
+
+    while (window->min_len &&
+           window->ring[window->min_queue[(window->min_head + window->min_len - 1) & RING_MASK] & RING_MASK] >= code) {
+        window->min_len--;
+    }
+    window->min_queue[(window->min_head + window->min_len) & RING_MASK] = (uint16_t)t;
+    window->min_len++;
+
+    window->total = t + 1;
+}
+
+void sliding_window_push(sliding_window_t *window, const uint16_t *codes, int num_samples) {
+    if (!window || !codes || num_samples <= 0) {
+        return;
+    }
+
+    for (int i = 0; i < num_samples; i++) {
+        push_one(window, codes[i]);
+    }
+
+    window_moments_t *m = &window->moments;
+    m->max_code = window->ring[window->max_queue[window->max_head] & RING_MASK];
+    m->min_code = window->ring[window->min_queue[window->min_head] & RING_MASK];
+
+    // Keep sign-dependent sums centred on the signal
+    int32_t mean = mean_code(m);
+    if (abs(mean - m->baseline) > BASELINE_TOLERANCE_CODES) {
+        rebuild_signed(window, mean);
+    }
+}
+
+bool sliding_window_ready(const sliding_window_t *window) {
+    return window && window->total >= ML_WINDOW_SIZE;
+}
+
+void sliding_window_snapshot(const sliding_window_t *window, uint16_t *codes,
+                             window_moments_t *moments) {
+    uint32_t count = window->moments.count;
+    uint32_t first = (window->total - count) & RING_MASK;
+
+    // Unroll the ring so codes[0] is the oldest sample
+    uint32_t tail = ML_WINDOW_SIZE - first;
+    if (tail > count) {
+        tail = count;
+    }
+    memcpy(codes, &window->ring[first], tail * sizeof(uint16_t));
+    memcpy(codes + tail, window->ring, (count - tail) * sizeof(uint16_t));
+
+    if (moments) {
+        *moments = window->moments;
+    }
+}
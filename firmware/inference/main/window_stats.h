@@ -0,0 +1,110 @@
+#ifndef WINDOW_STATS_H
+#define WINDOW_STATS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ml_contract.h"
+#include "signal_processing.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Integer moments of a raw ADC window
+ *
+ * Everything validate_signal() and the time-domain heuristic features
+ * need, kept as sums so they can be updated as samples slide in and out.
+ * Sign-dependent sums (zero crossings, symmetry, rectified mean) are taken
+ * around 'baseline', which tracks the window mean.
+ */
+typedef struct {
+    uint32_t count;               // Samples in the window
+    int32_t sum;                  // sum(code - ML_ADC_MIDSCALE)
+    int64_t sum_sq;               // sum((code - ML_ADC_MIDSCALE)^2)
+    uint16_t min_code;
+    uint16_t max_code;
+    int32_t baseline;             // Reference code for the sums below
+    int32_t sum_abs;              // sum|code - baseline|
+    int32_t positive_sum;         // sum of (code - baseline) > 0
+    int32_t negative_sum;         // sum of (baseline - code) > 0
+    uint32_t positive_count;
+    uint32_t negative_count;
+    uint32_t zero_crossings;      // Sign changes of (code - baseline)
+} window_moments_t;
+
+/**
+ * @brief Sliding window of raw codes with incrementally updated moments
+ *
+ * Each pushed sample updates the moments in O(1) (amortized O(1) for
+ * min/max via monotonic queues). The sign-dependent sums are rebuilt only
+ * when the mean drifts away from the baseline.
+ */
+typedef struct {
+    uint16_t ring[ML_WINDOW_SIZE];
+    uint32_t total;               // Samples pushed since reset
+    window_moments_t moments;
+    uint16_t max_queue[ML_WINDOW_SIZE];  // Sample indices, decreasing codes
+    uint16_t min_queue[ML_WINDOW_SIZE];  // Sample indices, increasing codes
+    uint16_t max_head, max_len;
+    uint16_t min_head, min_len;
+} sliding_window_t;
+
+/**
+ * @brief Compute the moments of a window from scratch
+ *
+ * @param codes Raw ADC codes
+ * @param num_samples Number of samples
+ * @param moments Output moments (baseline = window mean)
+ */
+void window_moments_compute(const uint16_t *codes, int num_samples, window_moments_t *moments);
+
+/**
+ * @brief Convert moments to signal statistics in sample units
+ *
+ * Samples are x = code / ML_ADC_MIDSCALE - 1, as seen by validate_signal().
+ *
+ * @param moments Window moments
+ * @param stats Output statistics
+ */
+void window_moments_to_stats(const window_moments_t *moments, signal_stats_t *stats);
+
+/**
+ * @brief Reset a sliding window to empty
+ *
+ * @param window Sliding window
+ */
+void sliding_window_reset(sliding_window_t *window);
+
+/**
+ * @brief Append samples, evicting the oldest once the window is full
+ *
+ * @param window Sliding window
+ * @param codes New raw ADC codes, oldest first
+ * @param num_samples Number of new samples
+ */
+void sliding_window_push(sliding_window_t *window, const uint16_t *codes, int num_samples);
+
+/**
+ * @brief Check whether the window holds ML_WINDOW_SIZE samples
+ *
+ * @param window Sliding window
+ * @return true if full
+ */
+bool sliding_window_ready(const sliding_window_t *window);
+
+/**
+ * @brief Copy out the current window (oldest first) and its moments
+ *
+ * @param window Sliding window
+ * @param codes Output buffer of ML_WINDOW_SIZE codes
+ * @param moments Output moments (may be NULL)
+ */
+void sliding_window_snapshot(const sliding_window_t *window, uint16_t *codes,
+                             window_moments_t *moments);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WINDOW_STATS_H */
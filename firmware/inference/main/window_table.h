@@ -0,0 +1,34 @@
+#ifndef WINDOW_TABLE_H
+#define WINDOW_TABLE_H
+
+#include <stdint.h>
+#include "ml_contract.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Window coefficients for ML_WINDOW_SIZE, generated at build time
+ *
+ * Produced by gen_window_table.py for the window selected in Kconfig
+ * (PREPROCESS_WINDOW_*), so preprocessing never evaluates cosf() for the
+ * configured size. Both tables are 16-byte aligned.
+ */
+extern const float ml_window_table[ML_WINDOW_SIZE];
+
+/**
+ * @brief Same coefficients in Q15 (1.0 saturated to 32767)
+ */
+extern const int16_t ml_window_table_q15[ML_WINDOW_SIZE];
+
+/**
+ * @brief Name of the generated window ("hann", "hamming" or "blackman")
+ */
+extern const char ml_window_name[];
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WINDOW_TABLE_H */
@@ -0,0 +1,472 @@
+"""
+Decode the firmware's binary telemetry (CONFIG_TELEMETRY_ENABLE).
+
+Telemetry records travel as STREAM_PKT_TELEMETRY frames on the sample
+stream (sample_stream.h), laid out as in telemetry.h. This reads them
+live from the stream port, acknowledging frames as collect_data.py does,
+or from a saved raw capture of the port. It prints each snapshot as a
+summary with percentiles computed from the raw histogram buckets, or as
+JSON lines. Log frames are echoed as text. Window stage traces
+(CONFIG_STAGE_TRACE) can also be written as a Chrome trace, for
+chrome://tracing or ui.perfetto.dev.
+
+    python telemetry_decode.py --port /dev/ttyUSB0
+    python telemetry_decode.py --port /dev/ttyUSB0 --log-interval 1 --json > run.jsonl
+    python telemetry_decode.py --file capture.bin
+    python telemetry_decode.py --file capture.bin --quiet --chrome-trace trace.json
+"""
+import argparse
+import json
+import struct
+import sys
+import time
+
+SYNC_BYTE = 0xAA
+PKT_TYPE_ACK = 0x04
+PKT_TYPE_COMMAND = 0x06
+ACK_RESYNC = 0x01                            # STREAM_ACK_RESYNC
+PKT_LOG = 0x11
+PKT_TELEMETRY = 0x12
+
+TELEMETRY_VERSION = 2
+REC_COUNTERS = 0x01
+REC_HEALTH = 0x02
+REC_HISTOGRAM = 0x03
+REC_BENCHMARK = 0x04
+REC_OP_PROFILE = 0x05
+REC_TRACE = 0x06
+
+CMD_LOG_INTERVAL = 0x01
+CMD_SNAPSHOT = 0x02
+
+FRAME_HEADER = struct.Struct('<BBHIHB')      # stream_frame_header_t
+UART_PACKET = struct.Struct('<BBHIB32s')     # uart_packet_t without crc8
+RECORD_HEADER = struct.Struct('<BBH')        # telemetry_header_t
+COUNTERS = struct.Struct('<9I4I2I4I2I')        # telemetry_counters_t
+HEALTH = struct.Struct('<BBBBHIIIf')         # telemetry_health_t
+HISTOGRAM = struct.Struct('<BBIQII')         # telemetry_histogram_t
+BUCKET = struct.Struct('<BI')                # telemetry_bucket_t
+BENCHMARK = struct.Struct('<B')              # telemetry_benchmark_t
+MODEL = struct.Struct('<bBBB16sIIIIffHH')    # telemetry_model_t
+OP_PROFILE = struct.Struct('<bBHI')          # telemetry_op_profile_t
+LAYER = struct.Struct('<20sQI')              # telemetry_layer_t
+TRACE = struct.Struct('<IBBHHqq')            # telemetry_trace_t, then mark_count uint32 cycles
+MAX_PAYLOAD = 4096
+
+# model_type_t, metric_stage_t, signal_gate_t and system_state_t order
+MODELS = ['CNN_FLOAT32', 'CNN_INT8', 'MLP_FLOAT32', 'MLP_INT8', 'HYBRID_FLOAT32', 'HYBRID_INT8']
+STAGES = ['adc_interval', 'preprocess', 'quantize', 'invoke', 'end_to_end', 'detection']
+GATE_VERDICTS = ['pass', 'idle', 'saturated', 'stuck']
+STATES = ['NORMAL', 'DEGRADED', 'CRITICAL', 'FAILED']
+COUNTER_FIELDS = ['uptime_ms', 'inference_count', 'correct_predictions', 'total_predictions',
+                  'transition_correct', 'transition_predictions', 'detections_missed',
+                  'windows_dropped', 'windows_gapped']
+COUNTER_TAIL = ['heap_used', 'heap_peak', 'stream_frames_sent', 'stream_blocks_dropped',
+                'stream_logs_dropped', 'records_dropped', 'engine_ready_ms', 'first_decision_ms']
+# stage_trace_mark_t, and the stage ending at each marker (stage_trace_stage_name())
+MARKS = ['dma_complete', 'prepared', 'sealed', 'dequeued', 'dispatched', 'preprocessed',
+         'quantized', 'invoked', 'postprocessed']
+MARK_STAGES = ['dma', 'acquire', 'publish', 'queue_wait', 'bookkeeping', 'input', 'quantize',
+               'invoke', 'postprocess']
+MARK_SEALED = 2
+MARK_DEQUEUED = 3
+PERCENTILES = [0.50, 0.95, 0.99, 0.999]
+
+
+# calculate_crc8() in clock_sync.c: polynomial 0x07, initial value 0
+def _crc8_table():
+    table = []
+    for byte in range(256):
+        crc = byte
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x07) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+        table.append(crc)
+    return bytes(table)
+
+
+CRC8_TABLE = _crc8_table()
+
+
+def crc8(data):
+    crc = 0
+    for byte in data:
+        crc = CRC8_TABLE[crc ^ byte]
+    return crc
+
+
+def c_string(raw):
+    return raw.split(b'\0', 1)[0].decode('ascii', errors='replace')
+
+
+def bucket_upper_us(index):
+    """Largest latency in a metrics.c histogram bucket"""
+    if index < 4:
+        return index
+    octave = index // 4 + 1
+    return ((4 + index % 4 + 1) << (octave - 2)) - 1
+
+
+def percentile(histogram, fraction):
+    """metrics_histogram_percentile() on a decoded histogram"""
+    if histogram['count'] == 0:
+        return 0
+    rank = max(1, int(fraction * histogram['count'] + 0.999999))
+    seen = 0
+    for index, count in sorted(histogram['buckets'].items()):
+        seen += count
+        if seen >= rank:
+            return min(bucket_upper_us(index), histogram['max_us'])
+    return histogram['max_us']
+
+
+def trace_times_us(cycles, sealed_us, dequeued_us, cpu_mhz):
+    """esp_timer time of each marker reached, {mark index: us}
+
+    The two cores' cycle counters are unrelated: acquisition markers are
+    placed back from SEALED, inference markers forward from DEQUEUED.
+    """
+    times = {}
+    mhz = max(cpu_mhz, 1)
+    for mark, count in cycles.items():
+        if mark < MARK_DEQUEUED and MARK_SEALED in cycles:
+            times[mark] = sealed_us - ((cycles[MARK_SEALED] - count) & 0xFFFFFFFF) / mhz
+        elif mark >= MARK_DEQUEUED and MARK_DEQUEUED in cycles:
+            times[mark] = dequeued_us + ((count - cycles[MARK_DEQUEUED]) & 0xFFFFFFFF) / mhz
+    return times
+
+
+def trace_stages(record):
+    """(stage, start_us, end_us, end mark) of a trace record, in order"""
+    times = {MARKS.index(name): us for name, us in record['marks_us'].items()}
+    stages = []
+    previous = None
+    for mark in sorted(times):
+        if previous is not None:
+            stages.append((MARK_STAGES[mark], times[previous], times[mark], mark))
+        previous = mark
+    return stages
+
+
+def decode_record(payload):
+    """One telemetry record as a dict (None if malformed or a newer version)"""
+    if len(payload) < RECORD_HEADER.size:
+        return None
+    rtype, version, snapshot = RECORD_HEADER.unpack_from(payload)
+    if version != TELEMETRY_VERSION:
+        return None
+    body = payload[RECORD_HEADER.size:]
+    record = {'snapshot': snapshot}
+
+    try:
+        if rtype == REC_COUNTERS:
+            values = COUNTERS.unpack_from(body)
+            record['type'] = 'counters'
+            record.update(zip(COUNTER_FIELDS, values[:9]))
+            record['windows_rejected'] = dict(zip(GATE_VERDICTS[1:], values[10:13]))
+            record.update(zip(COUNTER_TAIL, values[13:]))
+        elif rtype == REC_HEALTH:
+            (state, uart, queue, tasks, counter, free_heap, min_free_heap,
+             latency, accuracy) = HEALTH.unpack_from(body)
+            record.update(type='health', state=STATES[state & 3], uart_connected=bool(uart),
+                          queue_utilization=queue, task_count=tasks, health_counter=counter,
+                          free_heap=free_heap, min_free_heap=min_free_heap,
+                          inference_time_avg_us=latency, recent_accuracy=accuracy)
+        elif rtype == REC_HISTOGRAM:
+            stage, bucket_count, count, total_us, min_us, max_us = HISTOGRAM.unpack_from(body)
+            buckets = dict(BUCKET.unpack_from(body, HISTOGRAM.size + k * BUCKET.size)
+                           for k in range(bucket_count))
+            record.update(type='histogram',
+                          stage=STAGES[stage] if stage < len(STAGES) else str(stage),
+                          count=count, total_us=total_us, min_us=min_us, max_us=max_us,
+                          buckets=buckets)
+        elif rtype == REC_BENCHMARK:
+            (model_count,) = BENCHMARK.unpack_from(body)
+            models = []
+            for k in range(model_count):
+                (mtype, ops, nn_ops, fallback_ops, name, tests, labeled, correct, time_us,
+                 throughput, energy, flash_kb, ram_kb) = MODEL.unpack_from(
+                    body, BENCHMARK.size + k * MODEL.size)
+                models.append({'type': mtype, 'name': c_string(name), 'ops': ops,
+                               'esp_nn_ops': nn_ops, 'fallback_ops': fallback_ops,
+                               'test_count': tests, 'labeled_count': labeled,
+                               'correct_count': correct,
+                               'accuracy': correct / labeled if labeled else None,
+                               'inference_time_us': time_us, 'throughput_wps': throughput,
+                               'energy_uj': energy, 'flash_size_kb': flash_kb,
+                               'ram_usage_kb': ram_kb})
+            record.update(type='benchmark', models=models)
+        elif rtype == REC_OP_PROFILE:
+            model_type, layer_count, cpu_mhz, invokes = OP_PROFILE.unpack_from(body)
+            layers = []
+            for k in range(layer_count):
+                tag, cycles, calls = LAYER.unpack_from(body, OP_PROFILE.size + k * LAYER.size)
+                layers.append({'tag': c_string(tag), 'cycles': cycles, 'calls': calls})
+            record.update(type='op_profile', model_type=model_type,
+                          model=MODELS[model_type] if 0 <= model_type < len(MODELS) else str(model_type),
+                          cpu_mhz=cpu_mhz,
+                          invokes=invokes, layers=layers)
+        elif rtype == REC_TRACE:
+            (sequence, channel, mark_count, reached, cpu_mhz, sealed_us,
+             dequeued_us) = TRACE.unpack_from(body)
+            counts = struct.unpack_from(f'<{mark_count}I', body, TRACE.size)
+            cycles = {m: counts[m] for m in range(min(mark_count, len(MARKS)))
+                      if reached & (1 << m)}
+            record.update(type='trace', sequence=sequence, channel=channel, cpu_mhz=cpu_mhz,
+                          sealed_us=sealed_us, dequeued_us=dequeued_us,
+                          cycles={MARKS[m]: c for m, c in cycles.items()},
+                          marks_us={MARKS[m]: t for m, t in
+                                    trace_times_us(cycles, sealed_us, dequeued_us, cpu_mhz).items()})
+        else:
+            return None
+    except struct.error:
+        return None
+    return record
+
+
+class FrameReader:
+    """Split a byte stream into CRC-checked (type, sequence, payload) frames"""
+
+    def __init__(self):
+        self.buffer = bytearray()
+        self.crc_errors = 0
+        self.lost_frames = 0
+        self.last_sequence = None
+
+    def feed(self, data):
+        self.buffer.extend(data)
+        header_size = FRAME_HEADER.size
+        while True:
+            start = self.buffer.find(SYNC_BYTE)
+            if start < 0:
+                self.buffer.clear()
+                return
+            del self.buffer[:start]
+            if len(self.buffer) < header_size:
+                return
+
+            header = bytes(self.buffer[:header_size])
+            _, ptype, sequence, _, length, header_crc = FRAME_HEADER.unpack(header)
+            if crc8(header[:-1]) != header_crc or length > MAX_PAYLOAD:
+                self.crc_errors += 1
+                del self.buffer[:1]
+                continue
+            if len(self.buffer) < header_size + length + 1:
+                return
+
+            payload = bytes(self.buffer[header_size:header_size + length])
+            if crc8(payload) != self.buffer[header_size + length]:
+                self.crc_errors += 1
+                del self.buffer[:1]
+                continue
+            del self.buffer[:header_size + length + 1]
+
+            if self.last_sequence is not None:
+                self.lost_frames += (sequence - self.last_sequence - 1) & 0xFFFF
+            self.last_sequence = sequence
+            yield ptype, sequence, payload
+
+
+def host_packet(ptype, sequence, payload=b''):
+    """A generator-format uart_packet_t, as the device's packet decoder expects"""
+    body = UART_PACKET.pack(SYNC_BYTE, ptype, sequence & 0xFFFF,
+                            int(time.time() * 1000) & 0xFFFFFFFF, len(payload), payload)
+    return body + bytes([crc8(body)])
+
+
+class Printer:
+    """Human-readable output, one block per snapshot"""
+
+    def __init__(self):
+        self.previous = None
+
+    def counters(self, r):
+        rate = ''
+        previous, self.previous = self.previous, r
+        if previous and r['uptime_ms'] > previous['uptime_ms']:
+            seconds = (r['uptime_ms'] - previous['uptime_ms']) / 1000.0
+            rate = f" ({(r['inference_count'] - previous['inference_count']) / seconds:.1f}/s)"
+        print(f"--- snapshot {r['snapshot']} at {r['uptime_ms'] / 1000.0:.1f} s ---")
+        # Once per boot
+        if r['first_decision_ms'] and (not previous or
+                                       previous['first_decision_ms'] != r['first_decision_ms']):
+            print(f"startup: engine ready at {r['engine_ready_ms']} ms, "
+                  f"first decision at {r['first_decision_ms']} ms")
+        print(f"windows {r['inference_count']}{rate}, dropped {r['windows_dropped']}, "
+              f"missing samples {r['windows_gapped']}, gated "
+              + ', '.join(f"{v} {k}" for k, v in r['windows_rejected'].items()))
+        if r['total_predictions']:
+            print(f"accuracy {100.0 * r['correct_predictions'] / r['total_predictions']:.2f}% "
+                  f"({r['correct_predictions']}/{r['total_predictions']}), "
+                  f"transition windows {r['transition_predictions']}, "
+                  f"missed detections {r['detections_missed']}")
+        print(f"heap {r['heap_used'] / 1024:.1f} KB (peak {r['heap_peak'] / 1024:.1f} KB), "
+              f"stream {r['stream_frames_sent']} frames, {r['stream_blocks_dropped']} blocks "
+              f"and {r['stream_logs_dropped']} logs dropped, {r['records_dropped']} records dropped")
+
+    def health(self, r):
+        print(f"health {r['state']}, accuracy {r['recent_accuracy']:.2f}, "
+              f"latency {r['inference_time_avg_us']} us, ring {r['queue_utilization']}%, "
+              f"free heap {r['free_heap']} (min {r['min_free_heap']}), {r['task_count']} tasks, "
+              f"UART {'up' if r['uart_connected'] else 'down'}")
+
+    def histogram(self, r):
+        pcts = '  '.join(f"p{100 * p:g}={percentile(r, p)}" for p in PERCENTILES)
+        print(f"  {r['stage']:<12} n={r['count']:<7} avg={r['total_us'] // max(r['count'], 1):<7} "
+              f"{pcts}  max={r['max_us']}")
+
+    def benchmark(self, r):
+        print("--- benchmark ---")
+        for m in r['models']:
+            accuracy = f"{100.0 * m['accuracy']:5.1f}%" if m['accuracy'] is not None else '    -'
+            print(f"  {m['name']:<14} acc {accuracy} time {m['inference_time_us']:>6} us "
+                  f"energy {m['energy_uj']:7.1f} uJ rate {m['throughput_wps']:6.1f}/s "
+                  f"NN {m['esp_nn_ops']}/{m['ops']} ops ({m['fallback_ops']} fallback) "
+                  f"tests {m['test_count']}")
+
+    def op_profile(self, r):
+        total = sum(layer['cycles'] for layer in r['layers'])
+        invokes = max(r['invokes'], 1)
+        print(f"--- {r['model']}: per-op profile, {r['invokes']} invokes, "
+              f"{total // invokes} cycles ({total // invokes // max(r['cpu_mhz'], 1)} us) each ---")
+        for i, layer in enumerate(r['layers']):
+            average = layer['cycles'] // max(layer['calls'], 1)
+            share = 100.0 * layer['cycles'] / total if total else 0.0
+            print(f"  {i:2} {layer['tag']:<18} {average:9} cycles {share:5.1f}%")
+
+    def trace(self, r):
+        stages = ' '.join(f"{stage} {end - start:.0f}" for stage, start, end, _ in trace_stages(r))
+        print(f"trace #{r['sequence']} (input {r['channel']}): {stages} us")
+
+
+class ChromeTrace:
+    """Trace records as Chrome trace events, one track per core"""
+
+    ACQUISITION = 1
+    INFERENCE = 2
+
+    def __init__(self):
+        self.events = [
+            {'ph': 'M', 'name': 'thread_name', 'pid': 1, 'tid': self.ACQUISITION,
+             'args': {'name': 'acquisition'}},
+            {'ph': 'M', 'name': 'thread_name', 'pid': 1, 'tid': self.INFERENCE,
+             'args': {'name': 'inference'}},
+        ]
+
+    def add(self, r):
+        window = {'sequence': r['sequence'], 'channel': r['channel']}
+        for stage, start, end, mark in trace_stages(r):
+            if mark == MARK_DEQUEUED:
+                # Waits in the ring overlap the previous windows' work: async slice
+                ident = f"{r['channel']}:{r['sequence']}"
+                self.events.append({'ph': 'b', 'cat': 'ring', 'name': stage, 'id': ident,
+                                    'pid': 1, 'ts': start, 'args': window})
+                self.events.append({'ph': 'e', 'cat': 'ring', 'name': stage, 'id': ident,
+                                    'pid': 1, 'ts': end})
+                continue
+            tid = self.ACQUISITION if mark < MARK_DEQUEUED else self.INFERENCE
+            self.events.append({'ph': 'X', 'cat': 'stage', 'name': stage, 'pid': 1, 'tid': tid,
+                                'ts': start, 'dur': end - start, 'args': window})
+
+    def write(self, path):
+        with open(path, 'w') as f:
+            json.dump({'traceEvents': self.events, 'displayTimeUnit': 'ms'}, f)
+
+
+def run(source, args):
+    reader = FrameReader()
+    printer = Printer()
+    chrome = ChromeTrace() if args.chrome_trace else None
+    out = sys.stdout
+
+    def handle(payload):
+        record = decode_record(payload)
+        if record is None:
+            return
+        if chrome and record['type'] == 'trace':
+            chrome.add(record)
+        if args.json:
+            out.write(json.dumps(record) + '\n')
+            out.flush()
+        else:
+            getattr(printer, record['type'])(record)
+
+    unacked = 0
+    for data, conn in source:
+        for ptype, sequence, payload in reader.feed(data):
+            unacked += 1
+            if ptype == PKT_TELEMETRY:
+                handle(payload)
+            elif ptype == PKT_LOG and not args.quiet:
+                sys.stderr.write(payload.decode('utf-8', errors='replace'))
+        # Acknowledge regularly, and when idle in case an ACK was lost; until
+        # the first frame, reopen a window that closed before we attached
+        if conn and reader.last_sequence is None:
+            if not data:
+                conn.write(host_packet(PKT_TYPE_ACK, 0, bytes([ACK_RESYNC])))
+        elif conn and (unacked >= 8 or not data):
+            conn.write(host_packet(PKT_TYPE_ACK, reader.last_sequence))
+            unacked = 0
+
+    sys.stderr.write(f"{reader.crc_errors} CRC errors, {reader.lost_frames} lost frames\n")
+    if chrome:
+        chrome.write(args.chrome_trace)
+
+
+def serial_source(args):
+    import serial
+
+    with serial.Serial(args.port, args.baud, timeout=0.1) as conn:
+        conn.write(host_packet(PKT_TYPE_ACK, 0, bytes([ACK_RESYNC])))
+        command_sequence = 0
+        if args.log_interval is not None:
+            conn.write(host_packet(PKT_TYPE_COMMAND, command_sequence,
+                                   struct.pack('<BH', CMD_LOG_INTERVAL, args.log_interval)))
+            command_sequence += 1
+        if args.snapshot:
+            conn.write(host_packet(PKT_TYPE_COMMAND, command_sequence, bytes([CMD_SNAPSHOT])))
+        deadline = time.time() + args.duration if args.duration else None
+        try:
+            while deadline is None or time.time() < deadline:
+                waiting = conn.in_waiting
+                yield conn.read(waiting if waiting else 1), conn
+        except KeyboardInterrupt:
+            pass
+
+
+def file_source(path):
+    with open(path, 'rb') as f:
+        while True:
+            data = f.read(65536)
+            if not data:
+                return
+            yield data, None
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument('--port', help='Stream port of the device')
+    source.add_argument('--file', help='Raw capture of the stream port')
+    parser.add_argument('--baud', type=int, default=921600, help='CONFIG_SAMPLE_STREAM_BAUD')
+    parser.add_argument('--duration', type=float, help='Seconds to read (default: until Ctrl+C)')
+    parser.add_argument('--log-interval', type=int, metavar='N',
+                        help='Have the device log every Nth inference result (0 = none)')
+    parser.add_argument('--snapshot', action='store_true', help='Request a snapshot right away')
+    parser.add_argument('--json', action='store_true', help='One JSON record per line')
+    parser.add_argument('--quiet', action='store_true', help='Do not echo device log frames')
+    parser.add_argument('--chrome-trace', metavar='FILE',
+                        help='Write the window stage traces as Chrome trace JSON')
+    args = parser.parse_args()
+
+    if args.log_interval is not None and not 0 <= args.log_interval <= 0xFFFF:
+        parser.error('--log-interval must be 0..65535')
+    if args.file and (args.log_interval is not None or args.snapshot):
+        parser.error('--log-interval and --snapshot need --port')
+
+    run(serial_source(args) if args.port else file_source(args.file), args)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())